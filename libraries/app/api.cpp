@@ -25,16 +25,94 @@
 
 #include <graphene/app/api.hpp>
 #include <graphene/app/api_access.hpp>
+#include <graphene/app/api_cost_limiter.hpp>
 #include <graphene/app/application.hpp>
+#include <graphene/account_history/account_history_plugin.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/get_config.hpp>
 #include <graphene/utilities/key_conversion.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <graphene/chain/transaction_object.hpp>
 
+#include <fc/crypto/base64.hpp>
 #include <fc/crypto/hex.hpp>
+#include <fc/io/raw.hpp>
 #include <fc/smart_ref_impl.hpp>
 
+namespace graphene { namespace app {
+
+    namespace detail {
+
+       /// Position of a get_relative_account_history_page() cursor
+       struct account_history_page_position
+       {
+          account_uid_type   account = 0;
+          optional<uint16_t> op_type;
+          uint32_t           next_sequence = 0;
+       };
+
+       /// Position of a get_account_history_by_block_range() cursor
+       struct account_history_block_position
+       {
+          account_uid_type   account = 0;
+          optional<uint16_t> op_type;
+          uint32_t           next_block = 0;
+          uint32_t           next_sequence = 0;
+       };
+
+       /// @return the first block at or after @p time, or the block after the head block if there is none
+       uint32_t get_first_block_at( const graphene::chain::database& db, fc::time_point_sec time )
+       {
+          uint32_t low = 1;
+          uint32_t high = db.head_block_num() + 1;
+          if( time > db.head_block_time() )
+             return high;
+          // block times go up with the block number, so a binary search over the block log finds it
+          while( low < high )
+          {
+             const uint32_t middle = low + ( high - low ) / 2;
+             const auto block = db.fetch_block_by_number( middle );
+             if( !block.valid() || block->timestamp < time )
+                low = middle + 1;
+             else
+                high = middle;
+          }
+          return low;
+       }
+
+       struct history_stream
+       {
+          uint32_t                                   id = 0;
+          uint32_t                                   chunk_size = 0;
+          std::function<void(const variant&)>        callback;
+          /// reads the page at a cursor, returns its records and the cursor of the next page
+          std::function<std::pair<variant,string>( const string&, uint32_t )> read_page;
+          string                                     cursor;
+          uint32_t                                   sent = 0;
+          uint32_t                                   acknowledged = 0;
+       };
+
+       /// @return the account history plugin if it keeps account history in its on-disk store
+       std::shared_ptr<account_history::account_history_plugin> get_history_store( const application& app )
+       {
+          auto plugin = std::dynamic_pointer_cast<account_history::account_history_plugin>( app.get_plugin( "account_history" ) );
+          if( plugin && plugin->has_history_store() )
+             return plugin;
+          return std::shared_ptr<account_history::account_history_plugin>();
+       }
+
+       /// chunks a stream may send ahead of the client's acknowledgements
+       const uint32_t history_stream_window = 4;
+       /// streams a connection may run at once
+       const size_t max_history_streams = 8;
+
+    }
+
+} } // graphene::app
+
+FC_REFLECT( graphene::app::detail::account_history_page_position, (account)(op_type)(next_sequence) )
+FC_REFLECT( graphene::app::detail::account_history_block_position, (account)(op_type)(next_block)(next_sequence) )
+
 namespace graphene { namespace app {
 
     login_api::login_api(application& a)
@@ -72,7 +150,7 @@ namespace graphene { namespace app {
     {
        if( api_name == "database_api" )
        {
-          _database_api = std::make_shared< database_api >(std::ref(*_app.chain_database()), &(_app.get_options()));
+          _database_api = get_database_api_instance();
        }
        else if( api_name == "block_api" )
        {
@@ -84,7 +162,7 @@ namespace graphene { namespace app {
        }
        else if( api_name == "history_api" )
        {
-          _history_api = std::make_shared< history_api >( _app );
+          _history_api = get_history_api_instance();
        }
        else if( api_name == "network_node_api" )
        {
@@ -96,7 +174,12 @@ namespace graphene { namespace app {
        }
        else if( api_name == "asset_api" )
        {
-          _asset_api = std::make_shared< asset_api >( std::ref( *_app.chain_database() ) );
+          _asset_api = std::make_shared< asset_api >( std::ref( _app ) );
+       }
+       else if( api_name == "raw_api" )
+       {
+          _raw_api = std::make_shared< raw_api >( std::ref( _app ), get_database_api_instance(),
+                                                  get_history_api_instance() );
        }
        else if( api_name == "debug_api" )
        {
@@ -107,6 +190,21 @@ namespace graphene { namespace app {
        return;
     }
 
+    std::shared_ptr< database_api > login_api::get_database_api_instance()
+    {
+       if( !_database_api_instance )
+          _database_api_instance = std::make_shared< database_api >( std::ref( *_app.chain_database() ),
+                                                                     &( _app.get_options() ) );
+       return _database_api_instance;
+    }
+
+    std::shared_ptr< history_api > login_api::get_history_api_instance()
+    {
+       if( !_history_api_instance )
+          _history_api_instance = std::make_shared< history_api >( _app );
+       return _history_api_instance;
+    }
+
     // block_api
     block_api::block_api(graphene::chain::database& db) : _db(db) { }
     block_api::~block_api() { }
@@ -121,6 +219,54 @@ namespace graphene { namespace app {
        return res;
     }
 
+    // raw_api
+    template<typename T>
+    static std::string pack_to_base64( const T& value )
+    {
+       const vector<char> packed = fc::raw::pack( value );
+       return fc::base64_encode( packed.data(), packed.size() );
+    }
+
+    raw_api::raw_api(application& app,
+                     std::shared_ptr<graphene::app::database_api> database_api,
+                     std::shared_ptr<history_api> history_api)
+       : _app( app ),
+         _db( *app.chain_database() ),
+         _block_api( *app.chain_database() ),
+         _database_api( std::move( database_api ) ),
+         _history_api( std::move( history_api ) )
+    { }
+
+    std::string raw_api::get_block(uint32_t block_num)const
+    {
+       return pack_to_base64( _db.fetch_block_by_number( block_num ) );
+    }
+
+    std::string raw_api::get_blocks(uint32_t block_num_from, uint32_t block_num_to)const
+    {
+       FC_ASSERT( block_num_to >= block_num_from );
+       FC_ASSERT( uint64_t( block_num_to - block_num_from ) < _app.get_options().api_limit_get_blocks,
+                  "At most ${n} blocks can be fetched in one call", ("n", _app.get_options().api_limit_get_blocks) );
+       return pack_to_base64( _block_api.get_blocks( block_num_from, block_num_to ) );
+    }
+
+    std::string raw_api::get_full_accounts_by_uid(const vector<account_uid_type>& uids,
+                                                  const full_account_query_options& options)
+    {
+       FC_ASSERT( uids.size() <= _app.get_options().api_limit_get_full_accounts,
+                  "At most ${n} accounts can be fetched in one call", ("n", _app.get_options().api_limit_get_full_accounts) );
+       return pack_to_base64( _database_api->get_full_accounts_by_uid( uids, options ) );
+    }
+
+    std::string raw_api::get_relative_account_history(account_uid_type account,
+                                                      optional<uint16_t> op_type,
+                                                      uint32_t stop,
+                                                      unsigned limit,
+                                                      uint32_t start)const
+    {
+       return pack_to_base64( _history_api->get_relative_account_history( account, op_type, stop, limit, start ) );
+    }
+
     network_broadcast_api::network_broadcast_api(application& a):_app(a)
     {
        _applied_block_connection = _app.chain_database()->applied_block.connect([this](const signed_block& b){ on_applied_block(b); });
@@ -200,6 +346,11 @@ namespace graphene { namespace app {
        return _app.p2p_node()->get_potential_peers();
     }
 
+    fc::variant_object network_node_api::get_api_cost_info() const
+    {
+       return _app.get_api_cost_limiter()->get_info();
+    }
+
     fc::variant_object network_node_api::get_advanced_node_parameters() const
     {
        return _app.p2p_node()->get_advanced_node_parameters();
@@ -252,6 +403,12 @@ namespace graphene { namespace app {
        return *_asset_api;
     }
 
+    fc::api<raw_api> login_api::raw() const
+    {
+       FC_ASSERT(_raw_api);
+       return *_raw_api;
+    }
+
     fc::api<graphene::debug_witness::debug_api> login_api::debug() const
     {
        FC_ASSERT(_debug_api);
@@ -266,6 +423,8 @@ namespace graphene { namespace app {
        FC_ASSERT( _app.chain_database() );
        const auto& db = *_app.chain_database();       
        FC_ASSERT( limit <= 100 );
+       if( auto store = detail::get_history_store( _app ) )
+          return store->get_account_operations_by_id( account(db).uid, optional<uint16_t>(), stop, limit, start );
        vector<operation_history_object> result;
        const auto& stats = account(db).statistics(db);
        if( stats.most_recent_op == account_transaction_history_id_type() ) return result;
@@ -294,6 +453,8 @@ namespace graphene { namespace app {
        FC_ASSERT( _app.chain_database() );
        const auto& db = *_app.chain_database();
        FC_ASSERT( limit <= 100 );
+       if( auto store = detail::get_history_store( _app ) )
+          return store->get_account_operations_by_id( account(db).uid, uint16_t( operation_id ), stop, limit, start );
        vector<operation_history_object> result;
        const auto& stats = account(db).statistics(db);
        if( stats.most_recent_op == account_transaction_history_id_type() ) return result;
@@ -327,6 +488,12 @@ namespace graphene { namespace app {
        FC_ASSERT(limit <= 100);
        vector<std::pair<uint32_t,operation_history_object>> result;
        const auto& stats = db.get_account_statistics_by_uid( account );
+       if( auto store = detail::get_history_store( _app ) )
+       {
+          if( start != 0 && start < stop )
+             return result;
+          return store->get_account_operations( account, op_type, start, stop, limit );
+       }
        if( start == 0 )
           start = stats.total_ops;
        else
@@ -431,6 +598,374 @@ namespace graphene { namespace app {
        } FC_CAPTURE_AND_RETHROW((asset_a)(asset_b)(limit))
     }
 
+    page<std::pair<uint32_t,operation_history_object>> history_api::get_relative_account_history_page( account_uid_type account,
+                                                                                                       optional<uint16_t> op_type,
+                                                                                                       const string& cursor,
+                                                                                                       uint32_t limit )const
+    {
+       FC_ASSERT( _app.chain_database() );
+       const auto& db = *_app.chain_database();
+       FC_ASSERT( limit <= _app.get_options().api_limit_page_size );
+
+       page<std::pair<uint32_t,operation_history_object>> result;
+       result.head_block_num = db.head_block_num();
+
+       const auto store = detail::get_history_store( _app );
+       detail::account_history_page_position pos;
+       pos.account = account;
+       pos.op_type = op_type;
+       if( cursor.empty() )
+       {
+          // the store starts at the latest operation for sequence 0, in the same call as the page
+          if( !store )
+             pos.next_sequence = db.get_account_statistics_by_uid( account ).total_ops;
+       }
+       else
+       {
+          const auto from = page_cursor::decode<detail::account_history_page_position>( cursor,
+                                                         page_cursor::relative_account_history, result.head_block_num );
+          FC_ASSERT( from.account == account && from.op_type == op_type, "The cursor was issued for a different query" );
+          pos.next_sequence = from.next_sequence;
+          if( pos.next_sequence == 0 )
+             return result;
+       }
+
+       if( store )
+       {
+          result.items = store->get_account_operations( account, op_type, pos.next_sequence, 1, limit + 1 );
+          if( result.items.size() > limit )
+          {
+             pos.next_sequence = result.items.back().first;
+             result.next_cursor = page_cursor::encode( page_cursor::relative_account_history, result.head_block_num, pos );
+             result.items.pop_back();
+          }
+          return result;
+       }
+
+       const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
+       if( !op_type.valid() )
+       {
+          const auto& by_seq_idx = hist_idx.indices().get<by_seq>();
+          auto range_begin = by_seq_idx.lower_bound( boost::make_tuple( account ) );
+          auto itr = by_seq_idx.upper_bound( boost::make_tuple( account, pos.next_sequence ) );
+          while( itr != range_begin )
+          {
+             --itr;
+             if( result.items.size() >= limit )
+             {
+                pos.next_sequence = itr->sequence;
+                result.next_cursor = page_cursor::encode( page_cursor::relative_account_history, result.head_block_num, pos );
+                break;
+             }
+             result.items.push_back( std::make_pair( itr->sequence, itr->operation_id(db) ) );
+          }
+       }
+       else
+       {
+          const auto& by_type_seq_idx = hist_idx.indices().get<by_type_seq>();
+          auto range_begin = by_type_seq_idx.lower_bound( boost::make_tuple( account, *op_type ) );
+          auto itr = by_type_seq_idx.upper_bound( boost::make_tuple( account, *op_type, pos.next_sequence ) );
+          while( itr != range_begin )
+          {
+             --itr;
+             if( result.items.size() >= limit )
+             {
+                pos.next_sequence = itr->sequence;
+                result.next_cursor = page_cursor::encode( page_cursor::relative_account_history, result.head_block_num, pos );
+                break;
+             }
+             result.items.push_back( std::make_pair( itr->sequence, itr->operation_id(db) ) );
+          }
+       }
+       return result;
+    }
+
+    page<std::pair<uint32_t,operation_history_object>> history_api::get_account_history_by_block_range( account_uid_type account,
+                                                                                                        optional<uint16_t> op_type,
+                                                                                                        uint32_t start_block,
+                                                                                                        uint32_t end_block,
+                                                                                                        const string& cursor,
+                                                                                                        uint32_t limit )const
+    {
+       FC_ASSERT( _app.chain_database() );
+       const auto& db = *_app.chain_database();
+       FC_ASSERT( limit <= _app.get_options().api_limit_page_size );
+
+       page<std::pair<uint32_t,operation_history_object>> result;
+       result.head_block_num = db.head_block_num();
+
+       detail::account_history_block_position pos;
+       pos.account = account;
+       pos.op_type = op_type;
+       pos.next_block = start_block;
+       if( !cursor.empty() )
+       {
+          const auto from = page_cursor::decode<detail::account_history_block_position>( cursor,
+                                                         page_cursor::account_history_by_block, result.head_block_num );
+          FC_ASSERT( from.account == account && from.op_type == op_type && from.next_block >= start_block,
+                     "The cursor was issued for a different query" );
+          pos = from;
+       }
+       if( pos.next_block >= end_block )
+          return result;
+
+       if( auto store = detail::get_history_store( _app ) )
+       {
+          result.items = store->get_account_operations_by_block( account, op_type, pos.next_block, end_block,
+                                                                 pos.next_sequence, limit + 1 );
+          if( result.items.size() > limit )
+          {
+             pos.next_block = result.items.back().second.block_num;
+             pos.next_sequence = result.items.back().first;
+             result.next_cursor = page_cursor::encode( page_cursor::account_history_by_block, result.head_block_num, pos );
+             result.items.pop_back();
+          }
+          return result;
+       }
+
+       const auto& hist_idx = db.get_index_type<account_transaction_history_index>();
+       if( !op_type.valid() )
+       {
+          const auto& by_block_idx = hist_idx.indices().get<by_account_block>();
+          auto itr = by_block_idx.lower_bound( boost::make_tuple( account, pos.next_block, pos.next_sequence ) );
+          auto end = by_block_idx.lower_bound( boost::make_tuple( account, end_block ) );
+          for( ; itr != end; ++itr )
+          {
+             if( result.items.size() >= limit )
+             {
+                pos.next_block = itr->block_num;
+                pos.next_sequence = itr->sequence;
+                result.next_cursor = page_cursor::encode( page_cursor::account_history_by_block, result.head_block_num, pos );
+                break;
+             }
+             result.items.push_back( std::make_pair( itr->sequence, itr->operation_id(db) ) );
+          }
+       }
+       else
+       {
+          const auto& by_type_block_idx = hist_idx.indices().get<by_type_block>();
+          auto itr = by_type_block_idx.lower_bound( boost::make_tuple( account, *op_type, pos.next_block, pos.next_sequence ) );
+          auto end = by_type_block_idx.lower_bound( boost::make_tuple( account, *op_type, end_block ) );
+          for( ; itr != end; ++itr )
+          {
+             if( result.items.size() >= limit )
+             {
+                pos.next_block = itr->block_num;
+                pos.next_sequence = itr->sequence;
+                result.next_cursor = page_cursor::encode( page_cursor::account_history_by_block, result.head_block_num, pos );
+                break;
+             }
+             result.items.push_back( std::make_pair( itr->sequence, itr->operation_id(db) ) );
+          }
+       }
+       return result;
+    }
+
+    page<std::pair<uint32_t,operation_history_object>> history_api::get_account_history_by_time( account_uid_type account,
+                                                                                                 optional<uint16_t> op_type,
+                                                                                                 fc::time_point_sec start,
+                                                                                                 fc::time_point_sec end,
+                                                                                                 const string& cursor,
+                                                                                                 uint32_t limit )const
+    {
+       FC_ASSERT( _app.chain_database() );
+       const auto& db = *_app.chain_database();
+       return get_account_history_by_block_range( account, op_type, detail::get_first_block_at( db, start ),
+                                                  detail::get_first_block_at( db, end ), cursor, limit );
+    }
+
+    page<bucket_object> history_api::get_market_history_page( std::string asset_a, std::string asset_b, uint32_t bucket_seconds,
+                                                              fc::time_point_sec start, fc::time_point_sec end,
+                                                              const string& cursor, uint32_t limit )const
+    {
+       try {
+          FC_ASSERT( _app.chain_database() );
+          const auto& db = *_app.chain_database();
+          FC_ASSERT( limit <= _app.get_options().api_limit_page_size );
+          asset_aid_type a = database_api.get_asset_id_from_string( asset_a );
+          asset_aid_type b = database_api.get_asset_id_from_string( asset_b );
+          if( a > b ) std::swap( a, b );
+
+          page<bucket_object> result;
+          result.head_block_num = db.head_block_num();
+
+          bucket_key key( a, b, bucket_seconds, start );
+          if( !cursor.empty() )
+          {
+             key = page_cursor::decode<bucket_key>( cursor, page_cursor::market_history, result.head_block_num );
+             FC_ASSERT( key.base == a && key.quote == b && key.seconds == bucket_seconds,
+                        "The cursor was issued for a different query" );
+          }
+
+          const auto& by_key_idx = db.get_index_type<bucket_index>().indices().get<by_key>();
+          auto itr = by_key_idx.lower_bound( key );
+          while( itr != by_key_idx.end() && itr->key.base == a && itr->key.quote == b
+                 && itr->key.seconds == bucket_seconds && itr->key.open <= end )
+          {
+             if( result.items.size() >= limit )
+             {
+                result.next_cursor = page_cursor::encode( page_cursor::market_history, result.head_block_num, itr->key );
+                break;
+             }
+             result.items.push_back( *itr );
+             ++itr;
+          }
+          return result;
+       } FC_CAPTURE_AND_RETHROW( (asset_a)(asset_b)(bucket_seconds)(start)(end)(cursor)(limit) )
+    }
+
+    vector<market_candle> history_api::get_market_candles( std::string asset_a, std::string asset_b, uint32_t seconds,
+                                                           fc::time_point_sec start, fc::time_point_sec end,
+                                                           uint32_t limit )const
+    {
+       try {
+          FC_ASSERT( _app.chain_database() );
+          FC_ASSERT( limit <= _app.get_options().api_limit_page_size );
+          auto plugin = std::dynamic_pointer_cast<market_history::market_history_plugin>( _app.get_plugin( "market_history" ) );
+          FC_ASSERT( plugin, "Market history plugin is not enabled." );
+          asset_aid_type a = database_api.get_asset_id_from_string( asset_a );
+          asset_aid_type b = database_api.get_asset_id_from_string( asset_b );
+          if( a > b ) std::swap( a, b );
+
+          return plugin->market_candles().get_candles( *_app.chain_database(), std::make_pair( a, b ), seconds,
+                                                       start, end, limit );
+       } FC_CAPTURE_AND_RETHROW( (asset_a)(asset_b)(seconds)(start)(end)(limit) )
+    }
+
+    uint32_t history_api::stream_relative_account_history( std::function<void(const variant&)> callback,
+                                                           account_uid_type account,
+                                                           optional<uint16_t> op_type,
+                                                           uint32_t chunk_size )
+    {
+       // fail early on an unknown account rather than in the first chunk
+       FC_ASSERT( _app.chain_database() );
+       _app.chain_database()->get_account_statistics_by_uid( account );
+       return add_stream( callback, chunk_size, [this,account,op_type]( const string& cursor, uint32_t limit ) {
+          auto p = get_relative_account_history_page( account, op_type, cursor, limit );
+          return std::make_pair( variant( p.items, GRAPHENE_NET_MAX_NESTED_OBJECTS ), p.next_cursor );
+       });
+    }
+
+    uint32_t history_api::stream_market_history( std::function<void(const variant&)> callback,
+                                                 std::string a, std::string b, uint32_t bucket_seconds,
+                                                 fc::time_point_sec start, fc::time_point_sec end,
+                                                 uint32_t chunk_size )
+    {
+       database_api.get_asset_id_from_string( a );
+       database_api.get_asset_id_from_string( b );
+       return add_stream( callback, chunk_size, [=]( const string& cursor, uint32_t limit ) {
+          auto p = get_market_history_page( a, b, bucket_seconds, start, end, cursor, limit );
+          return std::make_pair( variant( p.items, GRAPHENE_NET_MAX_NESTED_OBJECTS ), p.next_cursor );
+       });
+    }
+
+    uint32_t history_api::stream_trade_history( std::function<void(const variant&)> callback,
+                                                std::string base, std::string quote,
+                                                fc::time_point_sec start, fc::time_point_sec stop,
+                                                uint32_t chunk_size )
+    {
+       FC_ASSERT( _app.get_options().has_market_history_plugin, "Market history plugin is not enabled." );
+       database_api.get_asset_id_from_string( base );
+       database_api.get_asset_id_from_string( quote );
+       return add_stream( callback, chunk_size, [=]( const string& cursor, uint32_t limit ) {
+          auto p = database_api.get_trade_history_page( base, quote, start, stop, cursor, limit );
+          return std::make_pair( variant( p.items, GRAPHENE_NET_MAX_NESTED_OBJECTS ), p.next_cursor );
+       });
+    }
+
+    account_history_watermark history_api::get_account_history_watermark()const
+    {
+       FC_ASSERT( _app.chain_database() );
+       account_history_watermark result;
+       result.head_block_num = _app.chain_database()->head_block_num();
+       result.indexed_block_num = result.head_block_num;
+       if( auto store = detail::get_history_store( _app ) )
+       {
+          result.indexed_block_num = store->get_indexed_block_num();
+          result.stored_block_num = store->get_stored_block_num();
+          result.error = store->get_indexing_error();
+       }
+       return result;
+    }
+
+    void history_api::ack_stream( uint32_t stream_id, uint32_t sequence )
+    {
+       auto itr = _streams.find( stream_id );
+       if( itr == _streams.end() )
+          return;
+       auto stream = itr->second;
+       FC_ASSERT( sequence < stream->sent, "Chunk ${s} of stream ${id} has not been sent yet",
+                  ("s", sequence)("id", stream_id) );
+       stream->acknowledged = std::max( stream->acknowledged, sequence + 1 );
+       send_stream_chunks( stream );
+    }
+
+    void history_api::cancel_stream( uint32_t stream_id )
+    {
+       _streams.erase( stream_id );
+    }
+
+    uint32_t history_api::add_stream( std::function<void(const variant&)> callback, uint32_t chunk_size,
+                                      std::function<std::pair<variant,string>( const string&, uint32_t )> read_page )
+    {
+       FC_ASSERT( chunk_size > 0 && chunk_size <= _app.get_options().api_limit_page_size );
+       FC_ASSERT( _streams.size() < detail::max_history_streams, "Too many streams running on this connection" );
+
+       auto stream = std::make_shared<detail::history_stream>();
+       stream->id = _next_stream_id++;
+       stream->chunk_size = chunk_size;
+       stream->callback = callback;
+       stream->read_page = read_page;
+       _streams[stream->id] = stream;
+
+       // start sending once the stream id has been returned to the client
+       std::weak_ptr<detail::history_stream> weak_stream = stream;
+       fc::async( [this,weak_stream]() {
+          if( auto s = weak_stream.lock() )
+             send_stream_chunks( s );
+       } );
+       return stream->id;
+    }
+
+    void history_api::send_stream_chunks( const std::shared_ptr<detail::history_stream>& stream )
+    {
+       while( stream->sent - stream->acknowledged < detail::history_stream_window )
+       {
+          history_stream_chunk chunk;
+          chunk.stream_id = stream->id;
+          chunk.sequence = stream->sent;
+          try
+          {
+             auto result = stream->read_page( stream->cursor, stream->chunk_size );
+             chunk.items = std::move( result.first );
+             stream->cursor = result.second;
+             chunk.last = stream->cursor.empty();
+          }
+          catch( const fc::exception& e )
+          {
+             chunk.items = fc::variants();
+             chunk.last = true;
+             chunk.error = e.to_string();
+          }
+          ++stream->sent;
+          if( chunk.last )
+             _streams.erase( stream->id );
+          try
+          {
+             stream->callback( variant( chunk, GRAPHENE_NET_MAX_NESTED_OBJECTS ) );
+          }
+          catch( const fc::exception& e )
+          {
+             // the client has gone away
+             wlog( "Stopping history stream ${id}: ${e}", ("id", stream->id)("e", e.to_string()) );
+             _streams.erase( stream->id );
+             break;
+          }
+          if( chunk.last )
+             break;
+       }
+    }
+
     crypto_api::crypto_api(){};
     
     blind_signature crypto_api::blind_sign( const extended_private_key_type& key, const blinded_hash& hash, int i )
@@ -502,54 +1037,64 @@ namespace graphene { namespace app {
     }
 
     // asset_api
-    asset_api::asset_api(graphene::chain::database& db) : _db(db) { }
+    asset_api::asset_api(application& app) : _app(app), _db(*app.chain_database()) { }
     asset_api::~asset_api() { }
 
     vector<account_asset_balance> asset_api::get_asset_holders( asset_aid_type asset_id ) const {
+      return get_asset_holders_page( asset_id, string(), _app.get_options().api_limit_get_asset_holders ).items;
+    }
 
-      const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
-      auto range = bal_idx.equal_range( asset_id );
-
-      vector<account_asset_balance> result;
+    page<account_asset_balance> asset_api::get_asset_holders_page( asset_aid_type asset_id, const string& cursor,
+                                                                   uint32_t limit ) const {
+      try {
+        FC_ASSERT( limit <= _app.get_options().api_limit_get_asset_holders );
 
-      for( const account_balance_object& bal : boost::make_iterator_range( range.first, range.second ) )
-      {
-        if( bal.balance.value == 0 ) break; // ordered
+        page<account_asset_balance> result;
+        result.head_block_num = _db.head_block_num();
 
-        account_asset_balance aab;
-        aab.account_uid = bal.owner;
-        aab.amount      = bal.balance.value;
+        // holders are ordered by balance from the largest, then by account
+        std::pair<share_type, account_uid_type> from( GRAPHENE_MAX_SHARE_SUPPLY, 0 );
+        if( !cursor.empty() )
+          from = page_cursor::decode< std::pair<share_type, account_uid_type> >( cursor, page_cursor::asset_holders,
+                                                                                result.head_block_num );
 
-        result.push_back(aab);
-      }
-
-      return result;
+        const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
+        auto itr = bal_idx.lower_bound( boost::make_tuple( asset_id, from.first, from.second ) );
+        for( ; itr != bal_idx.end() && itr->asset_type == asset_id && itr->balance.value != 0; ++itr )
+        {
+          if( result.items.size() >= limit )
+          {
+            result.next_cursor = page_cursor::encode( page_cursor::asset_holders, result.head_block_num,
+                                                      std::make_pair( itr->balance, itr->owner ) );
+            break;
+          }
+          account_asset_balance aab;
+          aab.account_uid = itr->owner;
+          aab.amount      = itr->balance.value;
+          result.items.push_back( aab );
+        }
+        return result;
+      } FC_CAPTURE_AND_RETHROW( (asset_id)(cursor)(limit) )
     }
+
     // get number of asset holders.
     uint64_t asset_api::get_asset_holders_count( asset_aid_type asset_id ) const {
-
-      const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
-      auto range = bal_idx.equal_range( asset_id );
-      // TODO FIXME filter out accounts with balance == 0
-      uint64_t count = boost::distance(range) - 1;
-
-      return count;
+      const auto& bal_idx = dynamic_cast<const primary_index<account_balance_index>&>( _db.get_index_type<account_balance_index>() );
+      const auto& holder_counts = bal_idx.get_secondary_index<graphene::chain::asset_holder_count_index>();
+      return holder_counts.get_holder_count( asset_id );
     }
     // function to get vector of system assets with holders count.
     vector<asset_holders> asset_api::get_all_asset_holders() const {
-            
+
+      const auto& bal_idx = dynamic_cast<const primary_index<account_balance_index>&>( _db.get_index_type<account_balance_index>() );
+      const auto& holder_counts = bal_idx.get_secondary_index<graphene::chain::asset_holder_count_index>();
       vector<asset_holders> result;
-            
+
       for( const asset_object& asset_obj : _db.get_index_type<asset_index>().indices() )
       {
-        const auto& bal_idx = _db.get_index_type< account_balance_index >().indices().get< by_asset_balance >();
-        auto range = bal_idx.equal_range( asset_obj.asset_id );
-        // TODO FIXME filter out accounts with balance == 0
-        uint64_t count = boost::distance(range) - 1;
-                
         asset_holders ah;
         ah.asset_id  = asset_obj.asset_id;
-        ah.count     = count;
+        ah.count     = holder_counts.get_holder_count( asset_obj.asset_id );
 
         result.push_back(ah);
       }
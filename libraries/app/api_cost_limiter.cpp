@@ -0,0 +1,199 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/api_cost_limiter.hpp>
+
+#include <algorithm>
+
+namespace graphene { namespace app {
+
+namespace {
+   /// weights of methods that touch many objects, every other method weighs 1
+   const std::map<std::string, double>& default_method_weights()
+   {
+      static const std::map<std::string, double> weights = {
+         { "get_account_history_by_time",       10 },
+         { "get_all_asset_holders",             10 },
+         { "get_asset_holders",                 5 },
+         { "get_asset_holders_page",            5 },
+         { "get_blocks",                        20 },
+         { "get_full_accounts",                 10 },
+         { "get_full_accounts_by_uid",          10 },
+         { "get_top_markets",                   10 },
+         { "lookup_platforms",                  10 },
+         { "get_account_history_by_block_range", 5 },
+         { "get_account_references",            5 },
+         { "get_key_references",                5 },
+         { "get_market_candles",                5 },
+         { "get_market_history",                5 },
+         { "get_market_history_page",           5 },
+         { "get_order_book",                    5 },
+         { "get_relative_account_history",      5 },
+         { "get_relative_account_history_page", 5 },
+         { "get_trade_history",                 5 },
+         { "get_trade_history_by_sequence",     5 },
+         { "get_trade_history_page",            5 },
+         { "list_scores",                       5 },
+         { "list_scores_page",                  5 }
+      };
+      return weights;
+   }
+}
+
+api_token_bucket::api_token_bucket( double capacity, double refill_per_second )
+   : _capacity( capacity ),
+     _refill_per_second( refill_per_second ),
+     _tokens( capacity ),
+     _last_refill( fc::time_point::now() )
+{
+}
+
+void api_token_bucket::refill()
+{
+   const fc::time_point now = fc::time_point::now();
+   _tokens = std::min( _capacity, _tokens + ( now - _last_refill ).count() * _refill_per_second / 1000000.0 );
+   _last_refill = now;
+}
+
+bool api_token_bucket::has( double cost )
+{
+   refill();
+   // a call that costs more than the whole bucket only needs a full one
+   return _tokens >= std::min( cost, _capacity );
+}
+
+void api_token_bucket::take( double cost )
+{
+   refill();
+   _tokens -= cost;
+}
+
+fc::microseconds api_token_bucket::time_until( double cost )
+{
+   refill();
+   const double missing = std::min( cost, _capacity ) - _tokens;
+   if( missing <= 0 )
+      return fc::microseconds();
+   if( _refill_per_second <= 0 )
+      return fc::microseconds::maximum();
+   return fc::microseconds( int64_t( missing * 1000000.0 / _refill_per_second ) + 1 );
+}
+
+api_cost_limiter::api_cost_limiter( const options& opts )
+   : _options( opts )
+{
+}
+
+double api_cost_limiter::estimate( const std::string& method, size_t items )const
+{
+   double weight = 1;
+   auto itr = _options.method_weights.find( method );
+   if( itr != _options.method_weights.end() )
+      weight = itr->second;
+   else
+   {
+      auto default_itr = default_method_weights().find( method );
+      if( default_itr != default_method_weights().end() )
+         weight = default_itr->second;
+   }
+   return weight * std::max<size_t>( items, 1 );
+}
+
+double api_cost_limiter::time_cost( const fc::microseconds& elapsed )
+{
+   return elapsed.count() / 1000.0;
+}
+
+std::unique_ptr<api_token_bucket> api_cost_limiter::make_connection_bucket()const
+{
+   if( _options.connection_capacity <= 0 )
+      return std::unique_ptr<api_token_bucket>();
+   return std::unique_ptr<api_token_bucket>( new api_token_bucket( _options.connection_capacity,
+                                                                   _options.connection_refill ) );
+}
+
+std::shared_ptr<api_token_bucket> api_cost_limiter::get_user_bucket( const std::string& user )
+{
+   if( _options.user_capacity <= 0 )
+      return std::shared_ptr<api_token_bucket>();
+   auto& bucket = _user_buckets[user];
+   if( !bucket )
+      bucket = std::make_shared<api_token_bucket>( _options.user_capacity, _options.user_refill );
+   return bucket;
+}
+
+const size_t api_cost_limiter::max_tracked_methods;
+
+api_cost_limiter::method_stats& api_cost_limiter::stats_of( const std::string& method )
+{
+   auto itr = _stats.find( method );
+   if( itr != _stats.end() )
+      return itr->second;
+   // method names come from requests and must not grow the map without bound
+   if( _stats.size() >= max_tracked_methods )
+      return _other_stats;
+   return _stats[method];
+}
+
+void api_cost_limiter::record_call( const std::string& method, double cost, const fc::microseconds& elapsed )
+{
+   auto& stats = stats_of( method );
+   ++stats.calls;
+   stats.cost += cost;
+   stats.time_us += elapsed.count();
+}
+
+void api_cost_limiter::record_rejection( const std::string& method )
+{
+   ++stats_of( method ).rejected;
+}
+
+fc::variant_object api_cost_limiter::get_info()const
+{
+   fc::mutable_variant_object methods;
+   uint64_t calls = 0;
+   uint64_t rejected = 0;
+   auto add_method = [&]( const std::string& name, const method_stats& stats )
+   {
+      methods[name] = fc::mutable_variant_object()
+         ( "calls", stats.calls )
+         ( "rejected", stats.rejected )
+         ( "cost", stats.cost )
+         ( "time_us", stats.time_us );
+      calls += stats.calls;
+      rejected += stats.rejected;
+   };
+   for( const auto& method : _stats )
+      add_method( method.first, method.second );
+   if( _other_stats.calls > 0 || _other_stats.rejected > 0 )
+      add_method( "(other)", _other_stats );
+
+   return fc::mutable_variant_object()
+      ( "enabled", enabled() )
+      ( "calls", calls )
+      ( "rejected", rejected )
+      ( "users", _user_buckets.size() )
+      ( "methods", methods );
+}
+
+} } // graphene::app
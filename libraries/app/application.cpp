@@ -23,8 +23,12 @@
  */
 #include <graphene/app/api.hpp>
 #include <graphene/app/api_access.hpp>
+#include <graphene/app/api_cost_limiter.hpp>
 #include <graphene/app/application.hpp>
+#include <graphene/app/json_writer.hpp>
+#include <graphene/app/metrics.hpp>
 #include <graphene/app/plugin.hpp>
+#include <graphene/app/websocket_rpc_connection.hpp>
 
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <graphene/chain/protocol/types.hpp>
@@ -41,6 +45,7 @@
 #include <fc/io/fstream.hpp>
 #include <fc/rpc/api_connection.hpp>
 #include <fc/rpc/websocket_api.hpp>
+#include <fc/network/http/server.hpp>
 #include <fc/network/resolve.hpp>
 #include <fc/crypto/base64.hpp>
 
@@ -124,6 +129,22 @@ namespace detail {
       return initial_state;
    }
 
+   /**
+    * Observes how long the handlers of @p sig take, from the first to the last one connected when
+    * this is called.  Handlers connected later, like those of API subscriptions, are not included.
+    */
+   template<typename... Args>
+   void observe_signal_handlers( fc::signal<void(Args...)>& sig, const std::shared_ptr<metrics_registry>& metrics,
+                                 const string& handler )
+   {
+      auto start = std::make_shared<fc::time_point>();
+      const string labels = metrics_registry::label( "signal", handler );
+      sig.connect( [start]( Args... ){ *start = fc::time_point::now(); }, boost::signals2::at_front );
+      sig.connect( [start,metrics,labels]( Args... ){
+         metrics->observe( "yoyow_plugin_handler_duration_seconds", fc::time_point::now() - *start, labels );
+      } );
+   }
+
    class application_impl : public net::node_delegate
    {
    public:
@@ -240,13 +261,47 @@ namespace detail {
          FC_CAPTURE_AND_RETHROW((endpoint_string))
       }
 
+      /**
+       * Database API calls that return large, deeply nested results are answered with JSON written
+       * straight from the result objects instead of going through fc::variant.
+       */
+      static void register_streamed_database_methods( websocket_rpc_connection& wsc, fc::api_id_type api_id,
+                                                      const fc::api<graphene::app::database_api>& db_api )
+      {
+         const uint32_t depth = GRAPHENE_NET_MAX_NESTED_OBJECTS;
+         wsc.register_streamed_method( api_id, "get_block", [db_api,depth]( const fc::variants& args ) {
+            FC_ASSERT( args.size() == 1 );
+            return to_json( db_api->get_block( args[0].as<uint32_t>( depth ) ), depth );
+         });
+         wsc.register_streamed_method( api_id, "list_scores", [db_api,depth]( const fc::variants& args ) {
+            FC_ASSERT( args.size() == 6 );
+            return to_json( db_api->list_scores( args[0].as<chain::account_uid_type>( depth ),
+                                                 args[1].as<chain::account_uid_type>( depth ),
+                                                 args[2].as<chain::post_pid_type>( depth ),
+                                                 args[3].as<chain::object_id_type>( depth ),
+                                                 args[4].as<uint32_t>( depth ),
+                                                 args[5].as<bool>( depth ) ), depth );
+         });
+         wsc.register_streamed_method( api_id, "get_posts_by_platform_poster", [db_api,depth]( const fc::variants& args ) {
+            FC_ASSERT( args.size() == 4 );
+            return to_json( db_api->get_posts_by_platform_poster(
+                                             args[0].as<chain::account_uid_type>( depth ),
+                                             args[1].as<optional<chain::account_uid_type>>( depth ),
+                                             args[2].as<chain::object_id_type>( depth ),
+                                             args[3].as<uint32_t>( depth ) ), depth );
+         });
+      }
+
       void new_connection( const fc::http::websocket_connection_ptr& c )
       {
-         auto wsc = std::make_shared<fc::rpc::websocket_api_connection>(*c, GRAPHENE_NET_MAX_NESTED_OBJECTS);
+         auto wsc = std::make_shared<websocket_rpc_connection>(*c, GRAPHENE_NET_MAX_NESTED_OBJECTS, _app_options.rpc_max_batch_size,
+                                                               _api_cost_limiter);
          auto login = std::make_shared<graphene::app::login_api>( std::ref(*_self) );
          login->enable_api("database_api");
 
-         wsc->register_api(login->database());
+         auto db_api = login->database();
+         auto db_api_id = wsc->register_api(db_api);
+         register_streamed_database_methods(*wsc, db_api_id, db_api);
          wsc->register_api(fc::api<graphene::app::login_api>(login));
          c->set_session_data( wsc );
 
@@ -269,7 +324,10 @@ namespace detail {
             password = parts[1];
          }
 
-         login->login(username, password);
+         if( login->login(username, password) )
+            wsc->set_user(username);
+         if( _metrics )
+            wsc->set_metrics(_metrics);
       }
 
       void reset_websocket_server()
@@ -286,6 +344,32 @@ namespace detail {
       } FC_CAPTURE_AND_RETHROW() }
 
 
+      void reset_metrics_server()
+      { try {
+         if( !_metrics )
+            return;
+
+         const string endpoint = _options->at("metrics-endpoint").as<string>();
+         _metrics_server = std::make_shared<fc::http::server>();
+         _metrics_server->listen( fc::ip::endpoint::from_string(endpoint) );
+         // on_request() must come after listen()
+         _metrics_server->on_request( [this]( const fc::http::request& req, const fc::http::server::response& resp )
+         {
+            if( req.path != "/metrics" && req.path != "/" )
+            {
+               resp.set_status( fc::http::reply::NotFound );
+               resp.set_length( 0 );
+               return;
+            }
+            const string body = _metrics->render();
+            resp.add_header( "Content-Type", "text/plain; version=0.0.4" );
+            resp.set_status( fc::http::reply::OK );
+            resp.set_length( body.size() );
+            resp.write( body.data(), body.size() );
+         } );
+         ilog("Serving metrics on http://${ip}/metrics", ("ip",endpoint));
+      } FC_CAPTURE_AND_RETHROW() }
+
       void reset_websocket_tls_server()
       { try {
          if( !_options->count("rpc-tls-endpoint") )
@@ -349,10 +433,143 @@ namespace detail {
          if (_options->count("api-limit-get-htlc-by")) {
             _app_options.api_limit_get_htlc_by = _options->at("api-limit-get-htlc-by").as<uint64_t>();
          }
+         if (_options->count("api-limit-page-size")) {
+            _app_options.api_limit_page_size = _options->at("api-limit-page-size").as<uint64_t>();
+         }
+         if (_options->count("api-limit-get-blocks")) {
+            _app_options.api_limit_get_blocks = _options->at("api-limit-get-blocks").as<uint64_t>();
+         }
+         if (_options->count("api-limit-get-full-accounts")) {
+            _app_options.api_limit_get_full_accounts = _options->at("api-limit-get-full-accounts").as<uint64_t>();
+         }
+         if (_options->count("api-limit-subscribed-objects")) {
+            _app_options.api_limit_subscribed_objects = _options->at("api-limit-subscribed-objects").as<uint64_t>();
+         }
+         if (_options->count("rpc-max-batch-size")) {
+            _app_options.rpc_max_batch_size = _options->at("rpc-max-batch-size").as<uint32_t>();
+         }
+      }
+
+      void set_api_cache()
+      {
+         if (_options->count("api-cache-methods")) {
+            std::vector<string> methods;
+            boost::split(methods, _options->at("api-cache-methods").as<string>(), [](char c){return c == ' ';});
+            for (const string& method : methods)
+            {
+               if (method.empty())
+                  continue;
+               FC_ASSERT(database_api::cacheable_methods().count(method),
+                         "api-cache-methods: ${m} is not a cacheable database API method, supported: ${s}",
+                         ("m", method)("s", database_api::cacheable_methods()));
+               _app_options.api_cache_methods.insert(method);
+            }
+            ilog("Caching responses of database API methods ${m}", ("m", _app_options.api_cache_methods));
+         }
+         if (_options->count("api-cache-max-size")) {
+            _app_options.api_cache_max_size = _options->at("api-cache-max-size").as<uint64_t>();
+         }
+      }
+
+      void set_api_budgets()
+      {
+         api_cost_limiter::options budgets;
+         if (_options->count("api-budget-connection-capacity"))
+            budgets.connection_capacity = _options->at("api-budget-connection-capacity").as<double>();
+         if (_options->count("api-budget-connection-refill"))
+            budgets.connection_refill = _options->at("api-budget-connection-refill").as<double>();
+         if (_options->count("api-budget-user-capacity"))
+            budgets.user_capacity = _options->at("api-budget-user-capacity").as<double>();
+         if (_options->count("api-budget-user-refill"))
+            budgets.user_refill = _options->at("api-budget-user-refill").as<double>();
+         if (_options->count("api-budget-max-wait-ms"))
+            budgets.max_wait_ms = _options->at("api-budget-max-wait-ms").as<uint32_t>();
+         if (_options->count("api-method-weights")) {
+            std::vector<string> entries;
+            boost::split(entries, _options->at("api-method-weights").as<string>(), [](char c){return c == ' ';});
+            for (const string& entry : entries)
+            {
+               if (entry.empty())
+                  continue;
+               auto pos = entry.find(':');
+               FC_ASSERT(pos != string::npos && pos > 0, "Bad api-method-weights entry ${e}, expected method:weight", ("e", entry));
+               budgets.method_weights[entry.substr(0, pos)] = boost::lexical_cast<double>(entry.substr(pos + 1));
+            }
+         }
+         _api_cost_limiter = std::make_shared<api_cost_limiter>(budgets);
+         if (_api_cost_limiter->enabled())
+            ilog("API budgets: ${c} per connection refilling ${cr}/s, ${u} per user refilling ${ur}/s",
+                 ("c", budgets.connection_capacity)("cr", budgets.connection_refill)
+                 ("u", budgets.user_capacity)("ur", budgets.user_refill));
+      }
+
+      void set_metrics()
+      {
+         if( !_options->count("metrics-endpoint") )
+            return;
+
+         _metrics = std::make_shared<metrics_registry>();
+         auto& m = *_metrics;
+         const auto& durations = metrics_registry::duration_buckets();
+         m.declare_histogram( "yoyow_block_apply_duration_seconds", "Time to push a block received from the network", durations );
+         m.declare_histogram( "yoyow_block_transactions", "Transactions per applied block",
+                              { 0, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000, 5000 } );
+         m.declare_counter( "yoyow_blocks_applied_total", "Blocks applied, including blocks produced by this node" );
+         m.declare_histogram( "yoyow_plugin_handler_duration_seconds", "Time spent in the handlers of a database signal per emission", durations );
+         m.declare_gauge( "yoyow_head_block_number", "Number of the head block" );
+         m.declare_gauge( "yoyow_pending_transactions", "Transactions waiting for the next block" );
+         m.declare_gauge( "yoyow_undo_stack_depth", "Undo sessions that can still be rolled back" );
+         m.declare_gauge( "yoyow_fork_db_blocks", "Blocks in the fork database" );
+         m.declare_gauge( "yoyow_index_objects", "Objects per index, labelled with the space and type id" );
+         m.declare_gauge( "yoyow_p2p_peers", "Connected p2p peers" );
+         m.declare_gauge( "yoyow_p2p_peer_bytes", "Bytes exchanged with the currently connected p2p peers" );
+         m.declare_counter( "yoyow_api_calls_total", "API calls handled, by method" );
+         m.declare_counter( "yoyow_api_rejected_calls_total", "API calls rejected because the budget ran out, by method" );
+         m.declare_histogram( "yoyow_api_call_duration_seconds", "Time to handle an API call, by method", durations );
+
+         auto metrics = _metrics;
+         _chain_db->applied_block.connect( [metrics]( const signed_block& b ){
+            metrics->increment( "yoyow_blocks_applied_total" );
+            metrics->observe( "yoyow_block_transactions", b.transactions.size() );
+         }, boost::signals2::at_front );
+         // plugins have connected their handlers in plugin_initialize()
+         observe_signal_handlers( _chain_db->applied_block, _metrics, "applied_block" );
+         observe_signal_handlers( _chain_db->new_objects, _metrics, "new_objects" );
+         observe_signal_handlers( _chain_db->changed_objects, _metrics, "changed_objects" );
+         observe_signal_handlers( _chain_db->removed_objects, _metrics, "removed_objects" );
+
+         _metrics->add_collector( [this]( metrics_registry& m ){
+            const database& db = *_chain_db;
+            m.set( "yoyow_head_block_number", db.head_block_num() );
+            m.set( "yoyow_pending_transactions", db.pending_transaction_count() );
+            m.set( "yoyow_undo_stack_depth", db.undo_stack_depth() );
+            m.set( "yoyow_fork_db_blocks", db.fork_db_size() );
+            db.inspect_all_indexes( [&m]( const graphene::db::index& idx ){
+               m.set( "yoyow_index_objects", idx.object_count(),
+                      metrics_registry::label( "space", std::to_string( idx.object_space_id() ) ) + ','
+                      + metrics_registry::label( "type", std::to_string( idx.object_type_id() ) ) );
+            } );
+
+            if( !_p2p_network )
+               return;
+            m.set( "yoyow_p2p_peers", _p2p_network->get_connection_count() );
+            uint64_t sent = 0;
+            uint64_t received = 0;
+            for( const auto& peer : _p2p_network->get_connected_peers() )
+            {
+               sent += peer.info["bytessent"].as_uint64();
+               received += peer.info["bytesrecv"].as_uint64();
+            }
+            m.set( "yoyow_p2p_peer_bytes", sent, metrics_registry::label( "direction", "sent" ) );
+            m.set( "yoyow_p2p_peer_bytes", received, metrics_registry::label( "direction", "received" ) );
+         } );
       }
 
       void startup()
       { try {
+         // bad option values are reported before the database is opened, which may take long
+         set_api_cache();
+
          fc::create_directories(_data_dir / "blockchain");
 
          auto initial_state = [this] {
@@ -463,6 +680,8 @@ namespace detail {
             _app_options.enable_subscribe_to_all = _options->at("enable-subscribe-to-all").as<bool>();
 
          set_api_limit();
+         set_api_budgets();
+         set_metrics();
 
          if (_active_plugins.find("market_history") != _active_plugins.end())
             _app_options.has_market_history_plugin = true;
@@ -495,12 +714,14 @@ namespace detail {
             wild_access.allowed_apis.push_back( "network_broadcast_api" );
             wild_access.allowed_apis.push_back( "history_api" );
             wild_access.allowed_apis.push_back( "crypto_api" );
+            wild_access.allowed_apis.push_back( "raw_api" );
             _apiaccess.permission_map["*"] = wild_access;
          }
 
          reset_p2p_node(_data_dir);
          reset_websocket_server();
          reset_websocket_tls_server();
+         reset_metrics_server();
       } FC_LOG_AND_RETHROW() }
 
       optional< api_access_info > get_api_access_info(const string& username)const
@@ -570,7 +791,10 @@ namespace detail {
             // you can help the network code out by throwing a block_older_than_undo_history exception.
             // when the net code sees that, it will stop trying to push blocks from that chain, but
             // leave that peer connected so that they can get sync blocks from us
+            const fc::time_point push_start = fc::time_point::now();
             bool result = _chain_db->push_block(blk_msg.block, (_is_block_producer | _force_validate) ? database::skip_nothing : ( database::skip_transaction_signatures | database::skip_invariants_check ) );
+            if( _metrics )
+               _metrics->observe( "yoyow_block_apply_duration_seconds", fc::time_point::now() - push_start );
             // the block was accepted, so we now know all of the transactions contained in the block
             if (!sync_mode)
             {
@@ -954,6 +1178,9 @@ namespace detail {
       std::shared_ptr<graphene::net::node>                  _p2p_network;
       std::shared_ptr<fc::http::websocket_server>      _websocket_server;
       std::shared_ptr<fc::http::websocket_tls_server>  _websocket_tls_server;
+      std::shared_ptr<api_cost_limiter>                _api_cost_limiter;
+      std::shared_ptr<metrics_registry>                _metrics;
+      std::shared_ptr<fc::http::server>                _metrics_server;
 
       std::map<string, std::shared_ptr<abstract_plugin>> _active_plugins;
       std::map<string, std::shared_ptr<abstract_plugin>> _available_plugins;
@@ -990,12 +1217,32 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("checkpoint,c", bpo::value<vector<string>>()->composing(), "Pairs of [BLOCK_NUM,BLOCK_ID] that should be enforced as checkpoints.")
          ("rpc-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8090"), "Endpoint for websocket RPC to listen on")
          ("rpc-tls-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:8089"), "Endpoint for TLS websocket RPC to listen on")
+         ("metrics-endpoint", bpo::value<string>()->implicit_value("127.0.0.1:9190"), "Endpoint for HTTP to serve Prometheus metrics on, at /metrics")
          ("server-pem,p", bpo::value<string>()->implicit_value("server.pem"), "The TLS certificate file for this server")
          ("server-pem-password,P", bpo::value<string>()->implicit_value(""), "Password for this certificate")
          ("genesis-json", bpo::value<boost::filesystem::path>(), "File to read Genesis State from")
          ("dbg-init-key", bpo::value<string>(), "Block signing key to use for init witnesses, overrides genesis file")
          ("api-access", bpo::value<boost::filesystem::path>(), "JSON file specifying API permissions")
          ("plugins", bpo::value<string>(), "Space-separated list of plugins to activate")
+         ("api-cache-methods", bpo::value<string>(), "Space-separated list of database API methods whose responses are cached until the next block. "
+          "Supported: get_global_properties get_dynamic_global_properties get_accounts_by_uid get_ticker get_order_book get_top_markets. "
+          "An unknown or unsupported method stops the node at startup")
+         ("api-cache-max-size", bpo::value<uint64_t>(), "Maximum size in bytes of the database API response cache (16MB by default)")
+         ("rpc-max-batch-size", bpo::value<uint32_t>(), "Maximum number of requests in one JSON-RPC batch on the websocket and HTTP RPC endpoints (100 by default)")
+         ("api-limit-get-asset-holders", bpo::value<uint64_t>(), "Maximum number of holders returned by get_asset_holders and by one page of get_asset_holders_page (100 by default)")
+         ("api-limit-page-size", bpo::value<uint64_t>(), "Maximum number of records in one page of the cursor paginated APIs, and in one chunk of a history stream (1000 by default)")
+         ("api-limit-get-blocks", bpo::value<uint64_t>(), "Maximum number of blocks returned by one raw_api get_blocks call (100 by default). "
+          "A delayed node reading from this node needs delayed-node-batch-size at or below it")
+         ("api-limit-get-full-accounts", bpo::value<uint64_t>(), "Maximum number of accounts requested in one raw_api get_full_accounts_by_uid call (100 by default)")
+         ("api-limit-subscribed-objects", bpo::value<uint64_t>(), "Maximum number of objects one database API subscription watches for changes, "
+          "further objects are not watched and a warning is logged (100000 by default)")
+         ("api-budget-connection-capacity", bpo::value<double>(), "API cost units one connection may spend in a burst, 0 to disable connection budgets (default). "
+          "A call costs the weight of its method times the size of its largest array argument, plus one unit per millisecond it runs")
+         ("api-budget-connection-refill", bpo::value<double>(), "API cost units per second a connection budget gets back")
+         ("api-budget-user-capacity", bpo::value<double>(), "API cost units the connections of one api-access user may spend in a burst, 0 to disable user budgets (default)")
+         ("api-budget-user-refill", bpo::value<double>(), "API cost units per second a user budget gets back")
+         ("api-budget-max-wait-ms", bpo::value<uint32_t>(), "Longest an API call waits for its budget to refill before it is rejected (1000 by default)")
+         ("api-method-weights", bpo::value<string>(), "Space-separated list of method:weight pairs overriding the built-in API method weights")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
@@ -1078,7 +1325,10 @@ void application::startup()
 
 std::shared_ptr<abstract_plugin> application::get_plugin(const string& name) const
 {
-   return my->_active_plugins[name];
+   auto itr = my->_active_plugins.find( name );
+   if( itr == my->_active_plugins.end() )
+      return std::shared_ptr<abstract_plugin>();
+   return itr->second;
 }
 
 net::node_ptr application::p2p_node()
@@ -1159,5 +1409,15 @@ const application_options& application::get_options()
    return my->_app_options;
 }
 
+std::shared_ptr<api_cost_limiter> application::get_api_cost_limiter()const
+{
+   return my->_api_cost_limiter;
+}
+
+std::shared_ptr<metrics_registry> application::get_metrics()const
+{
+   return my->_metrics;
+}
+
 // namespace detail
 } }
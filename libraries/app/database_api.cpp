@@ -22,21 +22,25 @@
  * THE SOFTWARE.
  */
 
+#include <graphene/app/counting_bloom_filter.hpp>
 #include <graphene/app/database_api.hpp>
 #include <graphene/app/util.hpp>
 #include <graphene/chain/get_config.hpp>
 #include <graphene/utilities/string_escape.hpp>
 
-#include <fc/bloom_filter.hpp>
 #include <fc/smart_ref_impl.hpp>
 
 #include <fc/crypto/hex.hpp>
+#include <fc/io/json.hpp>
 
 #include <boost/range/iterator_range.hpp>
 #include <boost/rational.hpp>
 #include <boost/multiprecision/cpp_int.hpp>
 
 #include <cctype>
+#include <deque>
+#include <limits>
+#include <unordered_set>
 
 #include <cfenv>
 #include <iostream>
@@ -47,6 +51,24 @@ typedef std::map< std::pair<graphene::chain::asset_aid_type, graphene::chain::as
 
 namespace graphene { namespace app {
 
+/// Position of a list_scores_page() cursor, the score to continue from is included in the next page
+struct score_page_position
+{
+   account_uid_type platform = 0;
+   account_uid_type poster = 0;
+   post_pid_type    post_pid = 0;
+   bool             current_period = false;
+   uint64_t         period_sequence = 0;
+   object_id_type   next_score;
+};
+
+} } // graphene::app
+
+FC_REFLECT( graphene::app::score_page_position,
+            (platform)(poster)(post_pid)(current_period)(period_sequence)(next_score) )
+
+namespace graphene { namespace app {
+
 signed_block_with_info::signed_block_with_info( const signed_block& block )
    : signed_block( block )
 {
@@ -58,6 +80,181 @@ signed_block_with_info::signed_block_with_info( const signed_block& block )
 }
 
 
+/// Adds the balance changes of the voters that are not in the stored tallies yet, see custom_vote_pending_object
+static void add_pending_custom_votes(const graphene::chain::database& db, custom_vote_object& vote)
+{
+   const auto& pending_idx = db.get_index_type<custom_vote_pending_index>().indices().get<by_voter_asset>();
+   if (pending_idx.empty())
+      return;
+   const auto& cast_idx = db.get_index_type<cast_custom_vote_index>().indices().get<by_custom_vote_vid>();
+   auto itr = cast_idx.lower_bound(std::make_tuple(vote.custom_vote_creator, vote.vote_vid));
+   while (itr != cast_idx.end() && itr->custom_vote_creator == vote.custom_vote_creator && itr->custom_vote_vid == vote.vote_vid)
+   {
+      auto pending_itr = pending_idx.find(std::make_tuple(itr->voter, vote.vote_asset_id));
+      if (pending_itr != pending_idx.end() && pending_itr->pending_amount != 0 && vote.vote_expired_time >= pending_itr->since)
+      {
+         for (const auto& v : itr->vote_result)
+            vote.vote_result.at(v) += pending_itr->pending_amount.value;
+      }
+      ++itr;
+   }
+}
+
+/// @return obj as a variant, a custom_vote_object with its pending votes added
+static fc::variant object_to_variant(const graphene::chain::database& db, const object& obj)
+{
+   if (obj.id.space() == custom_vote_object::space_id && obj.id.type() == custom_vote_object::type_id)
+   {
+      custom_vote_object vote = static_cast<const custom_vote_object&>(obj);
+      add_pending_custom_votes(db, vote);
+      return fc::variant(vote, GRAPHENE_MAX_NESTED_OBJECTS);
+   }
+   return obj.to_variant();
+}
+
+class database_api_impl;
+
+/**
+ * Shared by every database_api on the same database.  Keeps the subscriptions of all
+ * connections, indexed by object id and by account uid, so a notification only visits the
+ * subscribers it matches.  Each new, changed or removed object is converted to a variant at
+ * most once per notification, and the result is shared by every subscriber it is sent to.
+ */
+class object_notification_hub
+{
+   public:
+      explicit object_notification_hub( graphene::chain::database& db );
+      ~object_notification_hub();
+
+      /** returns the hub for db, creating it if no database_api currently holds one */
+      static std::shared_ptr<object_notification_hub> get( graphene::chain::database& db );
+
+      void subscribe_to_object( const database_api_impl* api, const object_id_type& id );
+      void subscribe_to_account( const database_api_impl* api, account_uid_type uid );
+      /** api receives every created and removed object */
+      void set_notify_remove_create( const database_api_impl* api, bool notify_remove_create );
+      /** drops everything api has subscribed to, using the api's own lists of subscriptions */
+      void unsubscribe_all( const database_api_impl* api );
+
+   private:
+      void dispatch( bool create_or_remove, bool full_object, const vector<object_id_type>& ids,
+                     const flat_set<account_uid_type>& impacted_accounts,
+                     const std::function<const object*(size_t)>& find_object );
+
+      typedef std::set<const database_api_impl*> subscriber_set;
+
+      graphene::chain::database&                              _db;
+      subscriber_set                                          _notify_remove_create_subscribers;
+      std::unordered_map<object_id_type, subscriber_set>      _object_subscribers;
+      std::unordered_map<account_uid_type, subscriber_set>    _account_subscribers;
+      counting_bloom_filter                                   _object_filter;
+      counting_bloom_filter                                   _account_filter;
+      boost::signals2::scoped_connection                      _new_connection;
+      boost::signals2::scoped_connection                      _change_connection;
+      boost::signals2::scoped_connection                      _removed_connection;
+};
+
+/**
+ * Responses of selected read-only methods, valid for one head block.  Shared by every
+ * database_api on the same database and emptied whenever a block is applied.  Entries are
+ * also tagged with the head block id, so nothing cached before a block was popped is served
+ * afterwards.  Results may not reflect pending transactions received after they were cached.
+ */
+class api_response_cache
+{
+   public:
+      api_response_cache( graphene::chain::database& db, const application_options* app_options );
+
+      /** returns the cache for db, creating it from app_options if no database_api currently holds one */
+      static std::shared_ptr<api_response_cache> get( graphene::chain::database& db, const application_options* app_options );
+
+      template<typename... Args>
+      static string make_key( const string& method, const Args&... args )
+      {
+         string key = method;
+         int expand[] = { 0, ( key += ',' + fc::json::to_string( fc::variant( args, 2 ) ), 0 )... };
+         (void)expand;
+         return key;
+      }
+
+      /** returns the cached result for key if method is cacheable and the entry is current, otherwise calls compute */
+      template<typename Result, typename Compute>
+      Result get_or_compute( const string& method, const string& key, Compute&& compute )
+      {
+         if( _cacheable_methods.find( method ) == _cacheable_methods.end() )
+            return compute();
+
+         method_counters& counters = _counters[method];
+         const block_id_type head_block_id = _db.head_block_id();
+         auto itr = _entries.find( key );
+         if( itr != _entries.end() )
+         {
+            if( itr->second.head_block_id == head_block_id )
+            {
+               ++counters.hits;
+               return *std::static_pointer_cast<const Result>( itr->second.value );
+            }
+            _size -= itr->second.size;
+            _entries.erase( itr );
+         }
+         ++counters.misses;
+
+         Result result = compute();
+         const size_t size = fc::raw::pack_size( result ) + key.size();
+         if( size > _max_size )
+            return result;
+         while( _size + size > _max_size && !_insertion_order.empty() )
+         {
+            auto oldest = _entries.find( _insertion_order.front().second );
+            if( oldest != _entries.end() && oldest->second.sequence == _insertion_order.front().first )
+            {
+               _size -= oldest->second.size;
+               _entries.erase( oldest );
+               ++_evictions;
+            }
+            _insertion_order.pop_front();
+         }
+         _entries[key] = entry{ head_block_id, std::make_shared<const Result>( result ), size, ++_sequence };
+         _insertion_order.push_back( std::make_pair( _sequence, key ) );
+         _size += size;
+         if( _insertion_order.size() > 2 * _entries.size() )
+            compact_insertion_order();
+         return result;
+      }
+
+      fc::variant_object get_info()const;
+
+   private:
+      struct entry
+      {
+         block_id_type               head_block_id;
+         std::shared_ptr<const void> value;
+         size_t                      size;
+         uint64_t                    sequence; ///< of the item of _insertion_order that belongs to this entry
+      };
+      struct method_counters
+      {
+         uint64_t hits = 0;
+         uint64_t misses = 0;
+      };
+
+      void clear();
+      /** drops the items of _insertion_order whose entry was replaced or removed */
+      void compact_insertion_order();
+
+      graphene::chain::database&                _db;
+      std::set<string>                          _cacheable_methods;
+      uint64_t                                  _max_size = 0;
+      uint64_t                                  _size = 0;
+      uint64_t                                  _evictions = 0;
+      uint64_t                                  _sequence = 0;
+      std::unordered_map<string, entry>         _entries;
+      /** keys oldest first with the sequence they were inserted with, a stale entry leaves its item behind */
+      std::deque<std::pair<uint64_t, string>>   _insertion_order;
+      std::map<string, method_counters>         _counters;
+      boost::signals2::scoped_connection        _applied_block_connection;
+};
+
 class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 {
    public:
@@ -159,6 +356,12 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
                                        const object_id_type   lower_bound_score,
                                        const uint32_t         limit,
                                        const bool             list_cur_period)const;
+      page<score_object> list_scores_page(const account_uid_type platform,
+                                          const account_uid_type poster_uid,
+                                          const post_pid_type    post_pid,
+                                          const bool             list_cur_period,
+                                          const string&          cursor,
+                                          const uint32_t         limit)const;
 
       optional<license_object> get_license(const account_uid_type platform,
                                            const license_lid_type license_lid)const;
@@ -229,6 +432,28 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 
       void subscribe_to_market(std::function<void(const variant&)> callback, const std::string& a, const std::string& b);
       void unsubscribe_from_market(const std::string& a, const std::string& b);
+      void subscribe_to_order_book(std::function<void(const variant&)> callback, const std::string& a, const std::string& b);
+      void unsubscribe_from_order_book(const std::string& a, const std::string& b);
+      void subscribe_to_market_candles(std::function<void(const variant&)> callback, const std::string& a, const std::string& b, uint32_t seconds);
+      void unsubscribe_from_market_candles(const std::string& a, const std::string& b, uint32_t seconds);
+
+      /// @return the aggregated order books of the market history plugin, nullptr if it is not enabled
+      const graphene::market_history::order_book_depth_index* get_order_book_depth()const
+      {
+         if (!_app_options || !_app_options->has_market_history_plugin)
+            return nullptr;
+         const auto& order_idx = dynamic_cast<const primary_index<limit_order_index>&>( _db.get_index_type<limit_order_index>() );
+         return &order_idx.get_secondary_index<graphene::market_history::order_book_depth_index>();
+      }
+
+      /// @return the candles of the market history plugin, nullptr if it is not enabled
+      const graphene::market_history::market_candle_index* get_market_candles()const
+      {
+         if (!_app_options || !_app_options->has_market_history_plugin)
+            return nullptr;
+         const auto& bucket_idx = dynamic_cast<const primary_index<graphene::market_history::bucket_index>&>( _db.get_index_type<graphene::market_history::bucket_index>() );
+         return &bucket_idx.get_secondary_index<graphene::market_history::market_candle_index>();
+      }
 
       market_ticker                      get_ticker(const string& base, const string& quote, bool skip_order_book = false)const;
       market_volume                      get_24_volume(const string& base, const string& quote)const;
@@ -236,6 +461,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       vector<market_ticker>              get_top_markets(uint32_t limit)const;
       vector<market_trade>               get_trade_history(const string& base, const string& quote, fc::time_point_sec start, fc::time_point_sec stop, unsigned limit = 100)const;
       vector<market_trade>               get_trade_history_by_sequence(const string& base, const string& quote, int64_t start, fc::time_point_sec stop, unsigned limit = 100)const;
+      page<market_trade>                 get_trade_history_page(const string& base, const string& quote, fc::time_point_sec start, fc::time_point_sec stop, const string& cursor, uint32_t limit)const;
 
       // Witnesses
       vector<optional<witness_object>> get_witnesses(const vector<account_uid_type>& witness_uids)const;
@@ -268,36 +494,81 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
    //private:
       static string price_to_string(const price& _price, const asset_object& _base, const asset_object& _quote);
 
-      template<typename T>
-      void subscribe_to_item( const T& i )const
+      /**
+       * Builds the trade at itr, and moves itr to the record of the other side of the trade if
+       * there is one.  Trades are usually tracked in each direction, the exception is global
+       * settlement where only one side is recorded.
+       */
+      template<typename Index>
+      static market_trade read_market_trade( const Index& idx, typename Index::const_iterator& itr,
+                                             const asset_object& base, const asset_object& quote )
       {
-         auto vec = fc::raw::pack(i);
-         if( !_subscribe_callback )
-            return;
+         market_trade trade;
 
-         if( !is_subscribed_to_item(i) )
+         if (base.asset_id == itr->op.receives.asset_id)
+         {
+            trade.amount = quote.amount_to_string(itr->op.pays);
+            trade.value = base.amount_to_string(itr->op.receives);
+         }
+         else
          {
-            _subscribe_filter.insert( vec.data(), vec.size() );
+            trade.amount = quote.amount_to_string(itr->op.receives);
+            trade.value = base.amount_to_string(itr->op.pays);
          }
+
+         trade.date = itr->time;
+         trade.price = price_to_string(itr->op.fill_price, base, quote);
+
+         if (itr->op.is_maker)
+         {
+            trade.sequence = -itr->key.sequence;
+            trade.side1_account_id = itr->op.account_id;
+         }
+         else
+            trade.side2_account_id = itr->op.account_id;
+
+         auto next_itr = std::next(itr);
+         if (next_itr != idx.end() && next_itr->key.base == itr->key.base && next_itr->key.quote == itr->key.quote
+            && next_itr->time == itr->time && next_itr->op.is_maker != itr->op.is_maker)
+         {  // next_itr now could be the other direction // FIXME not 100% sure
+            if (next_itr->op.is_maker)
+            {
+               trade.sequence = -next_itr->key.sequence;
+               trade.side1_account_id = next_itr->op.account_id;
+            }
+            else
+               trade.side2_account_id = next_itr->op.account_id;
+            // skip the other direction
+            itr = next_itr;
+         }
+         return trade;
       }
 
-      template<typename T>
-      bool is_subscribed_to_item( const T& i )const
+      void subscribe_to_item( const object_id_type& id )const
       {
          if( !_subscribe_callback )
-            return false;
-
-         return _subscribe_filter.contains( i );
+            return;
+         // past this many, further objects are not watched for this connection
+         const uint64_t limit = _app_options ? _app_options->api_limit_subscribed_objects
+                                             : application_options().api_limit_subscribed_objects;
+         if( _subscribed_objects.size() >= limit )
+         {
+            if( !_subscription_limit_logged && _subscribed_objects.find( id ) == _subscribed_objects.end() )
+            {
+               wlog( "A connection reached the limit of ${n} subscribed objects, no longer watching new ones like ${id}",
+                     ("n", limit)("id", id) );
+               _subscription_limit_logged = true;
+            }
+            return;
+         }
+         if( _subscribed_objects.insert( id ).second )
+            _notification_hub->subscribe_to_object( this, id );
       }
 
-      bool is_impacted_account( const flat_set<account_uid_type>& accounts)
+      void subscribe_to_account( account_uid_type uid )
       {
-         if( !_subscribed_accounts.size() || !accounts.size() )
-            return false;
-
-         return std::any_of(accounts.begin(), accounts.end(), [this](const account_uid_type& account) {
-            return _subscribed_accounts.find(account) != _subscribed_accounts.end();
-         });
+         if( _subscribed_accounts.insert( uid ).second && _subscribe_callback )
+            _notification_hub->subscribe_to_account( this, uid );
       }
 
       const account_object* get_account_from_string(const std::string& name_or_id) const
@@ -377,28 +648,31 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
           return result;
       }
 
-      void broadcast_updates( const vector<variant>& updates );
-      void handle_object_changed(bool force_notify, bool full_object, const vector<object_id_type>& ids, const flat_set<account_uid_type>& impacted_accounts, std::function<const object*(object_id_type id)> find_object);
+      void broadcast_updates( const vector<variant>& updates )const;
 
-      /** called every time a block is applied to report the objects that were changed */
-      void on_objects_new(const vector<object_id_type>& ids, const flat_set<account_uid_type>& impacted_accounts);
-      void on_objects_changed(const vector<object_id_type>& ids, const flat_set<account_uid_type>& impacted_accounts);
-      void on_objects_removed(const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_uid_type>& impacted_accounts);
       void on_applied_block();
 
+      /// most records a cursor paginated method returns, the default when no options were given
+      uint64_t page_size_limit()const
+      {
+         return _app_options ? _app_options->api_limit_page_size : application_options().api_limit_page_size;
+      }
+
       bool _notify_remove_create = false;
-      mutable fc::bloom_filter _subscribe_filter;
+      mutable std::unordered_set<object_id_type> _subscribed_objects;
+      mutable bool _subscription_limit_logged = false; ///< api-limit-subscribed-objects is logged once per callback
       std::set<account_uid_type> _subscribed_accounts;
       std::function<void(const fc::variant&)> _subscribe_callback;
       std::function<void(const fc::variant&)> _pending_trx_callback;
       std::function<void(const fc::variant&)> _block_applied_callback;
 
-      boost::signals2::scoped_connection                                                   _new_connection;
-      boost::signals2::scoped_connection                                                   _change_connection;
-      boost::signals2::scoped_connection                                                   _removed_connection;
+      std::shared_ptr<object_notification_hub>                                             _notification_hub;
+      std::shared_ptr<api_response_cache>                                                  _response_cache;
       boost::signals2::scoped_connection                                                   _applied_block_connection;
       boost::signals2::scoped_connection                                                   _pending_trx_connection;
       map< pair<asset_aid_type, asset_aid_type>, std::function<void(const variant&)> >     _market_subscriptions;
+      map< pair<asset_aid_type, asset_aid_type>, std::function<void(const variant&)> >     _order_book_subscriptions;
+      map< pair<asset_aid_type, asset_aid_type>, map< uint32_t, std::function<void(const variant&)> > > _candle_subscriptions;
       graphene::chain::database&                                                           _db;
       const application_options* _app_options = nullptr;
 };
@@ -418,15 +692,8 @@ database_api_impl::database_api_impl(graphene::chain::database& db, const applic
    : _db(db), _app_options(app_options)
 {
    wlog("creating database api ${x}", ("x",int64_t(this)) );
-   _new_connection = _db.new_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_uid_type>& impacted_accounts) {
-                                on_objects_new(ids, impacted_accounts);
-                                });
-   _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_uid_type>& impacted_accounts) {
-                                on_objects_changed(ids, impacted_accounts);
-                                });
-   _removed_connection = _db.removed_objects.connect([this](const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_uid_type>& impacted_accounts) {
-                                on_objects_removed(ids, objs, impacted_accounts);
-                                });
+   _notification_hub = object_notification_hub::get( _db );
+   _response_cache = api_response_cache::get( _db, _app_options );
    _applied_block_connection = _db.applied_block.connect([this](const signed_block&){ on_applied_block(); });
 
    _pending_trx_connection = _db.on_pending_transaction.connect([this](const signed_transaction& trx ){
@@ -437,6 +704,7 @@ database_api_impl::database_api_impl(graphene::chain::database& db, const applic
 database_api_impl::~database_api_impl()
 {
    elog("freeing database api ${x}", ("x",int64_t(this)) );
+   _notification_hub->unsubscribe_all( this );
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -533,7 +801,7 @@ fc::variants database_api_impl::get_objects(const vector<object_id_type>& ids)co
    std::transform(ids.begin(), ids.end(), std::back_inserter(result),
                   [this](object_id_type id) -> fc::variant {
       if(auto obj = _db.find_object(id))
-         return obj->to_variant();
+         return object_to_variant(_db, *obj);
       return {};
    });
 
@@ -553,17 +821,14 @@ void database_api::set_subscribe_callback( std::function<void(const variant&)> c
 
 void database_api_impl::set_subscribe_callback( std::function<void(const variant&)> cb, bool notify_remove_create )
 {
-   //edump((clear_filter));
-   _subscribe_callback = cb;
-   _notify_remove_create = notify_remove_create;
+   _notification_hub->unsubscribe_all( this );
+   _subscribed_objects.clear();
+   _subscription_limit_logged = false;
    _subscribed_accounts.clear();
 
-   static fc::bloom_parameters param;
-   param.projected_element_count    = 10000;
-   param.false_positive_probability = 1.0/100;
-   param.maximum_size = 1024*8*8*2;
-   param.compute_optimal_parameters();
-   _subscribe_filter = fc::bloom_filter(param);
+   _subscribe_callback = cb;
+   _notify_remove_create = notify_remove_create;
+   _notification_hub->set_notify_remove_create( this, _subscribe_callback && _notify_remove_create );
 }
 
 void database_api::set_pending_transaction_callback( std::function<void(const variant&)> cb )
@@ -680,7 +945,9 @@ chain_property_object database_api_impl::get_chain_properties()const
 
 global_property_object database_api::get_global_properties()const
 {
-   return my->get_global_properties();
+   return my->_response_cache->get_or_compute<global_property_object>( "get_global_properties",
+      api_response_cache::make_key( "get_global_properties" ),
+      [this]() { return my->get_global_properties(); } );
 }
 
 global_property_object database_api_impl::get_global_properties()const
@@ -710,7 +977,14 @@ chain_id_type database_api_impl::get_chain_id()const
 
 dynamic_global_property_object database_api::get_dynamic_global_properties()const
 {
-   return my->get_dynamic_global_properties();
+   return my->_response_cache->get_or_compute<dynamic_global_property_object>( "get_dynamic_global_properties",
+      api_response_cache::make_key( "get_dynamic_global_properties" ),
+      [this]() { return my->get_dynamic_global_properties(); } );
+}
+
+fc::variant_object database_api::get_response_cache_info()const
+{
+   return my->_response_cache->get_info();
 }
 
 dynamic_global_property_object database_api_impl::get_dynamic_global_properties()const
@@ -743,8 +1017,6 @@ vector<vector<account_uid_type>> database_api_impl::get_key_references( vector<p
 
    for( auto& key : keys )
    {
-      subscribe_to_item( key );
-
       const auto& idx = _db.get_index_type<account_index>();
       const auto& aidx = dynamic_cast<const primary_index<account_index>&>(idx);
       const auto& refs = aidx.get_secondary_index<graphene::chain::account_member_index>();
@@ -759,9 +1031,6 @@ vector<vector<account_uid_type>> database_api_impl::get_key_references( vector<p
       final_result.emplace_back( std::move(result) );
    }
 
-   for( auto i : final_result )
-      subscribe_to_item(i);
-
    return final_result;
 }
 
@@ -807,7 +1076,9 @@ vector<optional<account_object>> database_api::get_accounts(const vector<account
 
 vector<optional<account_object>> database_api::get_accounts_by_uid(const vector<account_uid_type>& account_uids)const
 {
-   return my->get_accounts_by_uid( account_uids );
+   return my->_response_cache->get_or_compute<vector<optional<account_object>>>( "get_accounts_by_uid",
+      api_response_cache::make_key( "get_accounts_by_uid", account_uids ),
+      [this,&account_uids]() { return my->get_accounts_by_uid( account_uids ); } );
 }
 
 vector<optional<account_object>> database_api_impl::get_accounts(const vector<account_id_type>& account_ids)const
@@ -874,7 +1145,7 @@ std::map<std::string, full_account> database_api_impl::get_full_accounts( const
       if( subscribe )
       {
          FC_ASSERT( std::distance(_subscribed_accounts.begin(), _subscribed_accounts.end()) < 100 );
-         _subscribed_accounts.insert( account->uid );
+         subscribe_to_account( account->uid );
          subscribe_to_item( account->id );
       }
 
@@ -1574,6 +1845,86 @@ vector<score_object> database_api_impl::list_scores(const account_uid_type platf
    return result;
 }
 
+page<score_object> database_api::list_scores_page(const account_uid_type platform,
+                                                  const account_uid_type poster_uid,
+                                                  const post_pid_type    post_pid,
+                                                  const bool             list_cur_period,
+                                                  const string&          cursor,
+                                                  const uint32_t         limit)const
+{
+   return my->list_scores_page(platform, poster_uid, post_pid, list_cur_period, cursor, limit);
+}
+
+page<score_object> database_api_impl::list_scores_page(const account_uid_type platform,
+                                                       const account_uid_type poster_uid,
+                                                       const post_pid_type    post_pid,
+                                                       const bool             list_cur_period,
+                                                       const string&          cursor,
+                                                       const uint32_t         limit)const
+{
+   FC_ASSERT(limit <= page_size_limit());
+   page<score_object> result;
+   result.head_block_num = _db.head_block_num();
+
+   score_page_position pos;
+   pos.platform = platform;
+   pos.poster = poster_uid;
+   pos.post_pid = post_pid;
+   pos.current_period = list_cur_period;
+   optional<object_id_type> start_score;
+   if (!cursor.empty())
+   {
+      const auto from = page_cursor::decode<score_page_position>(cursor, page_cursor::scores, result.head_block_num);
+      FC_ASSERT(from.platform == platform && from.poster == poster_uid && from.post_pid == post_pid
+                && from.current_period == list_cur_period, "The cursor was issued for a different query");
+      pos.period_sequence = from.period_sequence;
+      start_score = from.next_score;
+   }
+
+   // scores are listed newest first, like list_scores
+   if (list_cur_period)
+   {
+      // a listing started in one period stays in it
+      if (!start_score.valid())
+         pos.period_sequence = _db.get_dynamic_global_properties().current_active_post_sequence;
+      const auto& idx = _db.get_index_type<score_index>().indices().get<by_period_sequence>();
+      auto range_begin = idx.lower_bound(std::make_tuple(platform, poster_uid, post_pid, pos.period_sequence));
+      auto itr = start_score.valid()
+                 ? idx.upper_bound(std::make_tuple(platform, poster_uid, post_pid, pos.period_sequence, *start_score))
+                 : idx.upper_bound(std::make_tuple(platform, poster_uid, post_pid, pos.period_sequence));
+      while (itr != range_begin)
+      {
+         --itr;
+         if (result.items.size() >= limit)
+         {
+            pos.next_score = itr->id;
+            result.next_cursor = page_cursor::encode(page_cursor::scores, result.head_block_num, pos);
+            break;
+         }
+         result.items.push_back(*itr);
+      }
+   }
+   else
+   {
+      const auto& idx = _db.get_index_type<score_index>().indices().get<by_posts_pids>();
+      auto itr = start_score.valid()
+                 ? idx.lower_bound(std::make_tuple(platform, poster_uid, post_pid, *start_score))
+                 : idx.lower_bound(std::make_tuple(platform, poster_uid, post_pid));
+      while (itr != idx.end() && itr->platform == platform && itr->poster == poster_uid && itr->post_pid == post_pid)
+      {
+         if (result.items.size() >= limit)
+         {
+            pos.next_score = itr->id;
+            result.next_cursor = page_cursor::encode(page_cursor::scores, result.head_block_num, pos);
+            break;
+         }
+         result.items.push_back(*itr);
+         ++itr;
+      }
+   }
+   return result;
+}
+
 optional<license_object> database_api::get_license(const account_uid_type platform, const license_lid_type license_lid)const
 {
    return my->get_license(platform, license_lid);
@@ -1709,6 +2060,7 @@ vector<custom_vote_object> database_api_impl::lookup_custom_votes(const account_
    while (itr != idx.end() && limit-- && itr->custom_vote_creator == creator)
    {
       result.push_back(*itr);
+      add_pending_custom_votes(_db, result.back());
       ++itr;
    }
    return result;
@@ -1731,6 +2083,7 @@ vector<custom_vote_object> database_api_impl::list_custom_votes(optional<custom_
          {
             if (itr->vote_expired_time <= _db.head_block_time()){
                result.push_back(*itr);
+               add_pending_custom_votes(_db, result.back());
                limit--;
             }
             ++itr;
@@ -1741,6 +2094,7 @@ vector<custom_vote_object> database_api_impl::list_custom_votes(optional<custom_
          {
             if (itr->vote_expired_time > _db.head_block_time()){
                result.push_back(*itr);
+               add_pending_custom_votes(_db, result.back());
                limit--;
             }
             ++itr;
@@ -1751,6 +2105,7 @@ vector<custom_vote_object> database_api_impl::list_custom_votes(optional<custom_
       while (itr != idx.end() && limit--)
       {
          result.push_back(*itr);
+         add_pending_custom_votes(_db, result.back());
          ++itr;
       }
    }
@@ -2351,6 +2706,74 @@ void database_api_impl::subscribe_to_market(std::function<void(const variant&)>
    _market_subscriptions[std::make_pair(asset_a_id, asset_b_id)] = callback;
 }
 
+void database_api::subscribe_to_order_book(std::function<void(const variant&)> callback, const std::string& a, const std::string& b)
+{
+   my->subscribe_to_order_book(callback, a, b);
+}
+
+void database_api_impl::subscribe_to_order_book(std::function<void(const variant&)> callback, const std::string& a, const std::string& b)
+{
+   FC_ASSERT(get_order_book_depth() != nullptr, "Market history plugin is not enabled.");
+   auto asset_a_id = get_asset_from_string(a)->asset_id;
+   auto asset_b_id = get_asset_from_string(b)->asset_id;
+
+   if (asset_a_id > asset_b_id) std::swap(asset_a_id, asset_b_id);
+   FC_ASSERT(asset_a_id != asset_b_id);
+   _order_book_subscriptions[std::make_pair(asset_a_id, asset_b_id)] = callback;
+}
+
+void database_api::unsubscribe_from_order_book(const std::string& a, const std::string& b)
+{
+   my->unsubscribe_from_order_book(a, b);
+}
+
+void database_api_impl::unsubscribe_from_order_book(const std::string& a, const std::string& b)
+{
+   auto asset_a_id = get_asset_from_string(a)->asset_id;
+   auto asset_b_id = get_asset_from_string(b)->asset_id;
+
+   if (asset_a_id > asset_b_id) std::swap(asset_a_id, asset_b_id);
+   _order_book_subscriptions.erase(std::make_pair(asset_a_id, asset_b_id));
+}
+
+void database_api::subscribe_to_market_candles(std::function<void(const variant&)> callback, const std::string& a, const std::string& b, uint32_t seconds)
+{
+   my->subscribe_to_market_candles(callback, a, b, seconds);
+}
+
+void database_api_impl::subscribe_to_market_candles(std::function<void(const variant&)> callback, const std::string& a, const std::string& b, uint32_t seconds)
+{
+   const auto* candles = get_market_candles();
+   FC_ASSERT(candles != nullptr, "Market history plugin is not enabled.");
+   FC_ASSERT(candles->get_source_bucket_size(seconds) > 0, "Candles of ${s} seconds can not be built from the tracked bucket sizes",
+             ("s", seconds));
+   auto asset_a_id = get_asset_from_string(a)->asset_id;
+   auto asset_b_id = get_asset_from_string(b)->asset_id;
+
+   if (asset_a_id > asset_b_id) std::swap(asset_a_id, asset_b_id);
+   FC_ASSERT(asset_a_id != asset_b_id);
+   _candle_subscriptions[std::make_pair(asset_a_id, asset_b_id)][seconds] = callback;
+}
+
+void database_api::unsubscribe_from_market_candles(const std::string& a, const std::string& b, uint32_t seconds)
+{
+   my->unsubscribe_from_market_candles(a, b, seconds);
+}
+
+void database_api_impl::unsubscribe_from_market_candles(const std::string& a, const std::string& b, uint32_t seconds)
+{
+   auto asset_a_id = get_asset_from_string(a)->asset_id;
+   auto asset_b_id = get_asset_from_string(b)->asset_id;
+
+   if (asset_a_id > asset_b_id) std::swap(asset_a_id, asset_b_id);
+   auto itr = _candle_subscriptions.find(std::make_pair(asset_a_id, asset_b_id));
+   if (itr == _candle_subscriptions.end())
+      return;
+   itr->second.erase(seconds);
+   if (itr->second.empty())
+      _candle_subscriptions.erase(itr);
+}
+
 void database_api::unsubscribe_from_market(const std::string& a, const std::string& b)
 {
    my->unsubscribe_from_market(a, b);
@@ -2380,7 +2803,9 @@ string database_api_impl::price_to_string(const price& _price, const asset_objec
 
 market_ticker database_api::get_ticker(const string& base, const string& quote)const
 {
-   return my->get_ticker(base, quote);
+   return my->_response_cache->get_or_compute<market_ticker>( "get_ticker",
+      api_response_cache::make_key( "get_ticker", base, quote ),
+      [this,&base,&quote]() { return my->get_ticker(base, quote); } );
 }
 
 market_ticker database_api_impl::get_ticker(const string& base, const string& quote, bool skip_order_book)const
@@ -2433,7 +2858,9 @@ market_volume database_api_impl::get_24_volume(const string& base, const string&
 
 order_book database_api::get_order_book(const string& base, const string& quote, unsigned limit)const
 {
-   return my->get_order_book(base, quote, limit);
+   return my->_response_cache->get_or_compute<order_book>( "get_order_book",
+      api_response_cache::make_key( "get_order_book", base, quote, limit ),
+      [this,&base,&quote,limit]() { return my->get_order_book(base, quote, limit); } );
 }
 
 order_book database_api_impl::get_order_book(const string& base, const string& quote, unsigned limit)const
@@ -2451,6 +2878,41 @@ order_book database_api_impl::get_order_book(const string& base, const string& q
 
    auto base_id = assets[0]->asset_id;
    auto quote_id = assets[1]->asset_id;
+
+   if (const auto* depth = get_order_book_depth())
+   {
+      // one entry per price level, best prices first
+      const auto* levels = depth->get_levels(std::make_pair(std::min(base_id, quote_id), std::max(base_id, quote_id)));
+      if (levels == nullptr)
+         return result;
+      const auto add_side = [&](asset_aid_type sell, asset_aid_type receive, vector<order>& side) {
+         auto begin = levels->lower_bound(price::min(sell, receive));
+         auto itr = levels->upper_bound(price::max(sell, receive));
+         while (itr != begin && side.size() < limit)
+         {
+            --itr;
+            const price& p = itr->first;
+            const share_type receive_amount = (uint128_t(itr->second.value) * p.quote.amount.value / p.base.amount.value).convert_to<int64_t>();
+            order ord;
+            ord.price = price_to_string(p, *assets[0], *assets[1]);
+            if (sell == base_id)
+            {
+               ord.base = assets[0]->amount_to_string(itr->second);
+               ord.quote = assets[1]->amount_to_string(receive_amount);
+            }
+            else
+            {
+               ord.quote = assets[1]->amount_to_string(itr->second);
+               ord.base = assets[0]->amount_to_string(receive_amount);
+            }
+            side.push_back(ord);
+         }
+      };
+      add_side(base_id, quote_id, result.bids);
+      add_side(quote_id, base_id, result.asks);
+      return result;
+   }
+
    auto orders = get_limit_orders(base_id, quote_id, limit);
 
    for (const auto& o : orders)
@@ -2480,7 +2942,9 @@ order_book database_api_impl::get_order_book(const string& base, const string& q
 
 vector<market_ticker> database_api::get_top_markets(uint32_t limit)const
 {
-   return my->get_top_markets(limit);
+   return my->_response_cache->get_or_compute<vector<market_ticker>>( "get_top_markets",
+      api_response_cache::make_key( "get_top_markets", limit ),
+      [this,limit]() { return my->get_top_markets(limit); } );
 }
 
 vector<market_ticker> database_api_impl::get_top_markets(uint32_t limit)const
@@ -2497,8 +2961,8 @@ vector<market_ticker> database_api_impl::get_top_markets(uint32_t limit)const
 
    while (itr != volume_idx.rend() && result.size() < limit)
    {
-      const asset_object base = _db.get_asset_by_aid(itr->base);
-      const asset_object quote = _db.get_asset_by_aid(itr->quote);
+      const asset_object& base = _db.get_asset_by_aid(itr->base);
+      const asset_object& quote = _db.get_asset_by_aid(itr->quote);
       order_book orders;
       orders = get_order_book(base.symbol, quote.symbol, 1);
 
@@ -2547,47 +3011,7 @@ vector<market_trade> database_api_impl::get_trade_history(const string& base,
    while (itr != history_idx.end() && count < limit && !(itr->key.base != base_id || itr->key.quote != quote_id || itr->time < stop))
    {
       {
-         market_trade trade;
-
-         if (assets[0]->asset_id == itr->op.receives.asset_id)
-         {
-            trade.amount = assets[1]->amount_to_string(itr->op.pays);
-            trade.value = assets[0]->amount_to_string(itr->op.receives);
-         }
-         else
-         {
-            trade.amount = assets[1]->amount_to_string(itr->op.receives);
-            trade.value = assets[0]->amount_to_string(itr->op.pays);
-         }
-
-         trade.date = itr->time;
-         trade.price = price_to_string(itr->op.fill_price, *assets[0], *assets[1]);
-
-         if (itr->op.is_maker)
-         {
-            trade.sequence = -itr->key.sequence;
-            trade.side1_account_id = itr->op.account_id;
-         }
-         else
-            trade.side2_account_id = itr->op.account_id;
-
-         auto next_itr = std::next(itr);
-         // Trades are usually tracked in each direction, exception: for global settlement only one side is recorded
-         if (next_itr != history_idx.end() && next_itr->key.base == base_id && next_itr->key.quote == quote_id
-            && next_itr->time == itr->time && next_itr->op.is_maker != itr->op.is_maker)
-         {  // next_itr now could be the other direction // FIXME not 100% sure
-            if (next_itr->op.is_maker)
-            {
-               trade.sequence = -next_itr->key.sequence;
-               trade.side1_account_id = next_itr->op.account_id;
-            }
-            else
-               trade.side2_account_id = next_itr->op.account_id;
-            // skip the other direction
-            itr = next_itr;
-         }
-
-         result.push_back(trade);
+         result.push_back(read_market_trade(history_idx, itr, *assets[0], *assets[1]));
          ++count;
       }
 
@@ -2652,53 +3076,77 @@ vector<market_trade> database_api_impl::get_trade_history_by_sequence(
       }
       else
       {
-         market_trade trade;
+         result.push_back(read_market_trade(history_idx, itr, *assets[0], *assets[1]));
+         ++count;
+      }
 
-         if (assets[0]->asset_id == itr->op.receives.asset_id)
-         {
-            trade.amount = assets[1]->amount_to_string(itr->op.pays);
-            trade.value = assets[0]->amount_to_string(itr->op.receives);
-         }
-         else
-         {
-            trade.amount = assets[1]->amount_to_string(itr->op.receives);
-            trade.value = assets[0]->amount_to_string(itr->op.pays);
-         }
+      ++itr;
+   }
 
-         trade.date = itr->time;
-         trade.price = price_to_string(itr->op.fill_price, *assets[0], *assets[1]);
+   return result;
+}
 
-         if (itr->op.is_maker)
-         {
-            trade.sequence = -itr->key.sequence;
-            trade.side1_account_id = itr->op.account_id;
-         }
-         else
-            trade.side2_account_id = itr->op.account_id;
+page<market_trade> database_api::get_trade_history_page(const string& base,
+                                                        const string& quote,
+                                                        fc::time_point_sec start,
+                                                        fc::time_point_sec stop,
+                                                        const string& cursor,
+                                                        uint32_t limit)const
+{
+   return my->get_trade_history_page(base, quote, start, stop, cursor, limit);
+}
 
-         auto next_itr = std::next(itr);
-         // Trades are usually tracked in each direction, exception: for global settlement only one side is recorded
-         if (next_itr != history_idx.end() && next_itr->key.base == base_id && next_itr->key.quote == quote_id
-            && next_itr->time == itr->time && next_itr->op.is_maker != itr->op.is_maker)
-         {  // next_itr now could be the other direction // FIXME not 100% sure
-            if (next_itr->op.is_maker)
-            {
-               trade.sequence = -next_itr->key.sequence;
-               trade.side1_account_id = next_itr->op.account_id;
-            }
-            else
-               trade.side2_account_id = next_itr->op.account_id;
-            // skip the other direction
-            itr = next_itr;
-         }
+page<market_trade> database_api_impl::get_trade_history_page(const string& base,
+                                                             const string& quote,
+                                                             fc::time_point_sec start,
+                                                             fc::time_point_sec stop,
+                                                             const string& cursor,
+                                                             uint32_t limit)const
+{
+   FC_ASSERT(_app_options && _app_options->has_market_history_plugin, "Market history plugin is not enabled.");
+   FC_ASSERT(limit <= page_size_limit());
 
-         result.push_back(trade);
-         ++count;
-      }
+   auto assets = lookup_asset_symbols({ base, quote });
+   FC_ASSERT(assets[0], "Invalid base asset symbol: ${s}", ("s", base));
+   FC_ASSERT(assets[1], "Invalid quote asset symbol: ${s}", ("s", quote));
 
-      ++itr;
+   auto base_id = assets[0]->asset_id;
+   auto quote_id = assets[1]->asset_id;
+
+   if (base_id > quote_id) std::swap(base_id, quote_id);
+
+   page<market_trade> result;
+   result.head_block_num = _db.head_block_num();
+
+   history_key hkey;
+   if (cursor.empty())
+   {
+      if (start.sec_since_epoch() == 0)
+         start = fc::time_point_sec(fc::time_point::now());
+      const auto& time_idx = _db.get_index_type<graphene::market_history::history_index>().indices().get<by_market_time>();
+      auto itr = time_idx.lower_bound(std::make_tuple(base_id, quote_id, start));
+      if (itr == time_idx.end() || itr->key.base != base_id || itr->key.quote != quote_id)
+         return result;
+      hkey = itr->key;
+   }
+   else
+   {
+      hkey = page_cursor::decode<history_key>(cursor, page_cursor::trade_history, result.head_block_num);
+      FC_ASSERT(hkey.base == base_id && hkey.quote == quote_id, "The cursor was issued for a different market");
    }
 
+   const auto& history_idx = _db.get_index_type<graphene::market_history::history_index>().indices().get<by_key>();
+   auto itr = history_idx.lower_bound(hkey);
+   while (itr != history_idx.end() && itr->key.base == base_id && itr->key.quote == quote_id && itr->time >= stop)
+   {
+      if (result.items.size() >= limit)
+      {
+         result.next_cursor = page_cursor::encode(page_cursor::trade_history, result.head_block_num, itr->key);
+         break;
+      }
+      result.items.push_back(read_market_trade(history_idx, itr, *assets[0], *assets[1]));
+      ++itr;
+   }
    return result;
 }
 
@@ -3237,7 +3685,7 @@ vector<proposal_object> database_api_impl::get_proposed_transactions( account_ui
 //                                                                  //
 //////////////////////////////////////////////////////////////////////
 
-void database_api_impl::broadcast_updates( const vector<variant>& updates )
+void database_api_impl::broadcast_updates( const vector<variant>& updates )const
 {
    if( updates.size() && _subscribe_callback ) {
       auto capture_this = shared_from_this();
@@ -3249,64 +3697,245 @@ void database_api_impl::broadcast_updates( const vector<variant>& updates )
 }
 
 
-void database_api_impl::on_objects_removed( const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_uid_type>& impacted_accounts)
+object_notification_hub::object_notification_hub( graphene::chain::database& db )
+   : _db( db )
 {
-   handle_object_changed(_notify_remove_create, false, ids, impacted_accounts,
-      [objs](object_id_type id) -> const object* {
-         auto it = std::find_if(
-               objs.begin(), objs.end(),
-               [id](const object* o) {return o != nullptr && o->id == id;});
+   _new_connection = _db.new_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_uid_type>& impacted_accounts) {
+      dispatch( true, true, ids, impacted_accounts,
+                [this,&ids](size_t i) { return _db.find_object( ids[i] ); } );
+   });
+   _change_connection = _db.changed_objects.connect([this](const vector<object_id_type>& ids, const flat_set<account_uid_type>& impacted_accounts) {
+      dispatch( false, true, ids, impacted_accounts,
+                [this,&ids](size_t i) { return _db.find_object( ids[i] ); } );
+   });
+   // ids and objs are parallel, so the removed object is found by position rather than by searching objs
+   _removed_connection = _db.removed_objects.connect([this](const vector<object_id_type>& ids, const vector<const object*>& objs, const flat_set<account_uid_type>& impacted_accounts) {
+      dispatch( true, false, ids, impacted_accounts,
+                [&objs](size_t i) -> const object* { return i < objs.size() ? objs[i] : nullptr; } );
+   });
+}
 
-         if (it != objs.end())
-            return *it;
+const std::set<std::string>& database_api::cacheable_methods()
+{
+   // every method that calls api_response_cache::get_or_compute()
+   static const std::set<std::string> methods = {
+      "get_global_properties", "get_dynamic_global_properties", "get_accounts_by_uid",
+      "get_ticker", "get_order_book", "get_top_markets"
+   };
+   return methods;
+}
 
-         return nullptr;
-      }
-   );
+api_response_cache::api_response_cache( graphene::chain::database& db, const application_options* app_options )
+   : _db( db )
+{
+   if( app_options )
+   {
+      _cacheable_methods = app_options->api_cache_methods;
+      _max_size = app_options->api_cache_max_size;
+   }
+   _applied_block_connection = _db.applied_block.connect([this](const signed_block&){ clear(); });
 }
 
-void database_api_impl::on_objects_new(const vector<object_id_type>& ids, const flat_set<account_uid_type>& impacted_accounts)
+std::shared_ptr<api_response_cache> api_response_cache::get( graphene::chain::database& db, const application_options* app_options )
 {
-   handle_object_changed(_notify_remove_create, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
+   static std::map< const graphene::chain::database*, std::weak_ptr<api_response_cache> > caches;
+   auto& cache = caches[&db];
+   auto result = cache.lock();
+   if( !result )
+   {
+      result = std::make_shared<api_response_cache>( db, app_options );
+      cache = result;
+   }
+   return result;
 }
 
-void database_api_impl::on_objects_changed(const vector<object_id_type>& ids, const flat_set<account_uid_type>& impacted_accounts)
+void api_response_cache::clear()
 {
-   handle_object_changed(false, true, ids, impacted_accounts,
-      std::bind(&object_database::find_object, &_db, std::placeholders::_1)
-   );
+   _entries.clear();
+   _insertion_order.clear();
+   _size = 0;
 }
 
-void database_api_impl::handle_object_changed(bool force_notify, bool full_object, const vector<object_id_type>& ids, const flat_set<account_uid_type>& impacted_accounts, std::function<const object*(object_id_type id)> find_object)
+void api_response_cache::compact_insertion_order()
 {
-   if( _subscribe_callback )
+   std::deque<std::pair<uint64_t, string>> current;
+   for( auto& item : _insertion_order )
    {
-      vector<variant> updates;
+      auto itr = _entries.find( item.second );
+      if( itr != _entries.end() && itr->second.sequence == item.first )
+         current.push_back( std::move( item ) );
+   }
+   _insertion_order.swap( current );
+}
+
+fc::variant_object api_response_cache::get_info()const
+{
+   fc::mutable_variant_object methods;
+   for( const auto& method : _counters )
+   {
+      const uint64_t calls = method.second.hits + method.second.misses;
+      methods[method.first] = fc::mutable_variant_object()
+         ( "hits", method.second.hits )
+         ( "misses", method.second.misses )
+         ( "hit_rate", calls ? double( method.second.hits ) / calls : 0.0 );
+   }
+
+   fc::mutable_variant_object result;
+   result["cacheable_methods"] = _cacheable_methods;
+   result["max_size"] = _max_size;
+   result["size"] = _size;
+   result["entries"] = _entries.size();
+   result["evictions"] = _evictions;
+   result["methods"] = methods;
+   return result;
+}
+
+object_notification_hub::~object_notification_hub()
+{
+   if( !_account_subscribers.empty() )
+      --_db.impacted_account_listeners;
+}
 
-      for(auto id : ids)
+void object_notification_hub::subscribe_to_object( const database_api_impl* api, const object_id_type& id )
+{
+   if( _object_subscribers[id].insert( api ).second )
+      _object_filter.insert( id.number );
+}
+
+void object_notification_hub::subscribe_to_account( const database_api_impl* api, account_uid_type uid )
+{
+   if( _account_subscribers.empty() )
+      ++_db.impacted_account_listeners;
+   if( _account_subscribers[uid].insert( api ).second )
+      _account_filter.insert( uid );
+}
+
+void object_notification_hub::set_notify_remove_create( const database_api_impl* api, bool notify_remove_create )
+{
+   if( notify_remove_create )
+      _notify_remove_create_subscribers.insert( api );
+   else
+      _notify_remove_create_subscribers.erase( api );
+}
+
+void object_notification_hub::unsubscribe_all( const database_api_impl* api )
+{
+   _notify_remove_create_subscribers.erase( api );
+
+   for( const object_id_type& id : api->_subscribed_objects )
+   {
+      auto itr = _object_subscribers.find( id );
+      if( itr != _object_subscribers.end() && itr->second.erase( api ) )
+      {
+         _object_filter.remove( id.number );
+         if( itr->second.empty() )
+            _object_subscribers.erase( itr );
+      }
+   }
+
+   if( _account_subscribers.empty() )
+      return;
+   for( account_uid_type uid : api->_subscribed_accounts )
+   {
+      auto itr = _account_subscribers.find( uid );
+      if( itr != _account_subscribers.end() && itr->second.erase( api ) )
       {
-         if( force_notify || is_subscribed_to_item(id) || is_impacted_account(impacted_accounts) )
+         _account_filter.remove( uid );
+         if( itr->second.empty() )
+            _account_subscribers.erase( itr );
+      }
+   }
+   if( _account_subscribers.empty() )
+      --_db.impacted_account_listeners;
+}
+
+std::shared_ptr<object_notification_hub> object_notification_hub::get( graphene::chain::database& db )
+{
+   static std::map< const graphene::chain::database*, std::weak_ptr<object_notification_hub> > hubs;
+   auto& hub = hubs[&db];
+   auto result = hub.lock();
+   if( !result )
+   {
+      result = std::make_shared<object_notification_hub>( db );
+      hub = result;
+   }
+   return result;
+}
+
+void object_notification_hub::dispatch( bool create_or_remove, bool full_object, const vector<object_id_type>& ids,
+                                        const flat_set<account_uid_type>& impacted_accounts,
+                                        const std::function<const object*(size_t)>& find_object )
+{
+   // subscribers that get every id, and for the others the positions of the ids they watch
+   subscriber_set notify_all;
+   std::map< const database_api_impl*, vector<size_t> > notify_some;
+
+   if( create_or_remove )
+      notify_all = _notify_remove_create_subscribers;
+   if( !_account_subscribers.empty() )
+   {
+      for( account_uid_type uid : impacted_accounts )
+      {
+         if( !_account_filter.may_contain( uid ) )
+            continue;
+         auto itr = _account_subscribers.find( uid );
+         if( itr != _account_subscribers.end() )
+            notify_all.insert( itr->second.begin(), itr->second.end() );
+      }
+   }
+   if( !_object_subscribers.empty() )
+   {
+      for( size_t i = 0; i < ids.size(); ++i )
+      {
+         if( !_object_filter.may_contain( ids[i].number ) )
+            continue;
+         auto itr = _object_subscribers.find( ids[i] );
+         if( itr == _object_subscribers.end() )
+            continue;
+         for( const database_api_impl* api : itr->second )
+            if( notify_all.find( api ) == notify_all.end() )
+               notify_some[api].push_back( i );
+      }
+   }
+   if( notify_all.empty() && notify_some.empty() )
+      return;
+
+   // each payload is built the first time any subscriber needs it; copies of an object variant share its contents
+   vector<variant> payloads( ids.size() );
+   vector<bool> payload_built( ids.size(), false );
+   auto get_payload = [&]( size_t i ) -> const variant& {
+      if( !payload_built[i] )
+      {
+         if( full_object )
          {
-            if( full_object )
-            {
-               auto obj = find_object(id);
-               if( obj )
-               {
-                  updates.emplace_back( obj->to_variant() );
-               }
-            }
-            else
-            {
-               updates.emplace_back( fc::variant( id, 1 ) );
-            }
+            if( auto obj = find_object( i ) )
+               payloads[i] = object_to_variant( _db, *obj );
          }
+         else
+            payloads[i] = fc::variant( ids[i], 1 );
+         payload_built[i] = true;
       }
+      return payloads[i];
+   };
 
-      broadcast_updates(updates);
+   for( const database_api_impl* api : notify_all )
+   {
+      vector<variant> updates;
+      updates.reserve( ids.size() );
+      for( size_t i = 0; i < ids.size(); ++i )
+         if( !get_payload( i ).is_null() )
+            updates.push_back( payloads[i] );
+      api->broadcast_updates( updates );
+   }
+   for( const auto& subscriber : notify_some )
+   {
+      vector<variant> updates;
+      updates.reserve( subscriber.second.size() );
+      for( size_t i : subscriber.second )
+         if( !get_payload( i ).is_null() )
+            updates.push_back( payloads[i] );
+      subscriber.first->broadcast_updates( updates );
    }
-
 }
 
 /** note: this method cannot yield because it is called in the middle of
@@ -3323,6 +3952,59 @@ void database_api_impl::on_applied_block()
       });
    }
 
+   if (!_order_book_subscriptions.empty())
+   {
+      map< std::pair<asset_aid_type, asset_aid_type>, vector<graphene::market_history::order_book_level_change> > changes;
+      for (const auto& change : get_order_book_depth()->get_last_block_changes())
+      {
+         auto market = std::make_pair(change.sell_price.base.asset_id, change.sell_price.quote.asset_id);
+         if (market.first > market.second) std::swap(market.first, market.second);
+         if (_order_book_subscriptions.count(market))
+            changes[market].push_back(change);
+      }
+      if (!changes.empty())
+      {
+         auto capture_this = shared_from_this();
+         fc::async([this, capture_this, changes](){
+            for (const auto& item : changes)
+            {
+               auto itr = _order_book_subscriptions.find(item.first);
+               if (itr != _order_book_subscriptions.end())
+                  itr->second(fc::variant(item.second, GRAPHENE_NET_MAX_NESTED_OBJECTS));
+            }
+         });
+      }
+   }
+
+   if (!_candle_subscriptions.empty())
+   {
+      // push the candle of the head block time of every subscribed length of the markets that traded
+      vector< pair< std::function<void(const variant&)>, market_candle > > updates;
+      const auto* candles = get_market_candles();
+      const fc::time_point_sec now = _db.head_block_time();
+      for (const auto& market : candles->get_last_block_markets())
+      {
+         auto itr = _candle_subscriptions.find(market);
+         if (itr == _candle_subscriptions.end())
+            continue;
+         for (const auto& subscription : itr->second)
+         {
+            const fc::time_point_sec open(now.sec_since_epoch() / subscription.first * subscription.first);
+            auto current = candles->get_candles(_db, market, subscription.first, open, now, 1);
+            if (!current.empty())
+               updates.emplace_back(subscription.second, current.front());
+         }
+      }
+      if (!updates.empty())
+      {
+         auto capture_this = shared_from_this();
+         fc::async([this, capture_this, updates](){
+            for (const auto& update : updates)
+               update.first(fc::variant(update.second, GRAPHENE_NET_MAX_NESTED_OBJECTS));
+         });
+      }
+   }
+
    /// we need to ensure the database_api is not deleted for the life of the async operation
    if (_market_subscriptions.size() == 0)
        return;
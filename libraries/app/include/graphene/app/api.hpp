@@ -77,6 +77,27 @@ namespace graphene { namespace app {
       asset_aid_type  asset_id;
       uint64_t        count;
    };
+
+   /// One chunk of a history stream, see history_api::stream_relative_account_history
+   struct history_stream_chunk
+   {
+      uint32_t    stream_id = 0;
+      uint32_t    sequence = 0;   ///< chunks of a stream are numbered from 0
+      fc::variant items;          ///< the records, in the order and format of the matching *_page method
+      bool        last = false;   ///< no chunk follows this one
+      string      error;          ///< why the stream stopped early, empty if it did not
+   };
+
+   /// How far account history has been indexed, see history_api::get_account_history_watermark
+   struct account_history_watermark
+   {
+      uint32_t head_block_num = 0;
+      uint32_t indexed_block_num = 0;   ///< history queries include the operations of blocks up to this one
+      uint32_t stored_block_num = 0;    ///< operations of blocks up to this one are in the on-disk history store
+      string   error;                   ///< why indexing has stopped, history queries fail until the node is fixed
+   };
+
+   namespace detail { struct history_stream; }
    
    /**
     * @brief The history_api class implements the RPC API for account history
@@ -152,9 +173,126 @@ namespace graphene { namespace app {
 
          vector<order_history_object> get_fill_order_history(std::string a, std::string b, uint32_t limit)const;
 
+         /**
+          * @brief Get operations relevant to the specified account one page at a time, most recent first
+          * @param account The account whose history should be queried
+          * @param op_type Only query for this operation type if specified
+          * @param cursor empty for the first page, next_cursor of the previous page otherwise
+          * @param limit Maximum number of operations in the page (must not exceed api-limit-page-size)
+          * @return the operations with their sequence numbers, next_cursor is empty after the oldest operation
+          */
+         page<std::pair<uint32_t,operation_history_object>> get_relative_account_history_page( account_uid_type account,
+                                                                                               optional<uint16_t> op_type,
+                                                                                               const string& cursor,
+                                                                                               uint32_t limit )const;
+
+         /**
+          * @brief Get operations relevant to the specified account in a range of blocks one page at a time,
+          *        least recent first
+          * @param account The account whose history should be queried
+          * @param op_type Only query for this operation type if specified
+          * @param start_block The first block of the range
+          * @param end_block The block after the last block of the range
+          * @param cursor empty for the first page, next_cursor of the previous page otherwise
+          * @param limit Maximum number of operations in the page (must not exceed api-limit-page-size)
+          * @return the operations with their sequence numbers, next_cursor is empty after the last operation
+          */
+         page<std::pair<uint32_t,operation_history_object>> get_account_history_by_block_range( account_uid_type account,
+                                                                                                optional<uint16_t> op_type,
+                                                                                                uint32_t start_block,
+                                                                                                uint32_t end_block,
+                                                                                                const string& cursor,
+                                                                                                uint32_t limit )const;
+
+         /**
+          * @brief Get operations relevant to the specified account in blocks of the time range [start, end)
+          *        one page at a time, least recent first, see get_account_history_by_block_range
+          */
+         page<std::pair<uint32_t,operation_history_object>> get_account_history_by_time( account_uid_type account,
+                                                                                         optional<uint16_t> op_type,
+                                                                                         fc::time_point_sec start,
+                                                                                         fc::time_point_sec end,
+                                                                                         const string& cursor,
+                                                                                         uint32_t limit )const;
+
+         /**
+          * @brief Get OHLCV data of a trading pair in a time range one page at a time, least recent first
+          * @param a Asset symbol or ID in a trading pair
+          * @param b The other asset symbol or ID in the trading pair
+          * @param bucket_seconds Length of each time bucket in seconds
+          * @param start The start of the time range, only used for the first page
+          * @param end The end of the time range
+          * @param cursor empty for the first page, next_cursor of the previous page otherwise
+          * @param limit Maximum number of buckets in the page (must not exceed api-limit-page-size)
+          */
+         page<bucket_object> get_market_history_page( std::string a, std::string b, uint32_t bucket_seconds,
+                                                      fc::time_point_sec start, fc::time_point_sec end,
+                                                      const string& cursor, uint32_t limit )const;
+
+         /**
+          * @brief Get OHLCV data of a trading pair in candles of any length, least recent first
+          * @param a Asset symbol or ID in a trading pair
+          * @param b The other asset symbol or ID in the trading pair
+          * @param seconds Length of each candle in seconds, a multiple of a tracked bucket size
+          * @param start The start of the time range
+          * @param end The end of the time range, candles opening after it are not returned
+          * @param limit Maximum number of candles (must not exceed api-limit-page-size)
+          * @return the candles opening in [start, end], resampled on the node from the tracked buckets.
+          * Periods without any fill have no candle.  Call again with start after the open of the last
+          * candle for the next ones.
+          */
+         vector<market_candle> get_market_candles( std::string a, std::string b, uint32_t seconds,
+                                                   fc::time_point_sec start, fc::time_point_sec end,
+                                                   uint32_t limit )const;
+
+         /**
+          * @brief Push the whole history of an account to the client in chunks
+          *
+          * The chunks are history_stream_chunk objects passed to @p callback, each holding what
+          * get_relative_account_history_page would return for the next page.  At most a few chunks are
+          * sent ahead of the client: every chunk must be acknowledged with ack_stream() for the stream to
+          * go on, so a slow client is never flooded.
+          *
+          * @return id of the stream, for ack_stream() and cancel_stream()
+          */
+         uint32_t stream_relative_account_history( std::function<void(const variant&)> callback,
+                                                   account_uid_type account,
+                                                   optional<uint16_t> op_type,
+                                                   uint32_t chunk_size );
+
+         /// Push OHLCV data of a trading pair in chunks, see get_market_history_page and stream_relative_account_history
+         uint32_t stream_market_history( std::function<void(const variant&)> callback,
+                                         std::string a, std::string b, uint32_t bucket_seconds,
+                                         fc::time_point_sec start, fc::time_point_sec end,
+                                         uint32_t chunk_size );
+
+         /// Push trades of a market in chunks, see database_api::get_trade_history_page and stream_relative_account_history
+         uint32_t stream_trade_history( std::function<void(const variant&)> callback,
+                                        std::string base, std::string quote,
+                                        fc::time_point_sec start, fc::time_point_sec stop,
+                                        uint32_t chunk_size );
+
+         /**
+          * With account-history-async account history is indexed on a separate thread and may lag behind
+          * the head block for a moment, operations of blocks after indexed_block_num are not returned yet.
+          */
+         account_history_watermark get_account_history_watermark()const;
+
+         /// Acknowledge chunks of a stream up to and including @p sequence, which lets more chunks be sent
+         void ack_stream( uint32_t stream_id, uint32_t sequence );
+
+         /// Stop a stream, no more chunks are sent for it
+         void cancel_stream( uint32_t stream_id );
+
       private:
+           uint32_t add_stream( std::function<void(const variant&)> callback, uint32_t chunk_size,
+                                std::function<std::pair<variant,string>( const string& cursor, uint32_t limit )> read_page );
+           void send_stream_chunks( const std::shared_ptr<detail::history_stream>& stream );
+
            application& _app;
            graphene::app::database_api database_api;
+           std::map< uint32_t, std::shared_ptr<detail::history_stream> > _streams;
+           uint32_t _next_stream_id = 0;
    };
 
    /**
@@ -172,6 +310,44 @@ namespace graphene { namespace app {
       graphene::chain::database& _db;
    };
 
+   /**
+    * @brief The raw_api class returns the results of other APIs packed with fc::raw
+    *
+    * Each method returns the binary serialization of the type noted for it, which is much cheaper
+    * to produce and to parse than JSON for large results.  The packed bytes are base64 encoded so
+    * that a JSON connection carries them at 4/3 of their size instead of doubling them as hex;
+    * raw_api_client decodes and unpacks a result into the original type.
+    */
+   class raw_api
+   {
+      public:
+         raw_api(application& app,
+                 std::shared_ptr<graphene::app::database_api> database_api,
+                 std::shared_ptr<history_api> history_api);
+
+         /// @return base64 of packed optional<signed_block>
+         std::string get_block(uint32_t block_num)const;
+         /// @return base64 of packed vector<optional<signed_block>>, at most api-limit-get-blocks of them
+         std::string get_blocks(uint32_t block_num_from, uint32_t block_num_to)const;
+         /// @return base64 of packed std::map<account_uid_type,full_account>, see database_api::get_full_accounts_by_uid,
+         ///         @p uids holds at most api-limit-get-full-accounts ids
+         std::string get_full_accounts_by_uid(const vector<account_uid_type>& uids,
+                                              const full_account_query_options& options);
+         /// @return base64 of packed vector<std::pair<uint32_t,operation_history_object>>, see history_api::get_relative_account_history
+         std::string get_relative_account_history(account_uid_type account,
+                                                  optional<uint16_t> op_type,
+                                                  uint32_t stop = 0,
+                                                  unsigned limit = 100,
+                                                  uint32_t start = 0)const;
+
+      private:
+         application&                                  _app;
+         graphene::chain::database&                    _db;
+         block_api                                     _block_api;
+         std::shared_ptr<graphene::app::database_api>  _database_api;
+         std::shared_ptr<history_api>                  _history_api;
+   };
+
 
    /**
     * @brief The network_broadcast_api class allows broadcasting of transactions.
@@ -265,6 +441,11 @@ namespace graphene { namespace app {
           */
          std::vector<net::potential_peer_record> get_potential_peers() const;
 
+         /**
+          * @brief Get the cost accounting of API calls: calls, cost units, time and rejections per method
+          */
+         fc::variant_object get_api_cost_info() const;
+
       private:
          application& _app;
    };
@@ -313,14 +494,28 @@ namespace graphene { namespace app {
    class asset_api
    {
       public:
-         asset_api(graphene::chain::database& db);
+         asset_api(application& app);
          ~asset_api();
 
+         /**
+          * @brief Get the largest holders of an asset
+          * @return at most api-limit-get-asset-holders holders, ordered by balance from the largest,
+          *         use get_asset_holders_page() to list the rest
+          */
          vector<account_asset_balance> get_asset_holders( asset_aid_type asset_id )const;
+         /**
+          * @brief Get the holders of an asset, ordered by balance from the largest
+          * @param cursor next_cursor of the previous page, empty for the first page
+          * @param limit Maximum number of holders to return (must not exceed api-limit-get-asset-holders)
+          */
+         page<account_asset_balance> get_asset_holders_page( asset_aid_type asset_id, const string& cursor,
+                                                             uint32_t limit )const;
+         /// @return the number of accounts with a non-zero balance of the asset
          uint64_t get_asset_holders_count( asset_aid_type asset_id )const;
          vector<asset_holders> get_all_asset_holders() const;
 
       private:
+         application&               _app;
          graphene::chain::database& _db;
    };
 
@@ -361,10 +556,15 @@ namespace graphene { namespace app {
          fc::api<asset_api> asset()const;
          /// @brief Retrieve the debug API (if available)
          fc::api<graphene::debug_witness::debug_api> debug()const;
+         /// @brief Retrieve the binary-encoded API
+         fc::api<raw_api> raw()const;
 
          /// @brief Called to enable an API, not reflected.
          void enable_api( const string& api_name );
       private:
+         /// database_api and history_api instances of this session, shared with raw_api
+         std::shared_ptr< database_api > get_database_api_instance();
+         std::shared_ptr< history_api > get_history_api_instance();
 
          application& _app;
          optional< fc::api<block_api> > _block_api;
@@ -375,6 +575,9 @@ namespace graphene { namespace app {
          optional< fc::api<crypto_api> > _crypto_api;
          optional< fc::api<asset_api> > _asset_api;
          optional< fc::api<graphene::debug_witness::debug_api> > _debug_api;
+         optional< fc::api<raw_api> > _raw_api;
+         std::shared_ptr< database_api > _database_api_instance;
+         std::shared_ptr< history_api > _history_api_instance;
    };
 
 }}  // graphene::app
@@ -390,6 +593,8 @@ FC_REFLECT( graphene::app::verify_range_proof_rewind_result,
 
 FC_REFLECT( graphene::app::account_asset_balance, (account_uid)(amount) );
 FC_REFLECT( graphene::app::asset_holders, (asset_id)(count) );
+FC_REFLECT( graphene::app::history_stream_chunk, (stream_id)(sequence)(items)(last)(error) );
+FC_REFLECT( graphene::app::account_history_watermark, (head_block_num)(indexed_block_num)(stored_block_num)(error) );
 
 FC_API(graphene::app::history_api,
        //(get_account_history)
@@ -397,10 +602,27 @@ FC_API(graphene::app::history_api,
        (get_relative_account_history)
        (get_market_history)
        (get_fill_order_history)
+       (get_relative_account_history_page)
+       (get_account_history_by_block_range)
+       (get_account_history_by_time)
+       (get_market_history_page)
+       (get_market_candles)
+       (stream_relative_account_history)
+       (stream_market_history)
+       (stream_trade_history)
+       (ack_stream)
+       (cancel_stream)
+       (get_account_history_watermark)
      )
 FC_API(graphene::app::block_api,
        (get_blocks)
      )
+FC_API(graphene::app::raw_api,
+       (get_block)
+       (get_blocks)
+       (get_full_accounts_by_uid)
+       (get_relative_account_history)
+     )
 FC_API(graphene::app::network_broadcast_api,
        (broadcast_transaction)
        (broadcast_transaction_with_callback)
@@ -413,6 +635,7 @@ FC_API(graphene::app::network_node_api,
        (get_potential_peers)
        (get_advanced_node_parameters)
        (set_advanced_node_parameters)
+       (get_api_cost_info)
      )
 FC_API(graphene::app::crypto_api,
        (blind_sign)
@@ -427,6 +650,7 @@ FC_API(graphene::app::crypto_api,
      )
 FC_API(graphene::app::asset_api,
        (get_asset_holders)
+       (get_asset_holders_page)
        (get_asset_holders_count)
        (get_all_asset_holders)
      )
@@ -440,4 +664,5 @@ FC_API(graphene::app::login_api,
        (crypto)
        (asset)
        (debug)
+       (raw)
      )
@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/time.hpp>
+#include <fc/variant_object.hpp>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+
+namespace graphene { namespace app {
+
+   /**
+    * A budget of API cost units which refills at a constant rate up to its capacity.  A call is
+    * admitted when the bucket holds its estimated cost; the time the call actually took is charged
+    * afterwards and may push the bucket into debt, which delays the next calls.
+    */
+   class api_token_bucket
+   {
+      public:
+         api_token_bucket( double capacity, double refill_per_second );
+
+         /// @return true if @p cost units are available now
+         bool has( double cost );
+         /// Takes @p cost units, the bucket may go below zero
+         void take( double cost );
+         /// @return how long until @p cost units are available
+         fc::microseconds time_until( double cost );
+
+         double capacity()const { return _capacity; }
+
+      private:
+         void refill();
+
+         double          _capacity;
+         double          _refill_per_second;
+         double          _tokens;
+         fc::time_point  _last_refill;
+   };
+
+   /**
+    * Cost accounting and admission control for API calls.
+    *
+    * A call is estimated at the weight of its method, multiplied by the number of items of its largest
+    * array argument, so that looking up many accounts costs more than looking up one.  When it has run,
+    * every millisecond it took is charged as well.  Costs are drawn from a bucket of the connection and
+    * from a bucket shared by all connections of the same api-access user; a call that does not fit
+    * waits for the buckets to refill and is rejected if that takes too long.
+    */
+   class api_cost_limiter
+   {
+      public:
+         /// Calls of at most this many methods are counted apart, the methods after them are counted as "(other)"
+         static const size_t max_tracked_methods = 512;
+
+         struct options
+         {
+            double   connection_capacity = 0;   ///< cost units a connection may burst, 0 disables its budget
+            double   connection_refill = 0;     ///< cost units per second a connection gets back
+            double   user_capacity = 0;         ///< cost units the connections of one user may burst, 0 disables
+            double   user_refill = 0;
+            uint32_t max_wait_ms = 1000;        ///< longest a call waits for budget before it is rejected
+            std::map<std::string, double> method_weights;   ///< overrides of the built-in weights
+         };
+
+         explicit api_cost_limiter( const options& opts );
+
+         bool enabled()const { return _options.connection_capacity > 0 || _options.user_capacity > 0; }
+
+         /// @return the estimated cost of a call of @p method with @p items items in its largest array argument
+         double estimate( const std::string& method, size_t items )const;
+         /// @return the cost units charged for a call that ran for @p elapsed
+         static double time_cost( const fc::microseconds& elapsed );
+
+         /// @return a new connection budget, null if connection budgets are disabled
+         std::unique_ptr<api_token_bucket>  make_connection_bucket()const;
+         /// @return the budget shared by connections of @p user, null if user budgets are disabled
+         std::shared_ptr<api_token_bucket>  get_user_bucket( const std::string& user );
+
+         const options& get_options()const { return _options; }
+
+         void record_call( const std::string& method, double cost, const fc::microseconds& elapsed );
+         void record_rejection( const std::string& method );
+
+         /// @return per method call counts, costs, time and rejections
+         fc::variant_object get_info()const;
+
+      private:
+         struct method_stats
+         {
+            uint64_t calls = 0;
+            uint64_t rejected = 0;
+            double   cost = 0;
+            int64_t  time_us = 0;
+         };
+
+         /// @return the counters of @p method, taken from a client request
+         method_stats& stats_of( const std::string& method );
+
+         options                                                  _options;
+         std::map<std::string, std::shared_ptr<api_token_bucket>> _user_buckets;
+         std::map<std::string, method_stats>                      _stats;
+         method_stats                                             _other_stats;
+   };
+
+} } // graphene::app
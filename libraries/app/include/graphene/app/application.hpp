@@ -34,6 +34,8 @@ namespace graphene { namespace app {
    using std::string;
 
    class abstract_plugin;
+   class api_cost_limiter;
+   class metrics_registry;
 
    class application_options
    {
@@ -48,6 +50,14 @@ namespace graphene { namespace app {
       uint64_t api_limit_get_asset_holders = 100;
       uint64_t api_limit_get_key_references = 100;
       uint64_t api_limit_get_htlc_by = 100;
+      uint64_t api_limit_page_size = 1000; ///< most records in one page of the cursor paginated APIs
+      uint64_t api_limit_get_blocks = 100; ///< most blocks returned by one raw_api::get_blocks call
+      uint64_t api_limit_get_full_accounts = 100; ///< most accounts requested in one raw_api::get_full_accounts_by_uid call
+      uint64_t api_limit_subscribed_objects = 100000; ///< most objects one database_api subscription watches
+      uint32_t rpc_max_batch_size = 100; ///< most requests accepted in one JSON-RPC batch
+      /** database_api methods whose responses are cached until the next block, empty disables the cache */
+      std::set<std::string> api_cache_methods;
+      uint64_t api_cache_max_size = 16 * 1024 * 1024;
    };
 
    class application
@@ -66,6 +76,10 @@ namespace graphene { namespace app {
          void shutdown_plugins();
 
          const application_options& get_options();
+         /// Cost accounting of API calls, shared by all RPC connections
+         std::shared_ptr<api_cost_limiter> get_api_cost_limiter()const;
+         /// Metrics served on metrics-endpoint, null if it is not configured; plugins may add their own
+         std::shared_ptr<metrics_registry> get_metrics()const;
 
          template<typename PluginType>
          std::shared_ptr<PluginType> register_plugin()
@@ -0,0 +1,90 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <vector>
+
+namespace graphene { namespace app {
+
+   /**
+    * A bloom filter over 64 bit keys that supports removal.  Counters saturate rather than
+    * wrap, and a saturated counter is never decremented, so the filter can give false
+    * positives but never false negatives.
+    */
+   class counting_bloom_filter
+   {
+      public:
+         explicit counting_bloom_filter( size_t number_of_counters = 1 << 16 )
+            : _counters( number_of_counters, 0 ) {}
+
+         void insert( uint64_t key )
+         {
+            for( size_t i = 0; i < number_of_hashes; ++i )
+            {
+               uint8_t& counter = _counters[slot( key, i )];
+               if( counter < std::numeric_limits<uint8_t>::max() )
+                  ++counter;
+            }
+         }
+
+         void remove( uint64_t key )
+         {
+            for( size_t i = 0; i < number_of_hashes; ++i )
+            {
+               uint8_t& counter = _counters[slot( key, i )];
+               if( counter > 0 && counter < std::numeric_limits<uint8_t>::max() )
+                  --counter;
+            }
+         }
+
+         bool may_contain( uint64_t key )const
+         {
+            for( size_t i = 0; i < number_of_hashes; ++i )
+               if( _counters[slot( key, i )] == 0 )
+                  return false;
+            return true;
+         }
+
+      private:
+         static const size_t number_of_hashes = 3;
+
+         size_t slot( uint64_t key, size_t i )const
+         {
+            // mix the key (splitmix64 finalizer), then derive the hash functions from its two halves
+            uint64_t z = key + 0x9e3779b97f4a7c15ULL;
+            z = ( z ^ ( z >> 30 ) ) * 0xbf58476d1ce4e5b9ULL;
+            z = ( z ^ ( z >> 27 ) ) * 0x94d049bb133111ebULL;
+            z ^= z >> 31;
+            uint64_t h1 = z & 0xffffffff;
+            uint64_t h2 = ( z >> 32 ) | 1;
+            return ( h1 + i * h2 ) % _counters.size();
+         }
+
+         std::vector<uint8_t> _counters;
+   };
+
+} } // graphene::app
@@ -24,6 +24,7 @@
 #pragma once
 
 #include <graphene/app/full_account.hpp>
+#include <graphene/app/page_cursor.hpp>
 
 #include <graphene/chain/protocol/types.hpp>
 
@@ -53,6 +54,8 @@
 #include <functional>
 #include <map>
 #include <memory>
+#include <set>
+#include <string>
 #include <vector>
 
 namespace graphene { namespace app {
@@ -210,6 +213,9 @@ class database_api
       database_api(graphene::chain::database& db, const application_options* app_options = nullptr);
       ~database_api();
 
+      /** the methods whose responses can be cached with the api-cache-methods option */
+      static const std::set<std::string>& cacheable_methods();
+
       /////////////
       // Objects //
       /////////////
@@ -304,6 +310,12 @@ class database_api
        */
       dynamic_global_property_object get_dynamic_global_properties()const;
 
+      /**
+       * @brief Get the size and per-method hit rates of the response cache
+       * @return cache statistics; the cached methods are set with the api-cache-methods option
+       */
+      fc::variant_object get_response_cache_info()const;
+
       //////////
       // Keys //
       //////////
@@ -528,6 +540,24 @@ class database_api
                                        const uint32_t         limit,
                                        const bool             list_cur_period = true)const;
 
+      /**
+       * @brief Get scores of a post one page at a time, newest first
+       * @param platform platform of the post
+       * @param poster_uid poster of the post
+       * @param post_pid pid of the post
+       * @param list_cur_period true to list scores of the current period only, a listing started in one
+       *        period stays in that period
+       * @param cursor empty for the first page, next_cursor of the previous page otherwise
+       * @param limit Maximum number of scores in the page (must not exceed api-limit-page-size)
+       * @return the page, next_cursor is empty if there are no more scores
+       */
+      page<score_object> list_scores_page(const account_uid_type platform,
+                                          const account_uid_type poster_uid,
+                                          const post_pid_type    post_pid,
+                                          const bool             list_cur_period,
+                                          const string&          cursor,
+                                          const uint32_t         limit)const;
+
       optional<license_object> get_license(const account_uid_type platform,
                                            const license_lid_type license_lid)const;
 
@@ -693,6 +723,46 @@ class database_api
       */
       void unsubscribe_from_market(const std::string& a, const std::string& b);
 
+      /**
+      * @brief Request notification when price levels of the order book of a market change
+      * @param callback Callback method which is called after each block that changed the order book
+      * @param a First asset Symbol or ID
+      * @param b Second asset Symbol or ID
+      *
+      * Callback will be passed a variant containing a vector<order_book_level_change>, the new total amount for
+      * sale at every price of the market that changed, 0 for a price without orders left.  Applied to the result of
+      * get_order_book they keep a copy of the order book up to date.
+      */
+      void subscribe_to_order_book(std::function<void(const variant&)> callback,
+         const std::string& a, const std::string& b);
+
+      /**
+      * @brief Unsubscribe from order book updates of a given market
+      * @param a First asset Symbol ID
+      * @param b Second asset Symbol ID
+      */
+      void unsubscribe_from_order_book(const std::string& a, const std::string& b);
+
+      /**
+      * @brief Request notification when candles of a market change
+      * @param callback Callback method which is called after each block with fills in the market
+      * @param a First asset Symbol or ID
+      * @param b Second asset Symbol or ID
+      * @param seconds Length of the candles in seconds, see history_api::get_market_candles
+      *
+      * Callback will be passed a variant containing the market_candle of the head block time after the fills.
+      */
+      void subscribe_to_market_candles(std::function<void(const variant&)> callback,
+         const std::string& a, const std::string& b, uint32_t seconds);
+
+      /**
+      * @brief Unsubscribe from candle updates of a given market and candle length
+      * @param a First asset Symbol ID
+      * @param b Second asset Symbol ID
+      * @param seconds Length of the candles in seconds
+      */
+      void unsubscribe_from_market_candles(const std::string& a, const std::string& b, uint32_t seconds);
+
       /**
       * @brief Returns the ticker for the market assetA:assetB
       * @param a String name of the first asset
@@ -714,6 +784,7 @@ class database_api
       * @param base String name of the first asset
       * @param quote String name of the second asset
       * @param depth of the order book. Up to depth of each asks and bids, capped at 50. Prioritizes most moderate of each
+      * With the market history plugin every entry is a price level, holding all orders at its price
       * @return Order book of the market
       */
       order_book get_order_book(const string& base, const string& quote, unsigned limit = 50)const;
@@ -756,6 +827,22 @@ class database_api
          int64_t start, fc::time_point_sec stop,
          unsigned limit = 100)const;
 
+      /**
+      * @brief Returns trades for the market base:quote one page at a time, most recent first.
+      * Unlike get_trade_history, trades in the same second are never cut off: the cursor holds the exact
+      * position of the next trade.
+      * @param base symbol or ID of the base asset
+      * @param quote symbol or ID of the quote asset
+      * @param start Start time as a UNIX timestamp, the latest trade to retrieve, only used for the first page
+      * @param stop Stop time as a UNIX timestamp, the earliest trade to retrieve
+      * @param cursor empty for the first page, next_cursor of the previous page otherwise
+      * @param limit Number of trades in the page, must not exceed api-limit-page-size
+      * @return the page, next_cursor is empty if there are no more trades
+      */
+      page<market_trade> get_trade_history_page(const string& base, const string& quote,
+         fc::time_point_sec start, fc::time_point_sec stop,
+         const string& cursor, uint32_t limit)const;
+
       ///////////////
       // Witnesses //
       ///////////////
@@ -969,6 +1056,7 @@ FC_API( graphene::app::database_api,
    (get_config)
    (get_chain_id)
    (get_dynamic_global_properties)
+   (get_response_cache_info)
 
    // Keys
    (get_key_references)
@@ -1006,6 +1094,7 @@ FC_API( graphene::app::database_api,
    (get_score)
    (get_scores_by_uid)
    (list_scores)
+   (list_scores_page)
    (get_license)
    (list_licenses)
    (get_advertising)
@@ -1037,12 +1126,17 @@ FC_API( graphene::app::database_api,
    (get_account_all_limit_orders)
    (subscribe_to_market)
    (unsubscribe_from_market)
+   (subscribe_to_order_book)
+   (unsubscribe_from_order_book)
+   (subscribe_to_market_candles)
+   (unsubscribe_from_market_candles)
    (get_ticker)
    (get_24_volume)
    (get_order_book)
    (get_top_markets)
    (get_trade_history)
    (get_trade_history_by_sequence)
+   (get_trade_history_page)
 
    // Witnesses
    (get_witnesses)
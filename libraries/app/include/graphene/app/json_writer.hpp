@@ -0,0 +1,276 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/config.hpp>
+#include <graphene/chain/protocol/ext.hpp>
+#include <graphene/chain/protocol/types.hpp>
+
+#include <fc/container/flat.hpp>
+#include <fc/io/json.hpp>
+#include <fc/optional.hpp>
+#include <fc/reflect/reflect.hpp>
+#include <fc/reflect/variant.hpp>
+#include <fc/safe.hpp>
+#include <fc/static_variant.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <set>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace app {
+
+   /**
+    * Reflected types whose to_variant() is not the generic field-by-field one.  The JSON
+    * writer hands these to fc so their output stays exactly what fc produces.
+    */
+   template<typename T> struct json_writer_uses_variant : std::false_type {};
+   template<typename T> struct json_writer_uses_variant< fc::safe<T> > : std::true_type {};
+   template<typename T> struct json_writer_uses_variant< graphene::chain::extension<T> > : std::true_type {};
+   template<> struct json_writer_uses_variant< graphene::chain::public_key_type > : std::true_type {};
+   template<> struct json_writer_uses_variant< graphene::chain::extended_public_key_type > : std::true_type {};
+   template<> struct json_writer_uses_variant< graphene::chain::extended_private_key_type > : std::true_type {};
+
+   namespace detail {
+
+   /**
+    * Writes JSON for a value straight into a string, without building an fc::variant tree
+    * first.  Reflected structs, containers, optionals, static_variants, integers and plain
+    * strings are written here; every other leaf type (ids, hashes, keys, times, enums, maps...)
+    * is converted through fc, so the result is byte-for-byte what
+    * fc::json::to_string( fc::variant( value ) ) returns.
+    */
+   class json_stream_writer
+   {
+      public:
+         json_stream_writer( std::string& out, uint32_t max_depth ) : _out( out ), _max_depth( max_depth ) {}
+
+         void write( bool v )
+         {
+            _out += v ? "true" : "false";
+         }
+
+         void write( const std::string& v )
+         {
+            for( char c : v )
+            {
+               // anything fc would escape is left to fc
+               if( c < 0x20 || c > 0x7e || c == '"' || c == '\\' )
+                  return write_variant( v );
+            }
+            _out += '"';
+            _out += v;
+            _out += '"';
+         }
+
+         // fc writes vector<char> as hex
+         void write( const std::vector<char>& v ) { write_variant( v ); }
+
+         template<typename T>
+         void write( const fc::optional<T>& v )
+         {
+            if( v.valid() )
+               write( *v );
+            else
+               _out += "null";
+         }
+
+         template<typename A, typename B>
+         void write( const std::pair<A,B>& v )
+         {
+            _out += '[';
+            write( v.first );
+            _out += ',';
+            write( v.second );
+            _out += ']';
+         }
+
+         template<typename T> void write( const std::vector<T>& v )           { write_array( v ); }
+         template<typename T> void write( const std::deque<T>& v )            { write_array( v ); }
+         template<typename T> void write( const std::set<T>& v )              { write_array( v ); }
+         template<typename T> void write( const fc::flat_set<T>& v )          { write_array( v ); }
+
+         template<typename... Types>
+         void write( const fc::static_variant<Types...>& v )
+         {
+            _out += '[';
+            write_integer( static_cast<int64_t>( v.which() ) );
+            _out += ',';
+            static_variant_visitor visitor( *this );
+            v.visit( visitor );
+            _out += ']';
+         }
+
+         template<typename T>
+         void write( const T& v )
+         {
+            write_value( v, std::integral_constant< int, category<T>::value >() );
+         }
+
+      private:
+         enum { fallback_category = 0, signed_category = 1, unsigned_category = 2, struct_category = 3 };
+
+         template<typename T>
+         struct category
+         {
+            static const bool is_integer = std::is_integral<T>::value
+                                           && !std::is_same<T, char>::value && !std::is_same<T, bool>::value;
+            static const bool is_struct = fc::reflector<T>::is_defined::value && !fc::reflector<T>::is_enum::value
+                                          && !json_writer_uses_variant<T>::value;
+            static const int value = is_integer ? ( std::is_signed<T>::value ? signed_category : unsigned_category )
+                                                : ( is_struct ? struct_category : fallback_category );
+         };
+
+         template<typename T>
+         void write_value( const T& v, std::integral_constant<int, fallback_category> ) { write_variant( v ); }
+
+         template<typename T>
+         void write_value( const T& v, std::integral_constant<int, signed_category> )
+         {
+            write_integer( static_cast<int64_t>( v ) );
+         }
+
+         template<typename T>
+         void write_value( const T& v, std::integral_constant<int, unsigned_category> )
+         {
+            // fc quotes integers that do not fit in 32 bits
+            const uint64_t u = v;
+            if( u > 0xffffffff )
+               _out += '"' + std::to_string( u ) + '"';
+            else
+               _out += std::to_string( u );
+         }
+
+         template<typename T>
+         void write_value( const T& v, std::integral_constant<int, struct_category> )
+         {
+            _out += '{';
+            bool first = true;
+            fc::reflector<T>::visit( member_visitor<T>( *this, v, first ) );
+            _out += '}';
+         }
+
+         void write_integer( int64_t i )
+         {
+            if( i > INT32_MAX || i < INT32_MIN )
+               _out += '"' + std::to_string( i ) + '"';
+            else
+               _out += std::to_string( i );
+         }
+
+         template<typename Container>
+         void write_array( const Container& c )
+         {
+            _out += '[';
+            bool first = true;
+            for( const auto& item : c )
+            {
+               if( !first )
+                  _out += ',';
+               first = false;
+               write( item );
+            }
+            _out += ']';
+         }
+
+         template<typename T>
+         void write_variant( const T& v )
+         {
+            _out += fc::json::to_string( fc::variant( v, _max_depth ), fc::json::stringify_large_ints_and_doubles,
+                                         _max_depth );
+         }
+
+         template<typename T>
+         struct member_visitor
+         {
+            member_visitor( json_stream_writer& w, const T& o, bool& f ) : writer( w ), obj( o ), first( f ) {}
+
+            template<typename Member, class Class, Member (Class::*member)>
+            void operator()( const char* name )const
+            {
+               write_member( name, obj.*member );
+            }
+
+            template<typename M>
+            void write_member( const char* name, const M& m )const
+            {
+               if( !first )
+                  writer._out += ',';
+               first = false;
+               writer._out += '"';
+               writer._out += name;
+               writer._out += "\":";
+               writer.write( m );
+            }
+
+            // fc leaves unset optional members out of the object
+            template<typename M>
+            void write_member( const char* name, const fc::optional<M>& m )const
+            {
+               if( m.valid() )
+                  write_member( name, *m );
+            }
+
+            json_stream_writer& writer;
+            const T&            obj;
+            bool&               first;
+         };
+
+         struct static_variant_visitor
+         {
+            typedef void result_type;
+            explicit static_variant_visitor( json_stream_writer& w ) : writer( w ) {}
+
+            template<typename T>
+            void operator()( const T& v )const { writer.write( v ); }
+
+            json_stream_writer& writer;
+         };
+
+         std::string& _out;
+         uint32_t     _max_depth;
+   };
+
+   } // detail
+
+   /// Appends the JSON for @p v to @p out; the output is identical to fc::json::to_string( fc::variant( v ) )
+   template<typename T>
+   void write_json( std::string& out, const T& v, uint32_t max_depth = GRAPHENE_MAX_NESTED_OBJECTS )
+   {
+      detail::json_stream_writer( out, max_depth ).write( v );
+   }
+
+   template<typename T>
+   std::string to_json( const T& v, uint32_t max_depth = GRAPHENE_MAX_NESTED_OBJECTS )
+   {
+      std::string out;
+      write_json( out, v, max_depth );
+      return out;
+   }
+
+} } // graphene::app
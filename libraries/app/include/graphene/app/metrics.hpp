@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/time.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace app {
+
+   /**
+    * Counters, gauges and histograms of the node, rendered in the Prometheus text exposition format.
+    *
+    * A metric is declared once with its help text and then updated by name; each distinct label set
+    * is its own series.  Gauges that are cheaper to read than to keep up to date are filled by
+    * collectors, which run right before every render().  Like the rest of the node the registry is
+    * only used from the main thread.
+    */
+   class metrics_registry
+   {
+      public:
+         /// A family gets at most this many label sets, later ones are added to the series without labels
+         static const size_t max_series_per_metric = 512;
+
+         void declare_counter( const std::string& name, const std::string& help );
+         void declare_gauge( const std::string& name, const std::string& help );
+         /// @param bounds upper bounds of the buckets, in increasing order
+         void declare_histogram( const std::string& name, const std::string& help, const std::vector<double>& bounds );
+
+         void increment( const std::string& name, double value = 1, const std::string& labels = std::string() );
+         void set( const std::string& name, double value, const std::string& labels = std::string() );
+         void observe( const std::string& name, double value, const std::string& labels = std::string() );
+         void observe( const std::string& name, const fc::microseconds& elapsed, const std::string& labels = std::string() )
+         {
+            observe( name, elapsed.count() / 1000000.0, labels );
+         }
+
+         void add_collector( std::function<void( metrics_registry& )> collector );
+
+         /// @return all metrics in the text exposition format
+         std::string render();
+
+         /// @return @p key="value" with the value escaped for the exposition format
+         static std::string label( const std::string& key, const std::string& value );
+
+         /// Bucket bounds for durations in seconds, from 100us to 10s
+         static const std::vector<double>& duration_buckets();
+
+      private:
+         enum metric_type { counter_type, gauge_type, histogram_type };
+
+         struct series
+         {
+            double                value = 0;
+            uint64_t              count = 0;
+            std::vector<uint64_t> buckets;
+         };
+
+         struct metric
+         {
+            metric_type                     type = counter_type;
+            std::string                     help;
+            std::vector<double>             bounds;
+            std::map<std::string, series>   series_by_labels;
+         };
+
+         void     declare( const std::string& name, metric_type type, const std::string& help,
+                           const std::vector<double>& bounds );
+         series&  get_series( const std::string& name, metric_type type, const std::string& labels );
+
+         std::map<std::string, metric>                          _metrics;
+         std::vector< std::function<void( metrics_registry& )> > _collectors;
+   };
+
+} } // graphene::app
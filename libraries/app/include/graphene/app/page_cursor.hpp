@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <fc/crypto/hex.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/reflect/reflect.hpp>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace graphene { namespace app {
+
+   /**
+    * Position of a paginated query, handed to clients as an opaque string.  It holds the index
+    * key of the next record to return, so a page continues exactly where the previous one
+    * stopped however many records were added in between, and the head block at the time it was
+    * issued.
+    */
+   struct page_cursor
+   {
+      enum cursor_kind
+      {
+         relative_account_history = 1,
+         market_history           = 2,
+         trade_history            = 3,
+         scores                   = 4,
+         asset_holders            = 5,
+         account_history_by_block = 6
+      };
+
+      uint8_t           kind = 0;
+      uint32_t          block_num = 0;
+      std::vector<char> position;
+
+      /// @return the cursor string for the index key @p key of the next record
+      template<typename Key>
+      static std::string encode( cursor_kind kind, uint32_t block_num, const Key& key )
+      {
+         page_cursor cursor;
+         cursor.kind = kind;
+         cursor.block_num = block_num;
+         cursor.position = fc::raw::pack( key );
+         return fc::to_hex( fc::raw::pack( cursor ) );
+      }
+
+      /// @return the index key stored in @p cursor_string, which must have been issued for a query of @p kind
+      template<typename Key>
+      static Key decode( const std::string& cursor_string, cursor_kind kind, uint32_t head_block_num )
+      {
+         page_cursor cursor;
+         try
+         {
+            std::vector<char> data( cursor_string.size() / 2 );
+            FC_ASSERT( data.size() * 2 == cursor_string.size()
+                       && fc::from_hex( cursor_string, data.data(), data.size() ) == data.size() );
+            cursor = fc::raw::unpack<page_cursor>( data );
+         }
+         FC_RETHROW_EXCEPTIONS( warn, "Malformed cursor" )
+         FC_ASSERT( cursor.kind == kind, "The cursor was issued for a different query" );
+         FC_ASSERT( cursor.block_num <= head_block_num,
+                    "The cursor was issued at block ${b}, which is ahead of this node's head block ${h}",
+                    ("b", cursor.block_num)("h", head_block_num) );
+         try
+         {
+            return fc::raw::unpack<Key>( cursor.position );
+         }
+         FC_RETHROW_EXCEPTIONS( warn, "Malformed cursor" )
+      }
+   };
+
+   /// One page of a cursor-paginated query
+   template<typename T>
+   struct page
+   {
+      std::vector<T> items;
+      std::string    next_cursor;          ///< pass to the next call to continue, empty after the last page
+      uint32_t       head_block_num = 0;   ///< head block the page was read at
+   };
+
+} } // graphene::app
+
+FC_REFLECT( graphene::app::page_cursor, (kind)(block_num)(position) )
+FC_REFLECT_TEMPLATE( (typename T), graphene::app::page<T>, (items)(next_cursor)(head_block_num) )
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/api.hpp>
+
+#include <fc/crypto/base64.hpp>
+#include <fc/io/raw.hpp>
+
+namespace graphene { namespace app {
+
+   /**
+    * @brief Client side of raw_api
+    *
+    * Wraps a local or remote raw_api, decodes each base64 result and unpacks it into the type the
+    * corresponding JSON API would have returned.  Obtain the api from login_api::raw(), e.g.
+    * @code
+    * raw_api_client client( remote_login_api->raw() );
+    * optional<signed_block> block = client.get_block( 1000 );
+    * @endcode
+    */
+   class raw_api_client
+   {
+      public:
+         explicit raw_api_client( fc::api<raw_api> api ) : _api( std::move( api ) ) {}
+
+         optional<signed_block> get_block( uint32_t block_num )const
+         {
+            return unpack< optional<signed_block> >( _api->get_block( block_num ) );
+         }
+
+         vector<optional<signed_block>> get_blocks( uint32_t block_num_from, uint32_t block_num_to )const
+         {
+            return unpack< vector<optional<signed_block>> >( _api->get_blocks( block_num_from, block_num_to ) );
+         }
+
+         std::map<account_uid_type,full_account> get_full_accounts_by_uid( const vector<account_uid_type>& uids,
+                                                                           const full_account_query_options& options )const
+         {
+            return unpack< std::map<account_uid_type,full_account> >( _api->get_full_accounts_by_uid( uids, options ) );
+         }
+
+         vector<std::pair<uint32_t,operation_history_object>> get_relative_account_history( account_uid_type account,
+                                                                                            optional<uint16_t> op_type,
+                                                                                            uint32_t stop = 0,
+                                                                                            unsigned limit = 100,
+                                                                                            uint32_t start = 0 )const
+         {
+            return unpack< vector<std::pair<uint32_t,operation_history_object>> >(
+               _api->get_relative_account_history( account, op_type, stop, limit, start ) );
+         }
+
+      private:
+         template<typename T>
+         static T unpack( const std::string& encoded )
+         {
+            const std::string packed = fc::base64_decode( encoded );
+            return fc::raw::unpack<T>( std::vector<char>( packed.begin(), packed.end() ) );
+         }
+
+         fc::api<raw_api> _api;
+   };
+
+} } // graphene::app
@@ -0,0 +1,103 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/app/api_cost_limiter.hpp>
+#include <graphene/app/metrics.hpp>
+
+#include <fc/rpc/websocket_api.hpp>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+
+namespace graphene { namespace app {
+
+   /**
+    * The server side of an API websocket or HTTP connection.  Besides single JSON-RPC
+    * requests it accepts JSON-RPC 2.0 batches: an array of requests in one message, which
+    * are run in order and answered with one array of responses.  A malformed element is
+    * answered with invalid request (-32600), a failure of the server around a call with
+    * internal error (-32603); errors of the called method are reported as for single calls.
+    *
+    * Methods registered with register_streamed_method() skip fc's variant conversion: the handler
+    * gets the call arguments and returns the JSON of the result, which is written into the reply
+    * as is.  Requests the streamed path does not recognize go through the regular path; once a
+    * handler has been called, its exceptions are reported in the same form as fc reports them.
+    *
+    * With an api_cost_limiter every call is charged to the budget of the connection and of the
+    * api-access user it logged in as, and waits or is rejected when the budget is spent.  The
+    * calls of one websocket message wait at most max_wait_ms together, HTTP requests don't wait.
+    *
+    * With a metrics_registry the number and duration of calls are counted per method.
+    */
+   class websocket_rpc_connection : public fc::rpc::websocket_api_connection
+   {
+      public:
+         websocket_rpc_connection( fc::http::websocket_connection& c, uint32_t max_conversion_depth,
+                                   uint32_t max_batch_size,
+                                   std::shared_ptr<api_cost_limiter> cost_limiter = std::shared_ptr<api_cost_limiter>() );
+
+         /// Handler of a streamed method: takes the call arguments, returns the JSON of the result
+         typedef std::function<std::string( const fc::variants& )> streamed_method;
+
+         void register_streamed_method( fc::api_id_type api_id, const std::string& method, streamed_method handler );
+
+         /// Charge calls of this connection to the budget of api-access user @p user as well
+         void set_user( const std::string& user );
+
+         /// Count calls of this connection in @p metrics, which must declare the yoyow_api_* metrics
+         void set_metrics( std::shared_ptr<metrics_registry> metrics ) { _metrics = std::move( metrics ); }
+
+      protected:
+         std::string handle_message( const std::string& message, bool send_reply );
+         std::string handle_batch( const std::string& message, const fc::time_point& budget_deadline );
+         std::string handle_single( const std::string& message, bool send_reply, const fc::time_point& budget_deadline );
+         /// Charges, runs and measures one parsed request, @return its reply
+         std::string handle_call( const fc::variant_object& call, bool send_reply, const fc::time_point& budget_deadline );
+         bool        try_streamed_call( const fc::variant_object& call, std::string& reply );
+         /// Runs a request through the registered APIs, @return its reply, empty for a notification
+         std::string dispatch( const fc::variant_object& call );
+
+         /// Finds the API method a request calls and the size of its largest array argument
+         void        describe_call( const fc::variant_object& call, std::string& method, size_t& items )const;
+         /// Waits until the budgets hold @p cost, @return false if that would be after @p deadline
+         bool        wait_for_budget( double cost, const fc::time_point& deadline );
+         void        charge( double cost );
+         void        on_login_reply( const fc::variant_object& call, const std::string& reply );
+
+         uint32_t _max_request_depth;
+         uint32_t _max_batch_size;
+
+         std::map< std::pair<fc::api_id_type, std::string>, streamed_method > _streamed_methods;
+
+         std::shared_ptr<api_cost_limiter>                                    _cost_limiter;
+         std::unique_ptr<api_token_bucket>                                    _connection_budget;
+         std::shared_ptr<api_token_bucket>                                    _user_budget;
+         std::shared_ptr<metrics_registry>                                    _metrics;
+   };
+
+} } // graphene::app
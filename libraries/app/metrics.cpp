@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/metrics.hpp>
+
+#include <fc/exception/exception.hpp>
+#include <fc/log/logger.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+namespace graphene { namespace app {
+
+namespace {
+   std::string format_value( double v )
+   {
+      if( std::isinf( v ) )
+         return v > 0 ? "+Inf" : "-Inf";
+      if( std::isnan( v ) )
+         return "NaN";
+      char buffer[32];
+      if( v == std::floor( v ) && std::fabs( v ) < 1e15 )
+         std::snprintf( buffer, sizeof( buffer ), "%lld", static_cast<long long>( v ) );
+      else
+         std::snprintf( buffer, sizeof( buffer ), "%.10g", v );
+      return buffer;
+   }
+
+   const char* type_name( int type )
+   {
+      switch( type )
+      {
+         case 0: return "counter";
+         case 1: return "gauge";
+         default: return "histogram";
+      }
+   }
+
+   /// @return the series name with its labels, plus one more label if @p extra is not empty
+   std::string series_name( const std::string& name, const std::string& labels, const std::string& extra = std::string() )
+   {
+      if( labels.empty() && extra.empty() )
+         return name;
+      std::string result = name + '{' + labels;
+      if( !labels.empty() && !extra.empty() )
+         result += ',';
+      return result + extra + '}';
+   }
+}
+
+const size_t metrics_registry::max_series_per_metric;
+
+void metrics_registry::declare_counter( const std::string& name, const std::string& help )
+{
+   declare( name, counter_type, help, std::vector<double>() );
+}
+
+void metrics_registry::declare_gauge( const std::string& name, const std::string& help )
+{
+   declare( name, gauge_type, help, std::vector<double>() );
+}
+
+void metrics_registry::declare_histogram( const std::string& name, const std::string& help,
+                                          const std::vector<double>& bounds )
+{
+   FC_ASSERT( std::is_sorted( bounds.begin(), bounds.end() ), "Histogram buckets must be in increasing order" );
+   declare( name, histogram_type, help, bounds );
+}
+
+void metrics_registry::declare( const std::string& name, metric_type type, const std::string& help,
+                                const std::vector<double>& bounds )
+{
+   auto itr = _metrics.find( name );
+   if( itr != _metrics.end() )
+   {
+      FC_ASSERT( itr->second.type == type, "Metric ${n} is already declared with a different type", ("n", name) );
+      return;
+   }
+   metric& m = _metrics[name];
+   m.type = type;
+   m.help = help;
+   m.bounds = bounds;
+}
+
+metrics_registry::series& metrics_registry::get_series( const std::string& name, metric_type type,
+                                                        const std::string& labels )
+{
+   auto itr = _metrics.find( name );
+   FC_ASSERT( itr != _metrics.end(), "Metric ${n} is not declared", ("n", name) );
+   metric& m = itr->second;
+   FC_ASSERT( m.type == type, "Metric ${n} is not a ${t}", ("n", name)("t", type_name( type )) );
+
+   auto series_itr = m.series_by_labels.find( labels );
+   if( series_itr == m.series_by_labels.end() )
+   {
+      // labels taken from requests must not grow the registry without bound
+      const std::string& key = m.series_by_labels.size() < max_series_per_metric ? labels : std::string();
+      series_itr = m.series_by_labels.find( key );
+      if( series_itr == m.series_by_labels.end() )
+      {
+         series_itr = m.series_by_labels.insert( std::make_pair( key, series() ) ).first;
+         series_itr->second.buckets.resize( m.bounds.size() );
+      }
+   }
+   return series_itr->second;
+}
+
+void metrics_registry::increment( const std::string& name, double value, const std::string& labels )
+{
+   get_series( name, counter_type, labels ).value += value;
+}
+
+void metrics_registry::set( const std::string& name, double value, const std::string& labels )
+{
+   get_series( name, gauge_type, labels ).value = value;
+}
+
+void metrics_registry::observe( const std::string& name, double value, const std::string& labels )
+{
+   series& s = get_series( name, histogram_type, labels );
+   const std::vector<double>& bounds = _metrics[name].bounds;
+   auto bucket = std::lower_bound( bounds.begin(), bounds.end(), value );
+   if( bucket != bounds.end() )
+      ++s.buckets[ bucket - bounds.begin() ];
+   ++s.count;
+   s.value += value;
+}
+
+void metrics_registry::add_collector( std::function<void( metrics_registry& )> collector )
+{
+   _collectors.push_back( std::move( collector ) );
+}
+
+std::string metrics_registry::render()
+{
+   for( const auto& collector : _collectors )
+   {
+      try
+      {
+         collector( *this );
+      }
+      catch( const fc::exception& e )
+      {
+         wlog( "Metrics collector failed: ${e}", ("e", e.to_detail_string()) );
+      }
+   }
+
+   std::string out;
+   for( const auto& name_and_metric : _metrics )
+   {
+      const std::string& name = name_and_metric.first;
+      const metric& m = name_and_metric.second;
+      out += "# HELP " + name + ' ' + m.help + '\n';
+      out += "# TYPE " + name + ' ' + type_name( m.type ) + '\n';
+      for( const auto& labels_and_series : m.series_by_labels )
+      {
+         const std::string& labels = labels_and_series.first;
+         const series& s = labels_and_series.second;
+         if( m.type != histogram_type )
+         {
+            out += series_name( name, labels ) + ' ' + format_value( s.value ) + '\n';
+            continue;
+         }
+         // buckets are cumulative in the exposition format
+         uint64_t cumulative = 0;
+         for( size_t i = 0; i < m.bounds.size(); ++i )
+         {
+            cumulative += s.buckets[i];
+            out += series_name( name + "_bucket", labels, "le=\"" + format_value( m.bounds[i] ) + '"' )
+                   + ' ' + format_value( cumulative ) + '\n';
+         }
+         out += series_name( name + "_bucket", labels, "le=\"+Inf\"" ) + ' ' + format_value( s.count ) + '\n';
+         out += series_name( name + "_sum", labels ) + ' ' + format_value( s.value ) + '\n';
+         out += series_name( name + "_count", labels ) + ' ' + format_value( s.count ) + '\n';
+      }
+   }
+   return out;
+}
+
+std::string metrics_registry::label( const std::string& key, const std::string& value )
+{
+   std::string result = key + "=\"";
+   for( char c : value )
+   {
+      if( c == '\\' || c == '"' )
+         result += '\\';
+      if( c == '\n' )
+      {
+         result += "\\n";
+         continue;
+      }
+      result += c;
+   }
+   return result + '"';
+}
+
+const std::vector<double>& metrics_registry::duration_buckets()
+{
+   static const std::vector<double> buckets = { 0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+                                                0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10 };
+   return buckets;
+}
+
+} } // graphene::app
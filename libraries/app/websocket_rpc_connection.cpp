@@ -0,0 +1,428 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/app/websocket_rpc_connection.hpp>
+
+#include <fc/io/json.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <algorithm>
+#include <string>
+
+namespace graphene { namespace app {
+
+namespace {
+   // JSON-RPC 2.0 error codes
+   const int64_t parse_error_code     = -32700;
+   const int64_t invalid_request_code = -32600;
+   const int64_t internal_error_code  = -32603;
+   // implementation defined server error: the API budget ran out
+   const int64_t budget_exceeded_code = -32005;
+
+   std::string error_reply( const fc::variant& id, int64_t code, const std::string& message )
+   {
+      return fc::json::to_string( fc::mutable_variant_object()
+                                     ( "id", id )
+                                     ( "jsonrpc", "2.0" )
+                                     ( "error", fc::mutable_variant_object()( "code", code )( "message", message ) ) );
+   }
+
+   /// the reply fc sends when the called method throws @p e
+   std::string exception_reply( const fc::variant& id, const fc::exception& e, uint32_t max_depth )
+   {
+      return fc::json::to_string( fc::mutable_variant_object()
+                                     ( "id", id )
+                                     ( "jsonrpc", "2.0" )
+                                     ( "error", fc::mutable_variant_object()
+                                                   ( "code", 1 )
+                                                   ( "message", e.to_string() )
+                                                   ( "data", fc::variant( e, max_depth ) ) ),
+                                  fc::json::stringify_large_ints_and_doubles, max_depth );
+   }
+
+   bool is_id( const fc::variant& id )
+   {
+      return id.is_string() || id.is_int64() || id.is_uint64() || id.is_double();
+   }
+
+   /// @return why @p request is not a valid JSON-RPC request object, or an empty string if it is one
+   std::string find_request_error( const fc::variant& request )
+   {
+      if( !request.is_object() )
+         return "Batch element is not a request object";
+      const fc::variant_object& call = request.get_object();
+      auto method_itr = call.find( "method" );
+      if( method_itr == call.end() || !method_itr->value().is_string() )
+         return "Request has no method name";
+      auto params_itr = call.find( "params" );
+      if( params_itr != call.end() && !params_itr->value().is_array() )
+         return "Request params must be an array";
+      auto id_itr = call.find( "id" );
+      if( id_itr != call.end() && !id_itr->value().is_null() && !is_id( id_itr->value() ) )
+         return "Request id must be a string, a number or null";
+      return std::string();
+   }
+}
+
+websocket_rpc_connection::websocket_rpc_connection( fc::http::websocket_connection& c, uint32_t max_conversion_depth,
+                                                    uint32_t max_batch_size,
+                                                    std::shared_ptr<api_cost_limiter> cost_limiter )
+   : fc::rpc::websocket_api_connection( c, max_conversion_depth ),
+     _max_request_depth( max_conversion_depth ),
+     _max_batch_size( max_batch_size ),
+     _cost_limiter( cost_limiter )
+{
+   if( _cost_limiter )
+      _connection_budget = _cost_limiter->make_connection_bucket();
+   // replace the handlers installed by websocket_api_connection so batches are recognized
+   _connection.on_message_handler( [this]( const std::string& msg ){ handle_message( msg, true ); } );
+   _connection.on_http_handler( [this]( const std::string& msg ){ return handle_message( msg, false ); } );
+}
+
+std::string websocket_rpc_connection::handle_message( const std::string& message, bool send_reply )
+{
+   // all calls of one message share the wait for budget.  HTTP requests don't wait at all: the
+   // websocket server holds its network thread until their reply is ready
+   fc::time_point budget_deadline = fc::time_point::now();
+   if( _cost_limiter && send_reply )
+      budget_deadline += fc::milliseconds( _cost_limiter->get_options().max_wait_ms );
+
+   auto first = message.find_first_not_of( " \t\r\n" );
+   if( first == std::string::npos || message[first] != '[' )
+      return handle_single( message, send_reply, budget_deadline );
+
+   std::string reply = handle_batch( message, budget_deadline );
+   if( send_reply && !reply.empty() )
+      _connection.send_message( reply );
+   return reply;
+}
+
+std::string websocket_rpc_connection::handle_batch( const std::string& message, const fc::time_point& budget_deadline )
+{
+   fc::variant batch;
+   try
+   {
+      batch = fc::json::from_string( message, fc::json::legacy_parser, _max_request_depth );
+   }
+   catch( const fc::exception& e )
+   {
+      return error_reply( fc::variant(), parse_error_code, e.to_string() );
+   }
+
+   const fc::variants& requests = batch.get_array();
+   if( requests.empty() )
+      return error_reply( fc::variant(), invalid_request_code, "Empty batch" );
+   if( requests.size() > _max_batch_size )
+      return error_reply( fc::variant(), invalid_request_code,
+                          "Batch of " + std::to_string( requests.size() ) + " requests exceeds the limit of "
+                          + std::to_string( _max_batch_size ) );
+
+   // each request goes through the same path as a request in a message of its own, so it is
+   // dispatched and reported the same way.  Malformed elements are answered with invalid
+   // request, failures of the server itself with internal error
+   std::string reply;
+   for( const fc::variant& request : requests )
+   {
+      std::string response;
+      const std::string request_error = find_request_error( request );
+      if( !request_error.empty() )
+      {
+         fc::variant id;
+         if( request.is_object() && request.get_object().contains( "id" ) )
+         {
+            const fc::variant& request_id = request.get_object()["id"];
+            if( is_id( request_id ) )
+               id = request_id;
+         }
+         response = error_reply( id, invalid_request_code, request_error );
+      }
+      else
+      {
+         const fc::variant_object& request_object = request.get_object();
+         const fc::variant id = request_object.contains( "id" ) ? request_object["id"] : fc::variant();
+         try
+         {
+            // requests without an id are notifications and get no response
+            response = handle_call( request_object, false, budget_deadline );
+         }
+         catch( const fc::exception& e )
+         {
+            response = error_reply( id, internal_error_code, e.to_string() );
+         }
+         catch( const std::exception& e )
+         {
+            response = error_reply( id, internal_error_code, e.what() );
+         }
+         catch( ... )
+         {
+            response = error_reply( id, internal_error_code, "Unknown error" );
+         }
+         if( !request_object.contains( "id" ) )
+            response.clear();
+      }
+      if( response.empty() )
+         continue;
+      reply += reply.empty() ? "[" : ",";
+      reply += response;
+   }
+   if( !reply.empty() )
+      reply += "]";
+   return reply;
+}
+
+void websocket_rpc_connection::register_streamed_method( fc::api_id_type api_id, const std::string& method,
+                                                         streamed_method handler )
+{
+   _streamed_methods[ std::make_pair( api_id, method ) ] = std::move( handler );
+}
+
+std::string websocket_rpc_connection::handle_single( const std::string& message, bool send_reply,
+                                                     const fc::time_point& budget_deadline )
+{
+   fc::variant request;
+   try
+   {
+      request = fc::json::from_string( message, fc::json::legacy_parser, _max_request_depth );
+   }
+   catch( const fc::exception& )
+   {
+      // fc reports the parse error
+      return on_message( message, send_reply );
+   }
+   // replies to calls the server made, and malformed requests, are left to fc
+   if( !find_request_error( request ).empty() )
+      return on_message( message, send_reply );
+   return handle_call( request.get_object(), send_reply, budget_deadline );
+}
+
+std::string websocket_rpc_connection::handle_call( const fc::variant_object& call, bool send_reply,
+                                                   const fc::time_point& budget_deadline )
+{
+   const bool limited = _cost_limiter && ( _connection_budget || _user_budget );
+   const bool measured = _metrics != nullptr;
+
+   std::string method;
+   size_t items = 0;
+   // the method is needed to spot a login even while no budget applies to this connection
+   if( _cost_limiter || measured )
+      describe_call( call, method, items );
+   const std::string method_label = measured ? metrics_registry::label( "method", method ) : std::string();
+
+   std::string reply;
+   double cost = 0;
+   if( limited )
+   {
+      cost = _cost_limiter->estimate( method, items );
+      if( !wait_for_budget( cost, budget_deadline ) )
+      {
+         _cost_limiter->record_rejection( method );
+         if( measured )
+            _metrics->increment( "yoyow_api_rejected_calls_total", 1, method_label );
+         auto id_itr = call.find( "id" );
+         if( id_itr == call.end() )
+            return reply;
+         reply = error_reply( id_itr->value(), budget_exceeded_code,
+                              "API budget of this connection exhausted, retry later" );
+         if( send_reply )
+            _connection.send_message( reply );
+         return reply;
+      }
+      charge( cost );
+   }
+
+   const fc::time_point start = fc::time_point::now();
+   if( !try_streamed_call( call, reply ) )
+      reply = dispatch( call );
+   if( send_reply && !reply.empty() )
+      _connection.send_message( reply );
+
+   const fc::microseconds elapsed = fc::time_point::now() - start;
+   if( measured )
+   {
+      _metrics->increment( "yoyow_api_calls_total", 1, method_label );
+      _metrics->observe( "yoyow_api_call_duration_seconds", elapsed, method_label );
+   }
+   if( limited )
+   {
+      const double time_cost = api_cost_limiter::time_cost( elapsed );
+      charge( time_cost );
+      _cost_limiter->record_call( method, cost + time_cost, elapsed );
+   }
+   if( _cost_limiter && method == "login" )
+      on_login_reply( call, reply );
+   return reply;
+}
+
+std::string websocket_rpc_connection::dispatch( const fc::variant_object& call )
+{
+   // what websocket_api_connection::on_message() does with a request, without parsing it again
+   auto id_itr = call.find( "id" );
+   auto params_itr = call.find( "params" );
+   const std::string& method = call["method"].get_string();
+   try
+   {
+      const fc::variant result = _rpc_state.local_call( method, params_itr != call.end() ? params_itr->value().get_array()
+                                                                                        : fc::variants() );
+      if( id_itr == call.end() )
+         return std::string();
+      return fc::json::to_string( fc::mutable_variant_object()
+                                     ( "id", id_itr->value() )
+                                     ( "jsonrpc", "2.0" )
+                                     ( "result", result ),
+                                  fc::json::stringify_large_ints_and_doubles, _max_request_depth );
+   }
+   catch( const fc::exception& e )
+   {
+      if( id_itr == call.end() )
+         return std::string();
+      return exception_reply( id_itr->value(), e, _max_request_depth );
+   }
+}
+
+bool websocket_rpc_connection::try_streamed_call( const fc::variant_object& call, std::string& reply )
+{
+   if( _streamed_methods.empty() )
+      return false;
+
+   // only plain JSON-RPC 2.0 "call" requests with a non-negative integer id are taken, the
+   // reply envelope of those is the same whichever way fc would write it
+   auto id_itr = call.find( "id" );
+   auto version_itr = call.find( "jsonrpc" );
+   auto method_itr = call.find( "method" );
+   auto params_itr = call.find( "params" );
+   if( id_itr == call.end() || version_itr == call.end() || method_itr == call.end() || params_itr == call.end() )
+      return false;
+   const fc::variant& id = id_itr->value();
+   if( !id.is_uint64() && !( id.is_int64() && id.as_int64() >= 0 ) )
+      return false;
+   if( !version_itr->value().is_string() || version_itr->value().get_string() != "2.0" )
+      return false;
+   if( !method_itr->value().is_string() || method_itr->value().get_string() != "call" )
+      return false;
+   if( !params_itr->value().is_array() )
+      return false;
+   const fc::variants& params = params_itr->value().get_array();
+   if( params.size() != 3 || !( params[0].is_uint64() || params[0].is_int64() ) || !params[1].is_string()
+         || !params[2].is_array() )
+      return false;
+
+   auto handler_itr = _streamed_methods.find( std::make_pair( params[0].as<fc::api_id_type>( 1 ),
+                                                              params[1].get_string() ) );
+   if( handler_itr == _streamed_methods.end() )
+      return false;
+
+   // once the handler has run, the call is answered here, also when it failed: the call
+   // must not run a second time on the regular path
+   try
+   {
+      const std::string result = handler_itr->second( params[2].get_array() );
+      reply = "{\"id\":" + fc::json::to_string( id ) + ",\"jsonrpc\":\"2.0\",\"result\":" + result + "}";
+   }
+   catch( const fc::exception& e )
+   {
+      reply = exception_reply( id, e, _max_request_depth );
+   }
+   catch( const std::exception& e )
+   {
+      reply = exception_reply( id, fc::std_exception_wrapper::from_current_exception( e ), _max_request_depth );
+   }
+   return true;
+}
+
+void websocket_rpc_connection::set_user( const std::string& user )
+{
+   if( _cost_limiter )
+      _user_budget = _cost_limiter->get_user_bucket( user );
+}
+
+void websocket_rpc_connection::describe_call( const fc::variant_object& call, std::string& method, size_t& items )const
+{
+   auto method_itr = call.find( "method" );
+   auto params_itr = call.find( "params" );
+   if( method_itr == call.end() || !method_itr->value().is_string() )
+      return;
+   method = method_itr->value().get_string();
+   if( params_itr == call.end() || !params_itr->value().is_array() )
+      return;
+   const fc::variants* args = &params_itr->value().get_array();
+   // [api, method, [args...]]
+   if( method == "call" && args->size() == 3 && ( *args )[1].is_string() && ( *args )[2].is_array() )
+   {
+      method = ( *args )[1].get_string();
+      args = &( *args )[2].get_array();
+   }
+   for( const fc::variant& arg : *args )
+   {
+      if( arg.is_array() )
+         items = std::max( items, arg.get_array().size() );
+   }
+}
+
+bool websocket_rpc_connection::wait_for_budget( double cost, const fc::time_point& deadline )
+{
+   for( ;; )
+   {
+      fc::microseconds wait;
+      if( _connection_budget )
+         wait = std::max( wait, _connection_budget->time_until( cost ) );
+      if( _user_budget )
+         wait = std::max( wait, _user_budget->time_until( cost ) );
+      if( wait.count() == 0 )
+         return true;
+      const fc::time_point now = fc::time_point::now();
+      if( wait == fc::microseconds::maximum() || now + wait > deadline )
+         return false;
+      // the websocket server runs each message in a fiber of its own, so this only holds up the
+      // calls of this message, not other messages and connections
+      fc::usleep( wait );
+   }
+}
+
+void websocket_rpc_connection::charge( double cost )
+{
+   if( _connection_budget )
+      _connection_budget->take( cost );
+   if( _user_budget )
+      _user_budget->take( cost );
+}
+
+void websocket_rpc_connection::on_login_reply( const fc::variant_object& call, const std::string& reply )
+{
+   // a successful login switches the connection to the budget of the new user
+   try
+   {
+      const fc::variant response = fc::json::from_string( reply, fc::json::legacy_parser, _max_request_depth );
+      if( !response.is_object() || !response.get_object().contains( "result" )
+            || !response.get_object()["result"].is_bool() || !response.get_object()["result"].as_bool() )
+         return;
+      const fc::variants& params = call["params"].get_array();
+      const fc::variants& args = params.size() == 3 && params[2].is_array() ? params[2].get_array() : params;
+      if( !args.empty() && args[0].is_string() )
+         set_user( args[0].get_string() );
+   }
+   catch( const fc::exception& )
+   {
+   }
+}
+
+} } // graphene::app
@@ -275,4 +275,48 @@ void account_referrer_index::object_modified( const object& after  )
 {
 }
 
+void asset_holder_count_index::object_inserted( const object& obj )
+{
+   const account_balance_object& b = static_cast<const account_balance_object&>(obj);
+   adjust_holder_count( b.asset_type, b.balance != 0, false );
+}
+
+void asset_holder_count_index::object_removed( const object& obj )
+{
+   const account_balance_object& b = static_cast<const account_balance_object&>(obj);
+   adjust_holder_count( b.asset_type, false, b.balance != 0 );
+}
+
+void asset_holder_count_index::about_to_modify( const object& before )
+{
+   before_held = static_cast<const account_balance_object&>(before).balance != 0;
+}
+
+void asset_holder_count_index::object_modified( const object& after )
+{
+   const account_balance_object& b = static_cast<const account_balance_object&>(after);
+   adjust_holder_count( b.asset_type, b.balance != 0, before_held );
+}
+
+void asset_holder_count_index::adjust_holder_count( asset_aid_type asset, bool held, bool was_held )
+{
+   if( held == was_held )
+      return;
+   auto& count = holder_counts[asset];
+   if( held )
+      ++count;
+   else
+   {
+      assert( count > 0 );
+      if( --count == 0 )
+         holder_counts.erase( asset );
+   }
+}
+
+uint64_t asset_holder_count_index::get_holder_count( asset_aid_type asset )const
+{
+   auto itr = holder_counts.find( asset );
+   return itr == holder_counts.end() ? 0 : itr->second;
+}
+
 } } // graphene::chain
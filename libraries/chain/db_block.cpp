@@ -137,6 +137,8 @@ bool database::push_block(const signed_block& new_block, uint32_t skip)
 
 bool database::_push_block(const signed_block& new_block)
 { try {
+   // it was built on the head block, which is about to change
+   _prepared_block.reset();
    uint32_t skip = get_node_properties().skip_flags;
    if( !(skip&skip_fork_db) )
    {
@@ -250,6 +252,7 @@ processed_transaction database::_push_transaction( const signed_transaction& trx
    auto temp_session = _undo_db.start_undo_session();
    auto processed_trx = _apply_transaction( trx );
    _pending_tx.push_back(processed_trx);
+   ++_pending_tx_version;
 
    // notify_changed_objects();
    // The transaction applied successfully. Merge its changes into the pending block session.
@@ -325,11 +328,32 @@ signed_block database::_generate_block(
    if( !(skip & skip_witness_signature) )
       FC_ASSERT( witness_obj.signing_key == block_signing_private_key.get_public_key() );
 
-   static const size_t max_block_header_size = fc::raw::pack_size( signed_block_header() ) + 4;
-   auto maximum_block_size = get_global_properties().parameters.maximum_block_size;
-   size_t total_block_size = max_block_header_size;
-
    signed_block pending_block;
+   block_generation_stats stats;
+
+   if( has_prepared_block( when, witness_uid, skip ) )
+   {
+      // prepare_block() already applied the same pending transactions at the same time on top of the same head block
+      pending_block = std::move( _prepared_block->block );
+      stats.prepared = true;
+      stats.transactions = _prepared_block->stats.transactions;
+      stats.postponed_transactions = _prepared_block->stats.postponed_transactions;
+      stats.prepared_apply_pending_time = _prepared_block->stats.apply_pending_time;
+      stats.prepared_merkle_time = _prepared_block->stats.merkle_time;
+      _prepared_block.reset();
+      try
+      {
+         _sign_and_push_block( pending_block, block_signing_private_key, stats );
+         _last_block_generation_stats = stats;
+         return pending_block;
+      }
+      catch( const fc::exception& e )
+      {
+         // push_block() restored the pending transactions, the block is assembled from them as if nothing was prepared
+         wlog( "Prepared block could not be pushed, assembling it again: ${e}", ("e", e.to_detail_string()) );
+         stats = block_generation_stats();
+      }
+   }
 
    //
    // The following code throws away existing pending_tx_session and
@@ -345,6 +369,61 @@ signed_block database::_generate_block(
    _pending_tx_session.reset();
    _pending_tx_session = _undo_db.start_undo_session();
 
+   pending_block = _assemble_block( when, witness_uid, _pending_tx, stats );
+   _prepared_block.reset();
+
+   _sign_and_push_block( pending_block, block_signing_private_key, stats );
+
+   _last_block_generation_stats = stats;
+   return pending_block;
+} FC_CAPTURE_AND_RETHROW( (witness_uid) ) }
+
+void database::_sign_and_push_block(
+   signed_block& pending_block,
+   const fc::ecc::private_key& block_signing_private_key,
+   block_generation_stats& stats
+   )
+{
+   uint32_t skip = get_node_properties().skip_flags;
+   _pending_tx_session.reset();
+
+   // We have temporarily broken the invariant that
+   // _pending_tx_session is the result of applying _pending_tx, as
+   // _pending_tx now consists of the set of postponed transactions.
+   // However, the push_block() call below will re-create the
+   // _pending_tx_session.
+
+   fc::time_point start = fc::time_point::now();
+   if( !(skip & skip_witness_signature) )
+      pending_block.sign( block_signing_private_key );
+   stats.sign_time = fc::time_point::now() - start;
+
+   stats.block_size = fc::raw::pack_size( pending_block );
+   // TODO:  Move this to _push_block() so session is restored.
+   if( !(skip & skip_block_size_check) )
+   {
+      FC_ASSERT( stats.block_size <= get_global_properties().parameters.maximum_block_size );
+   }
+
+   start = fc::time_point::now();
+   push_block( pending_block, skip );
+   stats.push_block_time = fc::time_point::now() - start;
+}
+
+signed_block database::_assemble_block(
+   fc::time_point_sec when,
+   account_uid_type witness_uid,
+   const vector<processed_transaction>& transactions,
+   block_generation_stats& stats
+   )
+{
+   fc::time_point start = fc::time_point::now();
+   static const size_t max_block_header_size = fc::raw::pack_size( signed_block_header() ) + 4;
+   auto maximum_block_size = get_global_properties().parameters.maximum_block_size;
+   size_t total_block_size = max_block_header_size;
+
+   signed_block pending_block;
+
    pending_block.previous = head_block_id();
    pending_block.timestamp = when;
    pending_block.witness = witness_uid;
@@ -353,7 +432,7 @@ signed_block database::_generate_block(
 
    uint64_t postponed_tx_count = 0;
    // pop pending state (reset to head block state)
-   for( const processed_transaction& tx : _pending_tx )
+   for( const processed_transaction& tx : transactions )
    {
       size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
 
@@ -387,30 +466,87 @@ signed_block database::_generate_block(
    {
       wlog( "Postponed ${n} transactions due to block size limit", ("n", postponed_tx_count) );
    }
+   stats.transactions = pending_block.transactions.size();
+   stats.postponed_transactions = postponed_tx_count;
+   stats.apply_pending_time = fc::time_point::now() - start;
 
-   _pending_tx_session.reset();
-
-   // We have temporarily broken the invariant that
-   // _pending_tx_session is the result of applying _pending_tx, as
-   // _pending_tx now consists of the set of postponed transactions.
-   // However, the push_block() call below will re-create the
-   // _pending_tx_session.
-
+   start = fc::time_point::now();
    pending_block.transaction_merkle_root = pending_block.calculate_merkle_root();
+   stats.merkle_time = fc::time_point::now() - start;
+   return pending_block;
+}
 
-   if( !(skip & skip_witness_signature) )
-      pending_block.sign( block_signing_private_key );
+void database::prepare_block(
+   fc::time_point_sec when,
+   account_uid_type witness_uid,
+   uint32_t skip
+   )
+{ try {
+   _prepared_block.reset();
+   FC_ASSERT( get_slot_at_time( when ) > 0 );
+   FC_ASSERT( get_scheduled_witness( get_slot_at_time( when ) ) == witness_uid );
+
+   // The pending transactions were applied at the head block time, they are applied again at the
+   // block time on top of the head block so the block holds the results the other nodes compute.
+   prepared_block_info prepared;
+   prepared.skip = skip;
+   vector<processed_transaction> pending = std::move( _pending_tx );
+   _pending_tx.clear();
+   _pending_tx_session.reset();
+   detail::with_skip_flags( *this, skip, [&]()
+   {
+      optional<fc::exception> failure;
+      try
+      {
+         auto session = _undo_db.start_undo_session();
+         prepared.block = _assemble_block( when, witness_uid, pending, prepared.stats );
+      }
+      catch( const fc::exception& e )
+      {
+         failure = e;
+      }
 
-   // TODO:  Move this to _push_block() so session is restored.
-   if( !(skip & skip_block_size_check) )
+      // The pending state is rebuilt quietly, with the same flags push_block() restores it with:
+      // the transactions are not new, so nobody is notified again, and the transactions popped
+      // with a block wait for the next block as before.
+      _pending_tx_session = _undo_db.start_undo_session();
+      _pending_tx.reserve( pending.size() );
+      for( const processed_transaction& tx : pending )
+      {
+         try
+         {
+            auto temp_session = _undo_db.start_undo_session();
+            _pending_tx.push_back( _apply_transaction( tx ) );
+            temp_session.merge();
+         }
+         catch( const fc::exception& e )
+         {
+            wlog( "Pending transaction was dropped while preparing a block due to ${e}", ("e", e) );
+         }
+      }
+      if( failure )
+         failure->dynamic_rethrow_exception();
+   } );
+
+   // a pending transaction that did not make it back is not pending any more
+   if( _pending_tx.size() != pending.size() )
    {
-      FC_ASSERT( fc::raw::pack_size(pending_block) <= get_global_properties().parameters.maximum_block_size );
+      ++_pending_tx_version;
+      return;
    }
+   prepared.pending_tx_version = _pending_tx_version;
+   _prepared_block = std::move( prepared );
+} FC_CAPTURE_AND_RETHROW( (when)(witness_uid) ) }
 
-   push_block( pending_block, skip );
-
-   return pending_block;
-} FC_CAPTURE_AND_RETHROW( (witness_uid) ) }
+bool database::has_prepared_block( fc::time_point_sec when, account_uid_type witness_uid, uint32_t skip )const
+{
+   return _prepared_block.valid()
+       && _prepared_block->block.previous == head_block_id()
+       && _prepared_block->block.timestamp == when
+       && _prepared_block->block.witness == witness_uid
+       && _prepared_block->skip == skip
+       && _prepared_block->pending_tx_version == _pending_tx_version;
+}
 
 /**
  * Removes the most recent block from the database and
@@ -418,6 +554,7 @@ signed_block database::_generate_block(
  */
 void database::pop_block()
 { try {
+   _prepared_block.reset();
    _pending_tx_session.reset();
    auto head_id = head_block_id();
    optional<signed_block> head_block = fetch_block_by_id( head_id );
@@ -434,6 +571,7 @@ void database::clear_pending()
 { try {
    assert( (_pending_tx.size() == 0) || _pending_tx_session.valid() );
    _pending_tx.clear();
+   ++_pending_tx_version;
    _pending_tx_session.reset();
 } FC_CAPTURE_AND_RETHROW() }
 
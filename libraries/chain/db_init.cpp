@@ -160,6 +160,9 @@ const uint8_t custom_vote_object::type_id;
 const uint8_t cast_custom_vote_object::space_id;
 const uint8_t cast_custom_vote_object::type_id;
 
+const uint8_t custom_vote_pending_object::space_id;
+const uint8_t custom_vote_pending_object::type_id;
+
 const uint8_t pledge_mining_object::space_id;
 const uint8_t pledge_mining_object::type_id;
 
@@ -256,7 +259,8 @@ void database::initialize_indexes()
 
    //Implementation object indexes
    add_index< primary_index<transaction_index                             > >();
-   add_index< primary_index<account_balance_index                         > >();
+   auto bal_index = add_index< primary_index<account_balance_index        > >();
+   bal_index->add_secondary_index<asset_holder_count_index>();
    add_index< primary_index<simple_index<global_property_object          >> >();
    add_index< primary_index<simple_index<dynamic_global_property_object  >> >();
    add_index< primary_index<account_statistics_index                      > >();
@@ -270,6 +274,7 @@ void database::initialize_indexes()
    add_index< primary_index<advertising_order_index                       > >();
    add_index< primary_index<custom_vote_index                             > >();
    add_index< primary_index<cast_custom_vote_index                        > >();
+   add_index< primary_index<custom_vote_pending_index                     > >();
    add_index< primary_index<account_auth_platform_index                   > >();
    add_index< primary_index<pledge_mining_index                           > >();
    add_index< primary_index<committee_member_vote_index                   > >();
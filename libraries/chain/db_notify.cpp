@@ -543,6 +543,9 @@ void get_relevant_accounts( const object* obj, flat_set<account_uid_type>& accou
             } case impl_cast_custom_vote_object_type:{
                 // TODO review
                 break;
+            } case impl_custom_vote_pending_object_type:{
+                // TODO review
+                break;
             } case impl_committee_member_vote_object_type:{
                // TODO review
               break;
@@ -581,6 +584,7 @@ void database::notify_changed_objects()
    if( _undo_db.enabled() )
    {
       const auto& head_undo = _undo_db.head();
+      const bool compute_impacted_accounts = impacted_account_listeners > 0;
 
       // New
       if( !new_objects.empty() )
@@ -590,9 +594,12 @@ void database::notify_changed_objects()
         for( const auto& item : head_undo.new_ids )
         {
           new_ids.push_back(item);
-          auto obj = find_object(item);
-          if(obj != nullptr)
-            get_relevant_accounts(obj, new_accounts_impacted);
+          if( compute_impacted_accounts )
+          {
+            auto obj = find_object(item);
+            if(obj != nullptr)
+              get_relevant_accounts(obj, new_accounts_impacted);
+          }
         }
 
         new_objects(new_ids, new_accounts_impacted);
@@ -606,7 +613,8 @@ void database::notify_changed_objects()
         for( const auto& item : head_undo.old_values )
         {
           changed_ids.push_back(item.first);
-          get_relevant_accounts(item.second.get(), changed_accounts_impacted);
+          if( compute_impacted_accounts )
+            get_relevant_accounts(item.second.get(), changed_accounts_impacted);
         }
 
         changed_objects(changed_ids, changed_accounts_impacted);
@@ -623,7 +631,8 @@ void database::notify_changed_objects()
           removed_ids.emplace_back( item.first );
           auto obj = item.second.get();
           removed.emplace_back( obj );
-          get_relevant_accounts(obj, removed_accounts_impacted);
+          if( compute_impacted_accounts )
+            get_relevant_accounts(obj, removed_accounts_impacted);
         }
 
         removed_objects(removed_ids, removed, removed_accounts_impacted);
@@ -880,6 +880,28 @@ class pledge_balance_object:public graphene::db::abstract_object<pledge_balance_
          /** maps the referrer to the set of accounts that they have referred */
          map< account_uid_type, set<account_uid_type> > referred_by;
    };
+
+   /**
+    *  @brief This secondary index of account balances counts the accounts that hold a non-zero balance of
+    *  each asset, so the count does not need a walk over all balances of the asset.
+    */
+   class asset_holder_count_index : public secondary_index
+   {
+      public:
+         virtual void object_inserted( const object& obj ) override;
+         virtual void object_removed( const object& obj ) override;
+         virtual void about_to_modify( const object& before ) override;
+         virtual void object_modified( const object& after  ) override;
+
+         /** @return the number of accounts with a non-zero balance of asset */
+         uint64_t get_holder_count( asset_aid_type asset )const;
+
+      protected:
+         void adjust_holder_count( asset_aid_type asset, bool held, bool was_held );
+
+         map< asset_aid_type, uint64_t > holder_counts;
+         bool                            before_held = false;
+   };
    
    /**
     * @ingroup object_index
@@ -77,6 +77,57 @@ namespace graphene { namespace chain {
    typedef generic_index<cast_custom_vote_object, cast_custom_vote_multi_index_type> cast_custom_vote_index;
 
 
+   /**
+   * @brief Balance changes of a voter that are not in the tallies of its custom votes yet
+   * @ingroup object
+   *
+   * Maintained by the non_consensus plugin.  pending_amount is owed to every chosen option of every
+   * custom vote of vote_asset_id the voter cast that expires at or after since, and is added to those
+   * tallies when the voter casts a vote or one of those votes expires, which is no later than
+   * next_expired_time.  Queries of custom votes add it to the tallies they return.
+   */
+   class custom_vote_pending_object : public graphene::db::abstract_object<custom_vote_pending_object>
+   {
+   public:
+      static const uint8_t space_id = implementation_ids;
+      static const uint8_t type_id = impl_custom_vote_pending_object_type;
+
+      account_uid_type           voter;
+      asset_aid_type             vote_asset_id;
+      share_type                 pending_amount;
+      time_point_sec             since;
+      time_point_sec             next_expired_time;
+   };
+
+   struct by_voter_asset{};
+   struct by_next_expired_time{};
+
+   /**
+   * @ingroup object_index
+   */
+   typedef multi_index_container<
+      custom_vote_pending_object,
+      indexed_by<
+      ordered_unique< tag<by_id>, member< object, object_id_type, &object::id > >,
+      ordered_unique< tag<by_voter_asset>,
+         composite_key<
+            custom_vote_pending_object,
+            member< custom_vote_pending_object, account_uid_type, &custom_vote_pending_object::voter>,
+            member< custom_vote_pending_object, asset_aid_type,   &custom_vote_pending_object::vote_asset_id> > >,
+      ordered_unique< tag<by_next_expired_time>,
+         composite_key<
+            custom_vote_pending_object,
+            member< custom_vote_pending_object, time_point_sec, &custom_vote_pending_object::next_expired_time>,
+            member< object, object_id_type, &object::id > > >
+      >
+   > custom_vote_pending_multi_index_type;
+
+   /**
+   * @ingroup object_index
+   */
+   typedef generic_index<custom_vote_pending_object, custom_vote_pending_multi_index_type> custom_vote_pending_index;
+
+
    /**
    * @brief This class custom vote
    * @ingroup object
@@ -139,4 +190,8 @@ FC_REFLECT_DERIVED( graphene::chain::custom_vote_object,
 
 FC_REFLECT_DERIVED( graphene::chain::cast_custom_vote_object,
                    (graphene::db::object),
-                   (voter)(custom_vote_creator)(custom_vote_vid)(vote_asset_id)(vote_result)(vote_expired_time))
\ No newline at end of file
+                   (voter)(custom_vote_creator)(custom_vote_vid)(vote_asset_id)(vote_result)(vote_expired_time))
+
+FC_REFLECT_DERIVED( graphene::chain::custom_vote_pending_object,
+                   (graphene::db::object),
+                   (voter)(vote_asset_id)(pending_amount)(since)(next_expired_time))
@@ -54,6 +54,26 @@ namespace graphene { namespace chain {
 
    struct budget_record;
 
+   /**
+    *  Where the time of database::generate_block() went.  When the block was prepared in advance
+    *  by database::prepare_block(), the pending transactions were applied and the merkle root
+    *  computed before the slot, off the critical path: apply_pending_time and merkle_time are then
+    *  zero, and the time of those steps is in the prepared_ fields.
+    */
+   struct block_generation_stats
+   {
+      bool              prepared = false;
+      fc::microseconds  apply_pending_time;
+      fc::microseconds  merkle_time;
+      fc::microseconds  prepared_apply_pending_time;
+      fc::microseconds  prepared_merkle_time;
+      fc::microseconds  sign_time;
+      fc::microseconds  push_block_time;
+      uint32_t          transactions = 0;
+      uint32_t          postponed_transactions = 0;
+      uint64_t          block_size = 0;
+   };
+
    /**
     *   @class database
     *   @brief tracks the blockchain state in an extensible manner
@@ -134,6 +154,13 @@ namespace graphene { namespace chain {
          const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
+         /// @return the number of transactions waiting for the next block
+         size_t                     pending_transaction_count()const { return _pending_tx.size(); }
+         /// @return the number of blocks held by the fork database, linked and unlinked
+         size_t                     fork_db_size()const { return _fork_db.size(); }
+         /// @return the number of undo sessions that can still be rolled back
+         size_t                     undo_stack_depth()const { return _undo_db.size(); }
+
          /**
           *  Calculate the percent of block production slots that were missed in the
           *  past 128 blocks, not including the current block.
@@ -164,6 +191,23 @@ namespace graphene { namespace chain {
             const fc::ecc::private_key& block_signing_private_key
             );
 
+         /**
+          *  Assembles the block @p witness_uid would produce at @p when out of the pending transactions
+          *  and keeps it, so generate_block() only has to sign it as long as neither the head block nor
+          *  the pending transactions change in the meantime.  The pending transactions are applied at
+          *  @p when on top of the head block, as generate_block() would, then the pending state is
+          *  rebuilt without notifying on_pending_transaction again or touching the popped transactions.
+          */
+         void prepare_block(
+            const fc::time_point_sec when,
+            account_uid_type witness_uid,
+            uint32_t skip
+            );
+         /// @return true if generate_block() with these arguments would use the block kept by prepare_block()
+         bool has_prepared_block( const fc::time_point_sec when, account_uid_type witness_uid, uint32_t skip )const;
+         /// @return where the time of the last successful generate_block() call went
+         const block_generation_stats& get_last_block_generation_stats()const { return _last_block_generation_stats; }
+
          void pop_block();
          void clear_pending();
 
@@ -212,9 +256,17 @@ namespace graphene { namespace chain {
          fc::signal<void(const vector<object_id_type>&, const flat_set<account_uid_type>&)> changed_objects;
 
          /** this signal is emitted any time an object is removed and contains a
-          * pointer to the last value of every object that was removed.
+          * pointer to the last value of every object that was removed, in the same
+          * order as the ids.
           */
          fc::signal<void(const vector<object_id_type>&, const vector<const object*>&, const flat_set<account_uid_type>&)>  removed_objects;
+
+         /**
+          *  The impacted account sets passed to new_objects, changed_objects and removed_objects
+          *  are only computed while this is nonzero; otherwise they are empty.  Listeners that
+          *  use them increment it for as long as they need them.
+          */
+         uint32_t impacted_account_listeners = 0;
       
          /** this signal is emitted any time account balance adjust for update vote
           */
@@ -594,6 +646,26 @@ namespace graphene { namespace chain {
       private:
 
          vector< processed_transaction >        _pending_tx;
+         /// changes whenever _pending_tx does, so a prepared block can tell whether it is still current
+         uint64_t                               _pending_tx_version = 0;
+
+         struct prepared_block_info
+         {
+            signed_block            block;
+            block_generation_stats  stats;
+            uint32_t                skip = 0;
+            uint64_t                pending_tx_version = 0;
+         };
+         optional< prepared_block_info >        _prepared_block;
+         block_generation_stats                 _last_block_generation_stats;
+
+         /// Signs @p pending_block and pushes it, adding the time of both steps to @p stats
+         void _sign_and_push_block( signed_block& pending_block, const fc::ecc::private_key& block_signing_private_key,
+                                    block_generation_stats& stats );
+         /// Applies @p transactions on top of the head block as the next block at @p when, in an undo session the caller holds
+         signed_block _assemble_block( const fc::time_point_sec when, account_uid_type witness_uid,
+                                       const vector< processed_transaction >& transactions,
+                                       block_generation_stats& stats );
          fork_database                          _fork_db;
 
          /**
@@ -648,3 +720,8 @@ namespace graphene { namespace chain {
    }
 
 } }
+
+FC_REFLECT( graphene::chain::block_generation_stats,
+            (prepared)(apply_pending_time)(merkle_time)(prepared_apply_pending_time)(prepared_merkle_time)
+            (sign_time)(push_block_time)
+            (transactions)(postponed_transactions)(block_size) )
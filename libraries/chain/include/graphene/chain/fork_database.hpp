@@ -109,6 +109,7 @@ namespace graphene { namespace chain {
          > fork_multi_index_type;
 
          void set_max_size( uint32_t s );
+         size_t size()const { return _index.size() + _unlinked_index.size(); }
 
       private:
          /** @return a pointer to the newly pushed item */
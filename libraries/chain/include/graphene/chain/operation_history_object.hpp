@@ -96,6 +96,7 @@ namespace graphene { namespace chain {
          operation_history_id_type            operation_id;
          uint16_t                             operation_type;
          uint32_t                             sequence = 0; /// the operation position within the given account
+         uint32_t                             block_num = 0; /// the block that caused the operation
          // TODO change type? or just remove it?
          account_transaction_history_id_type  next;
 
@@ -118,6 +119,8 @@ struct by_seq;
 struct by_type_seq;
 struct by_op;
 struct by_opid;
+struct by_account_block;
+struct by_type_block;
 
 typedef multi_index_container<
    account_transaction_history_object,
@@ -136,6 +139,21 @@ typedef multi_index_container<
             member< account_transaction_history_object, uint32_t, &account_transaction_history_object::sequence>
          >
       >,
+      ordered_unique< tag<by_account_block>,
+         composite_key< account_transaction_history_object,
+            member< account_transaction_history_object, account_uid_type, &account_transaction_history_object::account>,
+            member< account_transaction_history_object, uint32_t, &account_transaction_history_object::block_num>,
+            member< account_transaction_history_object, uint32_t, &account_transaction_history_object::sequence>
+         >
+      >,
+      ordered_unique< tag<by_type_block>,
+         composite_key< account_transaction_history_object,
+            member< account_transaction_history_object, account_uid_type, &account_transaction_history_object::account>,
+            member< account_transaction_history_object, uint16_t, &account_transaction_history_object::operation_type>,
+            member< account_transaction_history_object, uint32_t, &account_transaction_history_object::block_num>,
+            member< account_transaction_history_object, uint32_t, &account_transaction_history_object::sequence>
+         >
+      >,
       ordered_unique< tag<by_op>,
          composite_key< account_transaction_history_object,
             member< account_transaction_history_object, account_uid_type, &account_transaction_history_object::account>,
@@ -157,4 +175,4 @@ FC_REFLECT_DERIVED( graphene::chain::operation_history_object, (graphene::chain:
                     (op)(result)(block_timestamp)(block_num)(trx_in_block)(op_in_trx)(virtual_op) )
 
 FC_REFLECT_DERIVED( graphene::chain::account_transaction_history_object, (graphene::chain::object),
-                    (account)(operation_id)(operation_type)(sequence)(next) )
+                    (account)(operation_id)(operation_type)(sequence)(block_num)(next) )
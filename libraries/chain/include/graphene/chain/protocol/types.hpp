@@ -190,6 +190,7 @@ namespace graphene { namespace chain {
       impl_account_auth_platform_object_type,
       impl_pledge_mining_object_type,
       impl_pledge_balance_object_type,
+      impl_custom_vote_pending_object_type,
       IMPL_OBJECT_TYPE_COUNT ///< Sentry value which contains the number of different impl object types
    };
 
@@ -208,6 +209,7 @@ namespace graphene { namespace chain {
    class advertising_order_object;
    class custom_vote_object;
    class cast_custom_vote_object;
+   class custom_vote_pending_object;
    class account_auth_platform_object;
    class pledge_mining_object;
    class limit_order_object;
@@ -269,6 +271,7 @@ namespace graphene { namespace chain {
    typedef object_id< implementation_ids, impl_advertising_order_object_type,advertising_order_object>                  advertising_order_id_type;
    typedef object_id< implementation_ids, impl_custom_vote_object_type,      custom_vote_object>                        custom_vote_id_type;
    typedef object_id< implementation_ids, impl_cast_custom_vote_object_type, cast_custom_vote_object>                   cast_custom_vote_id_type;
+   typedef object_id< implementation_ids, impl_custom_vote_pending_object_type, custom_vote_pending_object>             custom_vote_pending_id_type;
    typedef object_id< implementation_ids, impl_account_auth_platform_object_type, account_auth_platform_object>         account_auth_platform_id_type;
    typedef object_id< implementation_ids, impl_pledge_mining_object_type,    pledge_mining_object>                      pledge_mining_id_type;
    typedef object_id< implementation_ids, impl_pledge_balance_object_type,   pledge_balance_object>                     pledge_balance_id_type;
@@ -416,6 +419,7 @@ FC_REFLECT_ENUM( graphene::chain::impl_object_type,
                  (impl_account_auth_platform_object_type)
                  (impl_pledge_mining_object_type)
                  (impl_pledge_balance_object_type)
+                 (impl_custom_vote_pending_object_type)
                  (IMPL_OBJECT_TYPE_COUNT)
                )
 
@@ -447,6 +451,7 @@ FC_REFLECT_TYPENAME( graphene::chain::advertising_id_type)
 FC_REFLECT_TYPENAME( graphene::chain::advertising_order_id_type)
 FC_REFLECT_TYPENAME( graphene::chain::custom_vote_id_type)
 FC_REFLECT_TYPENAME( graphene::chain::cast_custom_vote_id_type)
+FC_REFLECT_TYPENAME( graphene::chain::custom_vote_pending_id_type)
 FC_REFLECT_TYPENAME( graphene::chain::account_auth_platform_id_type)
 FC_REFLECT_TYPENAME( graphene::chain::committee_member_vote_id_type )
 FC_REFLECT_TYPENAME( graphene::chain::registrar_takeover_id_type )
@@ -93,6 +93,8 @@ namespace graphene { namespace db {
             } FC_CAPTURE_AND_RETHROW()
          }
 
+         virtual size_t object_count()const override { return _objects.size(); }
+
          virtual fc::uint128 hash()const override {
             fc::uint128 result;
             for( const auto& ptr : _objects )
@@ -95,6 +95,8 @@ namespace graphene { namespace chain {
             } FC_CAPTURE_AND_RETHROW()
          }
 
+         virtual size_t object_count()const override { return _indices.size(); }
+
          const index_type& indices()const { return _indices; }
 
          virtual fc::uint128 hash()const override {
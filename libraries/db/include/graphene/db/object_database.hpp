@@ -75,6 +75,7 @@ namespace graphene { namespace db {
          const index&  get_index()const { return get_index(T::space_id,T::type_id); }
          const index&  get_index(uint8_t space_id, uint8_t type_id)const;
          const index&  get_index(object_id_type id)const { return get_index(id.space(),id.type()); }
+         void          inspect_all_indexes(std::function<void(const index&)> inspector)const;
          /// @}
 
          const object& get_object( object_id_type id )const;
@@ -98,6 +98,15 @@ namespace graphene { namespace db {
                }
             } FC_CAPTURE_AND_RETHROW()
          }
+
+         virtual size_t object_count()const override
+         {
+            size_t count = 0;
+            for( const auto& ptr : _objects )
+               if( ptr.get() )
+                  ++count;
+            return count;
+         }
          virtual fc::uint128 hash()const override {
             fc::uint128 result;
             for( const auto& ptr : _objects )
@@ -57,6 +57,15 @@
 
 #define GRAPHENE_NET_MAXIMUM_QUEUED_MESSAGES_IN_BYTES        (1024 * 1024)
 
+/**
+ * peer_connection coalesces queued messages into batches of up to this many bytes,
+ * which are encrypted and written to the socket together.  stcp_socket encrypts and
+ * decrypts in chunks of GRAPHENE_NET_STCP_BUFFER_SIZE, so a full batch costs one
+ * cipher call and one write.
+ */
+#define GRAPHENE_NET_MAX_SEND_BATCH_SIZE_IN_BYTES            (64 * 1024)
+#define GRAPHENE_NET_STCP_BUFFER_SIZE                        (64 * 1024)
+
 /**
  * When we receive a message from the network, we advertise it to
  * our peers and save a copy in a cache were we will find it if
@@ -79,6 +88,21 @@
 
 #define GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES           2
 
+/**
+ * The ids we have advertised to each peer, and that each peer has advertised to us,
+ * are kept in buckets covering this many seconds so they can be expired a bucket
+ * at a time.
+ */
+#define GRAPHENE_NET_INVENTORY_BUCKET_DURATION_SECONDS       10
+
+/**
+ * New transaction inventory is collected for this long before it is advertised, so a
+ * burst of transactions goes out in a few large item_ids_inventory_messages instead of
+ * many small ones.  Blocks are advertised as soon as they are accepted.  Configurable
+ * as the "inventory_flush_interval_ms" advanced parameter.
+ */
+#define GRAPHENE_NET_DEFAULT_INVENTORY_FLUSH_INTERVAL_MS     100
+
 #define GRAPHENE_NET_MAX_BLOCKS_PER_PEER_DURING_SYNCING      200
 
 /**
@@ -102,8 +126,38 @@
  */
 #define GRAPHENE_NET_MIN_BLOCK_IDS_TO_PREFETCH               10000
 
+/**
+ * Default for the per-peer transaction relay rate (the "max_transaction_relay_rate"
+ * advanced parameter).  We advertise at most this many transaction ids per second to
+ * each peer, and stop accepting transaction inventory from a peer once it has offered
+ * us GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES worth at this rate.
+ */
 #define GRAPHENE_NET_MAX_TRX_PER_SECOND                      1000
 
+/**
+ * Transactions held back by a peer's relay rate wait in a backlog holding at most
+ * this many seconds worth at that rate; the oldest are dropped when it overflows.
+ */
+#define GRAPHENE_NET_TRX_RELAY_BACKLOG_SECONDS               10
+
 #define GRAPHENE_NET_MAX_NESTED_OBJECTS                      (250)
 
+/**
+ * Peer scoring.  Each connected peer gets a rolling score built from its round trip
+ * delay, the rate at which it delivers items we request and the fraction of our
+ * requests it fails to satisfy.  Higher is better.  The score steers item requests,
+ * ranks connection candidates in the peer database, and lets us replace the slowest
+ * peer once we have our desired number of connections.
+ */
+#define GRAPHENE_NET_PEER_SCORE_SMOOTHING_FACTOR             0.2   // weight of the newest sample in the moving averages
+#define GRAPHENE_NET_PEER_SCORE_DEFAULT_ROUND_TRIP_DELAY_MS  250   // assumed until the first measurement arrives
+#define GRAPHENE_NET_PEER_SCORE_ROUND_TRIP_DELAY_SCALE_MS    100
+#define GRAPHENE_NET_PEER_SCORE_DELIVERY_RATE_SCALE          (64 * 1024) // bytes per second
+#define GRAPHENE_NET_PEER_SCORE_DELIVERY_WINDOW              60    // seconds of deliveries the delivery rate is taken over
+#define GRAPHENE_NET_PEER_SCORE_ROUND_TRIP_PROBE_INTERVAL    30    // seconds between round trip measurements
+#define GRAPHENE_NET_PEER_SCORE_MIN_SAMPLES                  20    // items a peer must have been asked for before it can be replaced
+#define GRAPHENE_NET_DEFAULT_SLOW_PEER_REPLACEMENT_INTERVAL  300   // seconds, 0 disables replacing slow peers
+#define GRAPHENE_NET_SLOW_PEER_SCORE_RATIO                   0.25  // a peer is slow if its score is below this fraction of the median
+#define GRAPHENE_NET_REPLACED_PEER_SCORE                     -1.0  // remembered for a peer we dropped as slow, so untried peers (0) come first
+
 #define MAXIMUM_PEERDB_SIZE 1000
\ No newline at end of file
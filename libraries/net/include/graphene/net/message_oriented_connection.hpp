@@ -52,6 +52,8 @@ namespace graphene { namespace net {
        void connect_to(const fc::ip::endpoint& remote_endpoint);
 
        void send_message(const message& message_to_send);
+       /** sends several messages with a single encrypted write */
+       void send_messages(const std::vector<message>& messages_to_send);
        void close_connection();
        void destroy_connection();
 
@@ -40,6 +40,7 @@
 #include <boost/multi_index/sequenced_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
 
+#include <deque>
 #include <queue>
 #include <boost/container/deque.hpp>
 #include <fc/thread/future.hpp>
@@ -61,6 +62,60 @@ namespace graphene { namespace net
       node_id_t        requesting_peer;
     };
 
+    /** traffic exchanged with a single peer for one message type */
+    struct message_type_counters
+    {
+      uint64_t messages_sent = 0;
+      uint64_t bytes_sent = 0;
+      uint64_t messages_received = 0;
+      uint64_t bytes_received = 0;
+    };
+
+    /** running statistics for a delay measured on a connection, all values in microseconds */
+    struct latency_counters
+    {
+      uint64_t count = 0;
+      int64_t  total = 0;
+      int64_t  average = 0;
+      int64_t  min = 0;
+      int64_t  max = 0;
+      int64_t  last = 0;
+
+      void record( const fc::microseconds& delay );
+    };
+
+    /**
+     * A set of item ids that remembers roughly when each id was inserted.  Ids are grouped
+     * into fixed-width time buckets, so expiring old ids drops whole buckets at once instead
+     * of maintaining an ordered timestamp index on every insert and erase.  An id may outlive
+     * the expiry time by up to one bucket width.
+     */
+    class timestamped_item_set
+    {
+    public:
+      explicit timestamped_item_set(uint32_t bucket_duration_seconds = GRAPHENE_NET_INVENTORY_BUCKET_DURATION_SECONDS);
+
+      /** returns false (and keeps the original timestamp) if the item is already in the set */
+      bool insert(const item_id& item, const fc::time_point_sec& timestamp);
+      bool contains(const item_id& item) const { return _items.find(item) != _items.end(); }
+      void erase(const item_id& item) { _items.erase(item); }
+      /** removes every bucket that ends at or before oldest_timestamp_to_keep, returns the number of ids removed */
+      size_t expire(const fc::time_point_sec& oldest_timestamp_to_keep);
+      size_t size() const { return _items.size(); }
+      bool empty() const { return _items.empty(); }
+      void clear();
+    private:
+      struct bucket
+      {
+        fc::time_point_sec   start_time;
+        std::vector<item_id> items; // may also hold ids that have since been erased
+      };
+      uint32_t                              _bucket_duration_seconds;
+      uint64_t                              _first_bucket_sequence; // sequence number of _buckets.front()
+      std::deque<bucket>                    _buckets;
+      std::unordered_map<item_id, uint64_t> _items; // maps each id to the sequence number of its bucket
+    };
+
     class peer_connection;
     class peer_connection_delegate
     {
@@ -235,23 +290,8 @@ namespace graphene { namespace net
 
       /// non-synchronization state data
       /// @{
-      struct timestamped_item_id
-      {
-        item_id            item;
-        fc::time_point_sec timestamp;
-        timestamped_item_id(const item_id& item, const fc::time_point_sec timestamp) :
-          item(item),
-          timestamp(timestamp)
-        {}
-      };
-      struct timestamp_index{};
-      typedef boost::multi_index_container<timestamped_item_id,
-                                           boost::multi_index::indexed_by<boost::multi_index::hashed_unique<boost::multi_index::member<timestamped_item_id, item_id, &timestamped_item_id::item>,
-                                                                                                            std::hash<item_id> >,
-                                                                          boost::multi_index::ordered_non_unique<boost::multi_index::tag<timestamp_index>,
-                                                                                                                 boost::multi_index::member<timestamped_item_id, fc::time_point_sec, &timestamped_item_id::timestamp> > > > timestamped_items_set_type;
-      timestamped_items_set_type inventory_peer_advertised_to_us;
-      timestamped_items_set_type inventory_advertised_to_peer;
+      timestamped_item_set inventory_peer_advertised_to_us;
+      timestamped_item_set inventory_advertised_to_peer;
 
       item_to_time_map_type items_requested_from_peer;  /// items we've requested from this peer during normal operation.  fetch from another peer if this peer disconnects
       /// @}
@@ -262,6 +302,33 @@ namespace graphene { namespace net
 
       uint32_t last_known_fork_block_number;
 
+      /// transaction relay shaping, see claim_transaction_relay_allowance()
+      /// @{
+      uint32_t            max_transaction_relay_rate; /// most transaction ids per second we'll advertise to this peer or accept from it
+      double              transaction_relay_allowance; /// transaction ids we may advertise right now
+      fc::time_point      last_transaction_relay_allowance_update;
+      std::deque<item_id> transaction_inventory_backlog; /// transaction ids waiting for relay allowance, oldest first
+      /// @}
+
+      /// network telemetry
+      /// @{
+      std::map<uint32_t, message_type_counters> message_counters; /// bytes and messages in each direction, by message type
+      latency_counters send_queue_delay; /// time a message waits in our send queue before we start transmitting it
+      latency_counters fetch_items_latency; /// time between sending a fetch_items_message and receiving the item
+      latency_counters fetch_blockchain_item_ids_latency; /// time between sending a fetch_blockchain_item_ids_message and receiving the inventory
+      latency_counters block_propagation_delay; /// for new blocks this peer delivered to us, time of arrival minus the block's timestamp
+      /// @}
+
+      /// peer scoring data, see get_score()
+      /// @{
+      fc::microseconds smoothed_round_trip_delay; /// moving average of round_trip_delay, zero until the first measurement
+      fc::time_point   last_round_trip_measurement_time;
+      std::deque<std::pair<fc::time_point_sec, uint64_t> > recent_deliveries; /// bytes of the items we requested from this peer, by the second they arrived in
+      double           smoothed_failure_ratio; /// moving average of requests the peer didn't satisfy (0 = all delivered, 1 = none)
+      uint32_t         number_of_item_requests_scored;
+      bool             replaced_as_slow_peer; /// we disconnected to make room for a faster peer
+      /// @}
+
       fc::future<void> accept_or_connect_task_done;
 
       firewall_check_state_data *firewall_check_state;
@@ -310,8 +377,21 @@ namespace graphene { namespace net
       void clear_old_inventory();
       bool is_inventory_advertised_to_us_list_full_for_transactions() const;
       bool is_inventory_advertised_to_us_list_full() const;
+      /** grants up to number_wanted transaction ids from this peer's relay allowance, returns how many were granted */
+      uint32_t claim_transaction_relay_allowance(uint32_t number_wanted);
       bool performing_firewall_check() const;
       fc::optional<fc::ip::endpoint> get_endpoint_for_connecting() const;
+
+      void record_round_trip_delay(const fc::microseconds& delay);
+      void record_item_delivered(size_t item_size, const fc::microseconds& latency,
+                                 const fc::time_point& now = fc::time_point::now());
+      void record_item_not_delivered();
+      /** returns the bytes per second of requested items the peer delivered over the last GRAPHENE_NET_PEER_SCORE_DELIVERY_WINDOW seconds */
+      double get_delivery_rate(const fc::time_point& now = fc::time_point::now()) const;
+      /** returns the peer's rolling score, higher is better */
+      double get_score(const fc::time_point& now = fc::time_point::now()) const;
+      /** returns the score to remember in the peer database when we disconnect */
+      double get_score_for_peer_database() const;
     private:
       void send_queued_messages_task();
       void accept_connection_task();
@@ -319,6 +399,14 @@ namespace graphene { namespace net
     };
     typedef std::shared_ptr<peer_connection> peer_connection_ptr;
 
+    /**
+     * Returns the peer to drop to make room for a faster one: the lowest scored of the peers in normal operation
+     * that were connected before connected_before and asked for enough items, if its score is below
+     * GRAPHENE_NET_SLOW_PEER_SCORE_RATIO of their median.  Returns null if there is no such peer.
+     */
+    peer_connection_ptr find_slow_peer(const std::vector<peer_connection_ptr>& peers, const fc::time_point& connected_before,
+                                       const fc::time_point& now = fc::time_point::now());
+
  } } // end namespace graphene::net
 
 // not sent over the wire, just reflected for logging
@@ -342,4 +430,5 @@ FC_REFLECT_ENUM(graphene::net::peer_connection::connection_negotiation_status, (
                                                                           (closing)
                                                                           (closed) )
 
-FC_REFLECT( graphene::net::peer_connection::timestamped_item_id, (item)(timestamp));
+FC_REFLECT( graphene::net::message_type_counters, (messages_sent)(bytes_sent)(messages_received)(bytes_received) );
+FC_REFLECT( graphene::net::latency_counters, (count)(total)(average)(min)(max)(last) );
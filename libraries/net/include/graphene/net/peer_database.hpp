@@ -52,10 +52,12 @@ namespace graphene { namespace net {
     uint32_t                          number_of_successful_connection_attempts;
     uint32_t                          number_of_failed_connection_attempts;
     fc::optional<fc::exception>       last_error;
+    double                            last_known_score; /// peer_connection::get_score() when we last disconnected, 0 if never scored, negative if we dropped it as slow
 
     potential_peer_record() :
       number_of_successful_connection_attempts(0),
-    number_of_failed_connection_attempts(0){}
+    number_of_failed_connection_attempts(0),
+    last_known_score(0){}
 
     potential_peer_record(fc::ip::endpoint endpoint,
                           fc::time_point_sec last_seen_time = fc::time_point_sec(),
@@ -64,7 +66,8 @@ namespace graphene { namespace net {
       last_seen_time(last_seen_time),
       last_connection_disposition(last_connection_disposition),
       number_of_successful_connection_attempts(0),
-      number_of_failed_connection_attempts(0)
+      number_of_failed_connection_attempts(0),
+      last_known_score(0)
     {}  
   };
 
@@ -108,6 +111,9 @@ namespace graphene { namespace net {
     potential_peer_record lookup_or_create_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
     fc::optional<potential_peer_record> lookup_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
 
+    /** returns all records, best connection candidates first (highest last_known_score, then most recently seen) */
+    std::vector<potential_peer_record> get_records_ranked_by_score() const;
+
     typedef detail::peer_database_iterator iterator;
     iterator begin() const;
     iterator end() const;
@@ -119,4 +125,4 @@ namespace graphene { namespace net {
 } } // end namespace graphene::net
 
 FC_REFLECT_ENUM(graphene::net::potential_peer_last_connection_disposition, (never_attempted_to_connect)(last_connection_failed)(last_connection_rejected)(last_connection_handshaking_failed)(last_connection_succeeded))
-FC_REFLECT(graphene::net::potential_peer_record, (endpoint)(last_seen_time)(last_connection_disposition)(last_connection_attempt_time)(number_of_successful_connection_attempts)(number_of_failed_connection_attempts)(last_error) )
+FC_REFLECT(graphene::net::potential_peer_record, (endpoint)(last_seen_time)(last_connection_disposition)(last_connection_attempt_time)(number_of_successful_connection_attempts)(number_of_failed_connection_attempts)(last_error)(last_known_score) )
@@ -61,6 +61,7 @@ namespace graphene { namespace net {
       fc::time_point _last_message_sent_time;
 
       bool _send_message_in_progress;
+      std::vector<char> _send_buffer; /// reused between sends to avoid an allocation per message
 
 #ifndef NDEBUG
       fc::thread* _thread;
@@ -68,6 +69,8 @@ namespace graphene { namespace net {
 
       void read_loop();
       void start_read_loop();
+      void append_message_to_send_buffer(const message& message_to_send);
+      void write_send_buffer();
     public:
       fc::tcp_socket& get_socket();
       void accept();
@@ -79,6 +82,7 @@ namespace graphene { namespace net {
       ~message_oriented_connection_impl();
 
       void send_message(const message& message_to_send);
+      void send_messages(const std::vector<message>& messages_to_send);
       void close_connection();
       void destroy_connection();
 
@@ -255,21 +259,61 @@ namespace graphene { namespace net {
 
       try
       {
-        size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size;
-        if( message_to_send.size > MAX_MESSAGE_SIZE )
-           elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
-        //pad the message we send to a multiple of 16 bytes
-        size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
-        std::unique_ptr<char[]> padded_message(new char[size_with_padding]);
-        memcpy(padded_message.get(), (char*)&message_to_send, sizeof(message_header));
-        memcpy(padded_message.get() + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
-        _sock.write(padded_message.get(), size_with_padding);
-        _sock.flush();
-        _bytes_sent += size_with_padding;
-        _last_message_sent_time = fc::time_point::now();
+        _send_buffer.clear();
+        append_message_to_send_buffer(message_to_send);
+        write_send_buffer();
       } FC_RETHROW_EXCEPTIONS( warn, "unable to send message" );
     }
 
+    void message_oriented_connection_impl::send_messages(const std::vector<message>& messages_to_send)
+    {
+      VERIFY_CORRECT_THREAD();
+      struct verify_no_send_in_progress {
+        bool& var;
+        verify_no_send_in_progress(bool& var) : var(var)
+        {
+          if (var)
+            elog("Error: two tasks are calling message_oriented_connection::send_messages() at the same time");
+          assert(!var);
+          var = true;
+        }
+        ~verify_no_send_in_progress() { var = false; }
+      } _verify_no_send_in_progress(_send_message_in_progress);
+
+      try
+      {
+        _send_buffer.clear();
+        for (const message& message_to_send : messages_to_send)
+          append_message_to_send_buffer(message_to_send);
+        if (!_send_buffer.empty())
+          write_send_buffer();
+      } FC_RETHROW_EXCEPTIONS( warn, "unable to send ${count} messages", ("count", messages_to_send.size()) );
+    }
+
+    void message_oriented_connection_impl::append_message_to_send_buffer(const message& message_to_send)
+    {
+      size_t size_of_message_and_header = sizeof(message_header) + message_to_send.size;
+      if( message_to_send.size > MAX_MESSAGE_SIZE )
+         elog("Trying to send a message larger than MAX_MESSAGE_SIZE. This probably won't work...");
+      //pad the message we send to a multiple of 16 bytes
+      size_t size_with_padding = 16 * ((size_of_message_and_header + 15) / 16);
+      size_t offset = _send_buffer.size();
+      _send_buffer.resize(offset + size_with_padding, 0);
+      memcpy(_send_buffer.data() + offset, (char*)&message_to_send, sizeof(message_header));
+      memcpy(_send_buffer.data() + offset + sizeof(message_header), message_to_send.data.data(), message_to_send.size );
+    }
+
+    void message_oriented_connection_impl::write_send_buffer()
+    {
+      _sock.write(_send_buffer.data(), _send_buffer.size());
+      _sock.flush();
+      _bytes_sent += _send_buffer.size();
+      _last_message_sent_time = fc::time_point::now();
+      // don't keep a buffer sized for the occasional huge block around for the life of the connection
+      if (_send_buffer.capacity() > 2 * GRAPHENE_NET_MAX_SEND_BATCH_SIZE_IN_BYTES)
+        std::vector<char>().swap(_send_buffer);
+    }
+
     void message_oriented_connection_impl::close_connection()
     {
       VERIFY_CORRECT_THREAD();
@@ -371,6 +415,11 @@ namespace graphene { namespace net {
     my->send_message(message_to_send);
   }
 
+  void message_oriented_connection::send_messages(const std::vector<message>& messages_to_send)
+  {
+    my->send_messages(messages_to_send);
+  }
+
   void message_oriented_connection::close_connection()
   {
     my->close_connection();
@@ -30,6 +30,7 @@
 #include <iostream>
 #include <algorithm>
 #include <tuple>
+#include <time.h>
 #include <boost/tuple/tuple.hpp>
 #include <boost/circular_buffer.hpp>
 
@@ -253,6 +254,23 @@ FC_REFLECT(graphene::net::detail::node_configuration, (listen_endpoint)
 
 namespace graphene { namespace net { namespace detail {
 
+    // converts per-message-type counters into an object keyed by message type name, for the
+    // network_node_api telemetry calls
+    static fc::variant_object message_counters_to_variant(const std::map<uint32_t, message_type_counters>& counters)
+    {
+      fc::mutable_variant_object result;
+      for (const auto& type_and_counters : counters)
+      {
+        uint32_t msg_type = type_and_counters.first;
+        bool is_known_type = msg_type == trx_message_type || msg_type == block_message_type ||
+                             (msg_type > core_message_type_first && msg_type <= get_current_connections_reply_message_type);
+        std::string type_name = is_known_type ? fc::reflector<core_message_type_enum>::to_string(core_message_type_enum(msg_type))
+                                              : fc::to_string(uint64_t(msg_type));
+        result[type_name] = fc::variant( type_and_counters.second, 2 );
+      }
+      return result;
+    }
+
     // when requesting items from peers, we want to prioritize any blocks before
     // transactions, but otherwise request items in the order we heard about them
     struct prioritized_item_id
@@ -473,7 +491,7 @@ namespace graphene { namespace net { namespace detail {
                                            > items_to_fetch_set_type;
       unsigned _items_to_fetch_sequence_counter;
       items_to_fetch_set_type _items_to_fetch; /// list of items we know another peer has and we want
-      peer_connection::timestamped_items_set_type _recently_failed_items; /// list of transactions we've recently pushed and had rejected by the delegate
+      timestamped_item_set          _recently_failed_items; /// list of transactions we've recently pushed and had rejected by the delegate
       // @}
 
       /// used by the task that advertises inventory during normal operation
@@ -510,6 +528,13 @@ namespace graphene { namespace net { namespace detail {
       uint32_t              _peer_connection_retry_timeout;
       /** how many seconds of inactivity are permitted before disconnecting a peer */
       uint32_t              _peer_inactivity_timeout;
+      /** once we have our desired number of connections, disconnect our slowest peer at most this often, in seconds (0 = never) */
+      uint32_t              _slow_peer_replacement_interval;
+      /** how long new transaction inventory accumulates before advertise_inventory_loop sends it, in milliseconds (blocks go out at once) */
+      uint32_t              _inventory_flush_interval_ms;
+      /** the most transaction ids per second we advertise to, or accept from, each peer */
+      uint32_t              _max_transaction_relay_rate;
+      fc::time_point        _last_slow_peer_replacement_time;
 
       fc::tcp_server       _tcp_server;
       fc::future<void>     _accept_loop_complete;
@@ -552,6 +577,8 @@ namespace graphene { namespace net { namespace detail {
       fc::time_point_sec _bandwidth_monitor_last_update_time;
       fc::future<void> _bandwidth_monitor_loop_done;
 
+      latency_counters _block_propagation_delay; /// for every new block we accept during normal operation, time of arrival minus the block's timestamp
+
       fc::future<void> _dump_node_status_task_done;
 
       /* We have two alternate paths through the schedule_peer_for_deletion code -- one that
@@ -603,6 +630,7 @@ namespace graphene { namespace net { namespace detail {
       void trigger_advertise_inventory_loop();
 
       void terminate_inactive_connections_loop();
+      peer_connection_ptr find_slow_peer_to_replace();
 
       void fetch_updated_peer_lists_loop();
       void update_bandwidth_data(uint32_t bytes_read_this_second, uint32_t bytes_written_this_second);
@@ -811,6 +839,9 @@ namespace graphene { namespace net { namespace detail {
       _maximum_number_of_connections(GRAPHENE_NET_DEFAULT_MAX_CONNECTIONS),
       _peer_connection_retry_timeout(GRAPHENE_NET_DEFAULT_PEER_CONNECTION_RETRY_TIME),
       _peer_inactivity_timeout(GRAPHENE_NET_PEER_HANDSHAKE_INACTIVITY_TIMEOUT),
+      _slow_peer_replacement_interval(GRAPHENE_NET_DEFAULT_SLOW_PEER_REPLACEMENT_INTERVAL),
+      _inventory_flush_interval_ms(GRAPHENE_NET_DEFAULT_INVENTORY_FLUSH_INTERVAL_MS),
+      _max_transaction_relay_rate(GRAPHENE_NET_MAX_TRX_PER_SECOND),
       _most_recent_blocks_accepted(_maximum_number_of_connections),
       _total_number_of_unfetched_items(0),
       _rate_limiter(0, 0),
@@ -848,6 +879,7 @@ namespace graphene { namespace net { namespace detail {
           if (updated_peer_record)
           {
             updated_peer_record->last_seen_time = fc::time_point::now();
+            updated_peer_record->last_known_score = active_peer->get_score_for_peer_database();
             _potential_peer_db.update_entry(*updated_peer_record);
           }
         }
@@ -923,8 +955,10 @@ namespace graphene { namespace net { namespace detail {
             bool initiated_connection_this_pass = false;
             _potential_peer_database_updated = false;
 
-            for (peer_database::iterator iter = _potential_peer_db.begin();
-                 iter != _potential_peer_db.end() && is_wanting_new_connections();
+            // try the candidates that served us best in the past first
+            std::vector<potential_peer_record> ranked_candidates = _potential_peer_db.get_records_ranked_by_score();
+            for (auto iter = ranked_candidates.begin();
+                 iter != ranked_candidates.end() && is_wanting_new_connections();
                  ++iter)
             {
               fc::microseconds delay_until_retry = fc::seconds((iter->number_of_failed_connection_attempts + 1) * _peer_connection_retry_timeout);
@@ -1101,7 +1135,7 @@ namespace graphene { namespace net { namespace detail {
     {
       for( const peer_connection_ptr& peer : _active_connections )
       {
-        if (peer->inventory_peer_advertised_to_us.find(item) != peer->inventory_peer_advertised_to_us.end() )
+        if (peer->inventory_peer_advertised_to_us.contains(item))
           return true;
       }
       return false;
@@ -1126,15 +1160,18 @@ namespace graphene { namespace net { namespace detail {
         struct peer_and_items_to_fetch
         {
           peer_connection_ptr peer;
+          double score;
           std::vector<item_id> item_ids;
-          peer_and_items_to_fetch(const peer_connection_ptr& peer) : peer(peer) {}
+          peer_and_items_to_fetch(const peer_connection_ptr& peer) : peer(peer), score(peer->get_score()) {}
           bool operator<(const peer_and_items_to_fetch& rhs) const { return peer < rhs.peer; }
           size_t number_of_items() const { return item_ids.size(); }
+          // least loaded peers first, and among equally loaded peers, the best scoring one first
+          std::pair<size_t, double> load_and_score() const { return std::make_pair(item_ids.size(), -score); }
         };
         typedef boost::multi_index_container<peer_and_items_to_fetch,
                                              boost::multi_index::indexed_by<boost::multi_index::ordered_unique<boost::multi_index::member<peer_and_items_to_fetch, peer_connection_ptr, &peer_and_items_to_fetch::peer> >,
                                                                             boost::multi_index::ordered_non_unique<boost::multi_index::tag<requested_item_count_index>,
-                                                                                                                   boost::multi_index::const_mem_fun<peer_and_items_to_fetch, size_t, &peer_and_items_to_fetch::number_of_items> > > > fetch_messages_to_send_set;
+                                                                                                                   boost::multi_index::const_mem_fun<peer_and_items_to_fetch, std::pair<size_t, double>, &peer_and_items_to_fetch::load_and_score> > > > fetch_messages_to_send_set;
         fetch_messages_to_send_set items_by_peer;
 
         // initialize the fetch_messages_to_send with an empty set of items for all idle peers
@@ -1155,14 +1192,15 @@ namespace graphene { namespace net { namespace detail {
           }
           else
           {
-            // find a peer that has it, we'll use the one who has the least requests going to it to load balance
+            // find a peer that has it, we'll use the one who has the least requests going to it to load balance,
+            // preferring the peer with the best score
             bool item_fetched = false;
             for (auto peer_iter = items_by_peer.get<requested_item_count_index>().begin(); peer_iter != items_by_peer.get<requested_item_count_index>().end(); ++peer_iter)
             {
               const peer_connection_ptr& peer = peer_iter->peer;
               // if they have the item and we haven't already decided to ask them for too many other items
               if (peer_iter->item_ids.size() < GRAPHENE_NET_MAX_ITEMS_PER_PEER_DURING_NORMAL_OPERATION &&
-                  peer->inventory_peer_advertised_to_us.find(item_iter->item) != peer->inventory_peer_advertised_to_us.end())
+                  peer->inventory_peer_advertised_to_us.contains(item_iter->item))
               {
                 if (item_iter->item.item_type == graphene::net::trx_message_type && peer->is_transaction_fetching_inhibited())
                   next_peer_unblocked_time = std::min(peer->transaction_fetching_inhibited_until, next_peer_unblocked_time);
@@ -1237,68 +1275,144 @@ namespace graphene { namespace net { namespace detail {
     void node_impl::advertise_inventory_loop()
     {
       VERIFY_CORRECT_THREAD();
+      // blocks (and anything else that isn't a transaction) are advertised as soon as we have them.
+      // New transactions accumulate for up to _inventory_flush_interval_ms so a burst of them goes
+      // out in a few large inventory messages; transactions held back for some peer's relay rate
+      // wait at least GRAPHENE_NET_DEFAULT_INVENTORY_FLUSH_INTERVAL_MS
+      bool transactions_held_back = false;
+      fc::time_point transaction_flush_time = fc::time_point::maximum(); // maximum() if no flush is scheduled
       while (!_advertise_inventory_loop_done.canceled())
       {
-        dlog("beginning an iteration of advertise inventory");
-        // swap inventory into local variable, clearing the node's copy
-        std::unordered_set<item_id> inventory_to_advertise;
-        inventory_to_advertise.swap(_new_inventory);
-
-        // process all inventory to advertise and construct the inventory messages we'll send
-        // first, then send them all in a batch (to avoid any fiber interruption points while
-        // we're computing the messages)
-        std::list<std::pair<peer_connection_ptr, item_ids_inventory_message> > inventory_messages_to_send;
+        bool new_transactions = false;
+        bool new_other_items = false;
+        for (const item_id& item : _new_inventory)
+          (item.item_type == trx_message_type ? new_transactions : new_other_items) = true;
+        if ((new_transactions || transactions_held_back) && transaction_flush_time == fc::time_point::maximum())
+        {
+          uint32_t flush_interval_ms = _inventory_flush_interval_ms;
+          if (transactions_held_back && !flush_interval_ms)
+            flush_interval_ms = GRAPHENE_NET_DEFAULT_INVENTORY_FLUSH_INTERVAL_MS;
+          transaction_flush_time = fc::time_point::now() + fc::milliseconds(flush_interval_ms);
+        }
+        const bool flush_transactions = fc::time_point::now() >= transaction_flush_time;
 
-        for (const peer_connection_ptr& peer : _active_connections)
+        if (new_other_items || flush_transactions)
         {
-          // only advertise to peers who are in sync with us
-           p2pddump((peer->peer_needs_sync_items_from_us));
-          if( !peer->peer_needs_sync_items_from_us )
+          dlog("beginning an iteration of advertise inventory");
+          // move the inventory we're advertising now into a local variable, leaving any
+          // transactions that are still accumulating in the node's copy
+          std::unordered_set<item_id> inventory_to_advertise;
+          if (flush_transactions)
           {
+            inventory_to_advertise.swap(_new_inventory);
+            transaction_flush_time = fc::time_point::maximum();
+          }
+          else
+            for (auto iter = _new_inventory.begin(); iter != _new_inventory.end();)
+              if (iter->item_type != trx_message_type)
+              {
+                inventory_to_advertise.insert(*iter);
+                iter = _new_inventory.erase(iter);
+              }
+              else
+                ++iter;
+
+          // process all inventory to advertise and construct the inventory messages we'll send
+          // first, then send them all in a batch (to avoid any fiber interruption points while
+          // we're computing the messages)
+          std::list<std::pair<peer_connection_ptr, item_ids_inventory_message> > inventory_messages_to_send;
+          const fc::time_point_sec now = fc::time_point::now();
+          if (flush_transactions)
+            transactions_held_back = false;
+
+          for (const peer_connection_ptr& peer : _active_connections)
+          {
+            peer->clear_old_inventory();
+            // only advertise to peers who are in sync with us
+            if (peer->peer_needs_sync_items_from_us)
+              continue;
+
             std::map<uint32_t, std::vector<item_hash_t> > items_to_advertise_by_type;
             // don't send the peer anything we've already advertised to it
             // or anything it has advertised to us
-            // group the items we need to send by type, because we'll need to send one inventory message per type
-            unsigned total_items_to_send_to_this_peer = 0;
-            p2pddump((inventory_to_advertise));
+            // group the items we need to send by type, because we'll need to send one inventory message per type.
+            // Transactions go through the peer's backlog so we never exceed its relay rate
             for (const item_id& item_to_advertise : inventory_to_advertise)
             {
-              if (peer->inventory_advertised_to_peer.find(item_to_advertise) != peer->inventory_advertised_to_peer.end() )
-                 p2pddump((*peer->inventory_advertised_to_peer.find(item_to_advertise)));
-              if (peer->inventory_peer_advertised_to_us.find(item_to_advertise) != peer->inventory_peer_advertised_to_us.end() )
-                 p2pddump((*peer->inventory_peer_advertised_to_us.find(item_to_advertise)));
-
-              if (peer->inventory_advertised_to_peer.find(item_to_advertise) == peer->inventory_advertised_to_peer.end() &&
-                  peer->inventory_peer_advertised_to_us.find(item_to_advertise) == peer->inventory_peer_advertised_to_us.end())
+              if (peer->inventory_advertised_to_peer.contains(item_to_advertise) ||
+                  peer->inventory_peer_advertised_to_us.contains(item_to_advertise))
+                continue;
+              if (item_to_advertise.item_type == trx_message_type)
+                peer->transaction_inventory_backlog.push_back(item_to_advertise);
+              else
               {
                 items_to_advertise_by_type[item_to_advertise.item_type].push_back(item_to_advertise.item_hash);
-                peer->inventory_advertised_to_peer.insert(peer_connection::timestamped_item_id(item_to_advertise, fc::time_point::now()));
-                ++total_items_to_send_to_this_peer;
-                if (item_to_advertise.item_type == trx_message_type)
-                  testnetlog("advertising transaction ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
-                dlog("advertising item ${id} to peer ${endpoint}", ("id", item_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
+                peer->inventory_advertised_to_peer.insert(item_to_advertise, now);
               }
             }
-              dlog("advertising ${count} new item(s) of ${types} type(s) to peer ${endpoint}",
-                   ("count", total_items_to_send_to_this_peer)
-                   ("types", items_to_advertise_by_type.size())
-                   ("endpoint", peer->get_remote_endpoint()));
+
+            size_t maximum_backlog_size = (size_t)peer->max_transaction_relay_rate * GRAPHENE_NET_TRX_RELAY_BACKLOG_SECONDS;
+            if (peer->transaction_inventory_backlog.size() > maximum_backlog_size)
+            {
+              size_t number_to_drop = peer->transaction_inventory_backlog.size() - maximum_backlog_size;
+              dlog("dropping ${count} transaction(s) from the relay backlog of peer ${endpoint}",
+                   ("count", number_to_drop)("endpoint", peer->get_remote_endpoint()));
+              peer->transaction_inventory_backlog.erase(peer->transaction_inventory_backlog.begin(),
+                                                        peer->transaction_inventory_backlog.begin() + number_to_drop);
+            }
+
+            uint32_t number_of_transactions_allowed =
+              peer->claim_transaction_relay_allowance((uint32_t)peer->transaction_inventory_backlog.size());
+            for (uint32_t i = 0; i < number_of_transactions_allowed; ++i)
+            {
+              item_id transaction_to_advertise = peer->transaction_inventory_backlog.front();
+              peer->transaction_inventory_backlog.pop_front();
+              // the peer may have offered it to us while it was waiting
+              if (peer->inventory_peer_advertised_to_us.contains(transaction_to_advertise) ||
+                  !peer->inventory_advertised_to_peer.insert(transaction_to_advertise, now))
+                continue;
+              items_to_advertise_by_type[trx_message_type].push_back(transaction_to_advertise.item_hash);
+              testnetlog("advertising transaction ${id} to peer ${endpoint}", ("id", transaction_to_advertise.item_hash)("endpoint", peer->get_remote_endpoint()));
+            }
+            if (!peer->transaction_inventory_backlog.empty())
+              transactions_held_back = true;
+
+            dlog("advertising ${count} new item type(s) to peer ${endpoint}, ${backlog} transaction(s) held back",
+                 ("count", items_to_advertise_by_type.size())
+                 ("backlog", peer->transaction_inventory_backlog.size())
+                 ("endpoint", peer->get_remote_endpoint()));
             for (auto items_group : items_to_advertise_by_type)
               inventory_messages_to_send.push_back(std::make_pair(peer, item_ids_inventory_message(items_group.first, items_group.second)));
           }
-          peer->clear_old_inventory();
-        }
 
-        for (auto iter = inventory_messages_to_send.begin(); iter != inventory_messages_to_send.end(); ++iter)
-          iter->first->send_message(iter->second);
-        inventory_messages_to_send.clear();
+          for (auto iter = inventory_messages_to_send.begin(); iter != inventory_messages_to_send.end(); ++iter)
+            iter->first->send_message(iter->second);
+          inventory_messages_to_send.clear();
+        }
 
-        if (_new_inventory.empty())
+        if (_new_inventory.empty() && !transactions_held_back)
         {
           _retrigger_advertise_inventory_loop_promise = fc::promise<void>::ptr(new fc::promise<void>("graphene::net::retrigger_advertise_inventory_loop"));
           _retrigger_advertise_inventory_loop_promise->wait();
           _retrigger_advertise_inventory_loop_promise.reset();
         }
+        else if (transaction_flush_time != fc::time_point::maximum() &&
+                 std::none_of(_new_inventory.begin(), _new_inventory.end(),
+                              [](const item_id& item) { return item.item_type != trx_message_type; }))
+        {
+          // only transactions are waiting, sleep until they're due unless a block comes in first
+          _retrigger_advertise_inventory_loop_promise = fc::promise<void>::ptr(new fc::promise<void>("graphene::net::retrigger_advertise_inventory_loop"));
+          try
+          {
+            fc::microseconds time_until_flush = transaction_flush_time - fc::time_point::now();
+            if (time_until_flush > fc::microseconds(0))
+              _retrigger_advertise_inventory_loop_promise->wait(time_until_flush);
+          }
+          catch (const fc::timeout_exception&)
+          {
+          }
+          _retrigger_advertise_inventory_loop_promise.reset();
+        }
       } // while(!canceled)
     }
 
@@ -1373,6 +1487,7 @@ namespace graphene { namespace net { namespace detail {
         fc::time_point active_disconnect_threshold = fc::time_point::now() - fc::seconds(active_disconnect_timeout);
         fc::time_point active_send_keepalive_threshold = fc::time_point::now() - fc::seconds(active_send_keepalive_timeout);
         fc::time_point active_ignored_request_threshold = fc::time_point::now() - active_ignored_request_timeout;
+        fc::time_point round_trip_probe_threshold = fc::time_point::now() - fc::seconds(GRAPHENE_NET_PEER_SCORE_ROUND_TRIP_PROBE_INTERVAL);
         for( const peer_connection_ptr& active_peer : _active_connections )
         {
           if( active_peer->connection_initiation_time < active_disconnect_threshold &&
@@ -1438,6 +1553,12 @@ namespace graphene { namespace net { namespace detail {
                       ("peer", active_peer->get_remote_endpoint()));
               peers_to_disconnect_forcibly.push_back(active_peer);
             }
+
+            // the current_time_request doubles as our round trip delay probe, which feeds the peer's score
+            if (active_peer->last_round_trip_measurement_time < round_trip_probe_threshold &&
+                (peers_to_disconnect_forcibly.empty() || peers_to_disconnect_forcibly.back() != active_peer) &&
+                (peers_to_send_keep_alive.empty() || peers_to_send_keep_alive.back() != active_peer))
+              peers_to_send_keep_alive.push_back(active_peer);
           }
         }
 
@@ -1499,6 +1620,15 @@ namespace graphene { namespace net { namespace detail {
       }
       peers_to_disconnect_gently.clear();
 
+      peer_connection_ptr slow_peer = find_slow_peer_to_replace();
+      if (slow_peer)
+      {
+        wlog("Disconnecting peer ${peer} with score ${score} to make room for a faster peer",
+             ("peer", slow_peer->get_remote_endpoint())("score", slow_peer->get_score()));
+        slow_peer->replaced_as_slow_peer = true;
+        disconnect_from_peer(slow_peer.get(), "Replacing my slowest peer");
+      }
+
       for( const peer_connection_ptr& peer : peers_to_send_keep_alive )
         peer->send_message(current_time_request_message(),
                            offsetof(current_time_request_message, request_sent_time));
@@ -1510,6 +1640,24 @@ namespace graphene { namespace net { namespace detail {
                                                                    "terminate_inactive_connections_loop" );
     }
 
+    peer_connection_ptr node_impl::find_slow_peer_to_replace()
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::time_point now = fc::time_point::now();
+      if (_slow_peer_replacement_interval == 0 ||
+          _active_connections.size() < _desired_number_of_connections ||
+          now < _last_slow_peer_replacement_time + fc::seconds(_slow_peer_replacement_interval))
+        return peer_connection_ptr();
+
+      std::vector<peer_connection_ptr> peers(_active_connections.begin(), _active_connections.end());
+      peer_connection_ptr slow_peer = find_slow_peer(peers, now - fc::seconds(_slow_peer_replacement_interval), now);
+      if (!slow_peer)
+        return peer_connection_ptr();
+
+      _last_slow_peer_replacement_time = now;
+      return slow_peer;
+    }
+
     void node_impl::fetch_updated_peer_lists_loop()
     {
       VERIFY_CORRECT_THREAD();
@@ -1535,9 +1683,7 @@ namespace graphene { namespace net { namespace detail {
       // this has nothing to do with updating the peer list, but we need to prune this list 
       // at regular intervals, this is a fine place to do it.
       fc::time_point_sec oldest_failed_ids_to_keep(fc::time_point::now() - fc::minutes(15));
-      auto oldest_failed_ids_to_keep_iter = _recently_failed_items.get<peer_connection::timestamp_index>().lower_bound(oldest_failed_ids_to_keep);
-      auto begin_iter = _recently_failed_items.get<peer_connection::timestamp_index>().begin();
-      _recently_failed_items.get<peer_connection::timestamp_index>().erase(begin_iter, oldest_failed_ids_to_keep_iter);
+      _recently_failed_items.expire(oldest_failed_ids_to_keep);
 
       if (!_node_is_shutting_down && !_fetch_updated_peer_lists_loop_done.canceled() )
          _fetch_updated_peer_lists_loop_done = fc::schedule( [this](){ fetch_updated_peer_lists_loop(); },
@@ -2455,6 +2601,8 @@ namespace graphene { namespace net { namespace detail {
       // ignore unless we asked for the data
       if( originating_peer->item_ids_requested_from_peer )
       {
+        originating_peer->fetch_blockchain_item_ids_latency.record(fc::time_point::now() - originating_peer->item_ids_requested_from_peer->get<1>());
+
         // verify that the peer's the block ids the peer sent is a valid response to our request;
         // It should either be an empty list of blocks, or a list of blocks that builds off of one of 
         // the blocks in the synopsis we sent
@@ -2830,6 +2978,7 @@ namespace graphene { namespace net { namespace detail {
       auto regular_item_iter = originating_peer->items_requested_from_peer.find(requested_item);
       if (regular_item_iter != originating_peer->items_requested_from_peer.end())
       {
+        originating_peer->record_item_not_delivered();
         originating_peer->items_requested_from_peer.erase( regular_item_iter );
         originating_peer->inventory_peer_advertised_to_us.erase( requested_item );
         if (is_item_in_any_peers_inventory(requested_item))
@@ -2874,7 +3023,7 @@ namespace graphene { namespace net { namespace detail {
         bool we_requested_this_item_from_a_peer = false;
         for (const peer_connection_ptr peer : _active_connections)
         {
-          if (peer->inventory_advertised_to_peer.find(advertised_item_id) != peer->inventory_advertised_to_peer.end())
+          if (peer->inventory_advertised_to_peer.contains(advertised_item_id))
           {
             we_advertised_this_item_to_a_peer = true;
             break;
@@ -2893,10 +3042,10 @@ namespace graphene { namespace net { namespace detail {
                originating_peer->is_inventory_advertised_to_us_list_full_for_transactions()) ||
               originating_peer->is_inventory_advertised_to_us_list_full())
             break;
-          originating_peer->inventory_peer_advertised_to_us.insert(peer_connection::timestamped_item_id(advertised_item_id, fc::time_point::now()));
+          originating_peer->inventory_peer_advertised_to_us.insert(advertised_item_id, fc::time_point::now());
           if (!we_requested_this_item_from_a_peer)
           {
-            if (_recently_failed_items.find(item_id(item_ids_inventory_message_received.item_type, item_hash)) != _recently_failed_items.end())
+            if (_recently_failed_items.contains(item_id(item_ids_inventory_message_received.item_type, item_hash)))
             {
               dlog("not adding ${item_hash} to our list of items to fetch because we've recently fetched a copy and it failed to push",
                    ("item_hash", item_hash));
@@ -2989,6 +3138,7 @@ namespace graphene { namespace net { namespace detail {
           if (updated_peer_record)
           {
             updated_peer_record->last_seen_time = fc::time_point::now();
+            updated_peer_record->last_known_score = originating_peer->get_score_for_peer_database();
             _potential_peer_db.update_entry(*updated_peer_record);
           }
         }
@@ -3402,6 +3552,10 @@ namespace graphene { namespace net { namespace detail {
           std::vector<fc::uint160_t> contained_transaction_message_ids;
           _delegate->handle_block(block_message_to_process, false, contained_transaction_message_ids);
           message_validated_time = fc::time_point::now();
+
+          fc::microseconds propagation_delay = message_receive_time - fc::time_point(block_message_to_process.block.timestamp);
+          originating_peer->block_propagation_delay.record(propagation_delay);
+          _block_propagation_delay.record(propagation_delay);
           ilog("Successfully pushed block ${num} (id:${id})",
                 ("num", block_message_to_process.block.block_num())
                 ("id", block_message_to_process.block_id));
@@ -3439,8 +3593,7 @@ namespace graphene { namespace net { namespace detail {
         {
           ASSERT_TASK_NOT_PREEMPTED(); // don't yield while iterating over _active_connections
 
-          auto iter = peer->inventory_peer_advertised_to_us.find(block_message_item_id);
-          if (iter != peer->inventory_peer_advertised_to_us.end())
+          if (peer->inventory_peer_advertised_to_us.contains(block_message_item_id))
           {
             // this peer offered us the item.  It will eventually expire from the peer's
             // inventory_peer_advertised_to_us list after some time has passed (currently 2 minutes).
@@ -3536,6 +3689,7 @@ namespace graphene { namespace net { namespace detail {
       auto item_iter = originating_peer->items_requested_from_peer.find(item_id(graphene::net::block_message_type, message_hash));
       if (item_iter != originating_peer->items_requested_from_peer.end())
       {
+        originating_peer->record_item_delivered(message_to_process.size, fc::time_point::now() - item_iter->second);
         originating_peer->items_requested_from_peer.erase(item_iter);
         process_block_during_normal_operation(originating_peer, block_message_to_process, message_hash);
         if (originating_peer->idle())
@@ -3555,7 +3709,12 @@ namespace graphene { namespace net { namespace detail {
           try
           {
             originating_peer->last_sync_item_received_time = fc::time_point::now();
-            _active_sync_requests.erase(block_message_to_process.block_id);
+            auto active_sync_request_iter = _active_sync_requests.find(block_message_to_process.block_id);
+            if (active_sync_request_iter != _active_sync_requests.end())
+            {
+              originating_peer->record_item_delivered(message_to_process.size, originating_peer->last_sync_item_received_time - active_sync_request_iter->second);
+              _active_sync_requests.erase(active_sync_request_iter);
+            }
             process_block_during_sync(originating_peer, block_message_to_process, message_hash);
             if (originating_peer->idle())
             {
@@ -3622,6 +3781,7 @@ namespace graphene { namespace net { namespace detail {
                                                          (current_time_reply_message_received.reply_transmitted_time - reply_received_time)).count() / 2);
       originating_peer->round_trip_delay = (reply_received_time - current_time_reply_message_received.request_sent_time) -
                                            (current_time_reply_message_received.reply_transmitted_time - current_time_reply_message_received.request_received_time);
+      originating_peer->record_round_trip_delay(originating_peer->round_trip_delay);
     }
 
     void node_impl::forward_firewall_check_to_next_available_peer(firewall_check_state_data* firewall_check_state)
@@ -3886,6 +4046,7 @@ namespace graphene { namespace net { namespace detail {
       }
       else
       {
+        originating_peer->record_item_delivered( message_to_process.size, message_receive_time - iter->second );
         originating_peer->items_requested_from_peer.erase( iter );
         if (originating_peer->idle())
           trigger_fetch_items_loop();
@@ -3912,7 +4073,7 @@ namespace graphene { namespace net { namespace detail {
         {
           wlog( "client rejected message sent by peer ${peer}, ${e}", ("peer", originating_peer->get_remote_endpoint() )("e", e) );
           // record it so we don't try to fetch this item again
-          _recently_failed_items.insert(peer_connection::timestamped_item_id(item_id(message_to_process.msg_type, message_hash ), fc::time_point::now()));
+          _recently_failed_items.insert(item_id(message_to_process.msg_type, message_hash), fc::time_point::now());
           return;
         }
 
@@ -4716,6 +4877,7 @@ namespace graphene { namespace net { namespace detail {
     void node_impl::move_peer_to_active_list(const peer_connection_ptr& peer)
     {
       VERIFY_CORRECT_THREAD();
+      peer->max_transaction_relay_rate = _max_transaction_relay_rate;
       _active_connections.insert(peer);
       _handshaking_connections.erase(peer);
       _closing_connections.erase(peer);
@@ -4806,6 +4968,8 @@ namespace graphene { namespace net { namespace detail {
           if (updated_peer_record)
           {
             updated_peer_record->last_seen_time = fc::time_point::now();
+            // the closed connection won't be active any more when it's reported, remember its score now
+            updated_peer_record->last_known_score = peer_to_disconnect->get_score_for_peer_database();
             if (error)
               updated_peer_record->last_error = error;
             else
@@ -4929,6 +5093,18 @@ namespace graphene { namespace net { namespace detail {
         peer_details["current_head_block_number"] = _delegate->get_block_number(peer->last_block_delegate_has_seen);
         peer_details["current_head_block_time"] = peer->last_block_time_delegate_has_seen;
 
+        peer_details["round_trip_delay"] = peer->round_trip_delay.count();
+        peer_details["score"] = peer->get_score();
+        peer_details["smoothed_round_trip_delay"] = peer->smoothed_round_trip_delay.count();
+        peer_details["delivery_rate"] = peer->get_delivery_rate();
+        peer_details["smoothed_failure_ratio"] = peer->smoothed_failure_ratio;
+        peer_details["transaction_inventory_backlog"] = peer->transaction_inventory_backlog.size();
+        peer_details["message_counters"] = message_counters_to_variant(peer->message_counters);
+        peer_details["send_queue_delay"] = fc::variant( peer->send_queue_delay, 2 );
+        peer_details["fetch_items_latency"] = fc::variant( peer->fetch_items_latency, 2 );
+        peer_details["fetch_blockchain_item_ids_latency"] = fc::variant( peer->fetch_blockchain_item_ids_latency, 2 );
+        peer_details["block_propagation_delay"] = fc::variant( peer->block_propagation_delay, 2 );
+
         this_peer_status.info = peer_details;
         statuses.push_back(this_peer_status);
       }
@@ -5012,6 +5188,16 @@ namespace graphene { namespace net { namespace detail {
         _maximum_number_of_sync_blocks_to_prefetch = params["maximum_number_of_sync_blocks_to_prefetch"].as<uint32_t>(1);
       if (params.contains("maximum_blocks_per_peer_during_syncing"))
         _maximum_blocks_per_peer_during_syncing = params["maximum_blocks_per_peer_during_syncing"].as<uint32_t>(1);
+      if (params.contains("slow_peer_replacement_interval"))
+        _slow_peer_replacement_interval = params["slow_peer_replacement_interval"].as<uint32_t>(1);
+      if (params.contains("inventory_flush_interval_ms"))
+        _inventory_flush_interval_ms = params["inventory_flush_interval_ms"].as<uint32_t>(1);
+      if (params.contains("max_transaction_relay_rate"))
+      {
+        _max_transaction_relay_rate = std::max<uint32_t>(params["max_transaction_relay_rate"].as<uint32_t>(1), 1);
+        for (const peer_connection_ptr& peer : _active_connections)
+          peer->max_transaction_relay_rate = _max_transaction_relay_rate;
+      }
 
       _desired_number_of_connections = std::min(_desired_number_of_connections, _maximum_number_of_connections);
 
@@ -5031,6 +5217,9 @@ namespace graphene { namespace net { namespace detail {
       result["maximum_number_of_blocks_to_handle_at_one_time"] = _maximum_number_of_blocks_to_handle_at_one_time;
       result["maximum_number_of_sync_blocks_to_prefetch"] = _maximum_number_of_sync_blocks_to_prefetch;
       result["maximum_blocks_per_peer_during_syncing"] = _maximum_blocks_per_peer_during_syncing;
+      result["slow_peer_replacement_interval"] = _slow_peer_replacement_interval;
+      result["inventory_flush_interval_ms"] = _inventory_flush_interval_ms;
+      result["max_transaction_relay_rate"] = _max_transaction_relay_rate;
       return result;
     }
 
@@ -5099,6 +5288,19 @@ namespace graphene { namespace net { namespace detail {
       info["node_public_key"] = fc::variant( _node_public_key, 1 );
       info["node_id"] = fc::variant( _node_id, 1 );
       info["firewalled"] = fc::variant( _is_firewalled, 1 );
+
+      std::map<uint32_t, message_type_counters> total_message_counters;
+      for (const peer_connection_ptr& peer : _active_connections)
+        for (const auto& type_and_counters : peer->message_counters)
+        {
+          message_type_counters& totals = total_message_counters[type_and_counters.first];
+          totals.messages_sent += type_and_counters.second.messages_sent;
+          totals.bytes_sent += type_and_counters.second.bytes_sent;
+          totals.messages_received += type_and_counters.second.messages_received;
+          totals.bytes_received += type_and_counters.second.bytes_received;
+        }
+      info["message_counters"] = message_counters_to_variant(total_message_counters);
+      info["block_propagation_delay"] = fc::variant( _block_propagation_delay, 2 );
       return info;
     }
     fc::variant_object node_impl::network_get_usage_stats() const
@@ -5129,6 +5331,12 @@ namespace graphene { namespace net { namespace detail {
       result["usage_by_second"] = fc::variant( network_usage_by_second, 2 );
       result["usage_by_minute"] = fc::variant( network_usage_by_minute, 2 );
       result["usage_by_hour"] = fc::variant( network_usage_by_hour, 2 );
+#ifndef _WIN32
+      // everything the node does runs on this thread
+      timespec thread_cpu_time;
+      if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &thread_cpu_time) == 0)
+        result["thread_cpu_time_us"] = int64_t(thread_cpu_time.tv_sec) * 1000000 + thread_cpu_time.tv_nsec / 1000;
+#endif
       return result;
     }
 
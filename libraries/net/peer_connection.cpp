@@ -31,6 +31,8 @@
 
 #include <boost/scope_exit.hpp>
 
+#include <algorithm>
+
 #ifdef DEFAULT_LOGGER
 # undef DEFAULT_LOGGER
 #endif
@@ -71,6 +73,67 @@ namespace graphene { namespace net
       return sizeof(item_id);
     }
 
+    void latency_counters::record( const fc::microseconds& delay )
+    {
+      int64_t delay_us = delay.count();
+      if( count == 0 || delay_us < min )
+        min = delay_us;
+      if( count == 0 || delay_us > max )
+        max = delay_us;
+      last = delay_us;
+      total += delay_us;
+      ++count;
+      average = total / (int64_t)count;
+    }
+
+    timestamped_item_set::timestamped_item_set(uint32_t bucket_duration_seconds) :
+      _bucket_duration_seconds(std::max<uint32_t>(bucket_duration_seconds, 1)),
+      _first_bucket_sequence(0)
+    {
+    }
+
+    bool timestamped_item_set::insert(const item_id& item, const fc::time_point_sec& timestamp)
+    {
+      if (contains(item))
+        return false;
+      // timestamps are normally nondecreasing; anything older than the newest bucket just goes into it
+      uint32_t bucket_start = timestamp.sec_since_epoch() - timestamp.sec_since_epoch() % _bucket_duration_seconds;
+      if (_buckets.empty() || _buckets.back().start_time < fc::time_point_sec(bucket_start))
+        _buckets.push_back(bucket{fc::time_point_sec(bucket_start), std::vector<item_id>()});
+      _buckets.back().items.push_back(item);
+      _items.emplace(item, _first_bucket_sequence + _buckets.size() - 1);
+      return true;
+    }
+
+    size_t timestamped_item_set::expire(const fc::time_point_sec& oldest_timestamp_to_keep)
+    {
+      size_t number_expired = 0;
+      while (!_buckets.empty() &&
+             _buckets.front().start_time + _bucket_duration_seconds <= oldest_timestamp_to_keep)
+      {
+        for (const item_id& item : _buckets.front().items)
+        {
+          // skip ids that were erased, or erased and then inserted again into a later bucket
+          auto iter = _items.find(item);
+          if (iter != _items.end() && iter->second == _first_bucket_sequence)
+          {
+            _items.erase(iter);
+            ++number_expired;
+          }
+        }
+        _buckets.pop_front();
+        ++_first_bucket_sequence;
+      }
+      return number_expired;
+    }
+
+    void timestamped_item_set::clear()
+    {
+      _first_bucket_sequence += _buckets.size();
+      _buckets.clear();
+      _items.clear();
+    }
+
     peer_connection::peer_connection(peer_connection_delegate* delegate) :
       _node(delegate),
       _message_connection(this),
@@ -88,6 +151,11 @@ namespace graphene { namespace net
       inhibit_fetching_sync_blocks(false),
       transaction_fetching_inhibited_until(fc::time_point::min()),
       last_known_fork_block_number(0),
+      max_transaction_relay_rate(GRAPHENE_NET_MAX_TRX_PER_SECOND),
+      transaction_relay_allowance(0),
+      smoothed_failure_ratio(0),
+      number_of_item_requests_scored(0),
+      replaced_as_slow_peer(false),
       firewall_check_state(nullptr),
 #ifndef NDEBUG
       _thread(&fc::thread::current()),
@@ -272,6 +340,9 @@ namespace graphene { namespace net
       BOOST_SCOPE_EXIT(this_) {
         this_->_currently_handling_message = false;
       } BOOST_SCOPE_EXIT_END
+      message_type_counters& counters = message_counters[received_message.msg_type];
+      ++counters.messages_received;
+      counters.bytes_received += sizeof(message_header) + received_message.size;
       _node->on_message( this, received_message );
     }
 
@@ -294,20 +365,34 @@ namespace graphene { namespace net
 #endif
       while (!_queued_messages.empty())
       {
-        _queued_messages.front()->transmission_start_time = fc::time_point::now();
-        message message_to_send = _queued_messages.front()->get_message(_node);
+        // take as many queued messages as fit in one batch, so they get encrypted and written
+        // to the socket together instead of paying for a cipher call and a write per message
+        std::vector<std::unique_ptr<queued_message> > batch;
+        std::vector<message> messages_to_send;
+        size_t batch_size_in_bytes = 0;
+        do
+        {
+          std::unique_ptr<queued_message> next_message = std::move(_queued_messages.front());
+          _queued_messages.pop();
+          next_message->transmission_start_time = fc::time_point::now();
+          messages_to_send.push_back(next_message->get_message(_node));
+          batch_size_in_bytes += sizeof(message_header) + messages_to_send.back().size;
+          batch.push_back(std::move(next_message));
+        }
+        while (!_queued_messages.empty() && batch_size_in_bytes < GRAPHENE_NET_MAX_SEND_BATCH_SIZE_IN_BYTES);
+
         try
         {
-          //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_message() "
-          //     "to send message of type ${type} for peer ${endpoint}",
-          //     ("type", message_to_send.msg_type)("endpoint", get_remote_endpoint()));
-          _message_connection.send_message(message_to_send);
-          //dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_message() completed normally for peer ${endpoint}",
+          //dlog("peer_connection::send_queued_messages_task() calling message_oriented_connection::send_messages() "
+          //     "to send ${count} messages for peer ${endpoint}",
+          //     ("count", messages_to_send.size())("endpoint", get_remote_endpoint()));
+          _message_connection.send_messages(messages_to_send);
+          //dlog("peer_connection::send_queued_messages_task()'s call to message_oriented_connection::send_messages() completed normally for peer ${endpoint}",
           //     ("endpoint", get_remote_endpoint()));
         }
         catch (const fc::canceled_exception&)
         {
-          dlog("message_oriented_connection::send_message() was canceled, rethrowing canceled_exception");
+          dlog("message_oriented_connection::send_messages() was canceled, rethrowing canceled_exception");
           throw;
         }
         catch (const fc::exception& send_error)
@@ -325,15 +410,22 @@ namespace graphene { namespace net
         }
         catch (const std::exception& e)
         {
-          elog("message_oriented_exception::send_message() threw a std::exception(): ${what}", ("what", e.what()));
+          elog("message_oriented_exception::send_messages() threw a std::exception(): ${what}", ("what", e.what()));
         }
         catch (...)
         {
-          elog("message_oriented_exception::send_message() threw an unhandled exception");
+          elog("message_oriented_exception::send_messages() threw an unhandled exception");
+        }
+        fc::time_point transmission_finish_time = fc::time_point::now();
+        for (size_t i = 0; i < batch.size(); ++i)
+        {
+          batch[i]->transmission_finish_time = transmission_finish_time;
+          send_queue_delay.record(batch[i]->transmission_start_time - batch[i]->enqueue_time);
+          message_type_counters& counters = message_counters[messages_to_send[i].msg_type];
+          ++counters.messages_sent;
+          counters.bytes_sent += sizeof(message_header) + messages_to_send[i].size;
+          _total_queued_messages_size -= batch[i]->get_size_in_queue();
         }
-        _queued_messages.front()->transmission_finish_time = fc::time_point::now();
-        _total_queued_messages_size -= _queued_messages.front()->get_size_in_queue();
-        _queued_messages.pop();
       }
       //dlog("leaving peer_connection::send_queued_messages_task() due to queue exhaustion");
     }
@@ -481,27 +573,22 @@ namespace graphene { namespace net
       fc::time_point_sec oldest_inventory_to_keep(fc::time_point::now() - fc::minutes(GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES));
 
       // expire old items from inventory_advertised_to_peer
-      auto oldest_inventory_to_keep_iter = inventory_advertised_to_peer.get<timestamp_index>().lower_bound(oldest_inventory_to_keep);
-      auto begin_iter = inventory_advertised_to_peer.get<timestamp_index>().begin();
-      unsigned number_of_elements_advertised_to_peer_to_discard = std::distance(begin_iter, oldest_inventory_to_keep_iter);
-      inventory_advertised_to_peer.get<timestamp_index>().erase(begin_iter, oldest_inventory_to_keep_iter);
+      size_t number_of_elements_advertised_to_peer_to_discard = inventory_advertised_to_peer.expire(oldest_inventory_to_keep);
 
       // also expire items from inventory_peer_advertised_to_us
-      oldest_inventory_to_keep_iter = inventory_peer_advertised_to_us.get<timestamp_index>().lower_bound(oldest_inventory_to_keep);
-      begin_iter = inventory_peer_advertised_to_us.get<timestamp_index>().begin();
-      unsigned number_of_elements_peer_advertised_to_discard = std::distance(begin_iter, oldest_inventory_to_keep_iter);
-      inventory_peer_advertised_to_us.get<timestamp_index>().erase(begin_iter, oldest_inventory_to_keep_iter);
-      dlog("Expiring old inventory for peer ${peer}: removing ${to_peer} items advertised to peer (${remain_to_peer} left), and ${to_us} advertised to us (${remain_to_us} left)",
-           ("peer", get_remote_endpoint())
-           ("to_peer", number_of_elements_advertised_to_peer_to_discard)("remain_to_peer", inventory_advertised_to_peer.size())
-           ("to_us", number_of_elements_peer_advertised_to_discard)("remain_to_us", inventory_peer_advertised_to_us.size()));
+      size_t number_of_elements_peer_advertised_to_discard = inventory_peer_advertised_to_us.expire(oldest_inventory_to_keep);
+      if (number_of_elements_advertised_to_peer_to_discard || number_of_elements_peer_advertised_to_discard)
+        dlog("Expiring old inventory for peer ${peer}: removing ${to_peer} items advertised to peer (${remain_to_peer} left), and ${to_us} advertised to us (${remain_to_us} left)",
+             ("peer", get_remote_endpoint())
+             ("to_peer", number_of_elements_advertised_to_peer_to_discard)("remain_to_peer", inventory_advertised_to_peer.size())
+             ("to_us", number_of_elements_peer_advertised_to_discard)("remain_to_us", inventory_peer_advertised_to_us.size()));
     }
 
     // we have a higher limit for blocks than transactions so we will still fetch blocks even when transactions are throttled
     bool peer_connection::is_inventory_advertised_to_us_list_full_for_transactions() const
     {
       VERIFY_CORRECT_THREAD();
-      return inventory_peer_advertised_to_us.size() > GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES * GRAPHENE_NET_MAX_TRX_PER_SECOND * 60;
+      return inventory_peer_advertised_to_us.size() > GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES * max_transaction_relay_rate * 60;
     }
 
     bool peer_connection::is_inventory_advertised_to_us_list_full() const
@@ -511,10 +598,28 @@ namespace graphene { namespace net
       // plus the maximum number of blocks that would be generated in GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES (plus one,
       // to give us some wiggle room)
       return inventory_peer_advertised_to_us.size() >
-        GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES * GRAPHENE_NET_MAX_TRX_PER_SECOND * 60 +
+        GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES * max_transaction_relay_rate * 60 +
         (GRAPHENE_NET_MAX_INVENTORY_SIZE_IN_MINUTES + 1) * 60 / GRAPHENE_MIN_BLOCK_INTERVAL;
     }
 
+    uint32_t peer_connection::claim_transaction_relay_allowance(uint32_t number_wanted)
+    {
+      VERIFY_CORRECT_THREAD();
+      // token bucket, refilled at max_transaction_relay_rate per second and holding at most one second's worth
+      fc::time_point now = fc::time_point::now();
+      if (last_transaction_relay_allowance_update == fc::time_point())
+        transaction_relay_allowance = max_transaction_relay_rate;
+      else
+        transaction_relay_allowance += (double)(now - last_transaction_relay_allowance_update).count() / fc::seconds(1).count() *
+                                       max_transaction_relay_rate;
+      transaction_relay_allowance = std::min<double>(transaction_relay_allowance, max_transaction_relay_rate);
+      last_transaction_relay_allowance_update = now;
+
+      uint32_t number_granted = std::min<uint32_t>(number_wanted, (uint32_t)transaction_relay_allowance);
+      transaction_relay_allowance -= number_granted;
+      return number_granted;
+    }
+
     bool peer_connection::performing_firewall_check() const
     {
       return firewall_check_state && firewall_check_state->requesting_peer != node_id_t();
@@ -527,4 +632,91 @@ namespace graphene { namespace net
       return fc::optional<fc::ip::endpoint>();
     }
 
+    void peer_connection::record_round_trip_delay(const fc::microseconds& delay)
+    {
+      VERIFY_CORRECT_THREAD();
+      fc::microseconds measured_delay = std::max(delay, fc::microseconds(0));
+      if (last_round_trip_measurement_time == fc::time_point())
+        smoothed_round_trip_delay = measured_delay;
+      else
+        smoothed_round_trip_delay = fc::microseconds((int64_t)(GRAPHENE_NET_PEER_SCORE_SMOOTHING_FACTOR * measured_delay.count() +
+                                                               (1 - GRAPHENE_NET_PEER_SCORE_SMOOTHING_FACTOR) * smoothed_round_trip_delay.count()));
+      last_round_trip_measurement_time = fc::time_point::now();
+    }
+
+    void peer_connection::record_item_delivered(size_t item_size, const fc::microseconds& latency, const fc::time_point& now)
+    {
+      VERIFY_CORRECT_THREAD();
+      fetch_items_latency.record(latency);
+      // one entry per second keeps the window small however many items arrive
+      const fc::time_point_sec second(now);
+      if (!recent_deliveries.empty() && recent_deliveries.back().first >= second)
+        recent_deliveries.back().second += item_size;
+      else
+        recent_deliveries.emplace_back(second, item_size);
+      while (recent_deliveries.front().first + GRAPHENE_NET_PEER_SCORE_DELIVERY_WINDOW <= second)
+        recent_deliveries.pop_front();
+      smoothed_failure_ratio = (1 - GRAPHENE_NET_PEER_SCORE_SMOOTHING_FACTOR) * smoothed_failure_ratio;
+      ++number_of_item_requests_scored;
+    }
+
+    void peer_connection::record_item_not_delivered()
+    {
+      VERIFY_CORRECT_THREAD();
+      smoothed_failure_ratio = GRAPHENE_NET_PEER_SCORE_SMOOTHING_FACTOR +
+                               (1 - GRAPHENE_NET_PEER_SCORE_SMOOTHING_FACTOR) * smoothed_failure_ratio;
+      ++number_of_item_requests_scored;
+    }
+
+    double peer_connection::get_delivery_rate(const fc::time_point& now) const
+    {
+      const fc::time_point_sec window_start = fc::time_point_sec(now) - GRAPHENE_NET_PEER_SCORE_DELIVERY_WINDOW;
+      uint64_t bytes = 0;
+      for (const auto& delivery : recent_deliveries)
+        if (delivery.first > window_start)
+          bytes += delivery.second;
+      // a peer connected for less than the window is judged over the time it has been connected
+      const int64_t window_us = fc::seconds(GRAPHENE_NET_PEER_SCORE_DELIVERY_WINDOW).count();
+      const int64_t span_us = std::min(window_us, std::max((now - get_connection_time()).count(), fc::seconds(1).count()));
+      return bytes * 1000000.0 / span_us;
+    }
+
+    double peer_connection::get_score(const fc::time_point& now) const
+    {
+      double round_trip_delay_ms = last_round_trip_measurement_time == fc::time_point() ?
+                                   GRAPHENE_NET_PEER_SCORE_DEFAULT_ROUND_TRIP_DELAY_MS :
+                                   smoothed_round_trip_delay.count() / 1000.0;
+      double latency_factor = 1.0 / (1.0 + round_trip_delay_ms / GRAPHENE_NET_PEER_SCORE_ROUND_TRIP_DELAY_SCALE_MS);
+      double throughput_factor = 1.0 + get_delivery_rate(now) / GRAPHENE_NET_PEER_SCORE_DELIVERY_RATE_SCALE;
+      return (1.0 - smoothed_failure_ratio) * latency_factor * throughput_factor;
+    }
+
+    double peer_connection::get_score_for_peer_database() const
+    {
+      return replaced_as_slow_peer ? GRAPHENE_NET_REPLACED_PEER_SCORE : get_score();
+    }
+
+    peer_connection_ptr find_slow_peer(const std::vector<peer_connection_ptr>& peers, const fc::time_point& connected_before,
+                                       const fc::time_point& now)
+    {
+      // only judge peers we've been in normal operation with long enough to have a meaningful score
+      std::vector<std::pair<double, peer_connection_ptr> > scored_peers;
+      for (const peer_connection_ptr& peer : peers)
+        if (!peer->we_need_sync_items_from_peer &&
+            peer->number_of_item_requests_scored >= GRAPHENE_NET_PEER_SCORE_MIN_SAMPLES &&
+            peer->get_connection_time() < connected_before)
+          scored_peers.emplace_back(peer->get_score(now), peer);
+      if (scored_peers.size() < 3)
+        return peer_connection_ptr();
+
+      std::sort(scored_peers.begin(), scored_peers.end(),
+                [](const std::pair<double, peer_connection_ptr>& lhs, const std::pair<double, peer_connection_ptr>& rhs) {
+                  return lhs.first < rhs.first;
+                });
+      double median_score = scored_peers[scored_peers.size() / 2].first;
+      if (scored_peers.front().first >= median_score * GRAPHENE_NET_SLOW_PEER_SCORE_RATIO)
+        return peer_connection_ptr();
+      return scored_peers.front().second;
+    }
+
 } } // end namespace graphene::net
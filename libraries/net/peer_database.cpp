@@ -21,6 +21,8 @@
  * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
  * THE SOFTWARE.
  */
+#include <algorithm>
+
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/hashed_index.hpp>
@@ -72,6 +74,7 @@ namespace graphene { namespace net {
       void update_entry(const potential_peer_record& updatedRecord);
       potential_peer_record lookup_or_create_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
       fc::optional<potential_peer_record> lookup_entry_for_endpoint(const fc::ip::endpoint& endpointToLookup);
+      std::vector<potential_peer_record> get_records_ranked_by_score() const;
 
       peer_database::iterator begin() const;
       peer_database::iterator end() const;
@@ -173,6 +176,18 @@ namespace graphene { namespace net {
       return fc::optional<potential_peer_record>();
     }
 
+    std::vector<potential_peer_record> peer_database_impl::get_records_ranked_by_score() const
+    {
+      std::vector<potential_peer_record> ranked_records(_potential_peer_set.begin(), _potential_peer_set.end());
+      std::stable_sort(ranked_records.begin(), ranked_records.end(),
+                       [](const potential_peer_record& lhs, const potential_peer_record& rhs) {
+                         if (lhs.last_known_score != rhs.last_known_score)
+                           return lhs.last_known_score > rhs.last_known_score;
+                         return lhs.last_seen_time > rhs.last_seen_time;
+                       });
+      return ranked_records;
+    }
+
     peer_database::iterator peer_database_impl::begin() const
     {
       return peer_database::iterator(new peer_database_iterator_impl(_potential_peer_set.get<last_seen_time_index>().begin()));
@@ -261,6 +276,11 @@ namespace graphene { namespace net {
     return my->lookup_entry_for_endpoint(endpoint_to_lookup);
   }
 
+  std::vector<potential_peer_record> peer_database::get_records_ranked_by_score() const
+  {
+    return my->get_records_ranked_by_score();
+  }
+
   peer_database::iterator peer_database::begin() const
   {
     return my->begin();
@@ -36,11 +36,26 @@
 #include <fc/smart_ref_impl.hpp>
 #include <fc/thread/thread.hpp>
 
+#include <atomic>
+#include <deque>
+#include <mutex>
+
 namespace graphene { namespace account_history {
 
 namespace detail
 {
 
+struct pending_operation
+{
+   operation_history_object   op;
+   flat_set<account_uid_type> accounts;
+};
+
+struct pending_block
+{
+   uint32_t                   block_num = 0;
+   vector<pending_operation>  operations;
+};
 
 class account_history_plugin_impl
 {
@@ -61,14 +76,82 @@ class account_history_plugin_impl
          return _self.database();
       }
 
+      /// Runs @p f on the indexing thread, which owns the store and the pending blocks, and waits for it
+      template<typename Functor>
+      auto run_on_store_thread( Functor&& f ) -> decltype( f() )
+      {
+         if( !_thread )
+            return f();
+         return _thread->async( std::forward<Functor>( f ), "account history store" ).wait();
+      }
+
+      /**
+       * Runs the query @p f like run_on_store_thread, ahead of the blocks waiting to be indexed, so
+       * it is answered as of get_indexed_block_num() instead of waiting for them.  A queued block that
+       * replaces a popped one is waited for, the popped one would be returned in its place.
+       */
+      template<typename Functor>
+      auto run_query( Functor&& f ) -> decltype( f() )
+      {
+         FC_ASSERT( !_store_failed, "Account history indexing has stopped: ${e}", ("e", get_store_error()) );
+         if( !_thread )
+            return f();
+         const fc::priority prio = _queued_replacements > 0 ? fc::priority() : fc::priority::max();
+         return _thread->async( std::forward<Functor>( f ), "account history query", prio ).wait();
+      }
+
+      /// @return why indexing has stopped, empty while it goes on
+      string get_store_error()const
+      {
+         std::lock_guard<std::mutex> lock( _store_error_mutex );
+         return _store_error;
+      }
+
+      /// Opens the account history store in _store_dir
+      void open_store();
+      /// Moves the operations of pending blocks up to @p last_block_num into the store
+      void flush_store( uint32_t last_block_num );
+      /// @return operations of pending blocks up to @p head_block_num that apply to @p account, oldest first
+      vector<const operation_history_object*> get_pending_operations( account_uid_type account, uint32_t head_block_num );
+
       account_history_plugin& _self;
       flat_set<account_uid_type> _tracked_accounts;
       bool _partial_operations = false;
       primary_index< operation_history_index >* _oho_index;
       uint32_t _max_ops_per_account = -1;
+
+      /// blocks handed to the indexing thread and not indexed yet, above this block application waits
+      static const uint32_t max_queued_blocks = 1000;
+
+      bool _store_enabled = false;
+      size_t _store_cache_pages = 16384;
+      fc::path _store_dir;
+      /// indexes blocks into the store, if account-history-async is on
+      std::unique_ptr<fc::thread> _thread;
+      std::atomic<uint32_t> _queued_blocks{ 0 };
+      /// queued blocks with a number not above one queued before, i.e. after a block was popped
+      std::atomic<uint32_t> _queued_replacements{ 0 };
+      /// the last block handed to the indexing thread, only used on the application thread
+      uint32_t _last_queued_block_num = 0;
+      std::atomic<uint32_t> _indexed_block_num{ 0 };
+      std::atomic<uint32_t> _stored_block_num{ 0 };
+      /// set when a block could not be indexed, nothing is indexed afterwards and queries fail
+      std::atomic<bool> _store_failed{ false };
+      string _store_error;
+      mutable std::mutex _store_error_mutex;
+
+      // only used on the indexing thread
+      std::unique_ptr<account_history_store> _store;
+      /// reversible blocks, their operations go to the store once they become irreversible
+      std::deque<pending_block> _pending_blocks;
    private:
+      static flat_set<account_uid_type> get_impacted_accounts( const operation_history_object& op );
+      /** record the operations of a block in the history store instead of the object database */
+      void store_account_histories( const signed_block& b );
+      void index_block( pending_block& block, uint32_t irreversible_block_num, bool commit );
       /** add one history record, then check and remove the earliest history record */
-      void add_account_history( const account_uid_type account_uid, const operation_history_id_type op_id, uint16_t op_type );
+      void add_account_history( const account_uid_type account_uid, const operation_history_id_type op_id, uint16_t op_type,
+                                uint32_t block_num );
 };
 
 account_history_plugin_impl::~account_history_plugin_impl()
@@ -76,9 +159,35 @@ account_history_plugin_impl::~account_history_plugin_impl()
    return;
 }
 
+flat_set<account_uid_type> account_history_plugin_impl::get_impacted_accounts( const operation_history_object& op )
+{
+   flat_set<account_uid_type> impacted_uids;
+   vector<authority> other;
+   operation_get_required_uid_authorities( op.op, impacted_uids, impacted_uids, impacted_uids, other,true);
+
+   graphene::chain::operation_get_impacted_account_uids( op.op, impacted_uids );
+
+   for( auto& a : other )
+      for( auto& item : a.account_uid_auths )
+         impacted_uids.insert( item.first.uid );
+
+   if (op.result.which() == operation_result::tag<advertising_confirm_result>::value)
+   {
+      auto result = op.result.get< advertising_confirm_result >();
+      for (auto& r : result)
+         impacted_uids.insert(r.first);
+   }
+   return impacted_uids;
+}
+
 void account_history_plugin_impl::update_account_histories( const signed_block& b )
 {
    graphene::chain::database& db = database();
+   if( _store_enabled )
+   {
+      store_account_histories( b );
+      return;
+   }
    const vector<optional< operation_history_object > >& hist = db.get_applied_operations();
    bool is_first = true;
    auto skip_oho_id = [&is_first,&db,this]() {
@@ -121,25 +230,8 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
       else if( !_partial_operations )  // add to the operation history index
          oho = create_oho();
 
-      const operation_history_object& op = *o_op;
-
       // get the set of accounts this operation applies to
-      flat_set<account_uid_type> impacted_uids;
-      vector<authority> other;
-      operation_get_required_uid_authorities( op.op, impacted_uids, impacted_uids, impacted_uids, other,true);
-
-      graphene::chain::operation_get_impacted_account_uids( op.op, impacted_uids );
-
-      for( auto& a : other )
-         for( auto& item : a.account_uid_auths )
-            impacted_uids.insert( item.first.uid );
-
-      if (op.result.which() == operation_result::tag<advertising_confirm_result>::value)
-      {
-         auto result = op.result.get< advertising_confirm_result >();
-         for (auto& r : result)
-            impacted_uids.insert(r.first);
-      }
+      const flat_set<account_uid_type> impacted_uids = get_impacted_accounts( *o_op );
 
       // for each operation this account applies to that is in the config link it into the history
       if( _tracked_accounts.size() == 0 )
@@ -158,7 +250,7 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
                 // that indexing now happens in observers' post_evaluate()
 
                 // add history
-                add_account_history( account_uid, oho->id, oho->op.which() );
+                add_account_history( account_uid, oho->id, oho->op.which(), oho->block_num );
             }
       }
       else   // tracking a subset of accounts
@@ -177,7 +269,7 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
                {
                   if (!oho.valid()) { oho = create_oho(); }
                   // add history
-                  add_account_history( account_uid, oho->id, oho->op.which() );
+                  add_account_history( account_uid, oho->id, oho->op.which(), oho->block_num );
                }
             }
          }
@@ -187,7 +279,8 @@ void account_history_plugin_impl::update_account_histories( const signed_block&
    }
 }
 
-void account_history_plugin_impl::add_account_history( const account_uid_type account_uid, const operation_history_id_type op_id, uint16_t op_type )
+void account_history_plugin_impl::add_account_history( const account_uid_type account_uid, const operation_history_id_type op_id, uint16_t op_type,
+                                                       uint32_t block_num )
 {
    graphene::chain::database& db = database();
    const auto& account_obj = db.get_account_by_uid(account_uid);
@@ -198,6 +291,7 @@ void account_history_plugin_impl::add_account_history( const account_uid_type ac
        obj.operation_type = op_type;
        obj.account = account_uid;
        obj.sequence = stats_obj.total_ops + 1;
+       obj.block_num = block_num;
        obj.next = stats_obj.most_recent_op;
    });
    db.modify( stats_obj, [&]( _account_statistics_object& obj ){
@@ -248,6 +342,165 @@ void account_history_plugin_impl::add_account_history( const account_uid_type ac
    }
 }
 
+void account_history_plugin_impl::open_store()
+{
+   _store.reset( new account_history_store( _store_cache_pages ) );
+   _store->open( _store_dir );
+}
+
+void account_history_plugin_impl::store_account_histories( const signed_block& b )
+{
+   graphene::chain::database& db = database();
+   if( _store_dir == fc::path() )
+      _store_dir = db.get_data_dir() / "database" / "account_history";
+
+   // the indexing thread must not touch the database, so it gets a copy of everything it needs
+   auto block = std::make_shared< pending_block >();
+   block->block_num = b.block_num();
+   for( const optional< operation_history_object >& o_op : db.get_applied_operations() )
+   {
+      if( !o_op.valid() )
+         continue;
+
+      flat_set<account_uid_type> accounts = get_impacted_accounts( *o_op );
+      if( !_tracked_accounts.empty() )
+      {
+         flat_set<account_uid_type> tracked;
+         for( auto account_uid : accounts )
+            if( _tracked_accounts.find( account_uid ) != _tracked_accounts.end() )
+               tracked.insert( account_uid );
+         accounts = std::move( tracked );
+      }
+      if( accounts.empty() )
+         continue;
+
+      // keep the statistics as without the store, there is no history object for most_recent_op
+      // to point to, so it holds the sequence of the newest operation of the account instead
+      for( auto account_uid : accounts )
+      {
+         db.modify( db.get_account_statistics_by_uid( account_uid ), [&]( _account_statistics_object& obj ){
+            ++obj.total_ops;
+            obj.most_recent_op = account_transaction_history_id_type( obj.total_ops );
+         });
+      }
+
+      block->operations.emplace_back();
+      pending_operation& pending = block->operations.back();
+      pending.op = *o_op;
+      pending.accounts = std::move( accounts );
+   }
+
+   const uint32_t irreversible_block_num = db.get_dynamic_global_properties().last_irreversible_block_num;
+   // while catching up commit from time to time only, every commit rewrites the state file
+   const bool commit = block->block_num % 1000 == 0 || fc::time_point::now() - fc::time_point( b.timestamp ) < fc::minutes( 1 );
+
+   if( !_thread )
+   {
+      index_block( *block, irreversible_block_num, commit );
+      return;
+   }
+
+   const bool replacement = block->block_num <= _last_queued_block_num;
+   _last_queued_block_num = block->block_num;
+   if( replacement )
+      ++_queued_replacements;
+   ++_queued_blocks;
+   auto task = _thread->async( [this,block,irreversible_block_num,commit,replacement]() {
+      index_block( *block, irreversible_block_num, commit );
+      if( replacement )
+         --_queued_replacements;
+      --_queued_blocks;
+   }, "account history indexing" );
+   // don't let the queue grow without bound while replaying or syncing
+   if( _queued_blocks > max_queued_blocks )
+      task.wait();
+}
+
+void account_history_plugin_impl::index_block( pending_block& block, uint32_t irreversible_block_num, bool commit )
+{
+   // after a failure the history would have a gap, so nothing more is indexed
+   if( _store_failed )
+      return;
+   try {
+   if( !_store )
+      open_store();
+
+   const uint32_t block_num = block.block_num;
+   // blocks of the store are applied again when replaying
+   if( block_num > _store->last_block_num() )
+   {
+      // on a fork switch the blocks after the fork point are applied again
+      while( !_pending_blocks.empty() && _pending_blocks.back().block_num >= block_num )
+         _pending_blocks.pop_back();
+
+      uint64_t next_operation = _store->operation_count();
+      for( const auto& pending : _pending_blocks )
+         next_operation += pending.operations.size();
+      for( auto& pending : block.operations )
+         pending.op.id = operation_history_id_type( next_operation++ );
+      _pending_blocks.push_back( std::move( block ) );
+
+      flush_store( irreversible_block_num );
+      if( commit )
+         _store->commit();
+   }
+   _indexed_block_num = block_num;
+   _stored_block_num = _store->last_block_num();
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Account history indexing stopped at block ${b}: ${e}", ("b", block.block_num)("e", e.to_detail_string()) );
+      {
+         std::lock_guard<std::mutex> lock( _store_error_mutex );
+         _store_error = e.to_string();
+      }
+      _store_failed = true;
+   }
+   catch( const std::exception& e )
+   {
+      elog( "Account history indexing stopped at block ${b}: ${e}", ("b", block.block_num)("e", e.what()) );
+      {
+         std::lock_guard<std::mutex> lock( _store_error_mutex );
+         _store_error = e.what();
+      }
+      _store_failed = true;
+   }
+}
+
+void account_history_plugin_impl::flush_store( uint32_t last_block_num )
+{
+   while( !_pending_blocks.empty() && _pending_blocks.front().block_num <= last_block_num )
+   {
+      const pending_block& block = _pending_blocks.front();
+      for( const auto& pending : block.operations )
+      {
+         const uint64_t operation = _store->append_operation( pending.op );
+         for( auto account_uid : pending.accounts )
+            _store->append_account_operation( account_uid, operation, pending.op.op.which() );
+      }
+      _store->set_last_block_num( block.block_num );
+      _pending_blocks.pop_front();
+   }
+}
+
+vector<const operation_history_object*> account_history_plugin_impl::get_pending_operations( account_uid_type account,
+                                                                                           uint32_t head_block_num )
+{
+   // blocks popped without a replacement yet must not show up
+   vector<const operation_history_object*> result;
+   for( const auto& block : _pending_blocks )
+   {
+      if( block.block_num > head_block_num )
+         break;
+      for( const auto& pending : block.operations )
+         if( pending.accounts.find( account ) != pending.accounts.end() )
+            result.push_back( &pending.op );
+   }
+   return result;
+}
+
+const uint32_t account_history_plugin_impl::max_queued_blocks;
+
 } // end namespace detail
 
 
@@ -278,6 +531,12 @@ void account_history_plugin::plugin_set_program_options(
          ("track-account", boost::program_options::value<string>()->default_value("[]"), "Account ID to track history for (specified as a JSON array)")
          ("partial-operations", boost::program_options::value<bool>(), "Keep only those operations in memory that are related to account history tracking")
          ("max-ops-per-account", boost::program_options::value<uint32_t>(), "Maximum number of operations per account will be kept in memory")
+         ("account-history-store", boost::program_options::value<bool>()->default_value(false),
+          "Keep the account history of irreversible blocks on disk instead of in memory")
+         ("account-history-store-cache-pages", boost::program_options::value<uint32_t>()->default_value(16384),
+          "Pages of 1KB of the account history store to keep cached in memory")
+         ("account-history-async", boost::program_options::value<bool>()->default_value(true),
+          "Index account history into the store on a separate thread instead of while applying blocks")
          ;
    cfg.add(cli);
 }
@@ -295,10 +554,230 @@ void account_history_plugin::plugin_initialize(const boost::program_options::var
    if (options.count("max-ops-per-account")) {
        my->_max_ops_per_account = options["max-ops-per-account"].as<uint32_t>();
    }
+   if (options.count("account-history-store")) {
+       my->_store_enabled = options["account-history-store"].as<bool>();
+   }
+   if (options.count("account-history-store-cache-pages")) {
+       my->_store_cache_pages = options["account-history-store-cache-pages"].as<uint32_t>();
+   }
+   if( my->_store_enabled && options.count("account-history-async") && options["account-history-async"].as<bool>() )
+      my->_thread.reset( new fc::thread( "account_history" ) );
 }
 
 void account_history_plugin::plugin_startup()
 {
+   if( !my->_store_enabled )
+      return;
+   if( my->_store_dir == fc::path() )
+      my->_store_dir = database().get_data_dir() / "database" / "account_history";
+   const uint32_t stored_block_num = my->run_on_store_thread( [this]() -> uint32_t {
+      if( !my->_store )
+         my->open_store();
+      my->_stored_block_num = my->_store->last_block_num();
+      if( my->_indexed_block_num < my->_stored_block_num )
+         my->_indexed_block_num = my->_stored_block_num.load();
+      return my->_store->last_block_num();
+   } );
+   FC_ASSERT( stored_block_num <= database().head_block_num(),
+              "The account history store is ahead of the chain, remove ${d} to rebuild it", ("d", my->_store_dir) );
+}
+
+void account_history_plugin::plugin_shutdown()
+{
+   if( !my->_store_enabled )
+      return;
+   // the database rewinds to the last irreversible block when it is closed, so the blocks after it
+   // are applied again on the next start and must not be in the store
+   const uint32_t irreversible_block_num = database().get_dynamic_global_properties().last_irreversible_block_num;
+   my->run_on_store_thread( [this,irreversible_block_num]() {
+      if( !my->_store )
+         return;
+      my->flush_store( irreversible_block_num );
+      my->_store->close();
+   } );
+   if( my->_thread )
+   {
+      my->_thread->quit();
+      my->_thread.reset();
+   }
+}
+
+bool account_history_plugin::has_history_store()const
+{
+   return my->_store_enabled;
+}
+
+uint32_t account_history_plugin::get_indexed_block_num()const
+{
+   const uint32_t head_block_num = app().chain_database()->head_block_num();
+   if( !my->_store_enabled )
+      return head_block_num;
+   // popped blocks stay indexed until their replacements are, but are not returned by queries
+   return std::min<uint32_t>( my->_indexed_block_num, head_block_num );
+}
+
+string account_history_plugin::get_indexing_error()const
+{
+   return my->get_store_error();
+}
+
+uint32_t account_history_plugin::get_stored_block_num()const
+{
+   return my->_stored_block_num;
+}
+
+uint32_t account_history_plugin::get_account_operation_count( account_uid_type account )const
+{
+   const uint32_t head_block_num = app().chain_database()->head_block_num();
+   return my->run_query( [this,account,head_block_num]() -> uint32_t {
+      if( !my->_store )
+         return 0;
+      return my->_store->account_operation_count( account ) + my->get_pending_operations( account, head_block_num ).size();
+   } );
+}
+
+vector<std::pair<uint32_t,operation_history_object>> account_history_plugin::get_account_operations(
+      account_uid_type account, optional<uint16_t> op_type, uint32_t start, uint32_t stop, uint32_t limit )const
+{
+   typedef vector<std::pair<uint32_t,operation_history_object>> result_type;
+   const uint32_t head_block_num = app().chain_database()->head_block_num();
+   return my->run_query( [=]() -> result_type {
+      result_type result;
+      if( !my->_store || limit == 0 )
+         return result;
+
+      const uint32_t stored = my->_store->account_operation_count( account );
+      const vector<const operation_history_object*> pending = my->get_pending_operations( account, head_block_num );
+      const uint32_t total = stored + pending.size();
+      const uint32_t first = ( start == 0 || start > total ) ? total : start;
+
+      for( uint32_t sequence = first; sequence >= std::max<uint32_t>( stop, 1 ) && result.size() < limit; --sequence )
+      {
+         if( sequence > stored )
+         {
+            const operation_history_object& op = *pending[ sequence - stored - 1 ];
+            if( !op_type.valid() || op.op.which() == *op_type )
+               result.push_back( std::make_pair( sequence, op ) );
+            continue;
+         }
+         const auto entry = my->_store->get_account_entry( account, sequence );
+         if( !op_type.valid() || entry.op_type == *op_type )
+            result.push_back( std::make_pair( sequence, my->_store->get_operation( entry.operation ) ) );
+      }
+      return result;
+   } );
+}
+
+vector<operation_history_object> account_history_plugin::get_account_operations_by_id( account_uid_type account,
+                                                                                      optional<uint16_t> op_type,
+                                                                                      operation_history_id_type stop,
+                                                                                      uint32_t limit,
+                                                                                      operation_history_id_type start )const
+{
+   typedef vector<operation_history_object> result_type;
+   const uint32_t head_block_num = app().chain_database()->head_block_num();
+   return my->run_query( [=]() -> result_type {
+      result_type result;
+      if( !my->_store || limit == 0 )
+         return result;
+
+      const uint32_t stored = my->_store->account_operation_count( account );
+      const vector<const operation_history_object*> pending = my->get_pending_operations( account, head_block_num );
+      const uint32_t total = stored + pending.size();
+      const auto get_operation_id = [&]( uint32_t sequence ) -> uint64_t {
+         if( sequence > stored )
+            return pending[ sequence - stored - 1 ]->id.instance.value;
+         return my->_store->get_account_entry( account, sequence ).operation;
+      };
+      // the ids of the operations of an account go up with the sequence, so the number of
+      // operations with ids up to a given one is found with a binary search
+      const auto count_up_to = [&]( uint64_t id ) -> uint32_t {
+         uint32_t low = 0;
+         uint32_t high = total;
+         while( low < high )
+         {
+            const uint32_t middle = high - ( high - low ) / 2;
+            if( get_operation_id( middle ) <= id )
+               low = middle;
+            else
+               high = middle - 1;
+         }
+         return low;
+      };
+
+      const uint32_t first = start == operation_history_id_type() ? total : count_up_to( start.instance.value );
+      const uint32_t last = count_up_to( stop.instance.value ) + 1;
+      for( uint32_t sequence = first; sequence >= last && result.size() < limit; --sequence )
+      {
+         if( sequence > stored )
+         {
+            const operation_history_object& op = *pending[ sequence - stored - 1 ];
+            if( !op_type.valid() || op.op.which() == *op_type )
+               result.push_back( op );
+            continue;
+         }
+         const auto entry = my->_store->get_account_entry( account, sequence );
+         if( !op_type.valid() || entry.op_type == *op_type )
+            result.push_back( my->_store->get_operation( entry.operation ) );
+      }
+      return result;
+   } );
+}
+
+vector<std::pair<uint32_t,operation_history_object>> account_history_plugin::get_account_operations_by_block(
+      account_uid_type account, optional<uint16_t> op_type, uint32_t start_block, uint32_t end_block,
+      uint32_t first_sequence, uint32_t limit )const
+{
+   typedef vector<std::pair<uint32_t,operation_history_object>> result_type;
+   const uint32_t head_block_num = app().chain_database()->head_block_num();
+   return my->run_query( [=]() -> result_type {
+      result_type result;
+      if( !my->_store || limit == 0 || start_block >= end_block )
+         return result;
+
+      const uint32_t stored = my->_store->account_operation_count( account );
+      const vector<const operation_history_object*> pending = my->get_pending_operations( account, head_block_num );
+      const uint32_t total = stored + pending.size();
+      const auto get_block_num = [&]( uint32_t sequence ) -> uint32_t {
+         if( sequence > stored )
+            return pending[ sequence - stored - 1 ]->block_num;
+         return my->_store->get_operation_block_num( my->_store->get_account_entry( account, sequence ).operation );
+      };
+
+      // the blocks of the operations of an account go up with the sequence
+      uint32_t low = std::max<uint32_t>( first_sequence, 1 );
+      if( first_sequence == 0 )
+      {
+         uint32_t high = total + 1;
+         while( low < high )
+         {
+            const uint32_t middle = low + ( high - low ) / 2;
+            if( get_block_num( middle ) < start_block )
+               low = middle + 1;
+            else
+               high = middle;
+         }
+      }
+
+      for( uint32_t sequence = low; sequence <= total && result.size() < limit; ++sequence )
+      {
+         if( sequence > stored )
+         {
+            const operation_history_object& op = *pending[ sequence - stored - 1 ];
+            if( op.block_num >= end_block )
+               break;
+            if( !op_type.valid() || op.op.which() == *op_type )
+               result.push_back( std::make_pair( sequence, op ) );
+            continue;
+         }
+         const auto entry = my->_store->get_account_entry( account, sequence );
+         if( my->_store->get_operation_block_num( entry.operation ) >= end_block )
+            break;
+         if( !op_type.valid() || entry.op_type == *op_type )
+            result.push_back( std::make_pair( sequence, my->_store->get_operation( entry.operation ) ) );
+      }
+      return result;
+   } );
 }
 
 flat_set<account_uid_type> account_history_plugin::tracked_accounts() const
@@ -0,0 +1,375 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/account_history/account_history_store.hpp>
+
+#include <fc/io/fstream.hpp>
+#include <fc/io/raw.hpp>
+#include <fc/smart_ref_impl.hpp>
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <iterator>
+
+namespace graphene { namespace account_history {
+
+namespace {
+   void open_stream( std::fstream& stream, const fc::path& file )
+   {
+      stream.exceptions( std::ios_base::failbit | std::ios_base::badbit );
+      if( !fc::exists( file ) )
+         stream.open( file.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc );
+      else
+         stream.open( file.generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+   }
+
+   /// Cuts off whatever was appended to @p file after the last commit
+   void truncate_file( const fc::path& file, uint64_t size )
+   {
+      if( fc::exists( file ) && fc::file_size( file ) > size )
+         boost::filesystem::resize_file( boost::filesystem::path( file.generic_string() ), size );
+   }
+}
+
+const uint32_t account_history_store::entries_per_page;
+
+account_history_store::account_history_store( size_t cache_pages )
+   : _cache_pages( std::max<size_t>( cache_pages, 1 ) )
+{
+   static_assert( sizeof( history_page ) == 1024, "history_page must fill 1KB" );
+}
+
+account_history_store::~account_history_store()
+{
+   if( is_open() )
+      close();
+}
+
+void account_history_store::open( const fc::path& dir )
+{ try {
+   fc::create_directories( dir );
+   _dir = dir;
+   _state = store_state();
+   if( fc::exists( _dir / "state" ) )
+   {
+      std::string data;
+      fc::read_file_contents( _dir / "state", data );
+      _state = fc::raw::unpack<store_state>( std::vector<char>( data.begin(), data.end() ) );
+   }
+
+   truncate_file( _dir / "operations", _state.log_size );
+   truncate_file( _dir / "operations.index", _state.operation_count * sizeof( uint64_t ) );
+   truncate_file( _dir / "operations.blocks", _state.operation_count * sizeof( uint32_t ) );
+   const bool has_block_index = fc::exists( _dir / "operations.blocks" )
+         && fc::file_size( _dir / "operations.blocks" ) == _state.operation_count * sizeof( uint32_t );
+   truncate_file( _dir / "accounts", uint64_t( _state.page_count ) * sizeof( history_page ) );
+   truncate_file( _dir / "accounts.directory", uint64_t( _state.page_count ) * sizeof( uint64_t ) );
+   const bool has_directory = fc::exists( _dir / "accounts.directory" )
+         && fc::file_size( _dir / "accounts.directory" ) == uint64_t( _state.page_count ) * sizeof( uint64_t );
+
+   open_stream( _log, _dir / "operations" );
+   open_stream( _log_index, _dir / "operations.index" );
+   open_stream( _block_index, _dir / "operations.blocks" );
+   open_stream( _pages, _dir / "accounts" );
+   open_stream( _directory, _dir / "accounts.directory" );
+
+   if( !has_block_index )
+      rebuild_block_index();
+   if( _state.pages_written || !has_directory )
+      recover();
+   else
+      load_directory();
+   _committed = _state;
+   ilog( "Opened account history store at block ${b} with ${o} operations of ${a} accounts",
+         ("b", _state.last_block_num)("o", _state.operation_count)("a", _accounts.size()) );
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+void account_history_store::load_directory()
+{
+   _accounts.clear();
+   std::vector<uint64_t> directory( _state.page_count );
+   _directory.seekg( 0 );
+   _directory.read( (char*)directory.data(), directory.size() * sizeof( uint64_t ) );
+   for( uint32_t page_num = 0; page_num < directory.size(); ++page_num )
+      _accounts[ directory[page_num] ].pages.push_back( page_num );
+}
+
+void account_history_store::recover()
+{
+   // read all pages to rebuild the directory, dropping entries of operations that were
+   // appended after the last commit
+   wlog( "Reading all ${n} pages of the account history store", ("n", _state.page_count) );
+   _accounts.clear();
+   const uint64_t committed = _state.operation_count;
+   history_page page;
+   for( uint32_t page_num = 0; page_num < _state.page_count; ++page_num )
+   {
+      _pages.seekg( uint64_t( page_num ) * sizeof( page ) );
+      _pages.read( (char*)&page, sizeof( page ) );
+      FC_ASSERT( page.used <= entries_per_page, "Corrupted account history page ${p}", ("p", page_num) );
+
+      uint32_t used = page.used;
+      while( used > 0 && ( page.entries[used - 1] >> 16 ) >= committed )
+         --used;
+      if( used != page.used )
+      {
+         page.used = used;
+         write_page( page_num, page );
+      }
+
+      account_pages& pages = _accounts[ page.account ];
+      FC_ASSERT( pages.pages.size() == page.page_in_account, "Account history pages out of order at page ${p}",
+                 ("p", page_num) );
+      pages.pages.push_back( page_num );
+      pages.count = page.page_in_account * entries_per_page + used;
+      pages.count_known = true;
+      _directory.seekp( uint64_t( page_num ) * sizeof( uint64_t ) );
+      _directory.write( (const char*)&page.account, sizeof( uint64_t ) );
+   }
+   _pages.flush();
+   _directory.flush();
+   _state.pages_written = false;
+   write_state( _state );
+}
+
+void account_history_store::rebuild_block_index()
+{
+   wlog( "Reading all ${n} operations of the account history store", ("n", _state.operation_count) );
+   for( uint64_t operation = 0; operation < _state.operation_count; ++operation )
+   {
+      const uint32_t block_num = get_operation( operation ).block_num;
+      _block_index.seekp( operation * sizeof( uint32_t ) );
+      _block_index.write( (const char*)&block_num, sizeof( block_num ) );
+   }
+   _block_index.flush();
+}
+
+bool account_history_store::is_open()const
+{
+   return _log.is_open();
+}
+
+void account_history_store::close()
+{
+   commit();
+   _cache.clear();
+   _lru.clear();
+   _accounts.clear();
+   _log.close();
+   _log_index.close();
+   _block_index.close();
+   _pages.close();
+   _directory.close();
+}
+
+uint32_t account_history_store::account_operation_count( account_uid_type account )const
+{
+   const account_pages* pages = find_account( account );
+   return pages ? pages->count : 0;
+}
+
+account_history_store::account_pages* account_history_store::find_account( account_uid_type account )const
+{
+   auto itr = _accounts.find( account );
+   if( itr == _accounts.end() )
+      return nullptr;
+   account_pages& pages = itr->second;
+   if( !pages.count_known )
+   {
+      // every page but the last one of an account is full
+      const history_page& page = get_page( pages.pages.back() );
+      FC_ASSERT( page.account == account && page.used <= entries_per_page,
+                 "Corrupted account history page ${p}", ("p", pages.pages.back()) );
+      pages.count = uint32_t( pages.pages.size() - 1 ) * entries_per_page + page.used;
+      pages.count_known = true;
+   }
+   return &pages;
+}
+
+uint64_t account_history_store::append_operation( const operation_history_object& op )
+{
+   const uint64_t operation = _state.operation_count;
+   const auto data = fc::raw::pack( op );
+   const uint32_t size = data.size();
+   _log.seekp( _state.log_size );
+   _log.write( (const char*)&size, sizeof( size ) );
+   _log.write( data.data(), data.size() );
+   _log_index.seekp( operation * sizeof( uint64_t ) );
+   _log_index.write( (const char*)&_state.log_size, sizeof( uint64_t ) );
+   _block_index.seekp( operation * sizeof( uint32_t ) );
+   _block_index.write( (const char*)&op.block_num, sizeof( op.block_num ) );
+   _state.log_size += sizeof( size ) + data.size();
+   ++_state.operation_count;
+   return operation;
+}
+
+void account_history_store::append_account_operation( account_uid_type account, uint64_t operation, uint16_t op_type )
+{
+   account_pages* existing = find_account( account );
+   account_pages& pages = existing ? *existing : _accounts[ account ];
+   pages.count_known = true;
+   const uint32_t slot = pages.count % entries_per_page;
+   history_page& page = slot == 0 ? new_page( account, pages.pages.size() ) : get_page( pages.pages.back() );
+   if( slot == 0 )
+      pages.pages.push_back( _state.page_count - 1 );
+   page.entries[slot] = ( operation << 16 ) | op_type;
+   page.used = slot + 1;
+   _cache[ pages.pages.back() ].dirty = true;
+   ++pages.count;
+}
+
+void account_history_store::commit()
+{ try {
+   // the log has to be on disk before the pages pointing into it
+   _log.flush();
+   _log_index.flush();
+   _block_index.flush();
+   for( auto& item : _cache )
+   {
+      if( !item.second.dirty )
+         continue;
+      write_page( item.first, item.second.page );
+      item.second.dirty = false;
+   }
+   _pages.flush();
+   _directory.flush();
+   _committed = _state;
+   write_state( _committed );
+} FC_CAPTURE_AND_RETHROW() }
+
+operation_history_object account_history_store::get_operation( uint64_t operation )const
+{ try {
+   FC_ASSERT( operation < _state.operation_count, "Operation ${o} is not in the account history store",
+              ("o", operation) );
+   uint64_t pos = 0;
+   _log_index.seekg( operation * sizeof( uint64_t ) );
+   _log_index.read( (char*)&pos, sizeof( pos ) );
+   uint32_t size = 0;
+   _log.seekg( pos );
+   _log.read( (char*)&size, sizeof( size ) );
+   std::vector<char> data( size );
+   _log.read( data.data(), size );
+
+   operation_history_object result = fc::raw::unpack<operation_history_object>( data );
+   result.id = operation_history_id_type( operation );
+   return result;
+} FC_CAPTURE_AND_RETHROW( (operation) ) }
+
+uint32_t account_history_store::get_operation_block_num( uint64_t operation )const
+{ try {
+   FC_ASSERT( operation < _state.operation_count, "Operation ${o} is not in the account history store",
+              ("o", operation) );
+   uint32_t block_num = 0;
+   _block_index.seekg( operation * sizeof( uint32_t ) );
+   _block_index.read( (char*)&block_num, sizeof( block_num ) );
+   return block_num;
+} FC_CAPTURE_AND_RETHROW( (operation) ) }
+
+account_history_store::account_entry account_history_store::get_account_entry( account_uid_type account,
+                                                                                uint32_t sequence )const
+{
+   const account_pages* pages = find_account( account );
+   FC_ASSERT( pages && sequence > 0 && sequence <= pages->count,
+              "Account ${a} has no operation ${s} in the account history store", ("a", account)("s", sequence) );
+   const history_page& page = get_page( pages->pages[ ( sequence - 1 ) / entries_per_page ] );
+   const uint64_t entry = page.entries[ ( sequence - 1 ) % entries_per_page ];
+   account_entry result;
+   result.operation = entry >> 16;
+   result.op_type = entry & 0xffff;
+   return result;
+}
+
+account_history_store::history_page& account_history_store::get_page( uint32_t page_num )const
+{
+   auto itr = _cache.find( page_num );
+   if( itr != _cache.end() )
+   {
+      _lru.splice( _lru.begin(), _lru, itr->second.lru );
+      return itr->second.page;
+   }
+
+   cached_page& cached = add_to_cache( page_num );
+   _pages.seekg( uint64_t( page_num ) * sizeof( history_page ) );
+   _pages.read( (char*)&cached.page, sizeof( history_page ) );
+   return cached.page;
+}
+
+account_history_store::history_page& account_history_store::new_page( account_uid_type account, uint32_t page_in_account )
+{
+   const uint64_t directory_entry = account;
+   _directory.seekp( uint64_t( _state.page_count ) * sizeof( uint64_t ) );
+   _directory.write( (const char*)&directory_entry, sizeof( directory_entry ) );
+   cached_page& cached = add_to_cache( _state.page_count++ );
+   cached.page.account = account;
+   cached.page.page_in_account = page_in_account;
+   cached.page.used = 0;
+   std::fill( std::begin( cached.page.entries ), std::end( cached.page.entries ), 0 );
+   cached.dirty = true;
+   return cached.page;
+}
+
+account_history_store::cached_page& account_history_store::add_to_cache( uint32_t page_num )const
+{
+   while( _cache.size() >= _cache_pages )
+   {
+      auto victim = _cache.find( _lru.back() );
+      if( victim->second.dirty )
+      {
+         // a page may now hold entries that are gone after a crash, the next open has to check all pages
+         if( !_committed.pages_written )
+         {
+            _committed.pages_written = true;
+            write_state( _committed );
+         }
+         write_page( victim->first, victim->second.page );
+      }
+      _cache.erase( victim );
+      _lru.pop_back();
+   }
+   cached_page& cached = _cache[ page_num ];
+   _lru.push_front( page_num );
+   cached.lru = _lru.begin();
+   return cached;
+}
+
+void account_history_store::write_page( uint32_t page_num, const history_page& page )const
+{
+   _pages.seekp( uint64_t( page_num ) * sizeof( history_page ) );
+   _pages.write( (const char*)&page, sizeof( history_page ) );
+}
+
+void account_history_store::write_state( const store_state& state )const
+{
+   // replace the state in one step so a crash leaves either the old or the new one
+   const auto data = fc::raw::pack( state );
+   {
+      std::ofstream out( ( _dir / "state.tmp" ).generic_string().c_str(), std::ofstream::binary | std::ofstream::trunc );
+      FC_ASSERT( out );
+      out.write( data.data(), data.size() );
+      out.flush();
+   }
+   fc::rename( _dir / "state.tmp", _dir / "state" );
+}
+
+} } // graphene::account_history
@@ -28,6 +28,8 @@
 
 #include <graphene/chain/operation_history_object.hpp>
 
+#include <graphene/account_history/account_history_store.hpp>
+
 #include <fc/thread/future.hpp>
 
 namespace graphene { namespace account_history {
@@ -74,9 +76,51 @@ class account_history_plugin : public graphene::app::plugin
          boost::program_options::options_description& cfg) override;
       virtual void plugin_initialize(const boost::program_options::variables_map& options) override;
       virtual void plugin_startup() override;
+      virtual void plugin_shutdown() override;
 
       flat_set<account_uid_type> tracked_accounts()const;
 
+      /// @return whether account history is kept in the on-disk store, see account-history-store
+      bool has_history_store()const;
+      /// @return the last block whose operations are in the account history, the head block without a history store
+      uint32_t get_indexed_block_num()const;
+      /// @return why indexing into the history store has stopped, empty while it goes on
+      string get_indexing_error()const;
+      /// @return the last block whose operations are in the on-disk part of the history store
+      uint32_t get_stored_block_num()const;
+      /// @return the number of operations in the history of @p account, only valid with a history store
+      uint32_t get_account_operation_count( account_uid_type account )const;
+      /**
+       * @return operations from the history of @p account with their sequence numbers, newest first,
+       *         starting at sequence @p start (0 for the latest) and going down to @p stop, only valid
+       *         with a history store
+       */
+      vector<std::pair<uint32_t,operation_history_object>> get_account_operations( account_uid_type account,
+                                                                                   optional<uint16_t> op_type,
+                                                                                   uint32_t start,
+                                                                                   uint32_t stop,
+                                                                                   uint32_t limit )const;
+      /**
+       * @return operations from the history of @p account with ids in ( @p stop, @p start ], newest first,
+       *         @p start 0 for the latest, only valid with a history store
+       */
+      vector<operation_history_object> get_account_operations_by_id( account_uid_type account,
+                                                                     optional<uint16_t> op_type,
+                                                                     operation_history_id_type stop,
+                                                                     uint32_t limit,
+                                                                     operation_history_id_type start )const;
+      /**
+       * @return operations of blocks in [ @p start_block, @p end_block ) from the history of @p account with
+       *         their sequence numbers, oldest first, beginning at sequence @p first_sequence if it is not 0,
+       *         only valid with a history store
+       */
+      vector<std::pair<uint32_t,operation_history_object>> get_account_operations_by_block( account_uid_type account,
+                                                                                            optional<uint16_t> op_type,
+                                                                                            uint32_t start_block,
+                                                                                            uint32_t end_block,
+                                                                                            uint32_t first_sequence,
+                                                                                            uint32_t limit )const;
+
       friend class detail::account_history_plugin_impl;
       std::unique_ptr<detail::account_history_plugin_impl> my;
 };
@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/operation_history_object.hpp>
+
+#include <fc/filesystem.hpp>
+
+#include <fstream>
+#include <list>
+#include <unordered_map>
+#include <vector>
+
+namespace graphene { namespace account_history {
+   using namespace chain;
+
+   /**
+    * Account history of irreversible blocks, kept on disk.
+    *
+    * Operations are appended to an operation log, with a file of fixed size offsets to find the
+    * operation with a given sequence number and a file with the block number of every operation.  The history of each account is a list of
+    * fixed size pages in a page file, every page holding the operation numbers and types of
+    * 126 consecutive operations of one account, so the operation at any account sequence is
+    * found with a single page read.  Pages go through an LRU cache.
+    *
+    * Nothing is ever rewritten except the last page of an account.  commit() makes the
+    * appended data durable; after a crash everything appended after the last commit is
+    * discarded when the store is opened again.
+    *
+    * A directory file holds the account of every page, so opening the store reads 8 bytes per
+    * page instead of the pages themselves.  The number of operations of an account is taken from
+    * its last page when the account is first used.  Only if pages were written out after the last
+    * commit, and may hold entries of discarded operations, are all pages read to remove those.
+    */
+   class account_history_store
+   {
+      public:
+         /// One operation in the history of an account
+         struct account_entry
+         {
+            uint64_t operation = 0;   ///< sequence number of the operation in the operation log
+            uint16_t op_type = 0;
+         };
+
+         static const uint32_t entries_per_page = 126;
+
+         explicit account_history_store( size_t cache_pages = 16384 );
+         ~account_history_store();
+
+         void open( const fc::path& dir );
+         bool is_open()const;
+         void close();
+
+         /// @return the last block whose operations have been appended
+         uint32_t last_block_num()const { return _state.last_block_num; }
+         /// @return the number of operations in the operation log, which is the number the next one gets
+         uint64_t operation_count()const { return _state.operation_count; }
+         /// @return the number of operations in the history of @p account
+         uint32_t account_operation_count( account_uid_type account )const;
+
+         /// Appends @p op to the operation log
+         /// @return the sequence number of the operation
+         uint64_t append_operation( const operation_history_object& op );
+         /// Appends operation @p operation to the history of @p account
+         void     append_account_operation( account_uid_type account, uint64_t operation, uint16_t op_type );
+         /// Records that all operations up to block @p block_num have been appended
+         void     set_last_block_num( uint32_t block_num ) { _state.last_block_num = block_num; }
+         /// Writes everything appended so far to disk
+         void     commit();
+
+         /// @return the operation with sequence number @p operation, its id is operation_history_id_type( operation )
+         operation_history_object get_operation( uint64_t operation )const;
+         /// @return the block of operation @p operation, without reading the operation
+         uint32_t                 get_operation_block_num( uint64_t operation )const;
+         /// @return the operation at @p sequence in the history of @p account, counting from 1
+         account_entry            get_account_entry( account_uid_type account, uint32_t sequence )const;
+
+         struct store_state
+         {
+            uint32_t last_block_num = 0;
+            uint64_t operation_count = 0;
+            uint64_t log_size = 0;
+            uint32_t page_count = 0;
+            bool     pages_written = false;   ///< pages were written after this commit
+         };
+
+      private:
+         struct history_page
+         {
+            uint64_t account = 0;
+            uint32_t page_in_account = 0;
+            uint32_t used = 0;
+            uint64_t entries[entries_per_page];   ///< operation << 16 | op_type
+         };
+
+         struct cached_page
+         {
+            history_page                  page;
+            bool                          dirty = false;
+            std::list<uint32_t>::iterator lru;
+         };
+
+         struct account_pages
+         {
+            std::vector<uint32_t> pages;   ///< page numbers in the page file, in account order
+            uint32_t              count = 0;
+            bool                  count_known = false;   ///< false until the last page has been read
+         };
+
+         /// @return the pages of @p account with their count known, nullptr if it has no history
+         account_pages* find_account( account_uid_type account )const;
+         history_page&  get_page( uint32_t page_num )const;
+         history_page&  new_page( account_uid_type account, uint32_t page_in_account );
+         cached_page&   add_to_cache( uint32_t page_num )const;
+         void           write_page( uint32_t page_num, const history_page& page )const;
+         void           write_state( const store_state& state )const;
+         void           load_directory();
+         void           recover();
+         void           rebuild_block_index();
+
+         fc::path                                              _dir;
+         store_state                                           _state;
+         /// the state on disk, _state without what has been appended since
+         mutable store_state                                   _committed;
+         size_t                                                _cache_pages;
+
+         mutable std::fstream                                  _log;
+         mutable std::fstream                                  _log_index;
+         mutable std::fstream                                  _block_index;   ///< block number of every operation
+         mutable std::fstream                                  _pages;
+         mutable std::fstream                                  _directory;   ///< account of every page
+
+         mutable std::unordered_map<account_uid_type, account_pages>  _accounts;
+
+         mutable std::unordered_map<uint32_t, cached_page>     _cache;
+         mutable std::list<uint32_t>                           _lru;   ///< page numbers, most recently used first
+   };
+
+} } // graphene::account_history
+
+FC_REFLECT( graphene::account_history::account_history_store::store_state,
+            (last_block_num)(operation_count)(log_size)(page_count)(pages_written) )
@@ -14,6 +14,7 @@
 
 #include <graphene/debug_witness/debug_api.hpp>
 #include <graphene/debug_witness/debug_witness.hpp>
+#include <graphene/witness/witness.hpp>
 
 namespace graphene { namespace debug_witness {
 
@@ -29,6 +30,7 @@ class debug_api_impl
       void debug_update_object( const fc::variant_object& update );
       void debug_stream_json_objects( const std::string& filename );
       void debug_stream_json_objects_flush();
+      std::vector< graphene::witness_plugin::block_production_attempt > debug_get_production_attempts( uint32_t limit );
       std::shared_ptr< graphene::debug_witness_plugin::debug_witness_plugin > get_plugin();
 
       graphene::app::application& app;
@@ -120,6 +122,13 @@ void debug_api_impl::debug_stream_json_objects_flush()
    get_plugin()->flush_json_object_stream();
 }
 
+std::vector< graphene::witness_plugin::block_production_attempt > debug_api_impl::debug_get_production_attempts( uint32_t limit )
+{
+   auto witness = std::dynamic_pointer_cast< graphene::witness_plugin::witness_plugin >( app.get_plugin( "witness" ) );
+   FC_ASSERT( witness, "The witness plugin is not enabled" );
+   return witness->production_attempts().get_last( limit );
+}
+
 } // detail
 
 debug_api::debug_api( graphene::app::application& app )
@@ -152,5 +161,10 @@ void debug_api::debug_stream_json_objects_flush()
    my->debug_stream_json_objects_flush();
 }
 
+std::vector< graphene::witness_plugin::block_production_attempt > debug_api::debug_get_production_attempts( uint32_t limit )
+{
+   return my->debug_get_production_attempts( limit );
+}
+
 
 } } // graphene::debug_witness
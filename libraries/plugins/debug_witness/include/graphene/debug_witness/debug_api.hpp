@@ -26,6 +26,8 @@
 #include <memory>
 #include <string>
 
+#include <graphene/witness/production_attempt.hpp>
+
 #include <fc/api.hpp>
 #include <fc/variant_object.hpp>
 
@@ -82,6 +84,12 @@ class debug_api
        */
       void debug_stream_json_objects_flush();
 
+      /**
+       * Get the most recent block production attempts in slots of the witnesses of this node, oldest first,
+       * with the time spent in each step of producing the block.  Requires the witness plugin.
+       */
+      std::vector< graphene::witness_plugin::block_production_attempt > debug_get_production_attempts( uint32_t limit );
+
       std::shared_ptr< detail::debug_api_impl > my;
 };
 
@@ -93,4 +101,5 @@ FC_API(graphene::debug_witness::debug_api,
        (debug_update_object)
        (debug_stream_json_objects)
        (debug_stream_json_objects_flush)
+       (debug_get_production_attempts)
      )
@@ -26,25 +26,49 @@
 #include <graphene/chain/protocol/types.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/app/api.hpp>
+#include <graphene/app/raw_api_client.hpp>
 
 #include <fc/network/http/websocket.hpp>
 #include <fc/rpc/websocket_api.hpp>
 #include <fc/api.hpp>
 #include <fc/smart_ref_impl.hpp>
 
+#include <deque>
+
 
 namespace graphene { namespace delayed_node {
 namespace bpo = boost::program_options;
 
 namespace detail {
 struct delayed_node_plugin_impl {
+   typedef vector<fc::optional<graphene::chain::signed_block>> blocks_type;
+
+   /// Fetches blocks [from, to] with the cheapest API the trusted node gives us
+   blocks_type fetch_blocks( uint32_t from, uint32_t to )
+   {
+      if( raw_client )
+         return raw_client->get_blocks( from, to );
+      if( block_api )
+         return (*block_api)->get_blocks( from, to );
+      blocks_type result;
+      for( uint32_t block_num = from; block_num <= to; ++block_num )
+         result.push_back( database_api->get_block( block_num ) );
+      return result;
+   }
+
    std::string remote_endpoint;
    fc::http::websocket_client client;
    std::shared_ptr<fc::rpc::websocket_api_connection> client_connection;
    fc::api<graphene::app::database_api> database_api;
+   fc::optional<graphene::app::raw_api_client> raw_client;
+   fc::optional<fc::api<graphene::app::block_api>> block_api;
    boost::signals2::scoped_connection client_connection_closed;
    graphene::chain::block_id_type last_received_remote_head;
    graphene::chain::block_id_type last_processed_remote_head;
+   /// set when the trusted node reports a new head block while the main loop waits for one
+   fc::promise<void>::ptr remote_head_changed;
+   uint32_t batch_size = 100;
+   uint32_t prefetch_batches = 4;
 };
 }
 
@@ -59,6 +83,10 @@ void delayed_node_plugin::plugin_set_program_options(bpo::options_description& c
 {
    cli.add_options()
          ("trusted-node", boost::program_options::value<std::string>()->required(), "RPC endpoint of a trusted validating node (required)")
+         ("delayed-node-batch-size", boost::program_options::value<uint32_t>()->default_value(100),
+          "Number of blocks fetched from the trusted node in one request (default: 100)")
+         ("delayed-node-prefetch-batches", boost::program_options::value<uint32_t>()->default_value(4),
+          "Number of batches requested ahead of the one being applied (default: 4)")
          ;
    cfg.add(cli);
 }
@@ -70,11 +98,44 @@ void delayed_node_plugin::connect()
    my->client_connection_closed = my->client_connection->closed.connect([this] {
       connection_failed();
    });
+
+   // ranges of blocks come from the raw API, or the block API, when the trusted node grants them
+   my->raw_client.reset();
+   my->block_api.reset();
+   try
+   {
+      auto login = my->client_connection->get_remote_api<graphene::app::login_api>(1);
+      login->login( "", "" );
+      try
+      {
+         my->raw_client = graphene::app::raw_api_client( login->raw() );
+      }
+      catch( const fc::exception& )
+      {
+         my->block_api = login->block();
+      }
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Trusted node grants neither raw_api nor block_api, fetching one block per request: ${e}",
+            ("e", e.to_string()) );
+   }
+
+   my->database_api->set_block_applied_callback([this]( const fc::variant& block_id )
+   {
+      fc::from_variant( block_id, my->last_received_remote_head, GRAPHENE_MAX_NESTED_OBJECTS );
+      if( my->remote_head_changed && !my->remote_head_changed->ready() )
+         my->remote_head_changed->set_value();
+   } );
 }
 
 void delayed_node_plugin::plugin_initialize(const boost::program_options::variables_map& options)
 {
    my->remote_endpoint = "ws://" + options.at("trusted-node").as<std::string>();
+   if( options.count("delayed-node-batch-size") )
+      my->batch_size = std::max<uint32_t>( options.at("delayed-node-batch-size").as<uint32_t>(), 1 );
+   if( options.count("delayed-node-prefetch-batches") )
+      my->prefetch_batches = std::max<uint32_t>( options.at("delayed-node-prefetch-batches").as<uint32_t>(), 1 );
 }
 
 void delayed_node_plugin::sync_with_trusted_node()
@@ -85,9 +146,10 @@ void delayed_node_plugin::sync_with_trusted_node()
    while( true )
    {
       graphene::chain::dynamic_global_property_object remote_dpo = my->database_api->get_dynamic_global_properties();
-      if( remote_dpo.last_irreversible_block_num <= db.head_block_num() )
+      const uint32_t target = remote_dpo.last_irreversible_block_num;
+      if( target <= db.head_block_num() )
       {
-         if( remote_dpo.last_irreversible_block_num < db.head_block_num() )
+         if( target < db.head_block_num() )
          {
             wlog( "Trusted node seems to be behind delayed node" );
          }
@@ -98,13 +160,38 @@ void delayed_node_plugin::sync_with_trusted_node()
          break;
       }
       pass_count++;
-      while( remote_dpo.last_irreversible_block_num > db.head_block_num() )
+
+      // keep a few batches in flight, so the next ones download while one is being pushed
+      std::deque<fc::future<detail::delayed_node_plugin_impl::blocks_type>> batches;
+      uint32_t next_block_num = db.head_block_num() + 1;
+      auto request_batches = [&]()
+      {
+         while( batches.size() < my->prefetch_batches && next_block_num <= target )
+         {
+            const uint32_t from = next_block_num;
+            const uint32_t to = std::min<uint64_t>( target, uint64_t( from ) + my->batch_size - 1 );
+            batches.push_back( fc::async( [this,from,to]() { return my->fetch_blocks( from, to ); },
+                                          "delayed_node fetch blocks" ) );
+            next_block_num = to + 1;
+         }
+      };
+
+      request_batches();
+      while( !batches.empty() )
       {
-         fc::optional<graphene::chain::signed_block> block = my->database_api->get_block( db.head_block_num()+1 );
-         FC_ASSERT(block, "Trusted node claims it has blocks it doesn't actually have.");
-         ilog("Pushing block #${n}", ("n", block->block_num()));
-         db.push_block(*block);
-         synced_blocks++;
+         const auto blocks = batches.front().wait();
+         batches.pop_front();
+         request_batches();
+         for( const auto& block : blocks )
+         {
+            FC_ASSERT( block, "Trusted node claims it has blocks it doesn't actually have." );
+            FC_ASSERT( block->block_num() == db.head_block_num() + 1, "Trusted node sent block ${n} instead of ${h}",
+                       ("n", block->block_num())("h", db.head_block_num() + 1) );
+            db.push_block(*block);
+            synced_blocks++;
+         }
+         if( !blocks.empty() )
+            ilog( "Pushed blocks up to #${n}", ("n", db.head_block_num()) );
       }
    }
 }
@@ -115,17 +202,29 @@ void delayed_node_plugin::mainloop()
    {
       try
       {
-         fc::usleep( fc::microseconds( 296645 ) );  // wake up a little over 3Hz
-
          if( my->last_received_remote_head == my->last_processed_remote_head )
+         {
+            // the block applied callback wakes us up, the timeout only covers a lost notification
+            my->remote_head_changed = fc::promise<void>::ptr( new fc::promise<void>( "delayed_node remote head" ) );
+            try
+            {
+               my->remote_head_changed->wait( fc::seconds( 5 ) );
+            }
+            catch( const fc::timeout_exception& )
+            {
+            }
+            my->remote_head_changed.reset();
             continue;
+         }
 
+         const auto remote_head = my->last_received_remote_head;
          sync_with_trusted_node();
-         my->last_processed_remote_head = my->last_received_remote_head;
+         my->last_processed_remote_head = remote_head;
       }
       catch( const fc::exception& e )
       {
          elog("Error during connection: ${e}", ("e", e.to_detail_string()));
+         fc::usleep( fc::seconds( 1 ) );
       }
    }
 }
@@ -140,10 +239,6 @@ void delayed_node_plugin::plugin_startup()
    try
    {
       connect();
-      my->database_api->set_block_applied_callback([this]( const fc::variant& block_id )
-      {
-         fc::from_variant( block_id, my->last_received_remote_head, GRAPHENE_MAX_NESTED_OBJECTS );
-      } );
       return;
    }
    catch (const fc::exception& e)
@@ -216,6 +216,111 @@ typedef generic_index<order_history_object, order_history_multi_index_type> hist
 typedef generic_index<market_ticker_object, market_ticker_object_multi_index_type> market_ticker_index;
 
 
+/// The total amount for sale at one price of a market after the last block
+struct order_book_level_change
+{
+   price       sell_price;
+   share_type  for_sale;   ///< 0 if no order is left at the price
+};
+
+/**
+ * Keeps the total amount for sale of the limit orders at every price of every market, updated
+ * whenever a limit order is created, filled or cancelled, so order books and the best bid and
+ * ask are read without walking the orders.
+ */
+class order_book_depth_index : public secondary_index
+{
+   public:
+      typedef std::pair<asset_aid_type,asset_aid_type> market_type;
+      /// total for_sale by sell_price of the orders selling either asset of a market
+      typedef std::map<price, share_type>              levels_type;
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      /// @return the price levels of @p market, nullptr if it has no orders
+      const levels_type* get_levels( const market_type& market )const;
+
+      /// @return the levels changed by the last applied block
+      const vector<order_book_level_change>& get_last_block_changes()const { return _last_block_changes; }
+      /// Makes the levels changed since the previous call the changes of the last applied block
+      void finish_block();
+
+   private:
+      void adjust_level( const price& sell_price, share_type delta );
+
+      std::map<market_type, levels_type> _markets;
+      std::set<price>                    _changed;
+      vector<order_book_level_change>    _last_block_changes;
+};
+
+/// OHLCV data of a market for a period of any multiple of the smallest tracked bucket size
+struct market_candle
+{
+   bucket_key          key;   ///< seconds is the length of the candle
+   share_type          high_base;
+   share_type          high_quote;
+   share_type          low_base;
+   share_type          low_quote;
+   share_type          open_base;
+   share_type          open_quote;
+   share_type          close_base;
+   share_type          close_quote;
+   share_type          base_volume;
+   share_type          quote_volume;
+};
+
+/**
+ * Resamples the buckets into candles of any length that is a multiple of a tracked bucket size.
+ *
+ * Candles are built from the largest tracked bucket size that divides their length and kept in a
+ * cache.  A change to any bucket, including one undone by a chain reorganization, drops the cached
+ * candles that cover it, so a cached candle is always the same as a freshly built one.
+ */
+class market_candle_index : public secondary_index
+{
+   public:
+      typedef std::pair<asset_aid_type,asset_aid_type> market_type;
+
+      /// At most this many candles are cached, the cache starts over when it is full
+      static const size_t max_cached_candles = 100000;
+
+      virtual void object_inserted( const object& obj ) override;
+      virtual void object_removed( const object& obj ) override;
+      virtual void about_to_modify( const object& before ) override;
+      virtual void object_modified( const object& after  ) override;
+
+      void set_tracked_buckets( const flat_set<uint32_t>& buckets ) { _tracked_buckets = buckets; }
+
+      /// @return the largest tracked bucket size that divides @p seconds, 0 if there is none
+      uint32_t get_source_bucket_size( uint32_t seconds )const;
+
+      /**
+       * @return at most @p limit candles of @p seconds of @p market that open in [start, end], least recent first;
+       *         periods without any fill have no candle
+       */
+      vector<market_candle> get_candles( const graphene::chain::database& db, const market_type& market,
+                                         uint32_t seconds, fc::time_point_sec start, fc::time_point_sec end,
+                                         uint32_t limit )const;
+
+      /// @return the markets whose buckets changed in the last applied block
+      const flat_set<market_type>& get_last_block_markets()const { return _last_block_markets; }
+      /// Makes the markets changed since the previous call the changes of the last applied block
+      void finish_block();
+
+   private:
+      void bucket_changed( const object& obj );
+
+      flat_set<uint32_t>                                  _tracked_buckets;
+      flat_set<market_type>                               _changed_markets;
+      flat_set<market_type>                               _last_block_markets;
+      /// lengths of the cached candles of every market
+      mutable std::map<market_type, std::set<uint32_t>>   _cached_seconds;
+      mutable std::map<bucket_key, market_candle>         _cache;
+};
+
 namespace detail
 {
     class market_history_plugin_impl;
@@ -245,6 +350,17 @@ class market_history_plugin : public graphene::app::plugin
       uint32_t                    max_order_his_records_per_market()const;
       uint32_t                    max_order_his_seconds_per_market()const;
 
+      /**
+       * Fills are merged per market and applied once per block by default. Without merging every fill updates the
+       * order history, tickers and buckets on its own, which gives the same result more slowly; tests compare both.
+       */
+      void set_merge_fills( bool merge );
+
+      /// @return the aggregated limit orders of all markets
+      const order_book_depth_index& order_book_depth()const;
+      /// @return the candles resampled from the buckets
+      const market_candle_index& market_candles()const;
+
    private:
       friend class detail::market_history_plugin_impl;
       std::unique_ptr<detail::market_history_plugin_impl> my;
@@ -253,6 +369,7 @@ class market_history_plugin : public graphene::app::plugin
 } } //graphene::market_history
 
 FC_REFLECT( graphene::market_history::history_key, (base)(quote)(sequence) )
+FC_REFLECT( graphene::market_history::order_book_level_change, (sell_price)(for_sale) )
 FC_REFLECT_DERIVED( graphene::market_history::order_history_object, (graphene::db::object), (key)(time)(op) )
 FC_REFLECT( graphene::market_history::bucket_key, (base)(quote)(seconds)(open) )
 FC_REFLECT_DERIVED( graphene::market_history::bucket_object, (graphene::db::object),
@@ -262,6 +379,13 @@ FC_REFLECT_DERIVED( graphene::market_history::bucket_object, (graphene::db::obje
                     (open_base)(open_quote)
                     (close_base)(close_quote)
                     (base_volume)(quote_volume) )
+FC_REFLECT( graphene::market_history::market_candle,
+            (key)
+            (high_base)(high_quote)
+            (low_base)(low_quote)
+            (open_base)(open_quote)
+            (close_base)(close_quote)
+            (base_volume)(quote_volume) )
 FC_REFLECT_DERIVED( graphene::market_history::market_ticker_object, (graphene::db::object),
                     (base)(quote)
                     (last_day_base)(last_day_quote)
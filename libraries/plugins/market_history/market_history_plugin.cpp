@@ -29,17 +29,33 @@
 #include <graphene/chain/config.hpp>
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/evaluator.hpp>
+#include <graphene/chain/market_object.hpp>
 #include <graphene/chain/operation_history_object.hpp>
 #include <graphene/chain/transaction_evaluation_state.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
 #include <fc/thread/thread.hpp>
 
+#include <map>
+
 namespace graphene { namespace market_history {
 
 namespace detail
 {
 
+/// The fills of one market in a block, merged
+struct market_fills
+{
+   int64_t      last_sequence = 0;   ///< of the newest order history record
+   uint32_t     maker_fills = 0;
+   fc::uint128  base_volume;
+   fc::uint128  quote_volume;
+   price        open;
+   price        close;
+   price        high;
+   price        low;
+};
+
 class market_history_plugin_impl
 {
    public:
@@ -57,22 +73,41 @@ class market_history_plugin_impl
          return _self.database();
       }
 
+      /// Updates the order history, tickers and buckets of the markets in _block_fills, then clears it
+      void apply_block_fills( fc::time_point_sec now );
+      /// Removes old filled order data of a market whose newest record has sequence @p last_sequence
+      void prune_order_history( const std::pair<asset_aid_type,asset_aid_type>& market, int64_t last_sequence,
+                                fc::time_point_sec now );
+      /// Adds the maker fills of a market in the last block to its ticker and buckets
+      void update_ticker_and_buckets( const std::pair<asset_aid_type,asset_aid_type>& market, const market_fills& fills,
+                                      fc::time_point_sec now );
+      /// Removes the buckets of @p size in @p market that opened before @p cutoff
+      void remove_expired_buckets( const std::pair<asset_aid_type,asset_aid_type>& market, uint32_t size,
+                                   fc::time_point_sec cutoff );
+
       market_history_plugin&     _self;
+      order_book_depth_index*    _depth_index = nullptr;
+      market_candle_index*       _candle_index = nullptr;
       flat_set<uint32_t>         _tracked_buckets;
       uint32_t                   _maximum_history_per_bucket_size = 1000;
       uint32_t                   _max_order_his_records_per_market = 1000;
       uint32_t                   _max_order_his_seconds_per_market = 259200;
+
+      /// fills of the block being processed, by market
+      std::map< std::pair<asset_aid_type,asset_aid_type>, market_fills >  _block_fills;
+      /// if false every fill is applied on its own, as if it was the only one of its block
+      bool                       _merge_fills = true;
 };
 
 
 struct operation_process_fill_order
 {
-   market_history_plugin&            _plugin;
+   market_history_plugin_impl&       _impl;
    fc::time_point_sec                _now;
    const market_ticker_meta_object*& _meta;
 
-   operation_process_fill_order( market_history_plugin& mhp, fc::time_point_sec n, const market_ticker_meta_object*& meta )
-   :_plugin(mhp),_now(n),_meta(meta) {}
+   operation_process_fill_order( market_history_plugin_impl& impl, fc::time_point_sec n, const market_ticker_meta_object*& meta )
+   :_impl(impl),_now(n),_meta(meta) {}
 
    typedef void result_type;
 
@@ -83,10 +118,8 @@ struct operation_process_fill_order
    void operator()( const fill_order_operation& o )const 
    {
       //ilog( "processing ${o}", ("o",o) );
-      auto& db         = _plugin.database();
-      const auto& order_his_idx = db.get_index_type<history_index>().indices();
-      const auto& history_idx = order_his_idx.get<by_key>();
-      const auto& his_time_idx = order_his_idx.get<by_market_time>();
+      auto& db         = _impl.database();
+      const auto& history_idx = db.get_index_type<history_index>().indices().get<by_key>();
 
       // To save new filled order data
       history_key hkey;
@@ -122,171 +155,39 @@ struct operation_process_fill_order
             _meta = &( *meta_idx.begin() );
       }
 
-      // To remove old filled order data
-      const auto max_records = _plugin.max_order_his_records_per_market();
-      hkey.sequence += max_records;
-      itr = history_idx.lower_bound( hkey );
-      if( itr != history_idx.end() && itr->key.base == hkey.base && itr->key.quote == hkey.quote )
-      {
-         const auto max_seconds = _plugin.max_order_his_seconds_per_market();
-         fc::time_point_sec min_time;
-         if( min_time + max_seconds < _now )
-            min_time = _now - max_seconds;
-         auto time_itr = his_time_idx.lower_bound( std::make_tuple( hkey.base, hkey.quote, min_time ) );
-         if( time_itr != his_time_idx.end() && time_itr->key.base == hkey.base && time_itr->key.quote == hkey.quote )
-         {
-            if( itr->key.sequence >= time_itr->key.sequence )
-            {
-               while( itr != history_idx.end() && itr->key.base == hkey.base && itr->key.quote == hkey.quote )
-               {
-                  auto old_itr = itr;
-                  ++itr;
-                  db.remove( *old_itr );
-               }
-            }
-            else
-            {
-               while( time_itr != his_time_idx.end() && time_itr->key.base == hkey.base && time_itr->key.quote == hkey.quote )
-               {
-                  auto old_itr = time_itr;
-                  ++time_itr;
-                  db.remove( *old_itr );
-               }
-            }
-         }
-      }
+      // old filled order data is removed once per market after the block
+      auto& fills = _impl._block_fills[ std::make_pair( hkey.base, hkey.quote ) ];
+      fills.last_sequence = hkey.sequence;
 
       // To update ticker data and buckets data, only update for maker orders
       if( !o.is_maker )
          return;
 
-      bucket_key key;
-      key.base    = o.pays.asset_id;
-      key.quote   = o.receives.asset_id;
-
       price trade_price = o.pays / o.receives;
-
-      if( key.base > key.quote )
-      {
-         std::swap( key.base, key.quote );
+      if( trade_price.base.asset_id > trade_price.quote.asset_id )
          trade_price = ~trade_price;
-      }
 
       price fill_price = o.fill_price;
       if( fill_price.base.asset_id > fill_price.quote.asset_id )
          fill_price = ~fill_price;
 
-      // To update ticker data
-      const auto& ticker_idx = db.get_index_type<market_ticker_index>().indices().get<by_market>();
-      auto ticker_itr = ticker_idx.find( std::make_tuple( key.base, key.quote ) );
-      if( ticker_itr == ticker_idx.end() )
+      if( fills.maker_fills == 0 )
       {
-         db.create<market_ticker_object>( [&]( market_ticker_object& mt ) {
-            mt.base           = key.base;
-            mt.quote          = key.quote;
-            mt.last_day_base  = 0;
-            mt.last_day_quote = 0;
-            mt.latest_base    = fill_price.base.amount;
-            mt.latest_quote   = fill_price.quote.amount;
-            mt.base_volume    = trade_price.base.amount.value;
-            mt.quote_volume   = trade_price.quote.amount.value;
-         });
+         fills.open = fill_price;
+         fills.high = fill_price;
+         fills.low = fill_price;
       }
       else
       {
-         db.modify( *ticker_itr, [&]( market_ticker_object& mt ) {
-            mt.latest_base    = fill_price.base.amount;
-            mt.latest_quote   = fill_price.quote.amount;
-            mt.base_volume    += trade_price.base.amount.value;  // ignore overflow
-            mt.quote_volume   += trade_price.quote.amount.value; // ignore overflow
-         });
-      }
-
-      // To update buckets data
-      const auto max_history = _plugin.max_history();
-      if( max_history == 0 ) return;
-
-      const auto& buckets = _plugin.tracked_buckets();
-      if( buckets.size() == 0 ) return;
-
-      const auto& bucket_idx = db.get_index_type<bucket_index>();
-      for( auto bucket : buckets )
-      {
-          auto bucket_num = _now.sec_since_epoch() / bucket;
-          fc::time_point_sec cutoff;
-          if( bucket_num > max_history )
-             cutoff = cutoff + ( bucket * ( bucket_num - max_history ) );
-
-          key.seconds = bucket;
-          key.open    = fc::time_point_sec() + ( bucket_num * bucket );
-
-          const auto& by_key_idx = bucket_idx.indices().get<by_key>();
-          auto bucket_itr = by_key_idx.find( key );
-          if( bucket_itr == by_key_idx.end() )
-          { // create new bucket
-            /* const auto& obj = */
-            db.create<bucket_object>( [&]( bucket_object& b ){
-                 b.key = key;
-                 b.base_volume = trade_price.base.amount;
-                 b.quote_volume = trade_price.quote.amount;
-                 b.open_base = fill_price.base.amount;
-                 b.open_quote = fill_price.quote.amount;
-                 b.close_base = fill_price.base.amount;
-                 b.close_quote = fill_price.quote.amount;
-                 b.high_base = b.close_base;
-                 b.high_quote = b.close_quote;
-                 b.low_base = b.close_base;
-                 b.low_quote = b.close_quote;
-            });
-            //wlog( "    creating bucket ${b}", ("b",obj) );
-          }
-          else
-          { // update existing bucket
-             //wlog( "    before updating bucket ${b}", ("b",*bucket_itr) );
-             db.modify( *bucket_itr, [&]( bucket_object& b ){
-                  try {
-                     b.base_volume += trade_price.base.amount;
-                  } catch( fc::overflow_exception& ) {
-                     b.base_volume = std::numeric_limits<int64_t>::max();
-                  }
-                  try {
-                     b.quote_volume += trade_price.quote.amount;
-                  } catch( fc::overflow_exception& ) {
-                     b.quote_volume = std::numeric_limits<int64_t>::max();
-                  }
-                  b.close_base = fill_price.base.amount;
-                  b.close_quote = fill_price.quote.amount;
-                  if( b.high() < fill_price )
-                  {
-                      b.high_base = b.close_base;
-                      b.high_quote = b.close_quote;
-                  }
-                  if( b.low() > fill_price )
-                  {
-                      b.low_base = b.close_base;
-                      b.low_quote = b.close_quote;
-                  }
-             });
-             //wlog( "    after bucket bucket ${b}", ("b",*bucket_itr) );
-          }
-
-          {
-             key.open = fc::time_point_sec();
-             bucket_itr = by_key_idx.lower_bound( key );
-
-             while( bucket_itr != by_key_idx.end() &&
-                    bucket_itr->key.base == key.base &&
-                    bucket_itr->key.quote == key.quote &&
-                    bucket_itr->key.seconds == bucket &&
-                    bucket_itr->key.open < cutoff )
-             {
-              //  elog( "    removing old bucket ${b}", ("b", *bucket_itr) );
-                auto old_bucket_itr = bucket_itr;
-                ++bucket_itr;
-                db.remove( *old_bucket_itr );
-             }
-          }
+         if( fills.high < fill_price )
+            fills.high = fill_price;
+         if( fills.low > fill_price )
+            fills.low = fill_price;
       }
+      fills.close = fill_price;
+      fills.base_volume += trade_price.base.amount.value;
+      fills.quote_volume += trade_price.quote.amount.value;
+      ++fills.maker_fills;
    }
 };
 
@@ -296,6 +197,7 @@ market_history_plugin_impl::~market_history_plugin_impl()
 void market_history_plugin_impl::update_market_histories( const signed_block& b )
 {
    graphene::chain::database& db = database();
+   _depth_index->finish_block();
    const market_ticker_meta_object* _meta = nullptr;
    const auto& meta_idx = db.get_index_type<simple_index<market_ticker_meta_object>>();
    if( meta_idx.size() > 0 )
@@ -307,10 +209,15 @@ void market_history_plugin_impl::update_market_histories( const signed_block& b
       {
          try
          {
-            o_op->op.visit( operation_process_fill_order( _self, b.timestamp, _meta ) );
+            o_op->op.visit( operation_process_fill_order( *this, b.timestamp, _meta ) );
          } FC_CAPTURE_AND_LOG( (o_op) )
+         if( !_merge_fills )
+            apply_block_fills( b.timestamp );
       }
    }
+   apply_block_fills( b.timestamp );
+   _candle_index->finish_block();
+
    // roll out expired data from ticker
    if( _meta != nullptr )
    {
@@ -382,6 +289,177 @@ void market_history_plugin_impl::update_market_histories( const signed_block& b
    }
 }
 
+void market_history_plugin_impl::apply_block_fills( fc::time_point_sec now )
+{
+   // tickers and buckets are updated once per market, however many fills the block has
+   for( const auto& item : _block_fills )
+   {
+      try
+      {
+         prune_order_history( item.first, item.second.last_sequence, now );
+         if( item.second.maker_fills > 0 )
+            update_ticker_and_buckets( item.first, item.second, now );
+      } FC_CAPTURE_AND_LOG( (item.first) )
+   }
+   _block_fills.clear();
+}
+
+void market_history_plugin_impl::prune_order_history( const std::pair<asset_aid_type,asset_aid_type>& market,
+                                                      int64_t last_sequence, fc::time_point_sec now )
+{
+   graphene::chain::database& db = database();
+   const auto& order_his_idx = db.get_index_type<history_index>().indices();
+   const auto& history_idx = order_his_idx.get<by_key>();
+   const auto& his_time_idx = order_his_idx.get<by_market_time>();
+
+   history_key hkey;
+   hkey.base = market.first;
+   hkey.quote = market.second;
+   hkey.sequence = last_sequence + _max_order_his_records_per_market;
+   auto itr = history_idx.lower_bound( hkey );
+   if( itr == history_idx.end() || itr->key.base != hkey.base || itr->key.quote != hkey.quote )
+      return;
+
+   fc::time_point_sec min_time;
+   if( min_time + _max_order_his_seconds_per_market < now )
+      min_time = now - _max_order_his_seconds_per_market;
+   auto time_itr = his_time_idx.lower_bound( std::make_tuple( hkey.base, hkey.quote, min_time ) );
+   if( time_itr == his_time_idx.end() || time_itr->key.base != hkey.base || time_itr->key.quote != hkey.quote )
+      return;
+
+   if( itr->key.sequence >= time_itr->key.sequence )
+   {
+      while( itr != history_idx.end() && itr->key.base == hkey.base && itr->key.quote == hkey.quote )
+      {
+         auto old_itr = itr;
+         ++itr;
+         db.remove( *old_itr );
+      }
+   }
+   else
+   {
+      while( time_itr != his_time_idx.end() && time_itr->key.base == hkey.base && time_itr->key.quote == hkey.quote )
+      {
+         auto old_itr = time_itr;
+         ++time_itr;
+         db.remove( *old_itr );
+      }
+   }
+}
+
+void market_history_plugin_impl::update_ticker_and_buckets( const std::pair<asset_aid_type,asset_aid_type>& market,
+                                                            const market_fills& fills, fc::time_point_sec now )
+{
+   graphene::chain::database& db = database();
+   const share_type max_share = std::numeric_limits<int64_t>::max();
+   const share_type base_volume = fills.base_volume < fc::uint128( max_share.value ) ? share_type( fills.base_volume.to_uint64() ) : max_share;
+   const share_type quote_volume = fills.quote_volume < fc::uint128( max_share.value ) ? share_type( fills.quote_volume.to_uint64() ) : max_share;
+
+   // To update ticker data
+   const auto& ticker_idx = db.get_index_type<market_ticker_index>().indices().get<by_market>();
+   auto ticker_itr = ticker_idx.find( std::make_tuple( market.first, market.second ) );
+   if( ticker_itr == ticker_idx.end() )
+   {
+      db.create<market_ticker_object>( [&]( market_ticker_object& mt ) {
+         mt.base           = market.first;
+         mt.quote          = market.second;
+         mt.last_day_base  = 0;
+         mt.last_day_quote = 0;
+         mt.latest_base    = fills.close.base.amount;
+         mt.latest_quote   = fills.close.quote.amount;
+         mt.base_volume    = fills.base_volume;
+         mt.quote_volume   = fills.quote_volume;
+      });
+   }
+   else
+   {
+      db.modify( *ticker_itr, [&]( market_ticker_object& mt ) {
+         mt.latest_base    = fills.close.base.amount;
+         mt.latest_quote   = fills.close.quote.amount;
+         mt.base_volume    += fills.base_volume;  // ignore overflow
+         mt.quote_volume   += fills.quote_volume; // ignore overflow
+      });
+   }
+
+   // To update buckets data
+   if( _maximum_history_per_bucket_size == 0 )
+      return;
+
+   const auto& by_key_idx = db.get_index_type<bucket_index>().indices().get<by_key>();
+   for( auto bucket : _tracked_buckets )
+   {
+      const auto bucket_num = now.sec_since_epoch() / bucket;
+      bucket_key key( market.first, market.second, bucket, fc::time_point_sec() + ( bucket_num * bucket ) );
+      auto bucket_itr = by_key_idx.find( key );
+      if( bucket_itr == by_key_idx.end() )
+      { // create new bucket
+         db.create<bucket_object>( [&]( bucket_object& b ){
+              b.key = key;
+              b.base_volume = base_volume;
+              b.quote_volume = quote_volume;
+              b.open_base = fills.open.base.amount;
+              b.open_quote = fills.open.quote.amount;
+              b.close_base = fills.close.base.amount;
+              b.close_quote = fills.close.quote.amount;
+              b.high_base = fills.high.base.amount;
+              b.high_quote = fills.high.quote.amount;
+              b.low_base = fills.low.base.amount;
+              b.low_quote = fills.low.quote.amount;
+         });
+         // the cutoff only moves when a new bucket opens, so old buckets are removed once per bucket
+         fc::time_point_sec cutoff;
+         if( bucket_num > _maximum_history_per_bucket_size )
+            cutoff = cutoff + ( bucket * ( bucket_num - _maximum_history_per_bucket_size ) );
+         remove_expired_buckets( market, bucket, cutoff );
+      }
+      else
+      { // update existing bucket
+         db.modify( *bucket_itr, [&]( bucket_object& b ){
+              try {
+                 b.base_volume += base_volume;
+              } catch( fc::overflow_exception& ) {
+                 b.base_volume = std::numeric_limits<int64_t>::max();
+              }
+              try {
+                 b.quote_volume += quote_volume;
+              } catch( fc::overflow_exception& ) {
+                 b.quote_volume = std::numeric_limits<int64_t>::max();
+              }
+              b.close_base = fills.close.base.amount;
+              b.close_quote = fills.close.quote.amount;
+              if( b.high() < fills.high )
+              {
+                  b.high_base = fills.high.base.amount;
+                  b.high_quote = fills.high.quote.amount;
+              }
+              if( b.low() > fills.low )
+              {
+                  b.low_base = fills.low.base.amount;
+                  b.low_quote = fills.low.quote.amount;
+              }
+         });
+      }
+   }
+}
+
+void market_history_plugin_impl::remove_expired_buckets( const std::pair<asset_aid_type,asset_aid_type>& market,
+                                                         uint32_t size, fc::time_point_sec cutoff )
+{
+   graphene::chain::database& db = database();
+   const auto& by_key_idx = db.get_index_type<bucket_index>().indices().get<by_key>();
+   auto bucket_itr = by_key_idx.lower_bound( bucket_key( market.first, market.second, size, fc::time_point_sec() ) );
+   while( bucket_itr != by_key_idx.end() &&
+          bucket_itr->key.base == market.first &&
+          bucket_itr->key.quote == market.second &&
+          bucket_itr->key.seconds == size &&
+          bucket_itr->key.open < cutoff )
+   {
+      auto old_bucket_itr = bucket_itr;
+      ++bucket_itr;
+      db.remove( *old_bucket_itr );
+   }
+}
+
 } // end namespace detail
 
 
@@ -389,6 +467,242 @@ void market_history_plugin_impl::update_market_histories( const signed_block& b
 
 
 
+void order_book_depth_index::object_inserted( const object& obj )
+{
+   const limit_order_object& o = static_cast<const limit_order_object&>( obj );
+   adjust_level( o.sell_price, o.for_sale );
+}
+
+void order_book_depth_index::object_removed( const object& obj )
+{
+   const limit_order_object& o = static_cast<const limit_order_object&>( obj );
+   adjust_level( o.sell_price, -o.for_sale );
+}
+
+void order_book_depth_index::about_to_modify( const object& before )
+{
+   object_removed( before );
+}
+
+void order_book_depth_index::object_modified( const object& after )
+{
+   object_inserted( after );
+}
+
+void order_book_depth_index::adjust_level( const price& sell_price, share_type delta )
+{
+   if( delta == 0 )
+      return;
+   auto market = std::make_pair( sell_price.base.asset_id, sell_price.quote.asset_id );
+   if( market.first > market.second )
+      std::swap( market.first, market.second );
+   levels_type& levels = _markets[market];
+   share_type& for_sale = levels[sell_price];
+   for_sale += delta;
+   if( for_sale == 0 )
+   {
+      levels.erase( sell_price );
+      if( levels.empty() )
+         _markets.erase( market );
+   }
+   _changed.insert( sell_price );
+}
+
+const order_book_depth_index::levels_type* order_book_depth_index::get_levels( const market_type& market )const
+{
+   auto itr = _markets.find( market );
+   return itr == _markets.end() ? nullptr : &itr->second;
+}
+
+void order_book_depth_index::finish_block()
+{
+   _last_block_changes.clear();
+   _last_block_changes.reserve( _changed.size() );
+   for( const price& p : _changed )
+   {
+      order_book_level_change change;
+      change.sell_price = p;
+      auto market = std::make_pair( p.base.asset_id, p.quote.asset_id );
+      if( market.first > market.second )
+         std::swap( market.first, market.second );
+      const levels_type* levels = get_levels( market );
+      if( levels != nullptr )
+      {
+         auto itr = levels->find( p );
+         if( itr != levels->end() )
+            change.for_sale = itr->second;
+      }
+      _last_block_changes.push_back( change );
+   }
+   _changed.clear();
+}
+
+namespace {
+   /// Adds @p delta to @p volume, stopping at the largest share_type
+   void add_volume( share_type& volume, share_type delta )
+   {
+      try {
+         volume += delta;
+      } catch( fc::overflow_exception& ) {
+         volume = std::numeric_limits<int64_t>::max();
+      }
+   }
+
+   market_candle make_candle( const bucket_object& b, uint32_t seconds, fc::time_point_sec open )
+   {
+      market_candle c;
+      c.key = bucket_key( b.key.base, b.key.quote, seconds, open );
+      c.high_base = b.high_base;
+      c.high_quote = b.high_quote;
+      c.low_base = b.low_base;
+      c.low_quote = b.low_quote;
+      c.open_base = b.open_base;
+      c.open_quote = b.open_quote;
+      c.close_base = b.close_base;
+      c.close_quote = b.close_quote;
+      c.base_volume = b.base_volume;
+      c.quote_volume = b.quote_volume;
+      return c;
+   }
+
+   /// Adds bucket @p b, which is later than everything in @p c, to candle @p c
+   void add_to_candle( market_candle& c, const bucket_object& b )
+   {
+      c.close_base = b.close_base;
+      c.close_quote = b.close_quote;
+      if( asset( c.high_base, c.key.base ) / asset( c.high_quote, c.key.quote ) < b.high() )
+      {
+         c.high_base = b.high_base;
+         c.high_quote = b.high_quote;
+      }
+      if( asset( c.low_base, c.key.base ) / asset( c.low_quote, c.key.quote ) > b.low() )
+      {
+         c.low_base = b.low_base;
+         c.low_quote = b.low_quote;
+      }
+      add_volume( c.base_volume, b.base_volume );
+      add_volume( c.quote_volume, b.quote_volume );
+   }
+
+   fc::time_point_sec candle_open( fc::time_point_sec t, uint32_t seconds )
+   {
+      return fc::time_point_sec( t.sec_since_epoch() / seconds * seconds );
+   }
+}
+
+const size_t market_candle_index::max_cached_candles;
+
+void market_candle_index::object_inserted( const object& obj )
+{
+   bucket_changed( obj );
+}
+
+void market_candle_index::object_removed( const object& obj )
+{
+   bucket_changed( obj );
+}
+
+void market_candle_index::about_to_modify( const object& before )
+{
+}
+
+void market_candle_index::object_modified( const object& after )
+{
+   bucket_changed( after );
+}
+
+void market_candle_index::bucket_changed( const object& obj )
+{
+   const bucket_object& b = static_cast<const bucket_object&>( obj );
+   const auto market = std::make_pair( b.key.base, b.key.quote );
+   _changed_markets.insert( market );
+
+   auto itr = _cached_seconds.find( market );
+   if( itr == _cached_seconds.end() )
+      return;
+   for( uint32_t seconds : itr->second )
+      _cache.erase( bucket_key( market.first, market.second, seconds, candle_open( b.key.open, seconds ) ) );
+}
+
+uint32_t market_candle_index::get_source_bucket_size( uint32_t seconds )const
+{
+   if( seconds == 0 )
+      return 0;
+   for( auto itr = _tracked_buckets.rbegin(); itr != _tracked_buckets.rend(); ++itr )
+   {
+      if( seconds % *itr == 0 )
+         return *itr;
+   }
+   return 0;
+}
+
+vector<market_candle> market_candle_index::get_candles( const graphene::chain::database& db, const market_type& market,
+                                                        uint32_t seconds, fc::time_point_sec start,
+                                                        fc::time_point_sec end, uint32_t limit )const
+{
+   const uint32_t source = get_source_bucket_size( seconds );
+   FC_ASSERT( source > 0, "Candles of ${s} seconds can not be built from the tracked bucket sizes ${b}",
+              ("s", seconds)("b", _tracked_buckets) );
+
+   // the candle that contains start opens before it and is left out, like the buckets of get_market_history
+   fc::time_point_sec first_open = candle_open( start, seconds );
+   if( first_open < start )
+      first_open += seconds;
+
+   vector<market_candle> result;
+   const auto& by_key_idx = db.get_index_type<bucket_index>().indices().get<by_key>();
+   auto itr = by_key_idx.lower_bound( bucket_key( market.first, market.second, source, first_open ) );
+   while( result.size() < limit && itr != by_key_idx.end() && itr->key.base == market.first
+          && itr->key.quote == market.second && itr->key.seconds == source )
+   {
+      const fc::time_point_sec open = candle_open( itr->key.open, seconds );
+      if( open > end )
+         break;
+      const fc::time_point_sec next_open = open + seconds;
+
+      if( source == seconds )
+      {
+         result.push_back( make_candle( *itr, seconds, open ) );
+         ++itr;
+         continue;
+      }
+
+      const bucket_key key( market.first, market.second, seconds, open );
+      auto cached = _cache.find( key );
+      if( cached != _cache.end() )
+      {
+         result.push_back( cached->second );
+         itr = by_key_idx.lower_bound( bucket_key( market.first, market.second, source, next_open ) );
+         continue;
+      }
+
+      market_candle candle = make_candle( *itr, seconds, open );
+      ++itr;
+      while( itr != by_key_idx.end() && itr->key.base == market.first && itr->key.quote == market.second
+             && itr->key.seconds == source && itr->key.open < next_open )
+      {
+         add_to_candle( candle, *itr );
+         ++itr;
+      }
+
+      if( _cache.size() >= max_cached_candles )
+      {
+         _cache.clear();
+         _cached_seconds.clear();
+      }
+      _cache[key] = candle;
+      _cached_seconds[market].insert( seconds );
+      result.push_back( candle );
+   }
+   return result;
+}
+
+void market_candle_index::finish_block()
+{
+   _last_block_markets.clear();
+   std::swap( _last_block_markets, _changed_markets );
+}
+
 market_history_plugin::market_history_plugin() :
    my( new detail::market_history_plugin_impl(*this) )
 {
@@ -428,6 +742,8 @@ void market_history_plugin::plugin_initialize(const boost::program_options::vari
    database().add_index< primary_index< history_index  > >();
    database().add_index< primary_index< market_ticker_index  > >();
    database().add_index< primary_index< simple_index< market_ticker_meta_object > > >();
+   my->_depth_index = database().add_secondary_index< primary_index< limit_order_index >, order_book_depth_index >();
+   my->_candle_index = database().add_secondary_index< primary_index< bucket_index >, market_candle_index >();
 
    if( options.count( "bucket-size" ) )
    {
@@ -435,6 +751,7 @@ void market_history_plugin::plugin_initialize(const boost::program_options::vari
       my->_tracked_buckets = fc::json::from_string(buckets).as<flat_set<uint32_t>>(2);
       my->_tracked_buckets.erase( 0 );
    }
+   my->_candle_index->set_tracked_buckets( my->_tracked_buckets );
    if( options.count( "history-per-size" ) )
       my->_maximum_history_per_bucket_size = options["history-per-size"].as<uint32_t>();
    if( options.count( "max-order-his-records-per-market" ) )
@@ -447,6 +764,21 @@ void market_history_plugin::plugin_startup()
 {
 }
 
+void market_history_plugin::set_merge_fills( bool merge )
+{
+   my->_merge_fills = merge;
+}
+
+const order_book_depth_index& market_history_plugin::order_book_depth()const
+{
+   return *my->_depth_index;
+}
+
+const market_candle_index& market_history_plugin::market_candles()const
+{
+   return *my->_candle_index;
+}
+
 const flat_set<uint32_t>& market_history_plugin::tracked_buckets() const
 {
    return my->_tracked_buckets;
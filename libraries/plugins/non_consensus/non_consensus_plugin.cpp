@@ -56,32 +56,102 @@ class non_consensus_plugin_impl
       }
    void update_custom_vote(const account_uid_type& account, asset delta);
    void create_custom_vote_index(const custom_vote_cast_operation & op);
+   void fold_custom_votes(const custom_vote_pending_object& pending);
+   void fold_expired_custom_votes();
 };
 
+// Balance changes are only collected in the voter's custom_vote_pending_object for the asset, and
+// added to the tallies of the custom votes once the set of votes they count for changes.
 void non_consensus_plugin_impl::update_custom_vote(const account_uid_type& account,asset delta)
 {  
    graphene::chain::database& db = database();
-   const auto& custom_vote_idx = db.get_index_type<custom_vote_index>().indices().get<by_creater>();
+   const auto now = db.head_block_time();
+   const auto& pending_idx = db.get_index_type<custom_vote_pending_index>().indices().get<by_voter_asset>();
+   auto pending_itr = pending_idx.find(std::make_tuple(account, delta.asset_id));
+   if (pending_itr != pending_idx.end() && pending_itr->next_expired_time < now)
+   {
+      fold_custom_votes(*pending_itr);
+      pending_itr = pending_idx.find(std::make_tuple(account, delta.asset_id));
+   }
+
+   if (pending_itr != pending_idx.end())
+   {
+      db.modify(*pending_itr, [&](custom_vote_pending_object& obj)
+      {
+         obj.pending_amount += delta.amount;
+      });
+      return;
+   }
+
+   // only voters with votes in progress have tallies to change
    const auto& cast_vote_idx = db.get_index_type<cast_custom_vote_index>().indices().get<by_custom_vote_asset_id>();
-   auto cast_vote_itr = cast_vote_idx.lower_bound(std::make_tuple(account, delta.asset_id, db.head_block_time()));
+   auto cast_vote_itr = cast_vote_idx.lower_bound(std::make_tuple(account, delta.asset_id, now));
+   if (cast_vote_itr == cast_vote_idx.end() || cast_vote_itr->voter != account
+      || cast_vote_itr->vote_asset_id != delta.asset_id)
+      return;
 
-   while (cast_vote_itr != cast_vote_idx.end() && cast_vote_itr->voter == account
-      && cast_vote_itr->vote_asset_id == delta.asset_id)
+   db.create<custom_vote_pending_object>([&](custom_vote_pending_object& obj)
    {
-      auto custom_vote_itr = custom_vote_idx.find(std::make_tuple(cast_vote_itr->custom_vote_creator,
-         cast_vote_itr->custom_vote_vid));
-      FC_ASSERT(custom_vote_itr != custom_vote_idx.end(),
-         "custom vote ${id} not found.", ("id", cast_vote_itr->custom_vote_vid));
+      obj.voter = account;
+      obj.vote_asset_id = delta.asset_id;
+      obj.pending_amount = delta.amount;
+      obj.since = now;
+      obj.next_expired_time = cast_vote_itr->vote_expired_time;
+   });
+}
+
+void non_consensus_plugin_impl::fold_custom_votes(const custom_vote_pending_object& pending)
+{
+   graphene::chain::database& db = database();
+   const auto now = db.head_block_time();
+   const auto& custom_vote_idx = db.get_index_type<custom_vote_index>().indices().get<by_creater>();
+   const auto& cast_vote_idx = db.get_index_type<cast_custom_vote_index>().indices().get<by_custom_vote_asset_id>();
 
-      db.modify(*custom_vote_itr, [&](custom_vote_object& obj)
+   if (pending.pending_amount != 0)
+   {
+      auto cast_vote_itr = cast_vote_idx.lower_bound(std::make_tuple(pending.voter, pending.vote_asset_id, pending.since));
+      while (cast_vote_itr != cast_vote_idx.end() && cast_vote_itr->voter == pending.voter
+         && cast_vote_itr->vote_asset_id == pending.vote_asset_id)
       {
-         for (const auto& v : cast_vote_itr->vote_result)
-            obj.vote_result.at(v) += delta.amount.value;
-      });
-      ++cast_vote_itr;
+         auto custom_vote_itr = custom_vote_idx.find(std::make_tuple(cast_vote_itr->custom_vote_creator,
+            cast_vote_itr->custom_vote_vid));
+         FC_ASSERT(custom_vote_itr != custom_vote_idx.end(),
+            "custom vote ${id} not found.", ("id", cast_vote_itr->custom_vote_vid));
+
+         db.modify(*custom_vote_itr, [&](custom_vote_object& obj)
+         {
+            for (const auto& v : cast_vote_itr->vote_result)
+               obj.vote_result.at(v) += pending.pending_amount.value;
+         });
+         ++cast_vote_itr;
+      }
    }
 
+   auto next_itr = cast_vote_idx.lower_bound(std::make_tuple(pending.voter, pending.vote_asset_id, now));
+   if (next_itr == cast_vote_idx.end() || next_itr->voter != pending.voter
+      || next_itr->vote_asset_id != pending.vote_asset_id)
+   {
+      db.remove(pending);
+      return;
+   }
+   db.modify(pending, [&](custom_vote_pending_object& obj)
+   {
+      obj.pending_amount = 0;
+      obj.since = now;
+      obj.next_expired_time = next_itr->vote_expired_time;
+   });
 }
+
+void non_consensus_plugin_impl::fold_expired_custom_votes()
+{
+   graphene::chain::database& db = database();
+   const auto now = db.head_block_time();
+   const auto& pending_idx = db.get_index_type<custom_vote_pending_index>().indices().get<by_next_expired_time>();
+   // folding moves next_expired_time to now or later, or removes the object
+   while (!pending_idx.empty() && pending_idx.begin()->next_expired_time < now)
+      fold_custom_votes(*pending_idx.begin());
+}
+
 void non_consensus_plugin_impl::create_custom_vote_index(const custom_vote_cast_operation & op)
 {
    graphene::chain::database& db = database();
@@ -90,6 +160,12 @@ void non_consensus_plugin_impl::create_custom_vote_index(const custom_vote_cast_
    uint64_t votes = db.get_account_statistics_by_uid(op.voter).get_votes_from_core_balance();
    const auto& cast_idx = db.get_index_type<cast_custom_vote_index>().indices().get<by_custom_voter>();
    auto cast_itr = cast_idx.find(std::make_tuple(op.voter, op.custom_vote_creator, op.custom_vote_vid));
+
+   // the pending balance changes count for the votes cast so far
+   const auto& pending_idx = db.get_index_type<custom_vote_pending_index>().indices().get<by_voter_asset>();
+   auto pending_itr = pending_idx.find(std::make_tuple(op.voter, custom_vote_obj->vote_asset_id));
+   if (pending_itr != pending_idx.end())
+      fold_custom_votes(*pending_itr);
  
    if (cast_itr == cast_idx.end()) {
       db.create<cast_custom_vote_object>([&](cast_custom_vote_object& obj)
@@ -106,6 +182,15 @@ void non_consensus_plugin_impl::create_custom_vote_index(const custom_vote_cast_
          for (const auto& v : op.vote_result)
             obj.vote_result.at(v) += votes;
       });
+
+      pending_itr = pending_idx.find(std::make_tuple(op.voter, custom_vote_obj->vote_asset_id));
+      if (pending_itr != pending_idx.end() && pending_itr->next_expired_time > custom_vote_obj->vote_expired_time)
+      {
+         db.modify(*pending_itr, [&](custom_vote_pending_object& obj)
+         {
+            obj.next_expired_time = custom_vote_obj->vote_expired_time;
+         });
+      }
    }
    else {
       db.modify(*custom_vote_obj, [&](custom_vote_object& obj)
@@ -130,6 +215,7 @@ void non_consensus_plugin::plugin_initialize(const boost::program_options::varia
    
    if(non_consensus_indexs.count("customer_vote")){
       database().balance_adjusted.connect( [&]( const account_uid_type& account,const asset& delta){ my->update_custom_vote(account,delta); } );  
+      database().applied_block.connect( [&]( const signed_block& b ){ my->fold_expired_custom_votes(); } );
       
       database().update_non_consensus_index.connect( [&]( const operation& op) {
          if(op.which()==operation::tag<custom_vote_cast_operation>::value)
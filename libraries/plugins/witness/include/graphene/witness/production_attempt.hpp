@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#pragma once
+
+#include <graphene/chain/database.hpp>
+
+#include <boost/circular_buffer.hpp>
+
+#include <set>
+
+namespace graphene { namespace witness_plugin {
+
+namespace block_production_condition
+{
+   enum block_production_condition_enum
+   {
+      produced = 0,
+      not_synced = 1,
+      not_my_turn = 2,
+      not_time_yet = 3,
+      no_private_key = 4,
+      low_participation = 5,
+      lag = 6,
+      consecutive = 7,
+      exception_producing_block = 8,
+      skipped = 9    ///< the production loop did not run during the slot
+   };
+}
+
+/**
+ * One attempt to produce a block in a slot of a witness controlled by this node.
+ */
+struct block_production_attempt
+{
+   uint64_t                   sequence = 0;
+   fc::time_point_sec         slot_time;
+   fc::time_point             wakeup;
+   fc::microseconds           wakeup_jitter;      ///< wakeup - slot_time, negative when woken up early
+   chain::account_uid_type    witness = 0;
+   block_production_condition::block_production_condition_enum result = block_production_condition::not_my_turn;
+   uint32_t                   block_num = 0;
+   chain::block_generation_stats generation;      ///< of the produced block
+   fc::microseconds           broadcast_delay;    ///< from the end of generate_block() until the broadcast started
+   std::string                error;
+};
+
+/**
+ * The most recent production attempts in slots of the witnesses of this node, in a ring buffer
+ * that drops the oldest attempt when it is full.
+ */
+class production_attempt_log
+{
+   public:
+      explicit production_attempt_log( size_t capacity = 1000 ) : _attempts( capacity ) {}
+
+      void   set_capacity( size_t capacity ) { _attempts.set_capacity( capacity ); }
+      size_t capacity()const { return _attempts.capacity(); }
+      size_t size()const { return _attempts.size(); }
+
+      /// @return the sequence number of a new attempt
+      uint64_t next_sequence() { return _next_sequence++; }
+      /// Keeps @p attempt, unless the capacity is 0
+      void push( const block_production_attempt& attempt );
+
+      /**
+       * Called whenever the production loop looks at @p slot, 0 if there is none.  Keeps a skipped attempt for
+       * every slot of one of @p witnesses between the previous call and @p slot, so slots are not lost when the
+       * loop does not wake up in time.  Slots before the head block are not checked.
+       * @return true if @p slot is looked at for the first time
+       */
+      bool check_slot( const chain::database& db, const std::set<chain::account_uid_type>& witnesses, uint32_t slot );
+
+      /// Sets the broadcast delay of the attempt with @p sequence, if it is still kept
+      void set_broadcast_delay( uint64_t sequence, const fc::microseconds& delay );
+
+      /// @return up to @p limit of the most recent attempts, oldest first
+      std::vector<block_production_attempt> get_last( uint32_t limit )const;
+
+   private:
+      boost::circular_buffer<block_production_attempt> _attempts;
+      uint64_t                                         _next_sequence = 0;
+      fc::time_point_sec                               _last_slot_time;   ///< of the last slot looked at
+};
+
+} } //graphene::witness_plugin
+
+FC_REFLECT_ENUM( graphene::witness_plugin::block_production_condition::block_production_condition_enum,
+                 (produced)(not_synced)(not_my_turn)(not_time_yet)(no_private_key)(low_participation)(lag)
+                 (consecutive)(exception_producing_block)(skipped) )
+
+FC_REFLECT( graphene::witness_plugin::block_production_attempt,
+            (sequence)(slot_time)(wakeup)(wakeup_jitter)(witness)(result)(block_num)(generation)
+            (broadcast_delay)(error) )
@@ -23,35 +23,23 @@
  */
 #pragma once
 
+#include <graphene/app/metrics.hpp>
 #include <graphene/app/plugin.hpp>
 #include <graphene/chain/database.hpp>
+#include <graphene/witness/production_attempt.hpp>
 
 #include <fc/thread/future.hpp>
 
 namespace graphene { namespace witness_plugin {
 
-namespace block_production_condition
-{
-   enum block_production_condition_enum
-   {
-      produced = 0,
-      not_synced = 1,
-      not_my_turn = 2,
-      not_time_yet = 3,
-      no_private_key = 4,
-      low_participation = 5,
-      lag = 6,
-      consecutive = 7,
-      exception_producing_block = 8
-   };
-}
-
 class witness_plugin : public graphene::app::plugin {
 public:
    ~witness_plugin() {
       try {
          if( _block_production_task.valid() )
             _block_production_task.cancel_and_wait(__FUNCTION__);
+         if( _block_preparation_task.valid() )
+            _block_preparation_task.cancel_and_wait(__FUNCTION__);
       } catch(fc::canceled_exception&) {
          //Expected exception. Move along.
       } catch(fc::exception& e) {
@@ -68,6 +56,10 @@ public:
 
    void set_block_production(bool allow) { _production_enabled = allow; }
 
+   /// the production attempts in slots of our witnesses, which the debug API reads
+   production_attempt_log&       production_attempts()      { return _production_attempts; }
+   const production_attempt_log& production_attempts()const { return _production_attempts; }
+
    virtual void plugin_initialize( const boost::program_options::variables_map& options ) override;
    virtual void plugin_startup() override;
    virtual void plugin_shutdown() override;
@@ -75,17 +67,27 @@ public:
 private:
    void schedule_production_loop();
    block_production_condition::block_production_condition_enum block_production_loop();
-   block_production_condition::block_production_condition_enum maybe_produce_block( fc::limited_mutable_variant_object& capture );
+   block_production_condition::block_production_condition_enum maybe_produce_block( fc::limited_mutable_variant_object& capture,
+                                                                                    block_production_attempt& attempt );
+   void schedule_block_preparation();
+   void maybe_prepare_block();
 
    boost::program_options::variables_map _options;
    bool _production_enabled = false;
    bool _consecutive_production_enabled = false;
    uint32_t _required_witness_participation = 33 * GRAPHENE_1_PERCENT;
    uint32_t _production_skip_flags = graphene::chain::database::skip_nothing;
+   bool _prepare_blocks = true;
 
    std::map<chain::public_key_type, fc::ecc::private_key> _private_keys;
    std::set<chain::account_uid_type> _witnesses;
    fc::future<void> _block_production_task;
+   fc::future<void> _block_preparation_task;
+   std::shared_ptr<graphene::app::metrics_registry> _metrics;
+   production_attempt_log _production_attempts;
+
+   boost::signals2::scoped_connection _applied_block_conn;
+   boost::signals2::scoped_connection _pending_transaction_conn;
 };
 
 } } //graphene::witness_plugin
@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/witness/production_attempt.hpp>
+
+namespace graphene { namespace witness_plugin {
+
+void production_attempt_log::push( const block_production_attempt& attempt )
+{
+   if( _attempts.capacity() > 0 )
+      _attempts.push_back( attempt );
+}
+
+bool production_attempt_log::check_slot( const chain::database& db, const std::set<chain::account_uid_type>& witnesses,
+                                         uint32_t slot )
+{
+   if( slot == 0 )
+      return false;
+   const fc::time_point_sec slot_time = db.get_slot_time( slot );
+   if( slot_time <= _last_slot_time )
+      return false;
+
+   // nothing is known of the slots before the first one looked at
+   if( _last_slot_time != fc::time_point_sec() )
+   {
+      const uint32_t first = _last_slot_time > db.head_block_time() ? db.get_slot_at_time( _last_slot_time ) + 1 : 1;
+      for( uint32_t s = first; s < slot; ++s )
+      {
+         const chain::account_uid_type witness = db.get_scheduled_witness( s );
+         if( witnesses.find( witness ) == witnesses.end() )
+            continue;
+         block_production_attempt skipped;
+         skipped.sequence = next_sequence();
+         skipped.slot_time = db.get_slot_time( s );
+         skipped.witness = witness;
+         skipped.result = block_production_condition::skipped;
+         push( skipped );
+      }
+   }
+   _last_slot_time = slot_time;
+   return true;
+}
+
+void production_attempt_log::set_broadcast_delay( uint64_t sequence, const fc::microseconds& delay )
+{
+   // the attempt was kept when the production loop returned, it is one of the last ones
+   for( auto itr = _attempts.rbegin(); itr != _attempts.rend(); ++itr )
+   {
+      if( itr->sequence == sequence )
+      {
+         itr->broadcast_delay = delay;
+         return;
+      }
+      if( itr->sequence < sequence )
+         return;
+   }
+}
+
+std::vector<block_production_attempt> production_attempt_log::get_last( uint32_t limit )const
+{
+   const size_t count = std::min<size_t>( limit, _attempts.size() );
+   return std::vector<block_production_attempt>( _attempts.end() - count, _attempts.end() );
+}
+
+} } // graphene::witness_plugin
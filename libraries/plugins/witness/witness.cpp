@@ -72,6 +72,10 @@ void witness_plugin::plugin_set_program_options(
          ("private-key", bpo::value<vector<string>>()->composing()->multitoken()->
           DEFAULT_VALUE_VECTOR(std::make_pair(chain::public_key_type(default_priv_key.get_public_key()), graphene::utilities::key_to_wif(default_priv_key))),
           "Tuple of [PublicKey, WIF private key] (may specify multiple times)")
+         ("prepare-blocks", bpo::value<bool>()->default_value(true),
+          "Assemble the next block of a local witness in the background as transactions arrive, so only signing is left at the slot")
+         ("production-attempts-to-keep", bpo::value<uint32_t>()->default_value(1000),
+          "Number of recent block production attempts of local witnesses kept for the debug API")
          ;
    config_file_options.add(command_line_options);
 }
@@ -86,6 +90,10 @@ void witness_plugin::plugin_initialize(const boost::program_options::variables_m
    ilog("witness plugin:  plugin_initialize() begin");
    _options = &options;
    LOAD_VALUE_SET(options, "witness", _witnesses, chain::account_uid_type )
+   if( options.count("prepare-blocks") )
+      _prepare_blocks = options["prepare-blocks"].as<bool>();
+   if( options.count("production-attempts-to-keep") )
+      _production_attempts.set_capacity( options["production-attempts-to-keep"].as<uint32_t>() );
 
    if( options.count("private-key") )
    {
@@ -129,6 +137,25 @@ void witness_plugin::plugin_startup()
          //   new_chain_banner(d);
          _production_skip_flags |= graphene::chain::database::skip_undo_history_check;
       }
+      _metrics = app().get_metrics();
+      if( _metrics )
+      {
+         const auto& durations = graphene::app::metrics_registry::duration_buckets();
+         _metrics->declare_histogram( "yoyow_block_generation_duration_seconds",
+                                      "Time to generate, sign and apply a block produced by this node, by whether it was prepared in advance",
+                                      durations );
+         _metrics->declare_histogram( "yoyow_block_preparation_duration_seconds",
+                                      "Time to assemble the next block of a local witness in advance", durations );
+      }
+      if( _prepare_blocks )
+      {
+         _applied_block_conn = d.applied_block.connect( [this]( const graphene::chain::signed_block& ){
+            schedule_block_preparation();
+         } );
+         _pending_transaction_conn = d.on_pending_transaction.connect( [this]( const graphene::chain::signed_transaction& ){
+            schedule_block_preparation();
+         } );
+      }
       schedule_production_loop();
    } else
       elog("No witnesses configured! Please add witness IDs and private keys to configuration.");
@@ -155,13 +182,56 @@ void witness_plugin::schedule_production_loop()
                                          next_wakeup, "Witness Block Production");
 }
 
+void witness_plugin::schedule_block_preparation()
+{
+   // the database can't be touched from its own signals, and a burst of transactions only needs one rebuild
+   if( _block_preparation_task.valid() && !_block_preparation_task.ready() )
+      return;
+   _block_preparation_task = fc::schedule( [this]{ maybe_prepare_block(); },
+                                           fc::time_point::now() + fc::milliseconds( 100 ), "Witness Block Preparation" );
+}
+
+void witness_plugin::maybe_prepare_block()
+{
+   chain::database& db = database();
+   if( !_production_enabled )
+      return;
+
+   // the first slot after now, which is the one maybe_produce_block() will fill next
+   const uint32_t slot = db.get_slot_at_time( fc::time_point::now() ) + 1;
+   const fc::time_point_sec scheduled_time = db.get_slot_time( slot );
+   const graphene::chain::account_uid_type scheduled_witness = db.get_scheduled_witness( slot );
+   if( _witnesses.find( scheduled_witness ) == _witnesses.end()
+         || db.has_prepared_block( scheduled_time, scheduled_witness, _production_skip_flags ) )
+      return;
+   if( _private_keys.find( db.get_witness_by_uid( scheduled_witness ).signing_key ) == _private_keys.end() )
+      return;
+
+   try
+   {
+      const fc::time_point start = fc::time_point::now();
+      db.prepare_block( scheduled_time, scheduled_witness, _production_skip_flags );
+      if( _metrics )
+         _metrics->observe( "yoyow_block_preparation_duration_seconds", fc::time_point::now() - start );
+   }
+   catch( const fc::canceled_exception& )
+   {
+      throw;
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Failed to prepare block for slot at ${t}: ${e}", ("t", scheduled_time)("e", e.to_detail_string()) );
+   }
+}
+
 block_production_condition::block_production_condition_enum witness_plugin::block_production_loop()
 {
    block_production_condition::block_production_condition_enum result;
    fc::limited_mutable_variant_object capture( GRAPHENE_MAX_NESTED_OBJECTS );
+   block_production_attempt attempt;
    try
    {
-      result = maybe_produce_block(capture);
+      result = maybe_produce_block(capture, attempt);
    }
    catch( const fc::canceled_exception& )
    {
@@ -172,6 +242,14 @@ block_production_condition::block_production_condition_enum witness_plugin::bloc
    {
       elog("Got exception while generating block:\n${e}", ("e", e.to_detail_string()));
       result = block_production_condition::exception_producing_block;
+      attempt.error = e.to_string();
+   }
+
+   // only slots of our own witnesses are worth keeping
+   if( _witnesses.find( attempt.witness ) != _witnesses.end() )
+   {
+      attempt.result = result;
+      _production_attempts.push( attempt );
    }
 
    switch( result )
@@ -201,18 +279,37 @@ block_production_condition::block_production_condition_enum witness_plugin::bloc
       case block_production_condition::exception_producing_block:
          elog( "exception producing block" );
          break;
+      case block_production_condition::skipped:
+         break;
    }
 
    schedule_production_loop();
    return result;
 }
 
-block_production_condition::block_production_condition_enum witness_plugin::maybe_produce_block( fc::limited_mutable_variant_object& capture )
+block_production_condition::block_production_condition_enum witness_plugin::maybe_produce_block( fc::limited_mutable_variant_object& capture,
+                                                                                                 block_production_attempt& attempt )
 {
    chain::database& db = database();
    fc::time_point now_fine = fc::time_point::now();
    fc::time_point_sec now = now_fine + fc::microseconds( 500000 );
 
+   // the first look at a slot of one of our witnesses is kept, whatever comes of it
+   uint32_t slot = db.get_slot_at_time( now );
+   if( _production_attempts.check_slot( db, _witnesses, slot ) )
+   {
+      const graphene::chain::account_uid_type slot_witness = db.get_scheduled_witness( slot );
+      if( _witnesses.find( slot_witness ) != _witnesses.end() )
+      {
+         const fc::time_point_sec slot_time = db.get_slot_time( slot );
+         attempt.sequence = _production_attempts.next_sequence();
+         attempt.slot_time = slot_time;
+         attempt.wakeup = now_fine;
+         attempt.wakeup_jitter = now_fine - fc::time_point( slot_time );
+         attempt.witness = slot_witness;
+      }
+   }
+
    // If the next block production opportunity is in the present or future, we're synced.
    if( !_production_enabled )
    {
@@ -223,7 +320,6 @@ block_production_condition::block_production_condition_enum witness_plugin::mayb
    }
 
    // is anyone scheduled to produce now or one second in the future?
-   uint32_t slot = db.get_slot_at_time( now );
    if( slot == 0 )
    {
       capture("next_time", db.get_slot_time(1));
@@ -249,6 +345,7 @@ block_production_condition::block_production_condition_enum witness_plugin::mayb
    }
 
    fc::time_point_sec scheduled_time = db.get_slot_time( slot );
+
    graphene::chain::public_key_type scheduled_key = db.get_witness_by_uid( scheduled_witness ).signing_key;
    auto private_key_itr = _private_keys.find( scheduled_key );
 
@@ -277,14 +374,26 @@ block_production_condition::block_production_condition_enum witness_plugin::mayb
    {
       try
       {
+         const bool prepared = db.has_prepared_block( scheduled_time, scheduled_witness, _production_skip_flags );
+         const fc::time_point start = fc::time_point::now();
          auto block = db.generate_block(
             scheduled_time,
             scheduled_witness,
             private_key_itr->second,
             _production_skip_flags
             );
+         if( _metrics )
+            _metrics->observe( "yoyow_block_generation_duration_seconds", fc::time_point::now() - start,
+                               graphene::app::metrics_registry::label( "prepared", prepared ? "true" : "false" ) );
          capture("n", block.block_num())("t", block.timestamp)("c", now)("w",scheduled_witness)("wname",witness_name)("bid",block.id());
-         fc::async( [this,block](){ p2p_node().broadcast(net::block_message(block)); } );
+         attempt.block_num = block.block_num();
+         attempt.generation = db.get_last_block_generation_stats();
+         const fc::time_point generated = fc::time_point::now();
+         const uint64_t sequence = attempt.sequence;
+         fc::async( [this,block,generated,sequence](){
+            _production_attempts.set_broadcast_delay( sequence, fc::time_point::now() - generated );
+            p2p_node().broadcast(net::block_message(block));
+         } );
 
          return block_production_condition::produced;
       }
@@ -292,6 +401,7 @@ block_production_condition::block_production_condition_enum witness_plugin::mayb
       {
          elog( "${e}", ("e",e.to_detail_string()) );
          elog( "Clearing pending transactions and attempting again" );
+         attempt.error = e.to_string();
          db.clear_pending();
          retry++;
       }
@@ -150,3 +150,32 @@ BOOST_AUTO_TEST_CASE( two_node_network )
       throw;
    }
 }
+
+BOOST_AUTO_TEST_CASE( api_cache_methods_option )
+{
+   using namespace graphene::app;
+   try {
+      auto start_with = []( const string& methods ) {
+         fc::temp_directory app_dir( graphene::utilities::temp_directory_path() );
+         graphene::app::application app;
+         boost::program_options::variables_map cfg;
+         cfg.emplace("p2p-endpoint", boost::program_options::variable_value(string("127.0.0.1:0"), false));
+         cfg.emplace("api-cache-methods", boost::program_options::variable_value(methods, false));
+         app.initialize(app_dir.path(), cfg);
+         app.startup();
+         app.shutdown();
+      };
+
+      BOOST_TEST_MESSAGE( "Starting with cacheable methods" );
+      start_with( "get_dynamic_global_properties  get_ticker" );
+
+      BOOST_TEST_MESSAGE( "Refusing to start with a misspelled method" );
+      BOOST_CHECK_THROW( start_with( "get_dynamic_global_properties get_tickers" ), fc::exception );
+
+      BOOST_TEST_MESSAGE( "Refusing to start with a method that is not cached" );
+      BOOST_CHECK_THROW( start_with( "get_block" ), fc::exception );
+   } catch( fc::exception& e ) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
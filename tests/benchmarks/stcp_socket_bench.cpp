@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <graphene/net/message_oriented_connection.hpp>
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/config.hpp>
+
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/thread/future.hpp>
+#include <fc/log/logger.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace graphene::net;
+
+namespace {
+
+struct counting_delegate : public message_oriented_connection_delegate
+{
+   uint64_t messages_received = 0;
+   uint64_t bytes_received = 0;
+
+   void on_message( message_oriented_connection* originating_connection, const message& received_message ) override
+   {
+      ++messages_received;
+      bytes_received += received_message.size;
+   }
+   void on_connection_closed( message_oriented_connection* originating_connection ) override {}
+};
+
+/** an encrypted connection to ourselves over the loopback interface */
+struct loopback_connection_pair
+{
+   counting_delegate           receiver_delegate;
+   message_oriented_connection sender;
+   message_oriented_connection receiver;
+   fc::tcp_server              server;
+
+   loopback_connection_pair() : receiver( &receiver_delegate )
+   {
+      server.listen( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ) );
+      fc::future<void> accept_done = fc::async( [this]() {
+         server.accept( receiver.get_socket() );
+         receiver.accept();
+      }, "stcp_bench_accept" );
+      sender.connect_to( server.get_local_endpoint() );
+      accept_done.wait();
+   }
+
+   ~loopback_connection_pair()
+   {
+      sender.destroy_connection();
+      receiver.destroy_connection();
+      server.close();
+   }
+
+   void wait_for( uint64_t message_count )
+   {
+      while( receiver_delegate.messages_received < message_count )
+         fc::yield();
+   }
+};
+
+message make_message( size_t payload_size )
+{
+   message msg;
+   msg.msg_type = trx_message_type;
+   msg.data.resize( payload_size, 'x' );
+   msg.size = (uint32_t)msg.data.size();
+   return msg;
+}
+
+void report( const char* mode, size_t payload_size, uint32_t message_count, const fc::microseconds& elapsed )
+{
+   double seconds = elapsed.count() / 1000000.0;
+   double megabytes = double( payload_size ) * message_count / ( 1024 * 1024 );
+   ilog( "${mode}: ${count} messages of ${size} bytes in ${ms} ms, ${mbps} MiB/s, ${mps} messages/s",
+         ("mode", mode)("count", message_count)("size", payload_size)
+         ("ms", elapsed.count() / 1000)
+         ("mbps", uint64_t( megabytes / seconds ))
+         ("mps", uint64_t( message_count / seconds )) );
+}
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE( stcp_socket_throughput_bench )
+{
+   try {
+#ifdef NDEBUG
+      const uint32_t message_count = 200000;
+#else
+      const uint32_t message_count = 20000;
+#endif
+      for( size_t payload_size : { size_t(100), size_t(1000), size_t(20000) } )
+      {
+         const message msg = make_message( payload_size );
+
+         {
+            loopback_connection_pair connections;
+            fc::time_point start = fc::time_point::now();
+            for( uint32_t i = 0; i < message_count; ++i )
+               connections.sender.send_message( msg );
+            connections.wait_for( message_count );
+            report( "one write per message", payload_size, message_count, fc::time_point::now() - start );
+         }
+
+         {
+            loopback_connection_pair connections;
+            size_t messages_per_batch = std::max<size_t>( 1, GRAPHENE_NET_MAX_SEND_BATCH_SIZE_IN_BYTES / ( sizeof(message_header) + payload_size ) );
+            std::vector<message> batch( messages_per_batch, msg );
+            fc::time_point start = fc::time_point::now();
+            uint32_t sent = 0;
+            while( sent < message_count )
+            {
+               if( message_count - sent < batch.size() )
+                  batch.resize( message_count - sent );
+               connections.sender.send_messages( batch );
+               sent += (uint32_t)batch.size();
+            }
+            connections.wait_for( message_count );
+            report( "batched writes", payload_size, message_count, fc::time_point::now() - start );
+         }
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
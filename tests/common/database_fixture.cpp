@@ -59,6 +59,11 @@ using std::cout;
 using std::cerr;
 
 database_fixture::database_fixture()
+   : database_fixture( boost::program_options::variables_map() )
+{
+}
+
+database_fixture::database_fixture( const boost::program_options::variables_map& account_history_options )
    : app(), db(*app.chain_database())
 {
    try {
@@ -106,7 +111,7 @@ database_fixture::database_fixture()
 
       // app.initialize();
       ahplugin->plugin_set_app(&app);
-      ahplugin->plugin_initialize(options);
+      ahplugin->plugin_initialize(account_history_options);
 
       nonlugin->plugin_set_app(&app);
       std::vector<string> vtr;
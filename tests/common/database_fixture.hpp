@@ -164,6 +164,8 @@ struct database_fixture {
    uint32_t anon_acct_count;
 
    database_fixture();
+   /// @param account_history_options options of the account history plugin, e.g. to keep history in its store
+   explicit database_fixture( const boost::program_options::variables_map& account_history_options );
    ~database_fixture();
 
    static fc::ecc::private_key generate_private_key(string seed);
@@ -0,0 +1,848 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * p2p propagation simulator running real graphene::net::node instances.
+ *
+ * N nodes are started in this process, each with its own p2p thread and a delegate that keeps a
+ * minimal in-memory chain instead of a database.  They are wired together on a configurable
+ * topology, and every link goes through a loopback TCP proxy that adds the link's latency and
+ * limits it to the link's bandwidth.  A block producer and a transaction stream inject items with
+ * node::broadcast(), and the nodes relay them with the real protocol, so every change to node.cpp
+ * shows up in the results.
+ *
+ * Nodes don't look for peers on their own and don't advertise addresses, so the topology stays
+ * the one configured as long as no link drops.  The seed determines the topology, the latencies
+ * and the workload; timings are real, so runs with the same seed are comparable but not identical.
+ */
+#include <algorithm>
+#include <deque>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <time.h>
+
+#include <fc/exception/exception.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/network/ip.hpp>
+#include <fc/network/tcp_socket.hpp>
+#include <fc/thread/thread.hpp>
+#include <fc/time.hpp>
+
+#include <graphene/chain/protocol/block.hpp>
+#include <graphene/net/core_messages.hpp>
+#include <graphene/net/message.hpp>
+#include <graphene/net/node.hpp>
+
+#include <boost/program_options.hpp>
+
+using namespace graphene::net;
+using namespace std;
+namespace bpo = boost::program_options;
+
+namespace {
+
+struct simulation_config
+{
+   uint32_t   node_count;
+   string     topology;
+   uint32_t   degree;
+   int64_t    min_latency;       // microseconds
+   int64_t    max_latency;       // microseconds
+   uint64_t   bandwidth;         // bytes per second
+   uint32_t   block_count;
+   int64_t    block_interval;    // microseconds
+   uint32_t   trx_per_block;
+   uint32_t   trx_size;
+   int64_t    processing_delay;  // microseconds
+   uint64_t   seed;
+};
+
+/// CPU time of the calling thread in microseconds
+int64_t current_thread_cpu_time()
+{
+#ifndef _WIN32
+   timespec cpu_time;
+   if( clock_gettime( CLOCK_THREAD_CPUTIME_ID, &cpu_time ) == 0 )
+      return int64_t( cpu_time.tv_sec ) * 1000000 + cpu_time.tv_nsec / 1000;
+#endif
+   return 0;
+}
+
+/**
+ * Forwards the connections of one link to the listening endpoint of a node, delaying everything by
+ * the link's latency and pacing it to the link's bandwidth.  Lives on the proxy thread.
+ */
+class delayed_link : public std::enable_shared_from_this<delayed_link>
+{
+public:
+   delayed_link( const fc::ip::endpoint& target, int64_t latency, uint64_t bandwidth ) :
+      _target( target ), _latency( latency ), _bandwidth( bandwidth )
+   {}
+
+   /// starts accepting connections, @return the endpoint to connect to instead of the target
+   fc::ip::endpoint start()
+   {
+      _server.listen( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ) );
+      auto self = shared_from_this();
+      _tasks.push_back( fc::async( [self]() { self->accept_loop(); }, "delayed_link accept" ) );
+      return fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), _server.get_port() );
+   }
+
+   void close()
+   {
+      _server.close();
+      for( const auto& socket : _sockets )
+      {
+         try
+         {
+            socket->close();
+         }
+         catch( const fc::exception& )
+         {
+         }
+      }
+      for( auto& task : _tasks )
+      {
+         try
+         {
+            if( task.valid() && !task.ready() )
+               task.cancel_and_wait( "simulation finished" );
+         }
+         catch( const fc::exception& )
+         {
+         }
+      }
+   }
+
+private:
+   struct direction
+   {
+      std::shared_ptr<fc::tcp_socket>                             from;
+      std::shared_ptr<fc::tcp_socket>                             to;
+      std::deque<std::pair<fc::time_point, std::vector<char> > >  chunks;   // data and when it may arrive
+      fc::promise<void>::ptr                                      chunk_arrived;
+      fc::time_point                                              link_free;
+      bool                                                        closed = false;
+   };
+
+   void accept_loop()
+   {
+      while( true )
+      {
+         auto incoming = std::make_shared<fc::tcp_socket>();
+         _server.accept( *incoming );
+         auto outgoing = std::make_shared<fc::tcp_socket>();
+         try
+         {
+            outgoing->connect_to( _target );
+         }
+         catch( const fc::exception& e )
+         {
+            wlog( "link can't reach ${t}: ${e}", ("t", _target)("e", e.to_string()) );
+            incoming->close();
+            continue;
+         }
+         _sockets.push_back( incoming );
+         _sockets.push_back( outgoing );
+         forward( incoming, outgoing );
+         forward( outgoing, incoming );
+      }
+   }
+
+   void forward( const std::shared_ptr<fc::tcp_socket>& from, const std::shared_ptr<fc::tcp_socket>& to )
+   {
+      auto d = std::make_shared<direction>();
+      d->from = from;
+      d->to = to;
+      auto self = shared_from_this();
+      _tasks.push_back( fc::async( [self, d]() { self->read_loop( d ); }, "delayed_link read" ) );
+      _tasks.push_back( fc::async( [self, d]() { self->write_loop( d ); }, "delayed_link write" ) );
+   }
+
+   void read_loop( const std::shared_ptr<direction>& d )
+   {
+      std::vector<char> buffer( 64 * 1024 );
+      try
+      {
+         while( true )
+         {
+            size_t bytes = d->from->readsome( buffer.data(), buffer.size() );
+            d->chunks.emplace_back( fc::time_point::now() + fc::microseconds( _latency ),
+                                    std::vector<char>( buffer.begin(), buffer.begin() + bytes ) );
+            wake_writer( *d );
+         }
+      }
+      catch( const fc::exception& )
+      {
+      }
+      d->closed = true;
+      wake_writer( *d );
+   }
+
+   void write_loop( const std::shared_ptr<direction>& d )
+   {
+      try
+      {
+         while( !d->chunks.empty() || !d->closed )
+         {
+            if( d->chunks.empty() )
+            {
+               d->chunk_arrived = fc::promise<void>::ptr( new fc::promise<void>( "delayed_link chunk" ) );
+               d->chunk_arrived->wait();
+               d->chunk_arrived.reset();
+               continue;
+            }
+            std::vector<char> data = std::move( d->chunks.front().second );
+            fc::time_point ready = std::max( d->chunks.front().first, d->link_free );
+            d->chunks.pop_front();
+
+            // the link carries one chunk at a time
+            fc::time_point delivered = ready + fc::microseconds( int64_t( data.size() * 1000000 / _bandwidth ) );
+            fc::time_point now = fc::time_point::now();
+            if( delivered > now )
+               fc::usleep( delivered - now );
+            d->to->write( data.data(), data.size() );
+            d->link_free = delivered;
+         }
+      }
+      catch( const fc::exception& )
+      {
+      }
+      try
+      {
+         d->to->close();
+      }
+      catch( const fc::exception& )
+      {
+      }
+   }
+
+   static void wake_writer( direction& d )
+   {
+      if( d.chunk_arrived && !d.chunk_arrived->ready() )
+         d.chunk_arrived->set_value();
+   }
+
+   fc::ip::endpoint                                 _target;
+   int64_t                                          _latency;
+   uint64_t                                         _bandwidth;
+   fc::tcp_server                                   _server;
+   std::vector<std::shared_ptr<fc::tcp_socket> >    _sockets;
+   std::vector<fc::future<void> >                   _tasks;
+};
+
+/**
+ * Stands in for the application: keeps the blocks and transactions the node delivered, in memory
+ * and without validation, and notes when each one first arrived.  Runs on its own thread.
+ */
+class simulated_node_delegate : public node_delegate
+{
+public:
+   explicit simulated_node_delegate( const simulation_config& config ) : _config( config ) {}
+
+   /// adds an item produced at this node, as the application does before broadcasting it
+   void add_block( const graphene::chain::signed_block& block )
+   {
+      store_block( block.id(), block );
+   }
+   void add_transaction( const trx_message& trx )
+   {
+      store_transaction( message( trx ).id(), trx );
+   }
+
+   bool has_item( const item_id& id ) override
+   {
+      if( id.item_type == block_message_type )
+      {
+         auto itr = _blocks.find( graphene::chain::block_header::num_from_id( id.item_hash ) );
+         return itr != _blocks.end() && itr->second.first == id.item_hash;
+      }
+      return _transactions.find( id.item_hash ) != _transactions.end();
+   }
+
+   bool handle_block( const block_message& blk_msg, bool sync_mode,
+                      std::vector<fc::uint160_t>& contained_transaction_message_ids ) override
+   {
+      if( has_item( item_id( block_message_type, blk_msg.block_id ) ) )
+      {
+         ++duplicate_items;
+         return false;
+      }
+      // validation time, the node waits for it before relaying the block
+      if( _config.processing_delay > 0 )
+         fc::usleep( fc::microseconds( _config.processing_delay ) );
+      store_block( blk_msg.block_id, blk_msg.block );
+      for( const auto& trx : blk_msg.block.transactions )
+         contained_transaction_message_ids.push_back( message( trx_message( trx ) ).id() );
+      return false;
+   }
+
+   void handle_transaction( const trx_message& trx_msg ) override
+   {
+      item_hash_t id = message( trx_msg ).id();
+      if( _transactions.find( id ) != _transactions.end() )
+      {
+         ++duplicate_items;
+         return;
+      }
+      store_transaction( id, trx_msg );
+   }
+
+   void handle_message( const message& ) override {}
+
+   std::vector<item_hash_t> get_block_ids( const std::vector<item_hash_t>& blockchain_synopsis,
+                                           uint32_t& remaining_item_count, uint32_t limit ) override
+   {
+      std::vector<item_hash_t> result;
+      remaining_item_count = 0;
+      uint32_t last_known = 0;
+      for( auto itr = blockchain_synopsis.rbegin(); itr != blockchain_synopsis.rend(); ++itr )
+         if( *itr == item_hash_t() ||
+             ( has_item( item_id( block_message_type, *itr ) ) &&
+               graphene::chain::block_header::num_from_id( *itr ) <= _head_num ) )
+         {
+            last_known = graphene::chain::block_header::num_from_id( *itr );
+            break;
+         }
+      for( uint32_t num = std::max<uint32_t>( last_known, 1 ); num <= _head_num && result.size() < limit; ++num )
+         result.push_back( _blocks[num].first );
+      if( !result.empty() )
+         remaining_item_count = _head_num - graphene::chain::block_header::num_from_id( result.back() );
+      return result;
+   }
+
+   message get_item( const item_id& id ) override
+   {
+      if( id.item_type == block_message_type )
+      {
+         auto itr = _blocks.find( graphene::chain::block_header::num_from_id( id.item_hash ) );
+         if( itr != _blocks.end() && itr->second.first == id.item_hash )
+            return block_message( itr->second.second );
+      }
+      else
+      {
+         auto itr = _transactions.find( id.item_hash );
+         if( itr != _transactions.end() )
+            return itr->second;
+      }
+      FC_THROW_EXCEPTION( fc::key_not_found_exception, "item not found" );
+   }
+
+   graphene::chain::chain_id_type get_chain_id()const override
+   {
+      return graphene::chain::chain_id_type();
+   }
+
+   std::vector<item_hash_t> get_blockchain_synopsis( const item_hash_t& reference_point,
+                                                     uint32_t number_of_blocks_after_reference_point ) override
+   {
+      uint32_t high = _head_num;
+      if( reference_point != item_hash_t() )
+         high = std::min( high, graphene::chain::block_header::num_from_id( reference_point ) );
+      std::vector<item_hash_t> synopsis;
+      for( uint32_t distance = 0, num = high; num > 0; )
+      {
+         synopsis.push_back( _blocks[num].first );
+         distance = distance ? distance * 2 : 1;
+         num = num > distance ? num - distance : 0;
+      }
+      std::reverse( synopsis.begin(), synopsis.end() );
+      return synopsis;
+   }
+
+   void sync_status( uint32_t, uint32_t ) override {}
+   void connection_count_changed( uint32_t ) override {}
+
+   uint32_t get_block_number( const item_hash_t& block_id ) override
+   {
+      return graphene::chain::block_header::num_from_id( block_id );
+   }
+
+   fc::time_point_sec get_block_time( const item_hash_t& block_id ) override
+   {
+      auto itr = _blocks.find( graphene::chain::block_header::num_from_id( block_id ) );
+      return itr != _blocks.end() && itr->second.first == block_id ? itr->second.second.timestamp : fc::time_point_sec();
+   }
+
+   item_hash_t get_head_block_id()const override
+   {
+      return _head_num ? _blocks.at( _head_num ).first : item_hash_t();
+   }
+
+   uint32_t estimate_last_known_fork_from_git_revision_timestamp( uint32_t )const override
+   {
+      return 0;
+   }
+
+   void error_encountered( const std::string& message, const fc::oexception& ) override
+   {
+      wlog( "${m}", ("m", message) );
+   }
+
+   uint8_t get_current_block_interval_in_seconds()const override
+   {
+      return uint8_t( std::max<int64_t>( _config.block_interval / 1000000, 1 ) );
+   }
+
+   std::map<uint32_t, fc::time_point>  block_arrival;          // by block number
+   std::map<item_hash_t, fc::time_point> transaction_arrival;
+   uint64_t                            duplicate_items = 0;    // items the node handed us again
+
+private:
+   void store_block( const item_hash_t& id, const graphene::chain::signed_block& block )
+   {
+      uint32_t num = block.block_num();
+      _blocks[num] = std::make_pair( id, block );
+      block_arrival.emplace( num, fc::time_point::now() );
+      // blocks may arrive out of order, the chain we offer to peers is the linked part
+      while( _blocks.find( _head_num + 1 ) != _blocks.end() )
+         ++_head_num;
+   }
+
+   void store_transaction( const item_hash_t& id, const trx_message& trx )
+   {
+      _transactions[id] = trx;
+      transaction_arrival.emplace( id, fc::time_point::now() );
+   }
+
+   const simulation_config&                                                _config;
+   std::map<uint32_t, std::pair<item_hash_t, graphene::chain::signed_block> > _blocks;
+   uint32_t                                                                _head_num = 0;
+   std::map<item_hash_t, trx_message>                                      _transactions;
+};
+
+struct simulated_node
+{
+   std::shared_ptr<fc::thread>               delegate_thread;
+   std::unique_ptr<simulated_node_delegate>  delegate;
+   std::shared_ptr<node>                     p2p_node;
+   fc::temp_directory                        data_dir;
+   std::vector<uint32_t>                     peers;
+
+   int64_t  node_cpu_start = 0;
+   int64_t  delegate_cpu_start = 0;
+   int64_t  node_cpu = 0;
+   int64_t  delegate_cpu = 0;
+   uint64_t messages_received = 0;
+   uint64_t bytes_received = 0;
+   uint64_t messages_sent = 0;
+   uint64_t bytes_sent = 0;
+   uint64_t inventory_messages_received = 0;
+   uint64_t duplicate_items = 0;
+};
+
+class network_simulation
+{
+public:
+   explicit network_simulation( const simulation_config& config ) :
+      _config( config ),
+      _random( config.seed ),
+      _proxy_thread( "network simulator links" )
+   {}
+
+   ~network_simulation()
+   {
+      for( auto& n : _nodes )
+         if( n->p2p_node )
+            n->p2p_node->close();
+      _proxy_thread.async( [this]() {
+         for( const auto& link : _links )
+            link->close();
+      } ).wait();
+      for( auto& n : _nodes )
+         n->p2p_node.reset();
+      _links.clear();
+   }
+
+   void start()
+   {
+      for( uint32_t i = 0; i < _config.node_count; ++i )
+         start_node( i );
+      build_topology();
+
+      // wait until every link carries a connection
+      fc::time_point deadline = fc::time_point::now() + fc::seconds( 30 );
+      while( fc::time_point::now() < deadline && !all_connected() )
+         fc::usleep( fc::milliseconds( 100 ) );
+      if( !all_connected() )
+         std::cerr << "WARNING: not every link got connected, results include the missing links\n";
+   }
+
+   void run()
+   {
+      for( auto& n : _nodes )
+      {
+         n->node_cpu_start = node_cpu_time( *n );
+         n->delegate_cpu_start = n->delegate_thread->async( []() { return current_thread_cpu_time(); } ).wait();
+      }
+
+      fc::time_point start = fc::time_point::now();
+      graphene::chain::block_id_type previous;
+      uint32_t trx_sequence = 0;
+      for( uint32_t block_num = 1; block_num <= _config.block_count; ++block_num )
+      {
+         // transactions spread evenly over each block interval, then the block that includes them
+         fc::time_point interval_start = start + fc::microseconds( ( block_num - 1 ) * _config.block_interval );
+         graphene::chain::signed_block block;
+         for( uint32_t i = 0; i < _config.trx_per_block; ++i )
+         {
+            sleep_until( interval_start + fc::microseconds( ( i * _config.block_interval ) / ( _config.trx_per_block + 1 ) ) );
+            trx_message trx( make_transaction( trx_sequence++ ) );
+            simulated_node& origin = *_nodes[ uniform( 0, _config.node_count - 1 ) ];
+            origin.delegate_thread->async( [&]() { origin.delegate->add_transaction( trx ); } ).wait();
+            _transaction_origin[ message( trx ).id() ] = fc::time_point::now();
+            origin.p2p_node->broadcast( trx );
+            block.transactions.push_back( graphene::chain::processed_transaction( trx.trx ) );
+         }
+
+         sleep_until( interval_start + fc::microseconds( _config.block_interval - 1 ) );
+         block.previous = previous;
+         block.timestamp = fc::time_point::now();
+         block.witness = ( block_num - 1 ) % _config.node_count;
+         block.transaction_merkle_root = block.calculate_merkle_root();
+         previous = block.id();
+         simulated_node& producer = *_nodes[ ( block_num - 1 ) % _config.node_count ];
+         producer.delegate_thread->async( [&]() { producer.delegate->add_block( block ); } ).wait();
+         _block_origin[ block_num ] = fc::time_point::now();
+         _block_size += fc::raw::pack_size( block );
+         producer.p2p_node->broadcast( block_message( block ) );
+      }
+
+      // let the last block reach everybody
+      fc::usleep( fc::microseconds( 2 * _config.max_latency * _config.node_count / std::max<uint32_t>( _config.degree, 1 ) )
+                  + fc::seconds( 2 ) );
+      collect();
+   }
+
+   void report( ostream& out )const
+   {
+      vector<int64_t> arrival_delays;       // every (block, node) pair
+      vector<int64_t> full_coverage_delays; // per block, time until the last node has it
+      vector<int64_t> transaction_delays;
+      uint64_t unreached = 0;
+      for( const auto& block_and_origin : _block_origin )
+      {
+         int64_t slowest = 0;
+         for( const auto& arrivals : _block_arrivals )
+         {
+            auto itr = arrivals.find( block_and_origin.first );
+            if( itr == arrivals.end() )
+            {
+               ++unreached;
+               continue;
+            }
+            int64_t delay = ( itr->second - block_and_origin.second ).count();
+            arrival_delays.push_back( delay );
+            slowest = std::max( slowest, delay );
+         }
+         full_coverage_delays.push_back( slowest );
+      }
+      for( const auto& arrivals : _transaction_arrivals )
+         for( const auto& arrival : arrivals )
+         {
+            auto itr = _transaction_origin.find( arrival.first );
+            if( itr != _transaction_origin.end() )
+               transaction_delays.push_back( ( arrival.second - itr->second ).count() );
+         }
+      sort( arrival_delays.begin(), arrival_delays.end() );
+      sort( full_coverage_delays.begin(), full_coverage_delays.end() );
+      sort( transaction_delays.begin(), transaction_delays.end() );
+
+      uint64_t total_messages = 0, total_bytes = 0, inventory_messages = 0;
+      for( const auto& n : _nodes )
+      {
+         total_messages += n->messages_received;
+         total_bytes += n->bytes_received;
+         inventory_messages += n->inventory_messages_received;
+      }
+      const uint64_t items = _block_origin.size() + _transaction_origin.size();
+
+      out << "nodes: " << _nodes.size() << ", topology: " << _config.topology << ", links: " << _links.size()
+          << ", seed: " << _config.seed << "\n";
+      out << "items injected: " << items << " (" << _block_origin.size() << " blocks of "
+          << ( _block_origin.empty() ? 0 : _block_size / _block_origin.size() ) << " bytes)\n";
+      out << "block propagation to each node (ms):  p50 " << percentile_ms( arrival_delays, 50 )
+          << "  p90 " << percentile_ms( arrival_delays, 90 )
+          << "  p99 " << percentile_ms( arrival_delays, 99 )
+          << "  max " << percentile_ms( arrival_delays, 100 ) << "\n";
+      out << "block propagation to all nodes (ms):  p50 " << percentile_ms( full_coverage_delays, 50 )
+          << "  p90 " << percentile_ms( full_coverage_delays, 90 )
+          << "  max " << percentile_ms( full_coverage_delays, 100 ) << "\n";
+      out << "transaction propagation to each node (ms):  p50 " << percentile_ms( transaction_delays, 50 )
+          << "  p90 " << percentile_ms( transaction_delays, 90 )
+          << "  max " << percentile_ms( transaction_delays, 100 ) << "\n";
+      if( unreached )
+         out << "WARNING: " << unreached << " block deliveries never happened\n";
+      out << "messages: " << total_messages << ", bytes: " << total_bytes
+          << ", inventory messages per item and node: " << std::fixed << std::setprecision(2)
+          << ( items ? double( inventory_messages ) / ( items * _nodes.size() ) : 0.0 ) << "\n";
+      out << "\n  node    peers    msgs in    bytes in   msgs out   bytes out  inventory  duplicates  p2p cpu (ms)  delegate cpu (ms)\n";
+      for( uint32_t i = 0; i < _nodes.size(); ++i )
+      {
+         const simulated_node& n = *_nodes[i];
+         out << std::setw(6) << i
+             << std::setw(8) << n.peers.size()
+             << std::setw(11) << n.messages_received
+             << std::setw(12) << n.bytes_received
+             << std::setw(11) << n.messages_sent
+             << std::setw(12) << n.bytes_sent
+             << std::setw(11) << n.inventory_messages_received
+             << std::setw(12) << n.duplicate_items
+             << std::setw(14) << std::setprecision(1) << n.node_cpu / 1000.0
+             << std::setw(19) << n.delegate_cpu / 1000.0 << "\n";
+      }
+   }
+
+private:
+   static double percentile_ms( const vector<int64_t>& sorted_values, uint32_t pct )
+   {
+      if( sorted_values.empty() )
+         return 0;
+      size_t index = std::min( sorted_values.size() - 1, ( sorted_values.size() * pct ) / 100 );
+      return sorted_values[index] / 1000.0;
+   }
+
+   static void sleep_until( const fc::time_point& when )
+   {
+      fc::time_point now = fc::time_point::now();
+      if( when > now )
+         fc::usleep( when - now );
+   }
+
+   uint32_t uniform( uint32_t low, uint32_t high )
+   {
+      return std::uniform_int_distribution<uint32_t>( low, high )( _random );
+   }
+
+   /// a transaction of about trx_size bytes, padded with signatures
+   graphene::chain::signed_transaction make_transaction( uint32_t sequence )const
+   {
+      graphene::chain::signed_transaction trx;
+      trx.ref_block_prefix = sequence;
+      trx.set_expiration( fc::time_point::now() + fc::hours( 1 ) );
+      while( fc::raw::pack_size( trx ) + sizeof( graphene::chain::signature_type ) <= _config.trx_size )
+         trx.signatures.push_back( graphene::chain::signature_type() );
+      return trx;
+   }
+
+   void start_node( uint32_t index )
+   {
+      auto n = std::make_shared<simulated_node>();
+      n->delegate_thread = std::make_shared<fc::thread>( "simulated node " + fc::to_string( uint64_t( index ) ) );
+      n->delegate.reset( new simulated_node_delegate( _config ) );
+      n->p2p_node = std::make_shared<node>( "network simulator" );
+      n->p2p_node->load_configuration( n->data_dir.path() );
+      n->p2p_node->listen_on_endpoint( fc::ip::endpoint( fc::ip::address( "127.0.0.1" ), 0 ), false );
+      n->p2p_node->disable_peer_advertising();
+      // only the configured links, no slow peer replacement that would break the topology
+      fc::mutable_variant_object params;
+      params["desired_number_of_connections"] = 0;
+      params["maximum_number_of_connections"] = _config.node_count;
+      params["slow_peer_replacement_interval"] = 0;
+      n->p2p_node->set_advanced_node_parameters( params );
+      simulated_node& sn = *n;
+      // delegate calls are made on the thread that sets the delegate
+      n->delegate_thread->async( [&sn]() { sn.p2p_node->set_node_delegate( sn.delegate.get() ); } ).wait();
+      n->p2p_node->sync_from( item_id( block_message_type, item_hash_t() ), std::vector<uint32_t>() );
+      n->p2p_node->listen_to_p2p_network();
+      n->p2p_node->connect_to_p2p_network();
+      _nodes.push_back( n );
+   }
+
+   void connect( uint32_t a, uint32_t b )
+   {
+      if( a == b || std::find( _nodes[a]->peers.begin(), _nodes[a]->peers.end(), b ) != _nodes[a]->peers.end() )
+         return;
+      int64_t latency = std::uniform_int_distribution<int64_t>( _config.min_latency, _config.max_latency )( _random );
+      auto link = std::make_shared<delayed_link>( _nodes[b]->p2p_node->get_actual_listening_endpoint(), latency, _config.bandwidth );
+      fc::ip::endpoint proxy_endpoint = _proxy_thread.async( [link]() { return link->start(); } ).wait();
+      _links.push_back( link );
+      _nodes[a]->peers.push_back( b );
+      _nodes[b]->peers.push_back( a );
+      _nodes[a]->p2p_node->connect_to_endpoint( proxy_endpoint );
+   }
+
+   void build_topology()
+   {
+      uint32_t n = _config.node_count;
+      if( _config.topology == "ring" )
+      {
+         for( uint32_t i = 0; i < n; ++i )
+            connect( i, ( i + 1 ) % n );
+      }
+      else if( _config.topology == "full" )
+      {
+         for( uint32_t i = 0; i < n; ++i )
+            for( uint32_t j = i + 1; j < n; ++j )
+               connect( i, j );
+      }
+      else if( _config.topology == "star" )
+      {
+         for( uint32_t i = 1; i < n; ++i )
+            connect( 0, i );
+      }
+      else
+      {
+         FC_ASSERT( _config.topology == "random", "unknown topology ${t}", ("t", _config.topology) );
+         // a ring guarantees the graph is connected, the rest of the links are random
+         for( uint32_t i = 0; i < n; ++i )
+            connect( i, ( i + 1 ) % n );
+         for( uint32_t i = 0; i < n; ++i )
+         {
+            uint32_t attempts = 0;
+            while( _nodes[i]->peers.size() < _config.degree && attempts++ < 10 * n )
+               connect( i, uniform( 0, n - 1 ) );
+         }
+      }
+   }
+
+   bool all_connected()const
+   {
+      for( const auto& n : _nodes )
+         if( n->p2p_node->get_connection_count() < n->peers.size() )
+            return false;
+      return true;
+   }
+
+   static int64_t node_cpu_time( simulated_node& n )
+   {
+      fc::variant_object usage = n.p2p_node->network_get_usage_stats();
+      return usage.contains( "thread_cpu_time_us" ) ? usage["thread_cpu_time_us"].as_int64() : 0;
+   }
+
+   void collect()
+   {
+      for( auto& n : _nodes )
+      {
+         n->node_cpu = node_cpu_time( *n ) - n->node_cpu_start;
+         simulated_node& sn = *n;
+         n->delegate_cpu = n->delegate_thread->async( []() { return current_thread_cpu_time(); } ).wait() - n->delegate_cpu_start;
+         n->delegate_thread->async( [&]() {
+            _block_arrivals.push_back( sn.delegate->block_arrival );
+            _transaction_arrivals.push_back( sn.delegate->transaction_arrival );
+            sn.duplicate_items = sn.delegate->duplicate_items;
+         } ).wait();
+
+         fc::variant_object counters = n->p2p_node->network_get_info()["message_counters"].get_object();
+         for( const auto& type_and_counters : counters )
+         {
+            const fc::variant_object& c = type_and_counters.value().get_object();
+            n->messages_received += c["messages_received"].as_uint64();
+            n->bytes_received += c["bytes_received"].as_uint64();
+            n->messages_sent += c["messages_sent"].as_uint64();
+            n->bytes_sent += c["bytes_sent"].as_uint64();
+            if( type_and_counters.key() == "item_ids_inventory_message_type" )
+               n->inventory_messages_received += c["messages_received"].as_uint64();
+         }
+      }
+   }
+
+   simulation_config                                   _config;
+   std::mt19937_64                                     _random;
+   fc::thread                                          _proxy_thread;
+   vector<std::shared_ptr<simulated_node> >            _nodes;
+   vector<std::shared_ptr<delayed_link> >              _links;
+   std::map<uint32_t, fc::time_point>                  _block_origin;
+   std::map<item_hash_t, fc::time_point>               _transaction_origin;
+   uint64_t                                            _block_size = 0;
+   vector<std::map<uint32_t, fc::time_point> >         _block_arrivals;        // per node
+   vector<std::map<item_hash_t, fc::time_point> >      _transaction_arrivals;  // per node
+};
+
+} // anonymous namespace
+
+int main( int argc, char** argv )
+{
+   try
+   {
+      bpo::options_description cli_options("Graphene p2p propagation simulator");
+      cli_options.add_options()
+            ("help,h", "Print this help message and exit.")
+            ("nodes,n", bpo::value<uint32_t>()->default_value(20), "Number of nodes")
+            ("topology", bpo::value<string>()->default_value("random"), "Network topology: random, ring, star or full")
+            ("degree", bpo::value<uint32_t>()->default_value(8), "Number of peers per node for the random topology")
+            ("min-latency-ms", bpo::value<uint32_t>()->default_value(20), "Minimum one-way link latency")
+            ("max-latency-ms", bpo::value<uint32_t>()->default_value(150), "Maximum one-way link latency")
+            ("bandwidth", bpo::value<uint64_t>()->default_value(1250000), "Link bandwidth in bytes per second")
+            ("blocks,b", bpo::value<uint32_t>()->default_value(20), "Number of blocks to produce")
+            ("block-interval-ms", bpo::value<uint32_t>()->default_value(3000), "Time between blocks")
+            ("trx-per-block", bpo::value<uint32_t>()->default_value(50), "Transactions broadcast during each block interval and included in the block")
+            ("trx-size", bpo::value<uint32_t>()->default_value(300), "Approximate size of each transaction in bytes")
+            ("processing-delay-ms", bpo::value<uint32_t>()->default_value(10), "Time a node needs to validate a block before relaying it")
+            ("seed", bpo::value<uint64_t>()->default_value(1), "Random seed for topology and workload")
+            ;
+
+      bpo::variables_map options;
+      try
+      {
+         boost::program_options::store( boost::program_options::parse_command_line(argc, argv, cli_options), options );
+      }
+      catch (const boost::program_options::error& e)
+      {
+         std::cerr << "network_simulator:  error parsing command line: " << e.what() << "\n";
+         return 1;
+      }
+
+      if( options.count("help") )
+      {
+         std::cout << cli_options << "\n";
+         return 0;
+      }
+
+      simulation_config config;
+      config.node_count       = options["nodes"].as<uint32_t>();
+      config.topology         = options["topology"].as<string>();
+      config.degree           = options["degree"].as<uint32_t>();
+      config.min_latency      = int64_t( options["min-latency-ms"].as<uint32_t>() ) * 1000;
+      config.max_latency      = int64_t( options["max-latency-ms"].as<uint32_t>() ) * 1000;
+      config.bandwidth        = options["bandwidth"].as<uint64_t>();
+      config.block_count      = options["blocks"].as<uint32_t>();
+      config.block_interval   = int64_t( options["block-interval-ms"].as<uint32_t>() ) * 1000;
+      config.trx_per_block    = options["trx-per-block"].as<uint32_t>();
+      config.trx_size         = options["trx-size"].as<uint32_t>();
+      config.processing_delay = int64_t( options["processing-delay-ms"].as<uint32_t>() ) * 1000;
+      config.seed             = options["seed"].as<uint64_t>();
+
+      FC_ASSERT( config.node_count >= 2, "need at least two nodes" );
+      FC_ASSERT( config.min_latency <= config.max_latency, "min-latency-ms must not exceed max-latency-ms" );
+      FC_ASSERT( config.bandwidth > 0, "bandwidth must be positive" );
+      FC_ASSERT( config.block_interval > 0, "block-interval-ms must be positive" );
+
+      network_simulation simulation( config );
+      simulation.start();
+      simulation.run();
+      simulation.report( std::cout );
+   }
+   catch ( const fc::exception& e )
+   {
+      std::cout << e.to_detail_string() << "\n";
+      return 1;
+   }
+   return 0;
+}
@@ -0,0 +1,191 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/market_history/market_history_plugin.hpp>
+
+#include <fc/io/json.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::market_history;
+
+namespace {
+
+const uint32_t markets = 4;
+
+/// Fills crossing orders in a few markets, with the market history plugin loaded
+struct market_history_fill_fixture : database_fixture
+{
+   market_history_plugin* plugin = nullptr;
+
+   /**
+    * Starts the plugin with @p args and creates the market assets.
+    * The fixture does not load the market history plugin itself.
+    */
+   void start( const std::vector<std::string>& args, bool merge_fills )
+   {
+      ACTORS((1000)(2000));
+      seller = u_1000_id;
+      seller_key = u_1000_private_key;
+      buyer = u_2000_id;
+      buyer_key = u_2000_private_key;
+
+      const share_type prec = asset::scaled_precision(asset_id_type()(db).precision);
+      transfer(committee_account, u_1000_id, asset(10000 * prec));
+      transfer(committee_account, u_2000_id, asset(10000 * prec));
+      add_csaf_for_account(u_1000_id, 10000);
+      add_csaf_for_account(u_2000_id, 10000);
+      generate_blocks(HARDFORK_0_5_TIME, true);
+
+      auto mhplugin = app.register_plugin<market_history_plugin>();
+      boost::program_options::options_description cli, cfg;
+      mhplugin->plugin_set_program_options(cli, cfg);
+      boost::program_options::variables_map options;
+      boost::program_options::store(boost::program_options::command_line_parser(args).options(cli).run(), options);
+      boost::program_options::notify(options);
+      mhplugin->plugin_set_app(&app);
+      mhplugin->plugin_initialize(options);
+      mhplugin->plugin_startup();
+      mhplugin->set_merge_fills(merge_fills);
+      plugin = mhplugin.get();
+
+      asset_options aopts;
+      aopts.max_supply = 100000000 * prec;
+      aopts.issuer_permissions = 15;
+      aopts.description = "benchmark asset";
+      for (uint32_t m = 0; m < markets; ++m)
+         create_asset({ seller_key }, seller, "MKT" + std::string(1, char('A' + m)), 5, aopts, 100000000 * prec);
+      generate_block();
+   }
+
+   /// @return the time spent applying @p blocks blocks with @p fills_per_market pairs of filled orders in every market
+   fc::microseconds fill( uint32_t blocks, uint32_t fills_per_market )
+   {
+      fc::microseconds total;
+      for (uint32_t b = 0; b < blocks; ++b)
+      {
+         const uint32_t expiration = db.head_block_time().sec_since_epoch() + 3600;
+         for (uint32_t m = 0; m < markets; ++m)
+         {
+            const asset_aid_type mkt = m + 1;
+            for (uint32_t j = 1; j <= fills_per_market; ++j)
+            {
+               // crossing orders at a different price every time, every pair fills completely
+               create_limit_order({ seller_key }, seller, mkt, 10 * j + b, GRAPHENE_CORE_ASSET_AID, j, expiration, false);
+               create_limit_order({ buyer_key }, buyer, GRAPHENE_CORE_ASSET_AID, j, mkt, 10 * j + b, expiration, false);
+            }
+         }
+
+         auto start = fc::time_point::now();
+         generate_block();
+         total += fc::time_point::now() - start;
+      }
+      return total;
+   }
+
+   /// @return the objects of @p Index as JSON, for comparing the state of two databases
+   template<typename Index>
+   std::string dump()const
+   {
+      vector<typename Index::object_type> objects;
+      for (const auto& o : db.get_index_type<Index>().indices())
+         objects.push_back(o);
+      return fc::json::to_string(fc::variant(objects, GRAPHENE_NET_MAX_NESTED_OBJECTS));
+   }
+
+   account_uid_type seller = 0;
+   fc::ecc::private_key seller_key;
+   account_uid_type buyer = 0;
+   fc::ecc::private_key buyer_key;
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_CASE(market_history_merged_fills_test)
+{
+   try
+   {
+      // small limits, so that buckets expire and order history is pruned while filling
+      const std::vector<std::string> args = { "--bucket-size=[15,60]", "--history-per-size=2",
+                                              "--max-order-his-records-per-market=30",
+                                              "--max-order-his-seconds-per-market=0" };
+      std::string buckets[2], tickers[2], histories[2];
+      for (int merge = 0; merge < 2; ++merge)
+      {
+         market_history_fill_fixture f;
+         f.start(args, merge != 0);
+         f.fill(30, 10);
+         buckets[merge] = f.dump<bucket_index>();
+         tickers[merge] = f.dump<market_ticker_index>();
+         histories[merge] = f.dump<history_index>();
+
+         const auto& bucket_idx = f.db.get_index_type<bucket_index>().indices();
+         BOOST_CHECK_EQUAL(f.db.get_index_type<market_ticker_index>().indices().size(), markets);
+         for (uint32_t m = 1; m <= markets; ++m)
+         {
+            // 90 seconds of fills, the expired buckets are gone
+            uint32_t small_buckets = 0;
+            for (const auto& b : bucket_idx)
+               if (b.key.quote == m && b.key.seconds == 15)
+                  ++small_buckets;
+            BOOST_CHECK_EQUAL(small_buckets, 3u);
+         }
+         BOOST_CHECK_LE(f.db.get_index_type<history_index>().indices().size(),
+                        size_t(markets) * 30);
+      }
+      BOOST_CHECK_EQUAL(buckets[0], buckets[1]);
+      BOOST_CHECK_EQUAL(tickers[0], tickers[1]);
+      BOOST_CHECK_EQUAL(histories[0], histories[1]);
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_AUTO_TEST_CASE(market_history_fill_benchmark)
+{
+   try
+   {
+      const uint32_t blocks = 20;
+      const uint32_t fills_per_market = 50;
+      const uint64_t fills = uint64_t(blocks) * markets * fills_per_market * 2;
+      fc::microseconds total[2];
+      for (int merge = 0; merge < 2; ++merge)
+      {
+         market_history_fill_fixture f;
+         f.start(std::vector<std::string>(), merge != 0);
+         total[merge] = f.fill(blocks, fills_per_market);
+         BOOST_CHECK_EQUAL(f.db.get_index_type<market_ticker_index>().indices().size(), markets);
+         BOOST_CHECK_GE(f.db.get_index_type<bucket_index>().indices().size(),
+                        markets * f.plugin->tracked_buckets().size());
+
+         wlog("${f} fills in ${b} blocks of ${m} markets, ${mode}: ${t}ms applying blocks, ${r} fills/s",
+              ("f", fills)("b", blocks)("m", markets)
+              ("mode", merge ? "merged per market" : "one fill at a time")("t", total[merge].count() / 1000)
+              ("r", fills * 1000000 / std::max<int64_t>(total[merge].count(), 1)));
+      }
+   }
+   FC_LOG_AND_RETHROW()
+}
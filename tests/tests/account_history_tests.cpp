@@ -0,0 +1,388 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <boost/test/unit_test.hpp>
+#include <boost/program_options.hpp>
+
+#include <graphene/account_history/account_history_plugin.hpp>
+#include <graphene/account_history/account_history_store.hpp>
+#include <graphene/app/api.hpp>
+#include <graphene/utilities/tempdir.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::account_history;
+
+namespace {
+
+boost::program_options::variables_map history_store_options( bool async )
+{
+   boost::program_options::variables_map options;
+   options.emplace( "account-history-store", boost::program_options::variable_value( true, false ) );
+   options.emplace( "account-history-async", boost::program_options::variable_value( async, false ) );
+   return options;
+}
+
+/// keeps account history in the store, indexing it while blocks are applied
+struct history_store_fixture : database_fixture
+{
+   history_store_fixture( bool async = false ) : database_fixture( history_store_options( async ) ) {}
+
+   std::shared_ptr<account_history_plugin> plugin()const
+   {
+      return app.get_plugin<account_history_plugin>( "account_history" );
+   }
+
+   /// waits until the indexing thread has caught up with the head block
+   void wait_for_indexing()
+   {
+      for( int i = 0; i < 1000 && plugin()->get_indexed_block_num() < db.head_block_num(); ++i )
+         fc::usleep( fc::milliseconds( 5 ) );
+      BOOST_REQUIRE_EQUAL( plugin()->get_indexed_block_num(), db.head_block_num() );
+   }
+
+   /// checks the whole history of @p account against the blocks and the account statistics
+   void check_history( account_uid_type account )
+   {
+      const uint32_t count = plugin()->get_account_operation_count( account );
+      BOOST_CHECK_EQUAL( count, db.get_account_statistics_by_uid( account ).total_ops );
+      const auto ops = plugin()->get_account_operations( account, optional<uint16_t>(), 0, 1, 10000 );
+      BOOST_REQUIRE_EQUAL( ops.size(), count );
+      for( size_t i = 0; i < ops.size(); ++i )
+      {
+         BOOST_CHECK_EQUAL( ops[i].first, count - i );
+         if( i > 0 )
+            BOOST_CHECK( ops[i].second.id < ops[i - 1].second.id );
+         const operation_history_object& op = ops[i].second;
+         BOOST_REQUIRE_LE( op.block_num, db.head_block_num() );
+         const auto block = db.fetch_block_by_number( op.block_num );
+         BOOST_REQUIRE( block.valid() );
+         // operations of popped blocks must not show up
+         if( op.trx_in_block < block->transactions.size() )
+         {
+            const auto& trx = block->transactions[op.trx_in_block];
+            BOOST_REQUIRE_LT( op.op_in_trx, trx.operations.size() );
+            BOOST_CHECK( fc::raw::pack( trx.operations[op.op_in_trx] ) == fc::raw::pack( op.op ) );
+         }
+      }
+   }
+};
+
+/// indexes account history into the store on its own thread
+struct async_history_store_fixture : history_store_fixture
+{
+   async_history_store_fixture() : history_store_fixture( true ) {}
+};
+
+} // anonymous namespace
+
+BOOST_AUTO_TEST_SUITE( account_history_tests )
+
+BOOST_AUTO_TEST_CASE( store_reopen )
+{
+   try {
+      fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+      const uint32_t accounts = 7;
+      const uint32_t operations = 1000;
+      const auto check = [&]( const account_history_store& store ) {
+         BOOST_CHECK_EQUAL( store.last_block_num(), operations );
+         BOOST_CHECK_EQUAL( store.operation_count(), operations );
+         for( uint32_t a = 0; a < accounts; ++a )
+         {
+            const uint32_t count = store.account_operation_count( 100 + a );
+            BOOST_REQUIRE_EQUAL( count, ( operations - a + accounts - 1 ) / accounts );
+            for( uint32_t sequence = 1; sequence <= count; sequence += 37 )
+            {
+               const auto entry = store.get_account_entry( 100 + a, sequence );
+               BOOST_CHECK_EQUAL( entry.operation, ( sequence - 1 ) * accounts + a );
+               BOOST_CHECK_EQUAL( entry.op_type, entry.operation % 3 );
+               BOOST_CHECK_EQUAL( store.get_operation( entry.operation ).block_num, entry.operation + 1 );
+               BOOST_CHECK_EQUAL( store.get_operation_block_num( entry.operation ), entry.operation + 1 );
+            }
+         }
+         BOOST_CHECK_EQUAL( store.account_operation_count( 99 ), 0u );
+      };
+
+      {
+         // a small cache, so pages are written out before they are committed
+         account_history_store store( 4 );
+         store.open( dir.path() );
+         operation_history_object op;
+         for( uint32_t i = 0; i < operations; ++i )
+         {
+            op.block_num = i + 1;
+            const uint64_t operation = store.append_operation( op );
+            store.append_account_operation( 100 + i % accounts, operation, i % 3 );
+            store.set_last_block_num( i + 1 );
+            if( i % 100 == 0 )
+               store.commit();
+         }
+         check( store );
+      }
+
+      // the directory is read instead of all pages
+      {
+         account_history_store store( 4 );
+         store.open( dir.path() );
+         check( store );
+      }
+
+      // without the directory all pages are read and the directory is written again
+      fc::remove( dir.path() / "accounts.directory" );
+      {
+         account_history_store store( 4 );
+         store.open( dir.path() );
+         check( store );
+      }
+      BOOST_CHECK( fc::exists( dir.path() / "accounts.directory" ) );
+
+      // the block numbers are read from the operations if they are missing
+      fc::remove( dir.path() / "operations.blocks" );
+      {
+         account_history_store store( 4 );
+         store.open( dir.path() );
+         check( store );
+      }
+      {
+         account_history_store store;
+         store.open( dir.path() );
+         check( store );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( store_pop_block_across_flush, history_store_fixture )
+{
+   try {
+      ACTORS((1000)(2000));
+      transfer( committee_account, u_1000_id, asset(1000) );
+      generate_block();
+      const uint32_t first_block = db.head_block_num();
+
+      // once irreversible the operations go to the store on disk
+      generate_blocks( 20 );
+      BOOST_REQUIRE_GE( plugin()->get_stored_block_num(), first_block );
+      BOOST_CHECK_EQUAL( plugin()->get_indexed_block_num(), db.head_block_num() );
+      const uint32_t stored_count = plugin()->get_account_operation_count( u_1000_id );
+      BOOST_REQUIRE_GT( stored_count, 0u );
+      check_history( u_1000_id );
+
+      // operations of reversible blocks are pending
+      transfer( committee_account, u_1000_id, asset(1) );
+      generate_block();
+      transfer( committee_account, u_1000_id, asset(2) );
+      generate_block();
+      const uint32_t popped_block = db.head_block_num();
+      BOOST_REQUIRE_LT( plugin()->get_stored_block_num(), popped_block - 1 );
+      BOOST_CHECK_EQUAL( plugin()->get_account_operation_count( u_1000_id ), stored_count + 2 );
+      check_history( u_1000_id );
+
+      // a popped block leaves the pending operations and the statistics
+      db.pop_block();
+      BOOST_CHECK_EQUAL( plugin()->get_account_operation_count( u_1000_id ), stored_count + 1 );
+      check_history( u_1000_id );
+
+      // its replacement takes its place
+      transfer( committee_account, u_1000_id, asset(3) );
+      transfer( committee_account, u_1000_id, asset(4) );
+      generate_block();
+      BOOST_CHECK_EQUAL( db.head_block_num(), popped_block );
+      BOOST_CHECK_GE( plugin()->get_account_operation_count( u_1000_id ), stored_count + 3 );
+      check_history( u_1000_id );
+      check_history( u_2000_id );
+
+      // and goes to disk with the rest
+      generate_blocks( 20 );
+      BOOST_REQUIRE_GE( plugin()->get_stored_block_num(), popped_block );
+      check_history( u_1000_id );
+
+      // operations between two ids are found by their sequence
+      const auto ops = plugin()->get_account_operations( u_1000_id, optional<uint16_t>(), 0, 1, 100 );
+      BOOST_REQUIRE_GE( ops.size(), 4u );
+      const auto between = plugin()->get_account_operations_by_id( u_1000_id, optional<uint16_t>(), ops[3].second.id,
+                                                                  100, ops[1].second.id );
+      BOOST_REQUIRE_EQUAL( between.size(), 2u );
+      BOOST_CHECK( between[0].id == ops[1].second.id );
+      BOOST_CHECK( between[1].id == ops[2].second.id );
+      const auto latest = plugin()->get_account_operations_by_id( u_1000_id, optional<uint16_t>(), ops[2].second.id,
+                                                                 1, operation_history_id_type() );
+      BOOST_REQUIRE_EQUAL( latest.size(), 1u );
+      BOOST_CHECK( latest[0].id == ops[0].second.id );
+
+      // on shutdown only irreversible blocks are written, the others are applied again on the next start
+      transfer( committee_account, u_1000_id, asset(5) );
+      generate_block();
+      const uint32_t irreversible_block_num = db.get_dynamic_global_properties().last_irreversible_block_num;
+      BOOST_REQUIRE_LT( irreversible_block_num, db.head_block_num() );
+      uint32_t irreversible_count = 0;
+      for( const auto& item : plugin()->get_account_operations( u_1000_id, optional<uint16_t>(), 0, 1, 10000 ) )
+         if( item.second.block_num <= irreversible_block_num )
+            ++irreversible_count;
+      plugin()->plugin_shutdown();
+      account_history_store store;
+      store.open( db.get_data_dir() / "database" / "account_history" );
+      BOOST_CHECK_EQUAL( store.last_block_num(), irreversible_block_num );
+      BOOST_CHECK_EQUAL( store.account_operation_count( u_1000_id ), irreversible_count );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( store_history_by_block_range, history_store_fixture )
+{
+   try {
+      ACTORS((1000)(2000));
+      const uint32_t first_block = db.head_block_num();
+      for( int i = 0; i < 30; ++i )
+      {
+         transfer( committee_account, u_1000_id, asset(100 + i) );
+         if( i % 3 == 0 )
+            transfer( u_1000_id, u_2000_id, asset(1) );
+         generate_block();
+      }
+      // some blocks are in the store on disk, the last ones are pending
+      BOOST_REQUIRE_GT( plugin()->get_stored_block_num(), first_block + 5 );
+      BOOST_REQUIRE_LT( plugin()->get_stored_block_num(), db.head_block_num() );
+
+      graphene::app::history_api hist_api( app );
+      auto all = plugin()->get_account_operations( u_1000_id, optional<uint16_t>(), 0, 1, 10000 );
+      std::reverse( all.begin(), all.end() );
+      const uint16_t transfer_type = operation::tag<transfer_operation>::value;
+
+      const auto check_range = [&]( optional<uint16_t> op_type, uint32_t start_block, uint32_t end_block ) {
+         vector<std::pair<uint32_t,operation_history_object>> expected;
+         for( const auto& item : all )
+            if( item.second.block_num >= start_block && item.second.block_num < end_block
+                && ( !op_type.valid() || item.second.op.which() == *op_type ) )
+               expected.push_back( item );
+
+         vector<std::pair<uint32_t,operation_history_object>> paged;
+         string cursor;
+         do
+         {
+            auto p = hist_api.get_account_history_by_block_range( u_1000_id, op_type, start_block, end_block, cursor, 2 );
+            BOOST_CHECK_LE( p.items.size(), 2u );
+            paged.insert( paged.end(), p.items.begin(), p.items.end() );
+            cursor = p.next_cursor;
+         } while( !cursor.empty() );
+
+         BOOST_REQUIRE_EQUAL( paged.size(), expected.size() );
+         for( size_t i = 0; i < paged.size(); ++i )
+         {
+            BOOST_CHECK_EQUAL( paged[i].first, expected[i].first );
+            BOOST_CHECK( paged[i].second.id == expected[i].second.id );
+         }
+      };
+
+      const uint32_t stored_block = plugin()->get_stored_block_num();
+      const uint32_t head = db.head_block_num();
+      check_range( optional<uint16_t>(), 1, head + 1 );
+      check_range( transfer_type, 1, head + 1 );
+      // ranges inside the store, across its end and inside the pending blocks
+      check_range( optional<uint16_t>(), first_block + 2, stored_block - 1 );
+      check_range( transfer_type, first_block + 2, stored_block - 1 );
+      check_range( transfer_type, first_block + 4, first_block + 5 );
+      check_range( optional<uint16_t>(), stored_block - 3, stored_block + 3 );
+      check_range( transfer_type, stored_block - 3, stored_block + 3 );
+      check_range( optional<uint16_t>(), stored_block + 1, head );
+      // an operation type the account does not have
+      check_range( uint16_t( operation::tag<post_operation>::value ), 1, head + 1 );
+      check_range( optional<uint16_t>(), head + 1, head + 10 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( async_store_fork_rollback, async_history_store_fixture )
+{
+   try {
+      ACTORS((1000)(2000));
+      graphene::app::history_api hist_api( app );
+      for( int i = 0; i < 5; ++i )
+      {
+         transfer( committee_account, u_1000_id, asset(100 + i) );
+         generate_block();
+      }
+      generate_blocks( 20 );
+      wait_for_indexing();
+      check_history( u_1000_id );
+
+      auto watermark = hist_api.get_account_history_watermark();
+      BOOST_CHECK_EQUAL( watermark.head_block_num, db.head_block_num() );
+      BOOST_CHECK_EQUAL( watermark.indexed_block_num, db.head_block_num() );
+      BOOST_CHECK_GT( watermark.stored_block_num, 0u );
+      BOOST_CHECK_LE( watermark.stored_block_num, db.get_dynamic_global_properties().last_irreversible_block_num );
+      BOOST_CHECK( watermark.error.empty() );
+
+      // roll back two blocks with operations of the account
+      transfer( committee_account, u_1000_id, asset(1) );
+      generate_block();
+      transfer( committee_account, u_1000_id, asset(2) );
+      generate_block();
+      wait_for_indexing();
+      const uint32_t count = plugin()->get_account_operation_count( u_1000_id );
+      const uint32_t fork_block = db.head_block_num() - 1;
+      db.pop_block();
+      db.pop_block();
+      db.clear_pending();
+      db._popped_tx.clear();
+
+      // the watermark does not stay above the head block
+      watermark = hist_api.get_account_history_watermark();
+      BOOST_CHECK_EQUAL( watermark.head_block_num, fork_block - 1 );
+      BOOST_CHECK_LE( watermark.indexed_block_num, watermark.head_block_num );
+      BOOST_CHECK_EQUAL( plugin()->get_account_operation_count( u_1000_id ), count - 2 );
+      check_history( u_1000_id );
+
+      // the other branch only has operations of u_2000
+      transfer( committee_account, u_2000_id, asset(3) );
+      generate_block();
+      generate_block();
+      BOOST_CHECK_EQUAL( db.head_block_num(), fork_block + 1 );
+      // queries wait for blocks that replace popped ones
+      check_history( u_2000_id );
+      wait_for_indexing();
+      check_history( u_1000_id );
+      check_history( u_2000_id );
+
+      const auto page = hist_api.get_relative_account_history_page( u_1000_id, optional<uint16_t>(), string(), 3 );
+      BOOST_REQUIRE_EQUAL( page.items.size(), 3u );
+      BOOST_CHECK_EQUAL( page.items.front().first, plugin()->get_account_operation_count( u_1000_id ) );
+      BOOST_CHECK_LT( page.items.front().second.block_num, fork_block );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
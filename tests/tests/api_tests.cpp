@@ -0,0 +1,496 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/app/api.hpp>
+#include <graphene/app/raw_api_client.hpp>
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/market_history/market_history_plugin.hpp>
+
+#include <fc/crypto/base64.hpp>
+#include <fc/io/raw.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::app;
+
+namespace {
+
+/// the fixture does not load the market history plugin, start it with its default bucket sizes
+void start_market_history( graphene::app::application& app )
+{
+   auto plugin = app.register_plugin<graphene::market_history::market_history_plugin>();
+   boost::program_options::options_description cli, cfg;
+   plugin->plugin_set_program_options( cli, cfg );
+   boost::program_options::variables_map options;
+   boost::program_options::store( boost::program_options::command_line_parser( std::vector<std::string>() ).options( cli ).run(),
+                                  options );
+   boost::program_options::notify( options );
+   plugin->plugin_set_app( &app );
+   plugin->plugin_initialize( options );
+   plugin->plugin_startup();
+}
+
+/// lets a history stream run to its end, acknowledging every chunk the callback collected into @p chunks
+void read_stream( history_api& hist_api, const vector<history_stream_chunk>& chunks, uint32_t stream_id )
+{
+   for( int i = 0; i < 500 && ( chunks.empty() || !chunks.back().last ); ++i )
+   {
+      if( !chunks.empty() )
+         hist_api.ack_stream( stream_id, chunks.back().sequence );
+      fc::usleep( fc::milliseconds( 10 ) );
+   }
+}
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE( api_tests, database_fixture )
+
+BOOST_AUTO_TEST_CASE( raw_api_client_round_trip )
+{
+   try {
+      ACTORS((1000)(2000));
+      for( int i = 0; i < 3; ++i )
+         transfer( committee_account, u_1000_id, asset(1000 + i) );
+      generate_block();
+      generate_block();
+
+      auto db_api = std::make_shared<graphene::app::database_api>( std::ref( db ), &app.get_options() );
+      auto hist_api = std::make_shared<history_api>( app );
+      block_api blk_api( db );
+      auto raw = std::make_shared<raw_api>( std::ref( app ), db_api, hist_api );
+      raw_api_client client( fc::api<raw_api>( raw ) );
+
+      const uint32_t head = db.head_block_num();
+      optional<signed_block> block = client.get_block( head );
+      BOOST_REQUIRE( block.valid() );
+      BOOST_CHECK( block->id() == db.head_block_id() );
+      BOOST_CHECK( !client.get_block( head + 1 ).valid() );
+
+      const auto blocks = client.get_blocks( 1, head );
+      const auto expected_blocks = blk_api.get_blocks( 1, head );
+      BOOST_REQUIRE_EQUAL( blocks.size(), expected_blocks.size() );
+      for( size_t i = 0; i < blocks.size(); ++i )
+      {
+         BOOST_REQUIRE( blocks[i].valid() );
+         BOOST_CHECK( blocks[i]->id() == expected_blocks[i]->id() );
+      }
+
+      const vector<account_uid_type> uids = { u_1000_id, u_2000_id };
+      const auto accounts = client.get_full_accounts_by_uid( uids, full_account_query_options() );
+      const auto expected_accounts = db_api->get_full_accounts_by_uid( uids, full_account_query_options() );
+      BOOST_CHECK_EQUAL( accounts.size(), 2u );
+      BOOST_CHECK( fc::raw::pack( accounts ) == fc::raw::pack( expected_accounts ) );
+
+      const auto history = client.get_relative_account_history( u_1000_id, optional<uint16_t>(), 0, 100, 0 );
+      const auto expected_history = hist_api->get_relative_account_history( u_1000_id, optional<uint16_t>(), 0, 100, 0 );
+      BOOST_REQUIRE_GT( history.size(), 3u );
+      BOOST_CHECK( fc::raw::pack( history ) == fc::raw::pack( expected_history ) );
+
+      // a result travels as base64 of the packed bytes, not as hex
+      const std::string encoded = raw->get_blocks( 1, head );
+      const vector<char> packed = fc::raw::pack( expected_blocks );
+      BOOST_CHECK_EQUAL( encoded.size(), ( packed.size() + 2 ) / 3 * 4 );
+      BOOST_CHECK( fc::base64_decode( encoded ) == std::string( packed.begin(), packed.end() ) );
+      BOOST_CHECK( fc::variant( encoded ).as_string() == encoded );
+
+      // the anonymous default access grants raw_api, so large requests are refused
+      const uint64_t max_blocks = app.get_options().api_limit_get_blocks;
+      BOOST_CHECK_EQUAL( client.get_blocks( 1, max_blocks ).size(), max_blocks );
+      BOOST_CHECK_THROW( client.get_blocks( 1, max_blocks + 1 ), fc::exception );
+      BOOST_CHECK_THROW( client.get_blocks( head, head - 1 ), fc::exception );
+      const vector<account_uid_type> too_many_uids( app.get_options().api_limit_get_full_accounts + 1, u_1000_id );
+      BOOST_CHECK_THROW( client.get_full_accounts_by_uid( too_many_uids, full_account_query_options() ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( score_page_test )
+{
+   try {
+      ACTORS((1001)(9000));
+      flat_map<account_uid_type, fc::ecc::private_key> score_map;
+      actor(1003, 10, score_map);
+      const share_type prec = asset::scaled_precision(asset_id_type()(db).precision);
+      auto _core = [&](int64_t x) -> asset
+      {  return asset(x*prec);    };
+
+      for (int i = 0; i < 5; ++i)
+         add_csaf_for_account(genesis_state.initial_accounts.at(i).uid, 1000);
+      transfer(committee_account, u_9000_id, _core(100000));
+      generate_blocks(10);
+
+      committee_update_global_extension_parameter_item_type item;
+      item.value = { 300, 300, 1000, 31536000, 10, 10000000000000, 10000000000000, 10000000000000, 1000, 100 };
+      committee_proposal_create(genesis_state.initial_accounts.at(0).uid, { item }, 100, voting_opinion_type::opinion_for, 100, 100);
+      for (int i = 1; i < 5; ++i)
+         committee_proposal_vote(genesis_state.initial_accounts.at(i).uid, 1, voting_opinion_type::opinion_for);
+      generate_blocks(89);
+
+      for (auto a : score_map)
+         add_csaf_for_account(a.first, 10000);
+      add_csaf_for_account(u_9000_id, 10000);
+      generate_blocks(HARDFORK_0_4_TIME, true);
+
+      create_platform(u_9000_id, "platform", _core(10000), "www.123456789.com", "", { u_9000_private_key });
+      create_license(u_9000_id, 6, "999999999", "license title", "license body", "extra", { u_9000_private_key });
+      account_auth_platform({ u_1001_private_key }, u_1001_id, u_9000_id, 10000 * prec, 0x1F);
+      post_operation::ext extensions;
+      extensions.license_lid = 1;
+      create_post({ u_1001_private_key, u_9000_private_key }, u_9000_id, u_1001_id, "", "", "", "",
+         optional<account_uid_type>(), optional<account_uid_type>(), optional<post_pid_type>(), extensions);
+      for (auto a : score_map)
+      {
+         account_auth_platform({ a.second }, a.first, u_9000_id, 1000 * prec, 0x1F);
+         account_manage(a.first, { true, true, true });
+         score_a_post({ a.second }, a.first, u_9000_id, u_1001_id, 1, 5, 10);
+      }
+      generate_block();
+
+      graphene::app::database_api db_api( db, &app.get_options() );
+
+      // all periods, in the order of list_scores
+      const auto expected = db_api.list_scores( u_9000_id, u_1001_id, 1, object_id_type(), 100, false );
+      BOOST_REQUIRE_EQUAL( expected.size(), score_map.size() );
+      vector<score_object> paged;
+      string cursor;
+      do
+      {
+         auto p = db_api.list_scores_page( u_9000_id, u_1001_id, 1, false, cursor, 3 );
+         BOOST_CHECK_LE( p.items.size(), 3u );
+         BOOST_CHECK_EQUAL( p.head_block_num, db.head_block_num() );
+         paged.insert( paged.end(), p.items.begin(), p.items.end() );
+         cursor = p.next_cursor;
+      } while( !cursor.empty() );
+      BOOST_REQUIRE_EQUAL( paged.size(), expected.size() );
+      for( size_t i = 0; i < paged.size(); ++i )
+         BOOST_CHECK( paged[i].id == expected[i].id );
+
+      // the current period, newest first
+      paged.clear();
+      do
+      {
+         auto p = db_api.list_scores_page( u_9000_id, u_1001_id, 1, true, cursor, 4 );
+         paged.insert( paged.end(), p.items.begin(), p.items.end() );
+         cursor = p.next_cursor;
+      } while( !cursor.empty() );
+      BOOST_REQUIRE_EQUAL( paged.size(), score_map.size() );
+      for( size_t i = 1; i < paged.size(); ++i )
+         BOOST_CHECK( paged[i].id < paged[i - 1].id );
+
+      // a cursor belongs to the query it was issued for, and the page size is limited
+      const auto first = db_api.list_scores_page( u_9000_id, u_1001_id, 1, false, string(), 3 );
+      BOOST_REQUIRE( !first.next_cursor.empty() );
+      GRAPHENE_REQUIRE_THROW( db_api.list_scores_page( u_9000_id, u_1001_id, 1, true, first.next_cursor, 3 ), fc::exception );
+      GRAPHENE_REQUIRE_THROW( db_api.list_scores_page( u_9000_id, u_1001_id, 1, false, string(),
+                                                       app.get_options().api_limit_page_size + 1 ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( market_pages_test )
+{
+   try {
+      ACTORS((1000)(2000));
+      const share_type prec = asset::scaled_precision(asset_id_type()(db).precision);
+      transfer(committee_account, u_1000_id, asset(10000 * prec));
+      transfer(committee_account, u_2000_id, asset(10000 * prec));
+      add_csaf_for_account(u_1000_id, 10000);
+      add_csaf_for_account(u_2000_id, 10000);
+      generate_blocks(HARDFORK_0_5_TIME, true);
+      start_market_history( app );
+
+      asset_options aopts;
+      aopts.max_supply = 100000000 * prec;
+      aopts.issuer_permissions = 15;
+      aopts.description = "market test asset";
+      create_asset({ u_1000_private_key }, u_1000_id, "MKTA", 5, aopts, 100000000 * prec);
+      generate_block();
+      const asset_aid_type mkta = 1;
+
+      // a few fills in each of several one minute buckets
+      for( uint32_t round = 0; round < 5; ++round )
+      {
+         const uint32_t expiration = db.head_block_time().sec_since_epoch() + 3600;
+         for( uint32_t j = 1; j <= 3; ++j )
+         {
+            create_limit_order({ u_1000_private_key }, u_1000_id, mkta, 10 * j + round, GRAPHENE_CORE_ASSET_AID, j, expiration, false);
+            create_limit_order({ u_2000_private_key }, u_2000_id, GRAPHENE_CORE_ASSET_AID, j, mkta, 10 * j + round, expiration, false);
+         }
+         generate_block();
+         generate_blocks( db.head_block_time() + 60, true );
+      }
+
+      // trades, most recent first
+      application_options opts = app.get_options();
+      opts.has_market_history_plugin = true;
+      graphene::app::database_api db_api( db, &opts );
+      const fc::time_point_sec start = db.head_block_time() + 3600;
+      const auto all_trades = db_api.get_trade_history_page( "MKTA", GRAPHENE_SYMBOL, start, fc::time_point_sec(), string(), 1000 );
+      BOOST_REQUIRE_GE( all_trades.items.size(), 15u );
+      BOOST_CHECK( all_trades.next_cursor.empty() );
+      vector<market_trade> trades;
+      string cursor;
+      do
+      {
+         auto p = db_api.get_trade_history_page( "MKTA", GRAPHENE_SYMBOL, start, fc::time_point_sec(), cursor, 4 );
+         BOOST_CHECK_LE( p.items.size(), 4u );
+         trades.insert( trades.end(), p.items.begin(), p.items.end() );
+         cursor = p.next_cursor;
+      } while( !cursor.empty() );
+      BOOST_REQUIRE_EQUAL( trades.size(), all_trades.items.size() );
+      for( size_t i = 0; i < trades.size(); ++i )
+      {
+         BOOST_CHECK_EQUAL( trades[i].sequence, all_trades.items[i].sequence );
+         BOOST_CHECK( trades[i].date == all_trades.items[i].date );
+         BOOST_CHECK_EQUAL( trades[i].price, all_trades.items[i].price );
+      }
+      const auto first_trades = db_api.get_trade_history_page( "MKTA", GRAPHENE_SYMBOL, start, fc::time_point_sec(), string(), 4 );
+      GRAPHENE_REQUIRE_THROW( db_api.get_trade_history_page( "MKTA", "MKTA", start, fc::time_point_sec(),
+                                                             first_trades.next_cursor, 4 ), fc::exception );
+      GRAPHENE_REQUIRE_THROW( db_api.get_trade_history_page( "MKTA", GRAPHENE_SYMBOL, start, fc::time_point_sec(), string(),
+                                                             opts.api_limit_page_size + 1 ), fc::exception );
+
+      // the page methods refuse to run without the plugin
+      graphene::app::database_api plain_db_api( db );
+      GRAPHENE_REQUIRE_THROW( plain_db_api.get_trade_history_page( "MKTA", GRAPHENE_SYMBOL, start, fc::time_point_sec(),
+                                                                   string(), 4 ), fc::exception );
+
+      // one minute buckets, oldest first
+      history_api hist_api( app );
+      const auto all_buckets = hist_api.get_market_history_page( "MKTA", GRAPHENE_SYMBOL, 60, fc::time_point_sec(), start,
+                                                                 string(), 1000 );
+      BOOST_REQUIRE_GE( all_buckets.items.size(), 5u );
+      vector<bucket_object> buckets;
+      do
+      {
+         auto p = hist_api.get_market_history_page( "MKTA", GRAPHENE_SYMBOL, 60, fc::time_point_sec(), start, cursor, 2 );
+         BOOST_CHECK_LE( p.items.size(), 2u );
+         buckets.insert( buckets.end(), p.items.begin(), p.items.end() );
+         cursor = p.next_cursor;
+      } while( !cursor.empty() );
+      BOOST_REQUIRE_EQUAL( buckets.size(), all_buckets.items.size() );
+      for( size_t i = 0; i < buckets.size(); ++i )
+         BOOST_CHECK( buckets[i].key == all_buckets.items[i].key );
+      const auto first_buckets = hist_api.get_market_history_page( "MKTA", GRAPHENE_SYMBOL, 60, fc::time_point_sec(), start,
+                                                                   string(), 2 );
+      GRAPHENE_REQUIRE_THROW( hist_api.get_market_history_page( "MKTA", GRAPHENE_SYMBOL, 300, fc::time_point_sec(), start,
+                                                                first_buckets.next_cursor, 2 ), fc::exception );
+
+      // the streamed variant sends the same buckets in chunks
+      vector<history_stream_chunk> chunks;
+      const uint32_t stream_id = hist_api.stream_market_history( [&chunks]( const variant& v ) {
+         chunks.push_back( v.as<history_stream_chunk>( GRAPHENE_NET_MAX_NESTED_OBJECTS ) );
+      }, "MKTA", GRAPHENE_SYMBOL, 60, fc::time_point_sec(), start, 2 );
+      read_stream( hist_api, chunks, stream_id );
+      BOOST_REQUIRE( !chunks.empty() );
+      BOOST_CHECK( chunks.back().last );
+      vector<bucket_object> streamed;
+      for( size_t i = 0; i < chunks.size(); ++i )
+      {
+         BOOST_CHECK_EQUAL( chunks[i].stream_id, stream_id );
+         BOOST_CHECK_EQUAL( chunks[i].sequence, i );
+         BOOST_CHECK( chunks[i].error.empty() );
+         const auto items = chunks[i].items.as<vector<bucket_object>>( GRAPHENE_NET_MAX_NESTED_OBJECTS );
+         BOOST_CHECK_LE( items.size(), 2u );
+         streamed.insert( streamed.end(), items.begin(), items.end() );
+      }
+      BOOST_REQUIRE_EQUAL( streamed.size(), all_buckets.items.size() );
+      for( size_t i = 0; i < streamed.size(); ++i )
+         BOOST_CHECK( streamed[i].key == all_buckets.items[i].key );
+
+      // an unacknowledged stream stops after a few chunks and can be cancelled
+      chunks.clear();
+      const uint32_t stalled_id = hist_api.stream_market_history( [&chunks]( const variant& v ) {
+         chunks.push_back( v.as<history_stream_chunk>( GRAPHENE_NET_MAX_NESTED_OBJECTS ) );
+      }, "MKTA", GRAPHENE_SYMBOL, 60, fc::time_point_sec(), start, 1 );
+      fc::usleep( fc::milliseconds( 50 ) );
+      BOOST_REQUIRE( !chunks.empty() );
+      BOOST_CHECK_LT( chunks.size(), streamed.size() );
+      BOOST_CHECK( !chunks.back().last );
+      hist_api.cancel_stream( stalled_id );
+      GRAPHENE_REQUIRE_THROW( hist_api.stream_market_history( []( const variant& ) {}, "MKTA", "NOSUCHASSET", 60,
+                                                              fc::time_point_sec(), start, 2 ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( order_book_depth_test )
+{
+   try {
+      ACTORS((1000)(2000));
+      const share_type prec = asset::scaled_precision(asset_id_type()(db).precision);
+      transfer(committee_account, u_1000_id, asset(10000 * prec));
+      transfer(committee_account, u_2000_id, asset(10000 * prec));
+      add_csaf_for_account(u_1000_id, 10000);
+      add_csaf_for_account(u_2000_id, 10000);
+      generate_blocks(HARDFORK_0_5_TIME, true);
+      start_market_history( app );
+
+      asset_options aopts;
+      aopts.max_supply = 100000000 * prec;
+      aopts.issuer_permissions = 15;
+      aopts.description = "market test asset";
+      create_asset({ u_1000_private_key }, u_1000_id, "MKTA", 5, aopts, 100000000 * prec);
+      generate_block();
+      const asset_aid_type mkta = 1;
+      const asset_object& mkta_asset = db.get_asset_by_aid( mkta );
+      const asset_object& core_asset = db.get_asset_by_aid( GRAPHENE_CORE_ASSET_AID );
+
+      // created after the plugin so that its block handler runs after the one of the depth index
+      application_options opts = app.get_options();
+      opts.has_market_history_plugin = true;
+      graphene::app::database_api db_api( db, &opts );
+      graphene::app::database_api plain_db_api( db );
+
+      typedef std::map<price, share_type> book_type;
+      book_type local_book;
+      vector< vector<graphene::market_history::order_book_level_change> > notifications;
+      db_api.subscribe_to_order_book( [&notifications]( const variant& v ) {
+         notifications.push_back( v.as< vector<graphene::market_history::order_book_level_change> >( GRAPHENE_NET_MAX_NESTED_OBJECTS ) );
+      }, GRAPHENE_SYMBOL, "MKTA" );
+
+      // the total for sale at each price, summed from the orders themselves
+      const auto expected_book = [this]() -> book_type {
+         book_type book;
+         for( const auto& o : db.get_index_type<limit_order_index>().indices() )
+            book[o.sell_price] += o.for_sale;
+         return book;
+      };
+      const auto find_order = [this]( account_uid_type seller, share_type for_sale ) -> limit_order_id_type {
+         for( const auto& o : db.get_index_type<limit_order_index>().indices() )
+            if( o.seller == seller && o.for_sale == for_sale )
+               return o.id;
+         BOOST_FAIL( "order not found" );
+         return limit_order_id_type();
+      };
+      // applies the changes pushed for the last block to the local book, returns how many levels changed
+      const auto apply_notifications = [&]() -> size_t {
+         fc::usleep( fc::milliseconds( 20 ) );
+         size_t changed = 0;
+         for( const auto& changes : notifications )
+            for( const auto& change : changes )
+            {
+               BOOST_CHECK( change.sell_price.base.asset_id == mkta || change.sell_price.quote.asset_id == mkta );
+               if( change.for_sale == 0 )
+                  local_book.erase( change.sell_price );
+               else
+                  local_book[change.sell_price] = change.for_sale;
+               ++changed;
+            }
+         notifications.clear();
+         return changed;
+      };
+      // get_order_book has one entry per level, with the same prices as the order by order book of a node
+      // without the plugin, and the amounts of the levels
+      const auto check_order_book = [&]() {
+         const book_type book = expected_book();
+         const order_book levels = db_api.get_order_book( GRAPHENE_SYMBOL, "MKTA", 50 );
+         const order_book orders = plain_db_api.get_order_book( GRAPHENE_SYMBOL, "MKTA", 50 );
+         const auto check_side = [&]( const vector<order>& level_side, const vector<order>& order_side, asset_aid_type sell ) {
+            vector<string> prices;
+            for( const auto& o : order_side )
+               if( prices.empty() || prices.back() != o.price )
+                  prices.push_back( o.price );
+            vector<share_type> amounts;
+            for( auto itr = book.rbegin(); itr != book.rend(); ++itr )
+               if( itr->first.base.asset_id == sell )
+                  amounts.push_back( itr->second );
+            BOOST_REQUIRE_EQUAL( level_side.size(), prices.size() );
+            BOOST_REQUIRE_EQUAL( level_side.size(), amounts.size() );
+            for( size_t i = 0; i < level_side.size(); ++i )
+            {
+               BOOST_CHECK_EQUAL( level_side[i].price, prices[i] );
+               if( sell == mkta )
+                  BOOST_CHECK_EQUAL( level_side[i].quote, mkta_asset.amount_to_string( amounts[i] ) );
+               else
+                  BOOST_CHECK_EQUAL( level_side[i].base, core_asset.amount_to_string( amounts[i] ) );
+            }
+         };
+         check_side( levels.bids, orders.bids, GRAPHENE_CORE_ASSET_AID );
+         check_side( levels.asks, orders.asks, mkta );
+      };
+
+      const uint32_t expiration = db.head_block_time().sec_since_epoch() + 3600;
+      // asks at 10 and 15 MKTA per CORE, two orders share the first level
+      create_limit_order({ u_1000_private_key }, u_1000_id, mkta, 100, GRAPHENE_CORE_ASSET_AID, 10, expiration, false);
+      create_limit_order({ u_1000_private_key }, u_1000_id, mkta, 200, GRAPHENE_CORE_ASSET_AID, 20, expiration, false);
+      create_limit_order({ u_1000_private_key }, u_1000_id, mkta, 300, GRAPHENE_CORE_ASSET_AID, 20, expiration, false);
+      // bids at 20 and 30 MKTA per CORE, they do not cross the asks
+      create_limit_order({ u_2000_private_key }, u_2000_id, GRAPHENE_CORE_ASSET_AID, 5, mkta, 100, expiration, false);
+      create_limit_order({ u_2000_private_key }, u_2000_id, GRAPHENE_CORE_ASSET_AID, 5, mkta, 150, expiration, false);
+      generate_block();
+      BOOST_CHECK_EQUAL( apply_notifications(), 4u );
+      BOOST_REQUIRE_EQUAL( local_book.size(), 4u );
+      BOOST_CHECK( local_book == expected_book() );
+      check_order_book();
+
+      // a block without order changes sends nothing
+      generate_block();
+      BOOST_CHECK_EQUAL( apply_notifications(), 0u );
+
+      // half of the 15 MKTA per CORE ask is taken, the level of the filled taker order is reported empty
+      create_limit_order({ u_2000_private_key }, u_2000_id, GRAPHENE_CORE_ASSET_AID, 10, mkta, 150, expiration, false);
+      generate_block();
+      BOOST_CHECK_EQUAL( apply_notifications(), 2u );
+      BOOST_CHECK_EQUAL( local_book.size(), 4u );
+      BOOST_CHECK( local_book == expected_book() );
+      check_order_book();
+
+      // cancelling one order of a shared level leaves the other, cancelling the last order of a level removes it
+      cancel_limit_order({ u_1000_private_key }, u_1000_id, find_order( u_1000_id, 200 ));
+      cancel_limit_order({ u_2000_private_key }, u_2000_id, find_order( u_2000_id, 5 )); // either bid
+      generate_block();
+      BOOST_CHECK_EQUAL( apply_notifications(), 2u );
+      BOOST_CHECK_EQUAL( local_book.size(), 3u );
+      BOOST_CHECK( local_book == expected_book() );
+      check_order_book();
+
+      // no more changes once unsubscribed
+      db_api.unsubscribe_from_order_book( "MKTA", GRAPHENE_SYMBOL );
+      create_limit_order({ u_1000_private_key }, u_1000_id, mkta, 400, GRAPHENE_CORE_ASSET_AID, 20, expiration, false);
+      generate_block();
+      BOOST_CHECK_EQUAL( apply_notifications(), 0u );
+      BOOST_CHECK( local_book != expected_book() );
+      check_order_book();
+
+      // a node without the plugin can not send the changes
+      GRAPHENE_REQUIRE_THROW( plain_db_api.subscribe_to_order_book( []( const variant& ) {}, GRAPHENE_SYMBOL, "MKTA" ),
+                              fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
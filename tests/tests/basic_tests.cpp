@@ -24,6 +24,12 @@
 
 #include <boost/test/unit_test.hpp>
 
+#include <graphene/app/api.hpp>
+#include <graphene/app/metrics.hpp>
+
+#include <graphene/account_history/account_history_store.hpp>
+#include <graphene/market_history/market_history_plugin.hpp>
+
 #include <graphene/chain/database.hpp>
 #include <graphene/chain/protocol/protocol.hpp>
 
@@ -33,6 +39,10 @@
 
 #include <graphene/db/simple_index.hpp>
 
+#include <graphene/net/peer_connection.hpp>
+
+#include <graphene/utilities/tempdir.hpp>
+
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/hex.hpp>
 #include "../common/database_fixture.hpp"
@@ -273,4 +283,540 @@ BOOST_AUTO_TEST_CASE( merkle_root )
    BOOST_CHECK( block.calculate_merkle_root() == c(dO) );
 }
 
+BOOST_AUTO_TEST_CASE( relative_account_history_page_test )
+{
+   try {
+      ACTORS((1000)(2000));
+      for( int i = 0; i < 12; ++i )
+         transfer( committee_account, u_1000_id, asset(1000 + i) );
+      generate_block();
+
+      graphene::app::history_api hist_api( app );
+      const auto expected = hist_api.get_relative_account_history( u_1000_id, optional<uint16_t>(), 0, 100, 0 );
+      BOOST_REQUIRE_GT( expected.size(), 5u );
+
+      // walk the history in pages of 5 and compare with the single call
+      vector<std::pair<uint32_t,operation_history_object>> paged;
+      string cursor;
+      do
+      {
+         auto p = hist_api.get_relative_account_history_page( u_1000_id, optional<uint16_t>(), cursor, 5 );
+         BOOST_CHECK_LE( p.items.size(), 5u );
+         BOOST_CHECK_EQUAL( p.head_block_num, db.head_block_num() );
+         paged.insert( paged.end(), p.items.begin(), p.items.end() );
+         cursor = p.next_cursor;
+      } while( !cursor.empty() );
+
+      BOOST_REQUIRE_EQUAL( paged.size(), expected.size() );
+      for( size_t i = 0; i < paged.size(); ++i )
+      {
+         BOOST_CHECK_EQUAL( paged[i].first, expected[i].first );
+         BOOST_CHECK( paged[i].second.id == expected[i].second.id );
+      }
+
+      // new operations do not shift a listing in progress
+      auto first = hist_api.get_relative_account_history_page( u_1000_id, optional<uint16_t>(), string(), 5 );
+      transfer( committee_account, u_1000_id, asset(1) );
+      auto second = hist_api.get_relative_account_history_page( u_1000_id, optional<uint16_t>(), first.next_cursor, 5 );
+      BOOST_CHECK_EQUAL( second.items.front().first, expected[5].first );
+
+      // a cursor belongs to the query it was issued for
+      GRAPHENE_REQUIRE_THROW( hist_api.get_relative_account_history_page( u_2000_id, optional<uint16_t>(),
+                                                                          first.next_cursor, 5 ), fc::exception );
+      GRAPHENE_REQUIRE_THROW( hist_api.get_relative_account_history_page( u_1000_id, optional<uint16_t>(),
+                                                                          "00ff", 5 ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( account_history_by_block_range_test )
+{
+   try {
+      ACTORS((1000));
+      for( int i = 0; i < 6; ++i )
+      {
+         transfer( committee_account, u_1000_id, asset(1000 + i) );
+         transfer( committee_account, u_1000_id, asset(2000 + i) );
+         generate_block();
+      }
+
+      graphene::app::history_api hist_api( app );
+      const auto all = hist_api.get_relative_account_history( u_1000_id, optional<uint16_t>(), 0, 100, 0 );
+      const uint32_t start_block = all.back().second.block_num + 2;
+      const uint32_t end_block = start_block + 3;
+      const uint16_t transfer_type = operation::tag<transfer_operation>::value;
+
+      // the same operations as filtering the whole history, oldest first
+      for( const auto& op_type : { optional<uint16_t>(), optional<uint16_t>( transfer_type ) } )
+      {
+         vector<std::pair<uint32_t,operation_history_object>> expected;
+         for( auto itr = all.rbegin(); itr != all.rend(); ++itr )
+            if( itr->second.block_num >= start_block && itr->second.block_num < end_block
+                && ( !op_type.valid() || itr->second.op.which() == *op_type ) )
+               expected.push_back( *itr );
+         BOOST_REQUIRE_GE( expected.size(), 6u );
+
+         vector<std::pair<uint32_t,operation_history_object>> paged;
+         string cursor;
+         do
+         {
+            auto p = hist_api.get_account_history_by_block_range( u_1000_id, op_type, start_block, end_block, cursor, 4 );
+            BOOST_CHECK_LE( p.items.size(), 4u );
+            paged.insert( paged.end(), p.items.begin(), p.items.end() );
+            cursor = p.next_cursor;
+         } while( !cursor.empty() );
+
+         BOOST_REQUIRE_EQUAL( paged.size(), expected.size() );
+         for( size_t i = 0; i < paged.size(); ++i )
+         {
+            BOOST_CHECK_EQUAL( paged[i].first, expected[i].first );
+            BOOST_CHECK( paged[i].second.id == expected[i].second.id );
+         }
+      }
+
+      // a time range covering the same blocks gives the same page
+      const auto start_time = db.fetch_block_by_number( start_block )->timestamp;
+      const auto end_time = db.fetch_block_by_number( end_block )->timestamp;
+      const auto by_block = hist_api.get_account_history_by_block_range( u_1000_id, optional<uint16_t>(), start_block,
+                                                                         end_block, string(), 100 );
+      const auto by_time = hist_api.get_account_history_by_time( u_1000_id, optional<uint16_t>(), start_time, end_time,
+                                                                 string(), 100 );
+      BOOST_REQUIRE_EQUAL( by_time.items.size(), by_block.items.size() );
+      for( size_t i = 0; i < by_time.items.size(); ++i )
+         BOOST_CHECK_EQUAL( by_time.items[i].first, by_block.items[i].first );
+
+      BOOST_CHECK( hist_api.get_account_history_by_block_range( u_1000_id, optional<uint16_t>(), end_block, start_block,
+                                                                string(), 100 ).items.empty() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( order_book_depth_index_test )
+{
+   try {
+      graphene::market_history::order_book_depth_index depth;
+      const asset_aid_type core = GRAPHENE_CORE_ASSET_AID;
+      const asset_aid_type other = 1;
+      const auto market = std::make_pair( core, other );
+      const auto make_order = []( share_type for_sale, const price& p ) {
+         limit_order_object o;
+         o.for_sale = for_sale;
+         o.sell_price = p;
+         return o;
+      };
+
+      // 1/2 and 2/4 are the same level
+      const limit_order_object a = make_order( 100, asset( 1, core ) / asset( 2, other ) );
+      const limit_order_object b = make_order( 50, asset( 2, core ) / asset( 4, other ) );
+      const limit_order_object c = make_order( 70, asset( 3, other ) / asset( 1, core ) );
+      depth.object_inserted( a );
+      depth.object_inserted( b );
+      depth.object_inserted( c );
+      depth.finish_block();
+      BOOST_CHECK_EQUAL( depth.get_last_block_changes().size(), 2u );
+
+      const auto* levels = depth.get_levels( market );
+      BOOST_REQUIRE( levels != nullptr );
+      BOOST_REQUIRE_EQUAL( levels->size(), 2u );
+      BOOST_CHECK_EQUAL( levels->at( a.sell_price ).value, 150 );
+      BOOST_CHECK_EQUAL( levels->at( c.sell_price ).value, 70 );
+
+      // a partial fill
+      limit_order_object filled = a;
+      filled.for_sale = 40;
+      depth.about_to_modify( a );
+      depth.object_modified( filled );
+      depth.finish_block();
+      BOOST_REQUIRE_EQUAL( depth.get_last_block_changes().size(), 1u );
+      BOOST_CHECK_EQUAL( depth.get_last_block_changes().front().for_sale.value, 90 );
+
+      // removing the last order of a level reports it with nothing left
+      depth.object_removed( c );
+      depth.finish_block();
+      BOOST_REQUIRE_EQUAL( depth.get_last_block_changes().size(), 1u );
+      BOOST_CHECK_EQUAL( depth.get_last_block_changes().front().for_sale.value, 0 );
+      BOOST_CHECK_EQUAL( depth.get_levels( market )->size(), 1u );
+
+      depth.object_removed( filled );
+      depth.object_removed( b );
+      BOOST_CHECK( depth.get_levels( market ) == nullptr );
+      depth.finish_block();
+      BOOST_CHECK_EQUAL( depth.get_last_block_changes().size(), 1u );
+      depth.finish_block();
+      BOOST_CHECK( depth.get_last_block_changes().empty() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( market_candle_index_test )
+{
+   try {
+      using namespace graphene::market_history;
+      db.add_index< primary_index< bucket_index > >();
+      auto* candles = db.add_secondary_index< primary_index< bucket_index >, market_candle_index >();
+      candles->set_tracked_buckets( { 60, 300 } );
+      const auto market = std::make_pair( asset_aid_type( 0 ), asset_aid_type( 1 ) );
+      const fc::time_point_sec t0( 600000 );
+
+      // ten one minute buckets, the price of minute i is 10 + i except for a spike in minute 3
+      vector<const bucket_object*> minutes;
+      for( uint32_t i = 0; i < 10; ++i )
+      {
+         minutes.push_back( &db.create<bucket_object>( [&]( bucket_object& b ) {
+            b.key = bucket_key( market.first, market.second, 60, t0 + 60 * i );
+            b.open_base = b.close_base = b.low_base = 10 + i;
+            b.high_base = i == 3 ? 50 : 10 + i;
+            b.open_quote = b.close_quote = b.high_quote = b.low_quote = 1;
+            b.base_volume = 100;
+            b.quote_volume = 10;
+         }) );
+      }
+
+      BOOST_CHECK_EQUAL( candles->get_source_bucket_size( 120 ), 60u );
+      BOOST_CHECK_EQUAL( candles->get_source_bucket_size( 600 ), 300u );
+      BOOST_CHECK_EQUAL( candles->get_source_bucket_size( 90 ), 0u );
+      GRAPHENE_CHECK_THROW( candles->get_candles( db, market, 90, t0, t0 + 600, 10 ), fc::exception );
+
+      auto two_minutes = candles->get_candles( db, market, 120, t0, t0 + 600, 10 );
+      BOOST_REQUIRE_EQUAL( two_minutes.size(), 5u );
+      BOOST_CHECK( two_minutes[1].key.open == t0 + 120 );
+      BOOST_CHECK_EQUAL( two_minutes[1].key.seconds, 120u );
+      BOOST_CHECK_EQUAL( two_minutes[1].open_base.value, 12 );
+      BOOST_CHECK_EQUAL( two_minutes[1].close_base.value, 13 );
+      BOOST_CHECK_EQUAL( two_minutes[1].high_base.value, 50 );
+      BOOST_CHECK_EQUAL( two_minutes[1].low_base.value, 12 );
+      BOOST_CHECK_EQUAL( two_minutes[1].base_volume.value, 200 );
+
+      // the range and the limit select candles by their open time
+      auto some = candles->get_candles( db, market, 120, t0 + 120, t0 + 360, 2 );
+      BOOST_REQUIRE_EQUAL( some.size(), 2u );
+      BOOST_CHECK( some[0].key.open == t0 + 120 );
+      BOOST_CHECK( some[1].key.open == t0 + 240 );
+      // the candle that contains start opens before it
+      some = candles->get_candles( db, market, 120, t0 + 130, t0 + 600, 2 );
+      BOOST_REQUIRE_EQUAL( some.size(), 2u );
+      BOOST_CHECK( some[0].key.open == t0 + 240 );
+      BOOST_CHECK( some[1].key.open == t0 + 360 );
+      some = candles->get_candles( db, market, 120, t0 + 130, t0 + 239, 10 );
+      BOOST_CHECK( some.empty() );
+
+      // a changed bucket drops the cached candle over it
+      candles->finish_block();
+      db.modify( *minutes[2], []( bucket_object& b ) {
+         b.low_base = 5;
+         b.base_volume += 100;
+      });
+      candles->finish_block();
+      BOOST_CHECK_EQUAL( candles->get_last_block_markets().size(), 1u );
+      two_minutes = candles->get_candles( db, market, 120, t0, t0 + 600, 10 );
+      BOOST_REQUIRE_EQUAL( two_minutes.size(), 5u );
+      BOOST_CHECK_EQUAL( two_minutes[1].low_base.value, 5 );
+      BOOST_CHECK_EQUAL( two_minutes[1].base_volume.value, 300 );
+      BOOST_CHECK_EQUAL( two_minutes[0].base_volume.value, 200 );
+
+      candles->finish_block();
+      BOOST_CHECK( candles->get_last_block_markets().empty() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( metrics_registry_test )
+{
+   try {
+      graphene::app::metrics_registry m;
+      m.declare_counter( "test_calls_total", "Calls" );
+      m.declare_gauge( "test_objects", "Objects" );
+      m.declare_histogram( "test_seconds", "Durations", { 0.1, 1 } );
+
+      const string labels = graphene::app::metrics_registry::label( "method", "a\"b" );
+      BOOST_CHECK_EQUAL( labels, "method=\"a\\\"b\"" );
+      m.increment( "test_calls_total", 1, labels );
+      m.increment( "test_calls_total", 2, labels );
+      m.add_collector( []( graphene::app::metrics_registry& r ){ r.set( "test_objects", 42 ); } );
+      m.observe( "test_seconds", 0.05 );
+      m.observe( "test_seconds", 0.5 );
+      m.observe( "test_seconds", fc::seconds( 5 ) );
+
+      const string out = m.render();
+      BOOST_CHECK( out.find( "# TYPE test_calls_total counter\n" ) != string::npos );
+      BOOST_CHECK( out.find( "test_calls_total{" + labels + "} 3\n" ) != string::npos );
+      BOOST_CHECK( out.find( "test_objects 42\n" ) != string::npos );
+      BOOST_CHECK( out.find( "test_seconds_bucket{le=\"0.1\"} 1\n" ) != string::npos );
+      BOOST_CHECK( out.find( "test_seconds_bucket{le=\"1\"} 2\n" ) != string::npos );
+      BOOST_CHECK( out.find( "test_seconds_bucket{le=\"+Inf\"} 3\n" ) != string::npos );
+      BOOST_CHECK( out.find( "test_seconds_sum 5.55\n" ) != string::npos );
+      BOOST_CHECK( out.find( "test_seconds_count 3\n" ) != string::npos );
+
+      GRAPHENE_REQUIRE_THROW( m.increment( "test_objects" ), fc::exception );
+      GRAPHENE_REQUIRE_THROW( m.set( "unknown", 1 ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+
+BOOST_AUTO_TEST_CASE( asset_holder_count_test )
+{
+   try {
+      ACTORS((1000)(2000)(3000));
+      graphene::app::asset_api ast_api( app );
+
+      const auto count_holders = [&]() -> uint64_t {
+         uint64_t count = 0;
+         for( const auto& b : db.get_index_type<account_balance_index>().indices() )
+            if( b.asset_type == GRAPHENE_CORE_ASSET_AID && b.balance != 0 )
+               ++count;
+         return count;
+      };
+
+      transfer( committee_account, u_1000_id, asset(1000) );
+      transfer( committee_account, u_2000_id, asset(3000) );
+      transfer( committee_account, u_3000_id, asset(2000) );
+      const uint64_t holders = ast_api.get_asset_holders_count( GRAPHENE_CORE_ASSET_AID );
+      BOOST_CHECK_EQUAL( holders, count_holders() );
+
+      // an emptied balance is no longer counted
+      db.adjust_balance( u_3000_id, -db.get_balance( u_3000_id, GRAPHENE_CORE_ASSET_AID ) );
+      BOOST_CHECK_EQUAL( ast_api.get_asset_holders_count( GRAPHENE_CORE_ASSET_AID ), holders - 1 );
+
+      // undone balance changes are taken out of the count as well
+      {
+         auto session = db._undo_db.start_undo_session();
+         db.adjust_balance( u_3000_id, asset(5) );
+         BOOST_CHECK_EQUAL( ast_api.get_asset_holders_count( GRAPHENE_CORE_ASSET_AID ), holders );
+      }
+      BOOST_CHECK_EQUAL( ast_api.get_asset_holders_count( GRAPHENE_CORE_ASSET_AID ), holders - 1 );
+      BOOST_CHECK_EQUAL( ast_api.get_asset_holders_count( GRAPHENE_CORE_ASSET_AID ), count_holders() );
+
+      const auto all = ast_api.get_all_asset_holders();
+      BOOST_REQUIRE( !all.empty() );
+      BOOST_CHECK_EQUAL( all.front().count, holders - 1 );
+
+      // pages of 2 list the same holders as one call, largest balance first
+      const auto expected = ast_api.get_asset_holders( GRAPHENE_CORE_ASSET_AID );
+      BOOST_REQUIRE_EQUAL( expected.size(), holders - 1 );
+      vector<graphene::app::account_asset_balance> paged;
+      string cursor;
+      do
+      {
+         auto p = ast_api.get_asset_holders_page( GRAPHENE_CORE_ASSET_AID, cursor, 2 );
+         BOOST_CHECK_LE( p.items.size(), 2u );
+         paged.insert( paged.end(), p.items.begin(), p.items.end() );
+         cursor = p.next_cursor;
+      } while( !cursor.empty() );
+      BOOST_REQUIRE_EQUAL( paged.size(), expected.size() );
+      for( size_t i = 0; i < paged.size(); ++i )
+      {
+         BOOST_CHECK_EQUAL( paged[i].account_uid, expected[i].account_uid );
+         if( i > 0 )
+            BOOST_CHECK( paged[i].amount <= paged[i-1].amount );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( account_history_store_test )
+{
+   try {
+      using graphene::account_history::account_history_store;
+      fc::temp_directory dir( graphene::utilities::temp_directory_path() );
+
+      // 3 cached pages for 3 accounts of 3 pages each, so pages are written and read back all the time
+      {
+         account_history_store store( 3 );
+         store.open( dir.path() );
+         for( uint32_t i = 0; i < 3 * account_history_store::entries_per_page; ++i )
+         {
+            operation_history_object op;
+            op.block_num = i;
+            const uint64_t operation = store.append_operation( op );
+            BOOST_CHECK_EQUAL( operation, i );
+            for( account_uid_type account = 1; account <= 3; ++account )
+               if( i % account == 0 )
+                  store.append_account_operation( account, operation, account );
+         }
+         store.set_last_block_num( 10 );
+         store.commit();
+      }
+
+      account_history_store store( 3 );
+      store.open( dir.path() );
+      BOOST_CHECK_EQUAL( store.last_block_num(), 10u );
+      BOOST_CHECK_EQUAL( store.operation_count(), 3 * account_history_store::entries_per_page );
+      for( account_uid_type account = 1; account <= 3; ++account )
+      {
+         BOOST_REQUIRE_EQUAL( store.account_operation_count( account ), 3 * account_history_store::entries_per_page / account );
+         for( uint32_t seq = 1; seq <= store.account_operation_count( account ); ++seq )
+         {
+            const auto entry = store.get_account_entry( account, seq );
+            BOOST_CHECK_EQUAL( entry.operation, ( seq - 1 ) * account );
+            BOOST_CHECK_EQUAL( entry.op_type, account );
+         }
+      }
+      const operation_history_object op = store.get_operation( 200 );
+      BOOST_CHECK_EQUAL( op.block_num, 200u );
+      BOOST_CHECK( op.id == operation_history_id_type( 200 ) );
+      BOOST_CHECK_EQUAL( store.account_operation_count( 4 ), 0u );
+      GRAPHENE_REQUIRE_THROW( store.get_account_entry( 1, 0 ), fc::exception );
+      GRAPHENE_REQUIRE_THROW( store.get_operation( store.operation_count() ), fc::exception );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( timestamped_item_set_test )
+{
+   try {
+      using graphene::net::item_id;
+      using graphene::net::timestamped_item_set;
+      auto make_item = []( uint32_t n ) {
+         return item_id( graphene::net::trx_message_type, fc::ripemd160::hash( fc::to_string( uint64_t( n ) ) ) );
+      };
+      const fc::time_point_sec start( 1000000 ); // a multiple of the bucket width
+
+      timestamped_item_set items( 10 );
+      BOOST_CHECK( items.empty() );
+      for( uint32_t i = 0; i < 30; ++i )
+         BOOST_CHECK( items.insert( make_item( i ), start + i ) );
+      BOOST_CHECK_EQUAL( items.size(), 30u );
+      // a second insert keeps the first timestamp
+      BOOST_CHECK( !items.insert( make_item( 5 ), start + 25 ) );
+      BOOST_CHECK( items.contains( make_item( 5 ) ) );
+      BOOST_CHECK( !items.contains( make_item( 30 ) ) );
+
+      // only whole buckets expire: [start, start+10) is gone once start+10 is the oldest to keep
+      BOOST_CHECK_EQUAL( items.expire( start + 9 ), 0u );
+      BOOST_CHECK_EQUAL( items.expire( start + 10 ), 10u );
+      BOOST_CHECK( !items.contains( make_item( 5 ) ) );
+      BOOST_CHECK( items.contains( make_item( 10 ) ) );
+      BOOST_CHECK_EQUAL( items.size(), 20u );
+
+      // an id erased and inserted again lives in its new bucket, the old bucket doesn't expire it
+      items.erase( make_item( 12 ) );
+      BOOST_CHECK( !items.contains( make_item( 12 ) ) );
+      BOOST_CHECK( items.insert( make_item( 12 ), start + 35 ) );
+      BOOST_CHECK_EQUAL( items.expire( start + 20 ), 9u );
+      BOOST_CHECK( items.contains( make_item( 12 ) ) );
+      BOOST_CHECK( !items.contains( make_item( 15 ) ) );
+
+      // an old timestamp goes into the newest bucket rather than a bucket that already expired
+      BOOST_CHECK( items.insert( make_item( 40 ), start ) );
+      BOOST_CHECK_EQUAL( items.expire( start + 30 ), 10u );
+      BOOST_CHECK( items.contains( make_item( 40 ) ) );
+      BOOST_CHECK_EQUAL( items.size(), 2u );
+
+      items.clear();
+      BOOST_CHECK( items.empty() );
+      BOOST_CHECK_EQUAL( items.expire( start + 100 ), 0u );
+      BOOST_CHECK( items.insert( make_item( 12 ), start + 100 ) );
+      BOOST_CHECK_EQUAL( items.size(), 1u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( peer_score_test )
+{
+   try {
+      using graphene::net::peer_connection;
+      using graphene::net::peer_connection_ptr;
+      // the test peers never connect, so they count as connected for the whole window
+      const fc::time_point now( fc::seconds( 1000000 ) );
+      const double scale = GRAPHENE_NET_PEER_SCORE_DELIVERY_RATE_SCALE;
+      const uint32_t window = GRAPHENE_NET_PEER_SCORE_DELIVERY_WINDOW;
+      const double default_latency_factor = 1.0 / ( 1.0 + GRAPHENE_NET_PEER_SCORE_DEFAULT_ROUND_TRIP_DELAY_MS
+                                                          / double( GRAPHENE_NET_PEER_SCORE_ROUND_TRIP_DELAY_SCALE_MS ) );
+
+      peer_connection_ptr peer = peer_connection::make_shared( nullptr );
+      BOOST_CHECK_CLOSE( peer->get_score( now ), default_latency_factor, 1e-9 );
+
+      // a small item that arrives at once is not a high delivery rate, only the bytes in the window count
+      peer->record_item_delivered( 100, fc::microseconds( 1 ), now );
+      BOOST_CHECK_CLOSE( peer->get_delivery_rate( now ), 100.0 / window, 1e-9 );
+
+      // one window's worth of the scale doubles the throughput factor, however the bytes are split
+      peer->record_item_delivered( uint64_t( scale * window ) - 100, fc::seconds( 10 ), now + fc::seconds( 1 ) );
+      BOOST_CHECK_CLOSE( peer->get_delivery_rate( now + fc::seconds( 1 ) ), scale, 1e-9 );
+      BOOST_CHECK_CLOSE( peer->get_score( now + fc::seconds( 1 ) ), 2 * default_latency_factor, 1e-9 );
+
+      // deliveries older than the window no longer count
+      BOOST_CHECK_CLOSE( peer->get_delivery_rate( now + fc::seconds( window ) ), scale - 100.0 / window, 1e-9 );
+      BOOST_CHECK_EQUAL( peer->get_delivery_rate( now + fc::seconds( window + 1 ) ), 0.0 );
+      peer->record_item_delivered( 600, fc::seconds( 1 ), now + fc::seconds( 2 * window ) );
+      BOOST_CHECK_EQUAL( peer->recent_deliveries.size(), 1u );
+      BOOST_CHECK_CLOSE( peer->get_delivery_rate( now + fc::seconds( 2 * window ) ), 600.0 / window, 1e-9 );
+
+      // a measured round trip replaces the default, and failed requests lower the score
+      peer_connection_ptr other = peer_connection::make_shared( nullptr );
+      other->record_round_trip_delay( fc::milliseconds( GRAPHENE_NET_PEER_SCORE_ROUND_TRIP_DELAY_SCALE_MS ) );
+      BOOST_CHECK_CLOSE( other->get_score( now ), 0.5, 1e-9 );
+      other->record_item_not_delivered();
+      BOOST_CHECK_CLOSE( other->get_score( now ), 0.5 * ( 1 - GRAPHENE_NET_PEER_SCORE_SMOOTHING_FACTOR ), 1e-9 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( find_slow_peer_test )
+{
+   try {
+      using graphene::net::peer_connection;
+      using graphene::net::peer_connection_ptr;
+      using graphene::net::find_slow_peer;
+      const fc::time_point now( fc::seconds( 1000000 ) );
+      const fc::time_point connected_before = now - fc::seconds( 300 );
+
+      // three peers that deliver what they are asked for, and one that fails most requests
+      std::vector<peer_connection_ptr> peers;
+      for( int i = 0; i < 4; ++i )
+      {
+         peer_connection_ptr peer = peer_connection::make_shared( nullptr );
+         peer->we_need_sync_items_from_peer = false;
+         for( uint32_t j = 0; j < GRAPHENE_NET_PEER_SCORE_MIN_SAMPLES; ++j )
+         {
+            if( i == 2 && j % 4 != 0 )
+               peer->record_item_not_delivered();
+            else
+               peer->record_item_delivered( 64 * 1024, fc::milliseconds( 100 ), now );
+         }
+         peers.push_back( peer );
+      }
+      BOOST_CHECK( find_slow_peer( peers, connected_before, now ) == peers[2] );
+      // only peers connected before the cutoff are judged
+      BOOST_CHECK( !find_slow_peer( peers, fc::time_point(), now ) );
+
+      // a peer still syncing from us, or asked for too few items, is not judged, and two peers are too few
+      peers[0]->we_need_sync_items_from_peer = true;
+      BOOST_CHECK( find_slow_peer( peers, connected_before, now ) == peers[2] );
+      peers[1]->number_of_item_requests_scored = GRAPHENE_NET_PEER_SCORE_MIN_SAMPLES - 1;
+      BOOST_CHECK( !find_slow_peer( peers, connected_before, now ) );
+
+      // a peer somewhat slower than the median is kept
+      peers[0]->we_need_sync_items_from_peer = false;
+      peers[1]->number_of_item_requests_scored = GRAPHENE_NET_PEER_SCORE_MIN_SAMPLES;
+      peers[2] = peer_connection::make_shared( nullptr );
+      peers[2]->we_need_sync_items_from_peer = false;
+      for( uint32_t j = 0; j < GRAPHENE_NET_PEER_SCORE_MIN_SAMPLES; ++j )
+         peers[2]->record_item_delivered( 16 * 1024, fc::milliseconds( 100 ), now );
+      BOOST_CHECK( !find_slow_peer( peers, connected_before, now ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/hardfork.hpp>
+#include <graphene/chain/market_object.hpp>
+
+#include <fc/io/raw.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+
+BOOST_FIXTURE_TEST_SUITE( block_tests, database_fixture )
+
+BOOST_AUTO_TEST_CASE( prepared_block_test )
+{
+   try {
+      ACTORS((1000)(2000));
+      const share_type prec = asset::scaled_precision( asset_id_type()(db).precision );
+      const uint32_t skip = ~0;
+      generate_block();
+
+      uint32_t pending_notifications = 0;
+      auto connection = db.on_pending_transaction.connect( [&pending_notifications]( const signed_transaction& ) {
+         ++pending_notifications;
+      } );
+
+      transfer( committee_account, u_2000_id, asset( 1 * prec ) );
+      const fc::time_point_sec when = db.get_slot_time( 1 );
+      const account_uid_type witness = db.get_scheduled_witness( 1 );
+      db.prepare_block( when, witness, skip );
+      BOOST_CHECK( db.has_prepared_block( when, witness, skip ) );
+      BOOST_CHECK( !db.has_prepared_block( when, witness, database::skip_nothing ) );
+      BOOST_CHECK_EQUAL( db.pending_transaction_count(), 1u );
+
+      // a new pending transaction makes the prepared block stale
+      transfer( committee_account, u_2000_id, asset( 2 * prec ) );
+      BOOST_CHECK( !db.has_prepared_block( when, witness, skip ) );
+      db.prepare_block( when, witness, skip );
+      BOOST_CHECK( db.has_prepared_block( when, witness, skip ) );
+      const share_type pending_balance = db.get_balance( u_2000_id, GRAPHENE_CORE_ASSET_AID ).amount;
+
+      // preparing rebuilds the pending state without announcing the pending transactions again
+      BOOST_CHECK_EQUAL( pending_notifications, 2u );
+      BOOST_CHECK_EQUAL( db.pending_transaction_count(), 2u );
+      connection.disconnect();
+
+      const signed_block block = generate_block();
+      BOOST_CHECK( block.timestamp == when );
+      BOOST_CHECK_EQUAL( block.transactions.size(), 2u );
+      BOOST_CHECK( block.transaction_merkle_root == block.calculate_merkle_root() );
+      BOOST_CHECK( !db.has_prepared_block( when, witness, skip ) );
+      BOOST_CHECK_EQUAL( db.head_block_num(), block.block_num() );
+      BOOST_CHECK_EQUAL( db.get_balance( u_2000_id, GRAPHENE_CORE_ASSET_AID ).amount.value, pending_balance.value );
+
+      // the steps done ahead of the slot are not counted in the generation time
+      const block_generation_stats& stats = db.get_last_block_generation_stats();
+      BOOST_CHECK( stats.prepared );
+      BOOST_CHECK_EQUAL( stats.apply_pending_time.count(), 0 );
+      BOOST_CHECK_EQUAL( stats.merkle_time.count(), 0 );
+      BOOST_CHECK_EQUAL( stats.transactions, 2u );
+      BOOST_CHECK_EQUAL( stats.postponed_transactions, 0u );
+      BOOST_CHECK_EQUAL( stats.block_size, fc::raw::pack_size( block ) );
+
+      transfer( committee_account, u_2000_id, asset( 3 * prec ) );
+      generate_block();
+      BOOST_CHECK( !db.get_last_block_generation_stats().prepared );
+      BOOST_CHECK_EQUAL( db.get_last_block_generation_stats().prepared_apply_pending_time.count(), 0 );
+      BOOST_CHECK_EQUAL( db.get_last_block_generation_stats().transactions, 1u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( prepared_block_head_change_test )
+{
+   try {
+      ACTORS((1000)(2000));
+      const share_type prec = asset::scaled_precision( asset_id_type()(db).precision );
+      const uint32_t skip = ~0;
+      generate_block();
+
+      // a block prepared for the second slot is dropped once another block fills the first one
+      transfer( committee_account, u_2000_id, asset( 1 * prec ) );
+      const fc::time_point_sec when = db.get_slot_time( 2 );
+      const account_uid_type witness = db.get_scheduled_witness( 2 );
+      db.prepare_block( when, witness, skip );
+      BOOST_CHECK( db.has_prepared_block( when, witness, skip ) );
+      const signed_block first = generate_block();
+      BOOST_CHECK_EQUAL( first.transactions.size(), 1u );
+      BOOST_CHECK( !db.has_prepared_block( when, witness, skip ) );
+      const signed_block second = generate_block();
+      BOOST_CHECK( second.timestamp == when );
+      BOOST_CHECK( second.previous == first.id() );
+      BOOST_CHECK( second.transactions.empty() );
+
+      // popping the head block drops a block prepared on it, and leaves the popped transactions alone
+      transfer( committee_account, u_2000_id, asset( 2 * prec ) );
+      generate_block();
+      db.prepare_block( db.get_slot_time( 1 ), db.get_scheduled_witness( 1 ), skip );
+      BOOST_CHECK( db.has_prepared_block( db.get_slot_time( 1 ), db.get_scheduled_witness( 1 ), skip ) );
+      db.pop_block();
+      BOOST_CHECK( !db.has_prepared_block( db.get_slot_time( 1 ), db.get_scheduled_witness( 1 ), skip ) );
+      db.clear_pending();
+      BOOST_REQUIRE_EQUAL( db._popped_tx.size(), 1u );
+      db.prepare_block( db.get_slot_time( 1 ), db.get_scheduled_witness( 1 ), skip );
+      BOOST_CHECK_EQUAL( db._popped_tx.size(), 1u );
+      BOOST_CHECK_EQUAL( db.pending_transaction_count(), 0u );
+
+      // the popped transaction is pending again after the next block
+      const signed_block replacement = generate_block();
+      BOOST_CHECK( replacement.previous == second.id() );
+      BOOST_CHECK( replacement.transactions.empty() );
+      BOOST_CHECK( db._popped_tx.empty() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( prepared_block_time_dependent_test )
+{
+   try {
+      ACTORS((1000)(2000));
+      const share_type prec = asset::scaled_precision( asset_id_type()(db).precision );
+      const uint32_t skip = ~0;
+      transfer( committee_account, u_1000_id, asset( 10000 * prec ) );
+      add_csaf_for_account( u_1000_id, 10000 );
+      generate_blocks( HARDFORK_0_5_TIME, true );
+
+      asset_options aopts;
+      aopts.max_supply = 100000000 * prec;
+      aopts.issuer_permissions = 15;
+      aopts.description = "prepared block test asset";
+      create_asset( { u_1000_private_key }, u_1000_id, "MKTA", 5, aopts, 100000000 * prec );
+      generate_block();
+      const asset_aid_type mkta = 1;
+
+      // an order that expires after the head block but before the slot is only valid while pending
+      const fc::time_point_sec when = db.get_slot_time( 1 );
+      const account_uid_type witness = db.get_scheduled_witness( 1 );
+      transfer( committee_account, u_2000_id, asset( 1 * prec ) );
+      create_limit_order( { u_1000_private_key }, u_1000_id, mkta, 100, GRAPHENE_CORE_ASSET_AID, 10,
+                          db.head_block_time().sec_since_epoch() + 1, false );
+      BOOST_REQUIRE_EQUAL( db.pending_transaction_count(), 2u );
+
+      // the block is prepared at the slot time, so the order is left out of it and stays pending
+      db.prepare_block( when, witness, skip );
+      BOOST_REQUIRE( db.has_prepared_block( when, witness, skip ) );
+      BOOST_CHECK_EQUAL( db.pending_transaction_count(), 2u );
+
+      const signed_block block = generate_block();
+      BOOST_CHECK( db.get_last_block_generation_stats().prepared );
+      BOOST_CHECK( block.timestamp == when );
+      BOOST_REQUIRE_EQUAL( block.transactions.size(), 1u );
+      BOOST_CHECK( block.transactions.front().operations.front().which() == operation::tag<transfer_operation>::value );
+      BOOST_CHECK_EQUAL( db.head_block_num(), block.block_num() );
+      BOOST_CHECK( db.get_index_type<limit_order_index>().indices().empty() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
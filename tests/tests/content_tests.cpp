@@ -15,6 +15,7 @@
 #include <graphene/chain/witness_object.hpp>
 #include <graphene/chain/advertising_object.hpp>
 #include <graphene/chain/custom_vote_object.hpp>
+#include <graphene/app/database_api.hpp>
 
 #include <fc/crypto/digest.hpp>
 #include <fc/log/logger.hpp>
@@ -1796,18 +1797,137 @@ BOOST_AUTO_TEST_CASE(custom_vote_test)
       BOOST_CHECK(obj.vote_result.at(2) == 20000 * prec);
       BOOST_CHECK(obj.vote_result.at(3) == 20000 * prec);
 
+      // balance changes are added to the stored tallies lazily, queries include them
+      graphene::app::database_api db_api(db);
+      auto tally = [&]() -> std::vector<uint64_t>
+      {  return db_api.lookup_custom_votes(u_9000_id, 1, 1).front().vote_result;    };
+
       transfer(committee_account, u_1000_id, _core(40000));
-      BOOST_CHECK(obj.vote_result.at(0) == 60000 * prec);
-      BOOST_CHECK(obj.vote_result.at(1) == 70000 * prec);
-      BOOST_CHECK(obj.vote_result.at(2) == 20000 * prec);
-      BOOST_CHECK(obj.vote_result.at(3) == 20000 * prec);
+      BOOST_CHECK(tally().at(0) == 60000 * prec);
+      BOOST_CHECK(tally().at(1) == 70000 * prec);
+      BOOST_CHECK(tally().at(2) == 20000 * prec);
+      BOOST_CHECK(tally().at(3) == 20000 * prec);
 
       transfer(u_3000_id, u_1000_id, _core(5000));
-      BOOST_CHECK(obj.vote_result.at(0) == 65000 * prec);
-      BOOST_CHECK(obj.vote_result.at(1) == 75000 * prec);
-      BOOST_CHECK(obj.vote_result.at(2) == 15000 * prec);
-      BOOST_CHECK(obj.vote_result.at(3) == 15000 * prec);
+      BOOST_CHECK(tally().at(0) == 65000 * prec);
+      BOOST_CHECK(tally().at(1) == 75000 * prec);
+      BOOST_CHECK(tally().at(2) == 15000 * prec);
+      BOOST_CHECK(tally().at(3) == 15000 * prec);
+
+   }
+   catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE(custom_vote_lazy_tally_test)
+{
+   try{
+      ACTORS((1000)(2000)(3000)(9000));
 
+      const share_type prec = asset::scaled_precision(asset_id_type()(db).precision);
+      auto _core = [&](int64_t x) -> asset
+      {  return asset(x*prec);    };
+      for (auto uid : { u_1000_id, u_2000_id, u_3000_id, u_9000_id })
+      {
+         transfer(committee_account, uid, _core(10000));
+         add_csaf_for_account(uid, 10000);
+      }
+      generate_blocks(HARDFORK_0_4_TIME, true);
+
+      // the tallies as the eager implementation kept them: every balance change of a voter is added
+      // right away to the options it chose in its votes that have not expired yet
+      std::map<custom_vote_vid_type, time_point_sec> expiration;
+      std::map<custom_vote_vid_type, std::vector<int64_t>> expected;
+      std::map<account_uid_type, std::map<custom_vote_vid_type, std::set<uint8_t>>> casts;
+      auto create = [&](custom_vote_vid_type vid, uint32_t seconds)
+      {
+         expiration[vid] = db.head_block_time() + seconds;
+         expected[vid] = std::vector<int64_t>(4, 0);
+         create_custom_vote({ u_9000_private_key }, u_9000_id, vid, "title", "description", expiration[vid],
+            0, share_type(1000000), 1, 3, { "aa", "bb", "cc", "dd" });
+      };
+      auto cast = [&](account_uid_type voter, const fc::ecc::private_key& key, custom_vote_vid_type vid, std::set<uint8_t> options)
+      {
+         const int64_t votes = db.get_account_statistics_by_uid(voter).get_votes_from_core_balance();
+         for (auto o : casts[voter][vid])
+            expected[vid][o] -= votes;
+         for (auto o : options)
+            expected[vid][o] += votes;
+         casts[voter][vid] = options;
+         cast_custom_vote({ key }, voter, u_9000_id, vid, options);
+      };
+      auto adjust = [&](account_uid_type voter, int64_t amount)
+      {
+         for (const auto& c : casts[voter])
+            if (expiration[c.first] >= db.head_block_time())
+               for (auto o : c.second)
+                  expected[c.first][o] += amount;
+      };
+      auto move = [&](account_uid_type from, account_uid_type to, int64_t amount)
+      {
+         transfer(from, to, _core(amount));
+         adjust(from, -amount * prec.value);
+         adjust(to, amount * prec.value);
+      };
+      graphene::app::database_api db_api(db);
+      auto check = [&](bool stored)
+      {
+         for (const auto& e : expected)
+         {
+            const auto& vote = db.get_custom_vote_by_vid(u_9000_id, e.first);
+            const auto queried = db_api.lookup_custom_votes(u_9000_id, e.first, 1).front().vote_result;
+            // fetching the object by id includes the pending amounts as well
+            const auto fetched = db_api.get_objects({ vote.id })[0].as<custom_vote_object>(GRAPHENE_MAX_NESTED_OBJECTS).vote_result;
+            for (size_t i = 0; i < e.second.size(); ++i)
+            {
+               BOOST_CHECK_EQUAL(int64_t(queried.at(i)), e.second[i]);
+               BOOST_CHECK_EQUAL(int64_t(fetched.at(i)), e.second[i]);
+               if (stored)
+                  BOOST_CHECK_EQUAL(int64_t(vote.vote_result.at(i)), e.second[i]);
+            }
+         }
+      };
+
+      create(1, 100000);
+      create(2, 600);
+      cast(u_1000_id, u_1000_private_key, 1, { 0, 1 });
+      cast(u_1000_id, u_1000_private_key, 2, { 0 });
+      cast(u_2000_id, u_2000_private_key, 1, { 2 });
+      cast(u_2000_id, u_2000_private_key, 2, { 1 });
+      cast(u_3000_id, u_3000_private_key, 2, { 0, 1 });
+
+      // many transfers only touch the pending amounts
+      for (int i = 0; i < 10; ++i)
+      {
+         move(u_1000_id, u_2000_id, 100 + i);
+         move(u_3000_id, u_1000_id, 10);
+      }
+      move(committee_account, u_3000_id, 500);
+      check(false);
+      generate_block();
+      check(false);
+
+      // a cast adds the pending amount to the votes cast before it
+      move(u_2000_id, u_1000_id, 50);
+      cast(u_1000_id, u_1000_private_key, 1, { 3 });
+      move(u_1000_id, u_3000_id, 20);
+      check(false);
+
+      // vote 2 expires, later transfers only count for vote 1
+      generate_blocks(expiration[2] + 10);
+      check(false);
+      move(u_1000_id, u_2000_id, 30);
+      move(u_3000_id, u_2000_id, 40);
+      check(false);
+
+      // once every vote has expired all pending amounts are in the stored tallies
+      generate_blocks(expiration[1] + 10);
+      move(u_1000_id, u_2000_id, 70);
+      generate_block();
+      check(true);
+      BOOST_CHECK(db.get_index_type<custom_vote_pending_index>().indices().empty());
    }
    catch (fc::exception& e) {
       edump((e.to_detail_string()));
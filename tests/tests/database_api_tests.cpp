@@ -0,0 +1,285 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/app/counting_bloom_filter.hpp>
+#include <graphene/app/database_api.hpp>
+
+#include <graphene/chain/protocol/protocol.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::app;
+
+namespace {
+
+/// collects the names of the methods of an fc::api
+struct api_method_names
+{
+   std::set<std::string>& names;
+
+   template<typename Member>
+   void operator()( const char* name, Member& )const
+   {
+      names.insert( name );
+   }
+};
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE( database_api_tests, database_fixture )
+
+BOOST_AUTO_TEST_CASE( counting_bloom_filter_test )
+{
+   try {
+      counting_bloom_filter filter( 1024 );
+      for( uint64_t key = 0; key < 100; ++key )
+         filter.insert( key * 7919 );
+      for( uint64_t key = 0; key < 100; ++key )
+         BOOST_CHECK( filter.may_contain( key * 7919 ) );
+
+      // removing half the keys never hides the others
+      for( uint64_t key = 0; key < 100; key += 2 )
+         filter.remove( key * 7919 );
+      uint32_t false_positives = 0;
+      for( uint64_t key = 0; key < 100; ++key )
+      {
+         if( key % 2 )
+            BOOST_CHECK( filter.may_contain( key * 7919 ) );
+         else if( filter.may_contain( key * 7919 ) )
+            ++false_positives;
+      }
+      BOOST_CHECK_LT( false_positives, 10u );
+
+      // a key inserted twice is still there after one removal
+      filter.insert( 1 );
+      filter.insert( 1 );
+      filter.remove( 1 );
+      BOOST_CHECK( filter.may_contain( 1 ) );
+      filter.remove( 1 );
+
+      // saturated counters stay put, so a key can't be lost through them
+      counting_bloom_filter small( 1 );
+      for( uint32_t i = 0; i < 300; ++i )
+         small.insert( 42 );
+      for( uint32_t i = 0; i < 300; ++i )
+         small.remove( 42 );
+      BOOST_CHECK( small.may_contain( 42 ) );
+
+      counting_bloom_filter empty;
+      BOOST_CHECK( !empty.may_contain( 0 ) );
+      BOOST_CHECK( !empty.may_contain( 42 ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( subscription_registry_test )
+{
+   try {
+      ACTORS((1000)(2000));
+      const share_type prec = asset::scaled_precision( asset_id_type()(db).precision );
+      generate_block();
+      BOOST_CHECK_EQUAL( db.impacted_account_listeners, 0u );
+
+      vector<variant> account_updates;
+      vector<variant> object_updates;
+      uint32_t unsubscribed_calls = 0;
+      auto collect = []( vector<variant>& updates ) {
+         return [&updates]( const variant& v ) {
+            for( const variant& update : v.get_array() )
+               updates.push_back( update );
+         };
+      };
+      auto contains_object = []( const vector<variant>& updates, const object_id_type& id ) -> bool {
+         for( const variant& update : updates )
+            if( update.is_object() && update.get_object().contains( "id" ) &&
+                update.get_object()["id"].as<object_id_type>( 1 ) == id )
+               return true;
+         return false;
+      };
+
+      // an account subscriber, an object subscriber, and a connection without a callback
+      database_api account_api( db );
+      account_api.set_subscribe_callback( collect( account_updates ), false );
+      account_api.get_full_accounts( { fc::to_string( u_1000_id ) }, true );
+      BOOST_CHECK_EQUAL( db.impacted_account_listeners, 1u );
+
+      database_api object_api( db );
+      object_api.set_subscribe_callback( collect( object_updates ), false );
+      object_api.get_objects( { dynamic_global_property_id_type() } );
+      BOOST_CHECK_EQUAL( db.impacted_account_listeners, 1u );
+
+      database_api silent_api( db );
+      silent_api.get_full_accounts( { fc::to_string( u_2000_id ) }, true );
+      silent_api.get_objects( { dynamic_global_property_id_type() } );
+      BOOST_CHECK_EQUAL( db.impacted_account_listeners, 1u );
+
+      // a block that doesn't touch u1000 only reaches the object subscriber
+      transfer( committee_account, u_2000_id, asset( 1 * prec ) );
+      generate_block();
+      fc::usleep( fc::milliseconds( 50 ) );
+      BOOST_CHECK( account_updates.empty() );
+      BOOST_CHECK( contains_object( object_updates, dynamic_global_property_id_type() ) );
+
+      object_updates.clear();
+      transfer( committee_account, u_1000_id, asset( 1 * prec ) );
+      generate_block();
+      fc::usleep( fc::milliseconds( 50 ) );
+      BOOST_CHECK( !account_updates.empty() );
+      // object subscribers only get the objects they watch
+      BOOST_REQUIRE_EQUAL( object_updates.size(), 1u );
+      BOOST_CHECK( contains_object( object_updates, dynamic_global_property_id_type() ) );
+
+      // dropping the only account subscription lowers impacted_account_listeners again
+      account_api.set_subscribe_callback( [&unsubscribed_calls]( const variant& ) { ++unsubscribed_calls; }, false );
+      BOOST_CHECK_EQUAL( db.impacted_account_listeners, 0u );
+      account_api.get_full_accounts( { fc::to_string( u_1000_id ) }, true );
+      BOOST_CHECK_EQUAL( db.impacted_account_listeners, 1u );
+      account_api.cancel_all_subscriptions();
+      BOOST_CHECK_EQUAL( db.impacted_account_listeners, 0u );
+
+      transfer( committee_account, u_1000_id, asset( 1 * prec ) );
+      generate_block();
+      fc::usleep( fc::milliseconds( 50 ) );
+      BOOST_CHECK_EQUAL( unsubscribed_calls, 0u );
+
+      // a destroyed connection leaves nothing behind in the registry
+      {
+         database_api temporary_api( db );
+         temporary_api.set_subscribe_callback( collect( account_updates ), false );
+         temporary_api.get_full_accounts( { fc::to_string( u_2000_id ) }, true );
+         BOOST_CHECK_EQUAL( db.impacted_account_listeners, 1u );
+      }
+      BOOST_CHECK_EQUAL( db.impacted_account_listeners, 0u );
+
+      // past api-limit-subscribed-objects a connection watches no further objects
+      application_options options;
+      options.api_limit_subscribed_objects = 1;
+      vector<variant> limited_updates;
+      database_api limited_api( db, &options );
+      limited_api.set_subscribe_callback( collect( limited_updates ), false );
+      limited_api.get_objects( { object_id_type( global_property_id_type() ),
+                                 object_id_type( dynamic_global_property_id_type() ) } );
+      object_updates.clear();
+      generate_block();
+      fc::usleep( fc::milliseconds( 50 ) );
+      BOOST_CHECK( contains_object( object_updates, dynamic_global_property_id_type() ) );
+      BOOST_CHECK( !contains_object( limited_updates, dynamic_global_property_id_type() ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( cacheable_methods_test )
+{
+   try {
+      // every name api-cache-methods accepts is a database API method
+      std::set<std::string> names;
+      fc::api<database_api> api( std::make_shared<database_api>( db ) );
+      api->visit( api_method_names{ names } );
+      BOOST_REQUIRE( !database_api::cacheable_methods().empty() );
+      for( const std::string& method : database_api::cacheable_methods() )
+         BOOST_CHECK_MESSAGE( names.count( method ), method + " is not a database API method" );
+
+      application_options options;
+      options.api_cache_methods = { "get_dynamic_global_properties" };
+      database_api cached_api( db, &options );
+      const auto method_counters = [&cached_api]( const std::string& method ) -> fc::variant_object {
+         const fc::variant_object info = cached_api.get_response_cache_info();
+         const fc::variant_object& methods = info["methods"].get_object();
+         return methods.contains( method.c_str() ) ? methods[method].get_object() : fc::variant_object();
+      };
+
+      const auto first = cached_api.get_dynamic_global_properties();
+      const auto second = cached_api.get_dynamic_global_properties();
+      BOOST_CHECK( first.head_block_id == second.head_block_id );
+      BOOST_CHECK_EQUAL( method_counters( "get_dynamic_global_properties" )["misses"].as_uint64(), 1u );
+      BOOST_CHECK_EQUAL( method_counters( "get_dynamic_global_properties" )["hits"].as_uint64(), 1u );
+
+      // methods that aren't configured are never cached
+      cached_api.get_global_properties();
+      cached_api.get_global_properties();
+      BOOST_CHECK_EQUAL( method_counters( "get_global_properties" ).size(), 0u );
+
+      // a new block empties the cache
+      generate_block();
+      const auto third = cached_api.get_dynamic_global_properties();
+      BOOST_CHECK( third.head_block_id == db.head_block_id() );
+      BOOST_CHECK_EQUAL( method_counters( "get_dynamic_global_properties" )["misses"].as_uint64(), 2u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( cache_eviction_after_stale_entries )
+{
+   try {
+      ACTORS((1000)(2000)(3000));
+      generate_block();
+      generate_block();
+
+      application_options options;
+      options.api_cache_methods = { "get_accounts_by_uid" };
+      uint64_t entry_size = 0;
+      {
+         database_api sizing_api( db, &options );
+         sizing_api.get_accounts_by_uid( { u_1000_id } );
+         entry_size = sizing_api.get_response_cache_info()["size"].as_uint64();
+      }
+
+      // room for two entries, not three
+      options.api_cache_max_size = entry_size * 5 / 2;
+      database_api cached_api( db, &options );
+      const auto counters = [&cached_api]() -> fc::variant_object {
+         return cached_api.get_response_cache_info()["methods"]["get_accounts_by_uid"].get_object();
+      };
+      cached_api.get_accounts_by_uid( { u_1000_id } );
+      cached_api.get_accounts_by_uid( { u_2000_id } );
+
+      // popping a block changes the head without emptying the cache, so both entries are stale.
+      // Computing the first one again makes it the newest, and the stale second one is evicted next
+      db.pop_block();
+      cached_api.get_accounts_by_uid( { u_1000_id } );
+      cached_api.get_accounts_by_uid( { u_3000_id } );
+      BOOST_CHECK_EQUAL( cached_api.get_response_cache_info()["evictions"].as_uint64(), 1u );
+      BOOST_CHECK_EQUAL( cached_api.get_response_cache_info()["entries"].as_uint64(), 2u );
+
+      const uint64_t hits = counters()["hits"].as_uint64();
+      cached_api.get_accounts_by_uid( { u_1000_id } );
+      cached_api.get_accounts_by_uid( { u_3000_id } );
+      BOOST_CHECK_EQUAL( counters()["hits"].as_uint64(), hits + 2 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,467 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/app/api_cost_limiter.hpp>
+#include <graphene/app/websocket_rpc_connection.hpp>
+
+#include <fc/api.hpp>
+#include <fc/exception/exception.hpp>
+#include <fc/io/json.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/// A small API to call over a websocket_rpc_connection
+struct rpc_test_api
+{
+   uint32_t echo_calls = 0;
+
+   bool     login( const std::string& user, const std::string& password ) { return password == "secret"; }
+   uint32_t echo( uint32_t value ) { ++echo_calls; return value; }
+   uint32_t fail( uint32_t value ) { FC_THROW( "failing on purpose with ${v}", ("v", value) ); }
+};
+
+FC_API( rpc_test_api, (login)(echo)(fail) )
+
+using namespace graphene::app;
+
+namespace {
+
+/// Keeps what the server sends instead of writing it to a socket
+class test_websocket_connection : public fc::http::websocket_connection
+{
+   public:
+      void send_message( const std::string& message ) override { sent.push_back( message ); }
+      void close( int64_t, const std::string& ) override {}
+      std::string get_request_header( const std::string& ) override { return std::string(); }
+
+      std::vector<std::string> sent;
+};
+
+struct rpc_connection_fixture
+{
+   test_websocket_connection                  connection;
+   std::shared_ptr<rpc_test_api>              api = std::make_shared<rpc_test_api>();
+   std::shared_ptr<websocket_rpc_connection>  rpc;
+
+   void connect( uint32_t max_batch_size = 10,
+                 std::shared_ptr<api_cost_limiter> cost_limiter = std::shared_ptr<api_cost_limiter>() )
+   {
+      rpc = std::make_shared<websocket_rpc_connection>( connection, 20, max_batch_size, cost_limiter );
+      BOOST_REQUIRE_EQUAL( rpc->register_api( fc::api<rpc_test_api>( api ) ), 0u );
+   }
+
+   /// sends @p message to the server over @p to, @return the parsed reply or null if there was none
+   static fc::variant send_to( test_websocket_connection& to, const std::string& message )
+   {
+      to.sent.clear();
+      to.on_message( message );
+      if( to.sent.empty() )
+         return fc::variant();
+      BOOST_REQUIRE_EQUAL( to.sent.size(), 1u );
+      return fc::json::from_string( to.sent.back() );
+   }
+
+   fc::variant send( const std::string& message )
+   {
+      return send_to( connection, message );
+   }
+
+   std::shared_ptr<websocket_rpc_connection> connect_other( test_websocket_connection& other,
+                                                            const std::shared_ptr<api_cost_limiter>& cost_limiter )
+   {
+      auto other_rpc = std::make_shared<websocket_rpc_connection>( other, 20, 10, cost_limiter );
+      other_rpc->register_api( fc::api<rpc_test_api>( api ) );
+      return other_rpc;
+   }
+
+   static std::shared_ptr<api_cost_limiter> make_limiter( double connection_capacity, double connection_refill,
+                                                          double user_capacity, double user_refill,
+                                                          uint32_t max_wait_ms )
+   {
+      api_cost_limiter::options options;
+      options.connection_capacity = connection_capacity;
+      options.connection_refill = connection_refill;
+      options.user_capacity = user_capacity;
+      options.user_refill = user_refill;
+      options.max_wait_ms = max_wait_ms;
+      return std::make_shared<api_cost_limiter>( options );
+   }
+
+   static std::string call( const fc::variant& id, const std::string& method, const std::string& args )
+   {
+      std::string request = "{\"jsonrpc\":\"2.0\",\"method\":\"call\",\"params\":[0,\"" + method + "\"," + args + "]";
+      if( !id.is_null() )
+         request += ",\"id\":" + fc::json::to_string( id );
+      return request + "}";
+   }
+
+   static int64_t error_code( const fc::variant& reply )
+   {
+      return reply.get_object()["error"].get_object()["code"].as_int64();
+   }
+};
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE( rpc_connection_tests, rpc_connection_fixture )
+
+BOOST_AUTO_TEST_CASE( batch_with_notifications )
+{
+   try {
+      connect();
+      const fc::variant reply = send( "[" + call( 1, "echo", "[11]" ) + "," + call( fc::variant(), "echo", "[12]" )
+                                      + "," + call( "two", "echo", "[13]" ) + "]" );
+      // every request runs, the notification gets no response
+      BOOST_CHECK_EQUAL( api->echo_calls, 3u );
+      const fc::variants& responses = reply.get_array();
+      BOOST_REQUIRE_EQUAL( responses.size(), 2u );
+      BOOST_CHECK_EQUAL( responses[0]["id"].as_uint64(), 1u );
+      BOOST_CHECK_EQUAL( responses[0]["result"].as_uint64(), 11u );
+      BOOST_CHECK_EQUAL( responses[1]["id"].as_string(), "two" );
+      BOOST_CHECK_EQUAL( responses[1]["result"].as_uint64(), 13u );
+
+      // a batch of notifications only gets no reply at all
+      BOOST_CHECK( send( "[" + call( fc::variant(), "echo", "[14]" ) + "]" ).is_null() );
+      BOOST_CHECK_EQUAL( api->echo_calls, 4u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( batch_size_limit )
+{
+   try {
+      connect( 2 );
+      const std::string two = call( 1, "echo", "[1]" ) + "," + call( 2, "echo", "[2]" );
+      BOOST_CHECK_EQUAL( send( "[" + two + "]" ).get_array().size(), 2u );
+      BOOST_CHECK_EQUAL( api->echo_calls, 2u );
+
+      // a batch over the limit is refused as a whole, nothing in it runs
+      const fc::variant too_large = send( "[" + two + "," + call( 3, "echo", "[3]" ) + "]" );
+      BOOST_REQUIRE( too_large.is_object() );
+      BOOST_CHECK_EQUAL( error_code( too_large ), -32600 );
+      BOOST_CHECK( too_large["id"].is_null() );
+      BOOST_CHECK_EQUAL( api->echo_calls, 2u );
+
+      BOOST_CHECK_EQUAL( error_code( send( "[]" ) ), -32600 );
+      BOOST_CHECK_EQUAL( error_code( send( "[{\"id\":1," ) ), -32700 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( batch_error_elements )
+{
+   try {
+      connect();
+      rpc->register_streamed_method( 0, "crash", []( const fc::variants& ) -> std::string { throw 42; } );
+      const fc::variant reply = send( "[42,"
+                                      "{\"id\":3,\"jsonrpc\":\"2.0\",\"params\":[]},"
+                                      "{\"id\":4,\"jsonrpc\":\"2.0\",\"method\":\"call\",\"params\":{}},"
+                                      "{\"id\":[5],\"jsonrpc\":\"2.0\",\"method\":\"call\",\"params\":[]},"
+                                      + call( 6, "fail", "[6]" ) + ","
+                                      + call( 7, "crash", "[]" ) + ","
+                                      + call( 8, "echo", "[8]" ) + "]" );
+      const fc::variants& responses = reply.get_array();
+      BOOST_REQUIRE_EQUAL( responses.size(), 7u );
+
+      // malformed elements are invalid requests, answered with their id where it is usable
+      BOOST_CHECK_EQUAL( error_code( responses[0] ), -32600 );
+      BOOST_CHECK( responses[0]["id"].is_null() );
+      BOOST_CHECK_EQUAL( error_code( responses[1] ), -32600 );
+      BOOST_CHECK_EQUAL( responses[1]["id"].as_uint64(), 3u );
+      BOOST_CHECK_EQUAL( error_code( responses[2] ), -32600 );
+      BOOST_CHECK_EQUAL( responses[2]["id"].as_uint64(), 4u );
+      BOOST_CHECK_EQUAL( error_code( responses[3] ), -32600 );
+      BOOST_CHECK( responses[3]["id"].is_null() );
+
+      // an exception of the called method is reported as by a single call
+      BOOST_CHECK_EQUAL( responses[4]["id"].as_uint64(), 6u );
+      BOOST_CHECK( responses[4].get_object().contains( "error" ) );
+      BOOST_CHECK_NE( error_code( responses[4] ), -32600 );
+      BOOST_CHECK_NE( error_code( responses[4] ), -32603 );
+      BOOST_CHECK( responses[4]["error"]["message"].as_string().find( "failing on purpose" ) != std::string::npos );
+
+      // a failure of the server around the call is an internal error, and the batch goes on
+      BOOST_CHECK_EQUAL( error_code( responses[5] ), -32603 );
+      BOOST_CHECK_EQUAL( responses[5]["id"].as_uint64(), 7u );
+      BOOST_CHECK_EQUAL( responses[6]["result"].as_uint64(), 8u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( streamed_call_runs_once )
+{
+   try {
+      connect();
+      uint32_t streamed_calls = 0;
+      rpc->register_streamed_method( 0, "echo", [&streamed_calls]( const fc::variants& args ) -> std::string {
+         ++streamed_calls;
+         FC_ASSERT( args.size() == 1 && args[0].as_uint64() < 100, "echo only takes small numbers" );
+         return fc::json::to_string( args[0] );
+      });
+
+      const fc::variant result = send( call( 1, "echo", "[42]" ) );
+      BOOST_CHECK_EQUAL( result["result"].as_uint64(), 42u );
+      BOOST_CHECK_EQUAL( streamed_calls, 1u );
+
+      // a failing handler is answered with its exception, the call isn't run again by fc
+      const fc::variant error = send( call( 2, "echo", "[420]" ) );
+      BOOST_CHECK_EQUAL( streamed_calls, 2u );
+      BOOST_CHECK_EQUAL( api->echo_calls, 0u );
+      BOOST_CHECK_EQUAL( error["id"].as_uint64(), 2u );
+      BOOST_CHECK_EQUAL( error_code( error ), 1 );
+      BOOST_CHECK( error["error"]["message"].as_string().find( "echo only takes small numbers" ) != std::string::npos );
+      BOOST_CHECK( error["error"].get_object().contains( "data" ) );
+
+      // the same in a batch
+      const fc::variant batch = send( "[" + call( 3, "echo", "[420]" ) + "," + call( 4, "echo", "[4]" ) + "]" );
+      BOOST_CHECK_EQUAL( streamed_calls, 4u );
+      BOOST_CHECK_EQUAL( api->echo_calls, 0u );
+      BOOST_REQUIRE_EQUAL( batch.get_array().size(), 2u );
+      BOOST_CHECK_EQUAL( error_code( batch.get_array()[0] ), 1 );
+      BOOST_CHECK_EQUAL( batch.get_array()[1]["result"].as_uint64(), 4u );
+
+      // requests the streamed path doesn't take still reach the API
+      const fc::variant regular = send( "{\"id\":5,\"method\":\"call\",\"params\":[0,\"echo\",[5]]}" );
+      BOOST_CHECK_EQUAL( regular["result"].as_uint64(), 5u );
+      BOOST_CHECK_EQUAL( streamed_calls, 4u );
+      BOOST_CHECK_EQUAL( api->echo_calls, 1u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( token_bucket_refill )
+{
+   try {
+      api_token_bucket bucket( 10, 1000 ); // a unit per millisecond
+      BOOST_CHECK( bucket.has( 10 ) );
+      bucket.take( 10 );
+      BOOST_CHECK( !bucket.has( 5 ) );
+      const fc::microseconds wait = bucket.time_until( 5 );
+      BOOST_CHECK( wait > fc::microseconds( 0 ) );
+      BOOST_CHECK( wait <= fc::milliseconds( 5 ) + fc::microseconds( 1 ) );
+
+      fc::usleep( fc::milliseconds( 6 ) );
+      BOOST_CHECK( bucket.has( 5 ) );
+      BOOST_CHECK_EQUAL( bucket.time_until( 5 ).count(), 0 );
+
+      // refills stop at the capacity, and a call costing more only needs a full bucket
+      fc::usleep( fc::milliseconds( 20 ) );
+      BOOST_CHECK( bucket.has( 50 ) );
+      bucket.take( 15 );
+      BOOST_CHECK( !bucket.has( 1 ) );
+
+      // a bucket without refill never gets its units back
+      api_token_bucket fixed( 2, 0 );
+      fixed.take( 2 );
+      BOOST_CHECK( fixed.time_until( 1 ) == fc::microseconds::maximum() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( budget_rejection )
+{
+   try {
+      // two calls' worth of budget that never comes back
+      auto limiter = make_limiter( 2.5, 0, 0, 0, 10 );
+      connect( 10, limiter );
+      BOOST_CHECK_EQUAL( send( call( 1, "echo", "[1]" ) )["result"].as_uint64(), 1u );
+      BOOST_CHECK_EQUAL( send( call( 2, "echo", "[2]" ) )["result"].as_uint64(), 2u );
+
+      const fc::variant rejected = send( call( 3, "echo", "[3]" ) );
+      BOOST_CHECK_EQUAL( error_code( rejected ), -32005 );
+      BOOST_CHECK_EQUAL( rejected["id"].as_uint64(), 3u );
+      // a rejected notification is dropped silently
+      BOOST_CHECK( send( call( fc::variant(), "echo", "[4]" ) ).is_null() );
+      BOOST_CHECK_EQUAL( api->echo_calls, 2u );
+
+      const fc::variant_object info = limiter->get_info();
+      BOOST_CHECK_EQUAL( info["calls"].as_uint64(), 2u );
+      BOOST_CHECK_EQUAL( info["rejected"].as_uint64(), 2u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( method_stats_are_bounded )
+{
+   try {
+      auto limiter = make_limiter( 10, 0, 0, 0, 10 );
+      const size_t methods = api_cost_limiter::max_tracked_methods + 100;
+      for( size_t i = 0; i < methods; ++i )
+      {
+         limiter->record_call( "method_" + std::to_string( i ), 1, fc::microseconds( 10 ) );
+         limiter->record_rejection( "method_" + std::to_string( i ) );
+      }
+      limiter->record_call( "method_0", 1, fc::microseconds( 10 ) );
+
+      // names past the cap share one entry, and none of the calls is lost
+      const fc::variant_object info = limiter->get_info();
+      const fc::variant_object& stats = info["methods"].get_object();
+      BOOST_CHECK_EQUAL( stats.size(), api_cost_limiter::max_tracked_methods + 1 );
+      BOOST_CHECK_EQUAL( stats["method_0"]["calls"].as_uint64(), 2u );
+      BOOST_CHECK_EQUAL( stats["(other)"]["calls"].as_uint64(), 100u );
+      BOOST_CHECK_EQUAL( stats["(other)"]["rejected"].as_uint64(), 100u );
+      BOOST_CHECK_EQUAL( info["calls"].as_uint64(), methods + 1 );
+      BOOST_CHECK_EQUAL( info["rejected"].as_uint64(), methods );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( batch_shares_budget_wait )
+{
+   try {
+      // one unit every 10ms, a call waits at most 30ms
+      connect( 20, make_limiter( 1, 100, 0, 0, 30 ) );
+      std::string batch;
+      for( uint32_t i = 1; i <= 20; ++i )
+         batch += ( batch.empty() ? "[" : "," ) + call( i, "echo", "[" + std::to_string( i ) + "]" );
+      batch += "]";
+
+      // waiting for each element in turn would take 190ms, the batch only gets 30ms in all
+      const fc::time_point start = fc::time_point::now();
+      const fc::variant reply = send( batch );
+      BOOST_CHECK( fc::time_point::now() - start < fc::milliseconds( 120 ) );
+
+      const fc::variants& responses = reply.get_array();
+      BOOST_REQUIRE_EQUAL( responses.size(), 20u );
+      BOOST_CHECK_EQUAL( responses[0]["result"].as_uint64(), 1u );
+      BOOST_CHECK_EQUAL( error_code( responses[19] ), -32005 );
+      BOOST_CHECK_LT( api->echo_calls, 10u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( user_budgets_after_login )
+{
+   try {
+      auto limiter = make_limiter( 0, 0, 3.5, 0, 10 );
+      connect( 10, limiter );
+      test_websocket_connection other;
+      auto other_rpc = connect_other( other, limiter );
+      // the application starts every connection as the default user
+      rpc->set_user( "*" );
+      other_rpc->set_user( "*" );
+
+      BOOST_CHECK( send( call( 1, "login", "[\"alice\",\"secret\"]" ) )["result"].as_bool() );
+      BOOST_CHECK( send_to( other, call( 1, "login", "[\"alice\",\"secret\"]" ) )["result"].as_bool() );
+      BOOST_CHECK_EQUAL( limiter->get_info()["users"].as_uint64(), 2u );
+
+      // both connections now draw on alice's budget of three calls
+      BOOST_CHECK_EQUAL( send( call( 2, "echo", "[2]" ) )["result"].as_uint64(), 2u );
+      BOOST_CHECK_EQUAL( send_to( other, call( 2, "echo", "[2]" ) )["result"].as_uint64(), 2u );
+      BOOST_CHECK_EQUAL( send( call( 3, "echo", "[3]" ) )["result"].as_uint64(), 3u );
+      BOOST_CHECK_EQUAL( error_code( send_to( other, call( 3, "echo", "[3]" ) ) ), -32005 );
+
+      // a failed login keeps the connection on its user, no budget is made for the new name.
+      // The three logins have used up all but half a call of the default user's budget
+      test_websocket_connection third;
+      auto third_rpc = connect_other( third, limiter );
+      third_rpc->set_user( "*" );
+      BOOST_CHECK( !send_to( third, call( 1, "login", "[\"bob\",\"wrong\"]" ) )["result"].as_bool() );
+      BOOST_CHECK_EQUAL( limiter->get_info()["users"].as_uint64(), 2u );
+      BOOST_CHECK_EQUAL( error_code( send_to( third, call( 2, "echo", "[2]" ) ) ), -32005 );
+
+      // a connection no budget applies to yet still moves to the budget of the user it logs in as
+      test_websocket_connection fourth;
+      auto fourth_rpc = connect_other( fourth, limiter );
+      BOOST_CHECK_EQUAL( send_to( fourth, call( 1, "echo", "[1]" ) )["result"].as_uint64(), 1u );
+      BOOST_CHECK( send_to( fourth, call( 2, "login", "[\"alice\",\"secret\"]" ) )["result"].as_bool() );
+      BOOST_CHECK_EQUAL( error_code( send_to( fourth, call( 3, "echo", "[3]" ) ) ), -32005 );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( waiting_call_does_not_block_others )
+{
+   try {
+      // one unit every 100ms
+      auto limiter = make_limiter( 1, 10, 0, 0, 1000 );
+      connect( 10, limiter );
+      test_websocket_connection other;
+      auto other_rpc = connect_other( other, limiter );
+
+      BOOST_CHECK_EQUAL( send( call( 1, "echo", "[1]" ) )["result"].as_uint64(), 1u );
+      // the websocket server handles every message in a fiber of its own
+      connection.sent.clear();
+      fc::future<void> waiting = fc::async( [this]() { connection.on_message( call( 2, "echo", "[2]" ) ); } );
+      fc::usleep( fc::milliseconds( 10 ) );
+      BOOST_CHECK( !waiting.ready() );
+
+      // while that call waits for budget, another connection is served at once
+      const fc::time_point start = fc::time_point::now();
+      BOOST_CHECK_EQUAL( send_to( other, call( 1, "echo", "[7]" ) )["result"].as_uint64(), 7u );
+      BOOST_CHECK( fc::time_point::now() - start < fc::milliseconds( 50 ) );
+      BOOST_CHECK( !waiting.ready() );
+
+      waiting.wait();
+      BOOST_REQUIRE_EQUAL( connection.sent.size(), 1u );
+      BOOST_CHECK_EQUAL( fc::json::from_string( connection.sent.back() )["result"].as_uint64(), 2u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( http_requests_do_not_wait )
+{
+   try {
+      connect( 10, make_limiter( 1, 10, 0, 0, 1000 ) );
+      BOOST_CHECK_EQUAL( fc::json::from_string( connection.on_http( call( 1, "echo", "[1]" ) ) )["result"].as_uint64(), 1u );
+
+      // the budget refills in 100ms, but an HTTP request is rejected instead of holding the server
+      const fc::time_point start = fc::time_point::now();
+      const fc::variant rejected = fc::json::from_string( connection.on_http( call( 2, "echo", "[2]" ) ) );
+      BOOST_CHECK( fc::time_point::now() - start < fc::milliseconds( 50 ) );
+      BOOST_CHECK_EQUAL( error_code( rejected ), -32005 );
+      BOOST_CHECK( connection.sent.empty() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -26,6 +26,8 @@
 
 #include <graphene/chain/database.hpp>
 
+#include <graphene/app/database_api.hpp>
+#include <graphene/app/json_writer.hpp>
 
 #include <fc/crypto/digest.hpp>
 #include <fc/crypto/elliptic.hpp>
@@ -35,6 +37,13 @@
 
 using namespace graphene::chain;
 
+template<typename T>
+static std::string expected_json( const T& v )
+{
+   return fc::json::to_string( fc::variant( v, GRAPHENE_MAX_NESTED_OBJECTS ),
+                               fc::json::stringify_large_ints_and_doubles, GRAPHENE_MAX_NESTED_OBJECTS );
+}
+
 BOOST_FIXTURE_TEST_SUITE( operation_unit_tests, database_fixture )
 
 BOOST_AUTO_TEST_CASE( serialization_raw_test )
@@ -74,6 +83,43 @@ BOOST_AUTO_TEST_CASE( serialization_json_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( json_writer_test )
+{
+   try {
+      ACTORS((1000)(2000));
+
+      transfer_operation op;
+      op.from = u_1000_id;
+      op.to = u_2000_id;
+      op.amount = asset(100);
+      trx.operations.push_back( op );
+      trx.set_expiration( db.head_block_time() + fc::minutes(1) );
+      BOOST_CHECK_EQUAL( graphene::app::to_json( trx ), expected_json( trx ) );
+
+      generate_block();
+      for( uint32_t num = 1; num <= db.head_block_num(); ++num )
+      {
+         graphene::app::signed_block_with_info block( *db.fetch_block_by_number( num ) );
+         BOOST_CHECK_EQUAL( graphene::app::to_json( block ), expected_json( block ) );
+      }
+
+      BOOST_CHECK_EQUAL( graphene::app::to_json( u_1000 ), expected_json( u_1000 ) );
+      BOOST_CHECK_EQUAL( graphene::app::to_json( db.get_global_properties() ),
+                         expected_json( db.get_global_properties() ) );
+
+      // leaf values that need quoting or escaping
+      optional<account_uid_type> missing;
+      BOOST_CHECK_EQUAL( graphene::app::to_json( missing ), expected_json( missing ) );
+      std::pair<uint64_t, int64_t> large( uint64_t(1) << 40, -(int64_t(1) << 40) );
+      BOOST_CHECK_EQUAL( graphene::app::to_json( large ), expected_json( large ) );
+      std::vector<std::string> strings{ "plain", "quote\" and \\", "tab\t", "\xe4\xbd\xa0\xe5\xa5\xbd" };
+      BOOST_CHECK_EQUAL( graphene::app::to_json( strings ), expected_json( strings ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( json_tests )
 {
    try {
@@ -0,0 +1,157 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ *
+ * The MIT License
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+#include <boost/test/unit_test.hpp>
+
+#include <graphene/debug_witness/debug_api.hpp>
+#include <graphene/witness/witness.hpp>
+
+#include "../common/database_fixture.hpp"
+
+using namespace graphene::chain;
+using namespace graphene::witness_plugin;
+
+namespace {
+
+block_production_attempt make_attempt( production_attempt_log& log, block_production_condition::block_production_condition_enum result )
+{
+   block_production_attempt attempt;
+   attempt.sequence = log.next_sequence();
+   attempt.result = result;
+   return attempt;
+}
+
+} // anonymous namespace
+
+BOOST_FIXTURE_TEST_SUITE( witness_tests, database_fixture )
+
+BOOST_AUTO_TEST_CASE( production_attempt_log_test )
+{
+   try {
+      // the oldest attempts make room for new ones
+      production_attempt_log log( 3 );
+      for( int i = 0; i < 5; ++i )
+         log.push( make_attempt( log, block_production_condition::produced ) );
+      BOOST_CHECK_EQUAL( log.size(), 3u );
+      auto attempts = log.get_last( 10 );
+      BOOST_REQUIRE_EQUAL( attempts.size(), 3u );
+      for( size_t i = 0; i < attempts.size(); ++i )
+         BOOST_CHECK_EQUAL( attempts[i].sequence, i + 2 );
+      attempts = log.get_last( 2 );
+      BOOST_REQUIRE_EQUAL( attempts.size(), 2u );
+      BOOST_CHECK_EQUAL( attempts.front().sequence, 3u );
+      BOOST_CHECK( log.get_last( 0 ).empty() );
+
+      // the broadcast delay only reaches an attempt that is still kept
+      log.set_broadcast_delay( 3, fc::milliseconds( 5 ) );
+      log.set_broadcast_delay( 0, fc::milliseconds( 7 ) );
+      log.set_broadcast_delay( 9, fc::milliseconds( 9 ) );
+      attempts = log.get_last( 3 );
+      BOOST_CHECK( attempts[0].broadcast_delay == fc::microseconds() );
+      BOOST_CHECK( attempts[1].broadcast_delay == fc::milliseconds( 5 ) );
+      BOOST_CHECK( attempts[2].broadcast_delay == fc::microseconds() );
+
+      // a smaller capacity keeps the newest attempts, none are kept without capacity
+      log.set_capacity( 1 );
+      BOOST_REQUIRE_EQUAL( log.size(), 1u );
+      BOOST_CHECK_EQUAL( log.get_last( 10 ).front().sequence, 4u );
+      log.set_capacity( 0 );
+      log.push( make_attempt( log, block_production_condition::produced ) );
+      BOOST_CHECK_EQUAL( log.size(), 0u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( production_attempt_skipped_slots_test )
+{
+   try {
+      generate_block();
+      const std::set<account_uid_type> witnesses = { db.get_scheduled_witness( 2 ), db.get_scheduled_witness( 3 ) };
+      production_attempt_log log;
+
+      // the first slot looked at is only remembered
+      BOOST_CHECK( !log.check_slot( db, witnesses, 0 ) );
+      BOOST_CHECK( log.check_slot( db, witnesses, 1 ) );
+      BOOST_CHECK( !log.check_slot( db, witnesses, 1 ) );
+      BOOST_CHECK_EQUAL( log.size(), 0u );
+
+      // the loop did not look at slots 2 and 3, which belong to our witnesses
+      BOOST_CHECK( log.check_slot( db, witnesses, 4 ) );
+      auto attempts = log.get_last( 10 );
+      BOOST_REQUIRE_EQUAL( attempts.size(), 2u );
+      for( uint32_t i = 0; i < 2; ++i )
+      {
+         BOOST_CHECK( attempts[i].result == block_production_condition::skipped );
+         BOOST_CHECK( attempts[i].slot_time == db.get_slot_time( i + 2 ) );
+         BOOST_CHECK_EQUAL( attempts[i].witness, db.get_scheduled_witness( i + 2 ) );
+         BOOST_CHECK_EQUAL( attempts[i].sequence, i );
+      }
+
+      // once a block is in, slots are counted from it, the slot looked at last is not looked at again
+      const fc::time_point_sec last_slot_time = db.get_slot_time( 4 );
+      generate_block();
+      BOOST_CHECK( db.get_slot_time( 3 ) == last_slot_time );
+      BOOST_CHECK( !log.check_slot( db, witnesses, 3 ) );
+      BOOST_CHECK( log.check_slot( db, witnesses, 4 ) );
+      BOOST_CHECK_EQUAL( log.size(), 2u );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( debug_get_production_attempts_test )
+{
+   try {
+      graphene::debug_witness::debug_api debug_api( app );
+      GRAPHENE_REQUIRE_THROW( debug_api.debug_get_production_attempts( 10 ), fc::exception );
+
+      auto plugin = app.register_plugin<graphene::witness_plugin::witness_plugin>();
+      app.enable_plugin( "witness" );
+      BOOST_CHECK( debug_api.debug_get_production_attempts( 10 ).empty() );
+
+      production_attempt_log& log = plugin->production_attempts();
+      log.push( make_attempt( log, block_production_condition::skipped ) );
+      log.push( make_attempt( log, block_production_condition::produced ) );
+      auto attempts = debug_api.debug_get_production_attempts( 10 );
+      BOOST_REQUIRE_EQUAL( attempts.size(), 2u );
+      BOOST_CHECK( attempts[0].result == block_production_condition::skipped );
+      BOOST_CHECK( attempts[1].result == block_production_condition::produced );
+      attempts = debug_api.debug_get_production_attempts( 1 );
+      BOOST_REQUIRE_EQUAL( attempts.size(), 1u );
+      BOOST_CHECK_EQUAL( attempts.front().sequence, 1u );
+
+      // the results go out by name
+      const fc::variant v( attempts.front(), GRAPHENE_MAX_NESTED_OBJECTS );
+      BOOST_CHECK_EQUAL( v["result"].as_string(), "produced" );
+      BOOST_CHECK( v.as<block_production_attempt>( GRAPHENE_MAX_NESTED_OBJECTS ).result == block_production_condition::produced );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_SUITE_END()